@@ -60,12 +60,30 @@
 #include "src/common/parse_time.h"
 #include "src/common/slurm_auth.h"
 #include "src/common/slurm_protocol_api.h"
+#include "src/common/slurm_protocol_pack.h"
 #include "src/common/uid.h"
 #include "src/common/xstring.h"
 
 static pthread_mutex_t job_node_info_lock = PTHREAD_MUTEX_INITIALIZER;
 static node_info_msg_t *job_node_ptr = NULL;
 
+/* Packed job records from the last job information delta response, so that
+ * later polls for changes only need to transfer modified records */
+typedef struct {
+	uint32_t job_id;
+	uint32_t size;
+	char *rec;
+} job_delta_rec_t;
+
+static pthread_mutex_t job_delta_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t job_delta_version = 0;	/* 0 if no records cached */
+static char *job_delta_cluster = NULL;
+static uint16_t job_delta_protocol = 0;
+static uint16_t job_delta_show_flags = 0;
+static uint32_t job_delta_field_mask = 0;
+static uint32_t job_delta_cnt = 0;
+static job_delta_rec_t *job_delta_rec = NULL;	/* sorted by job ID */
+
 /* This set of functions loads/free node information so that we can map a job's
  * core bitmap to it's CPU IDs based upon the thread count on each node. */
 static void _load_node_info(void)
@@ -991,6 +1009,161 @@ slurm_sprint_job_info ( job_info_t * job_ptr, int one_liner )
 	return out;
 }
 
+/* Discard cached job records, job_delta_lock must be locked */
+static void _job_delta_clear(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < job_delta_cnt; i++)
+		xfree(job_delta_rec[i].rec);
+	xfree(job_delta_rec);
+	xfree(job_delta_cluster);
+	job_delta_cnt = 0;
+	job_delta_version = 0;
+}
+
+/*
+ * Merge a delta response into the cached job records, job_delta_lock must be
+ * locked. Records from the delta are moved into the cache.
+ * RET SLURM_SUCCESS or SLURM_ERROR if the delta does not apply to the cache,
+ *     in which case the cache is cleared
+ */
+static int _job_delta_merge(job_info_delta_msg_t *delta)
+{
+	job_delta_rec_t *recs, *old_rec;
+	uint32_t cnt = 0, i = 0, j = 0, k = 0;
+
+	if (!delta->base_version)
+		_job_delta_clear();
+	else if (delta->base_version != job_delta_version)
+		goto mismatch;
+
+	recs = xmalloc(sizeof(job_delta_rec_t) * (delta->record_count + 1));
+	while ((i < job_delta_cnt) || (j < delta->update_cnt)) {
+		old_rec = (i < job_delta_cnt) ? &job_delta_rec[i] : NULL;
+		if (cnt >= delta->record_count)
+			break;
+		if ((j < delta->update_cnt) &&
+		    (!old_rec || (delta->update_id[j] <= old_rec->job_id))) {
+			/* New or changed record */
+			if (old_rec && (delta->update_id[j] == old_rec->job_id))
+				i++;
+			recs[cnt].job_id = delta->update_id[j];
+			recs[cnt].size = delta->update_size[j];
+			recs[cnt].rec = delta->update_rec[j];
+			delta->update_rec[j] = NULL;
+			cnt++;
+			j++;
+			continue;
+		}
+		while ((k < delta->purge_cnt) &&
+		       (delta->purge_id[k] < old_rec->job_id))
+			k++;
+		if ((k >= delta->purge_cnt) ||
+		    (delta->purge_id[k] != old_rec->job_id)) {
+			/* Unchanged record */
+			recs[cnt] = *old_rec;
+			old_rec->rec = NULL;
+			cnt++;
+		}
+		i++;
+	}
+
+	_job_delta_clear();
+	job_delta_rec = recs;
+	job_delta_cnt = cnt;
+	if ((cnt != delta->record_count) || (j != delta->update_cnt))
+		goto mismatch;
+	job_delta_version = delta->version;
+	return SLURM_SUCCESS;
+
+mismatch:
+	_job_delta_clear();
+	return SLURM_ERROR;
+}
+
+/* Build a job information response from the cached job records,
+ * job_delta_lock must be locked */
+static int _job_delta_load(time_t last_update,
+			   job_info_msg_t **job_info_msg_pptr)
+{
+	slurm_msg_t msg;
+	Buf buffer;
+	uint32_t i, size = 0;
+	int rc;
+
+	for (i = 0; i < job_delta_cnt; i++)
+		size += job_delta_rec[i].size;
+	buffer = init_buf(size + BUF_SIZE);
+	pack32(job_delta_cnt, buffer);
+	pack_time(last_update, buffer);
+	for (i = 0; i < job_delta_cnt; i++) {
+		packmem_array(job_delta_rec[i].rec, job_delta_rec[i].size,
+			      buffer);
+	}
+	set_buf_offset(buffer, 0);
+
+	slurm_msg_t_init(&msg);
+	msg.msg_type = RESPONSE_JOB_INFO;
+	msg.protocol_version = job_delta_protocol;
+	rc = unpack_msg(&msg, buffer);
+	free_buf(buffer);
+	if (rc != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	*job_info_msg_pptr = (job_info_msg_t *) msg.data;
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Apply a job information delta response to the cached job records
+ * RET SLURM_SUCCESS or SLURM_ERROR if the full records must be requested
+ */
+static int _job_delta_apply(job_info_delta_msg_t *delta,
+			    uint16_t protocol_version, uint16_t show_flags,
+			    uint32_t field_mask,
+			    job_info_msg_t **job_info_msg_pptr)
+{
+	int rc;
+
+	slurm_mutex_lock(&job_delta_lock);
+	if (delta->base_version &&
+	    ((job_delta_protocol != protocol_version) ||
+	     (job_delta_show_flags != show_flags) ||
+	     (job_delta_field_mask != field_mask))) {
+		_job_delta_clear();
+		rc = SLURM_ERROR;
+	} else if ((rc = _job_delta_merge(delta)) == SLURM_SUCCESS) {
+		job_delta_protocol = protocol_version;
+		job_delta_show_flags = show_flags;
+		job_delta_field_mask = field_mask;
+		if (working_cluster_rec)
+			job_delta_cluster = xstrdup(working_cluster_rec->name);
+		rc = _job_delta_load(delta->last_update, job_info_msg_pptr);
+		if (rc != SLURM_SUCCESS)
+			_job_delta_clear();
+	}
+	slurm_mutex_unlock(&job_delta_lock);
+
+	return rc;
+}
+
+/* Get the version of the cached job records to request changes against */
+static uint32_t _job_delta_version(uint16_t show_flags, uint32_t field_mask)
+{
+	uint32_t version = NO_VAL;
+	char *cluster = working_cluster_rec ? working_cluster_rec->name : NULL;
+
+	slurm_mutex_lock(&job_delta_lock);
+	if (job_delta_version && (job_delta_show_flags == show_flags) &&
+	    (job_delta_field_mask == field_mask) &&
+	    !xstrcmp(job_delta_cluster, cluster))
+		version = job_delta_version;
+	slurm_mutex_unlock(&job_delta_lock);
+
+	return version;
+}
+
 /*
  * slurm_load_jobs - issue RPC to get all job configuration
  *	information if changed since update_time
@@ -1003,17 +1176,51 @@ slurm_sprint_job_info ( job_info_t * job_ptr, int one_liner )
 extern int
 slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 		 uint16_t show_flags)
+{
+	return slurm_load_jobs_cond(update_time, job_info_msg_pptr, show_flags,
+				    NULL);
+}
+
+/*
+ * slurm_load_jobs_cond - same as slurm_load_jobs(), but slurmctld only
+ *	sends the jobs matching the filters of cond and the optional fields
+ *	in its field_mask
+ * IN update_time - time of current configuration data
+ * IN/OUT job_info_msg_pptr - place to store a job configuration pointer
+ * IN show_flags - job filtering options
+ * IN cond - jobs and fields to report, NULL for all
+ * RET 0 or -1 on error
+ * NOTE: free the response using slurm_free_job_info_msg
+ */
+extern int slurm_load_jobs_cond(time_t update_time,
+				job_info_msg_t **job_info_msg_pptr,
+				uint16_t show_flags, job_info_cond_t *cond)
 {
 	int rc;
 	slurm_msg_t resp_msg;
 	slurm_msg_t req_msg;
 	job_info_request_msg_t req;
-
-	slurm_msg_t_init(&req_msg);
-	slurm_msg_t_init(&resp_msg);
-
+	uint32_t field_mask = cond ? cond->field_mask : JOB_FIELD_ALL;
+	bool filtered = slurm_job_info_cond_filtered(cond);
+
+	/* Callers polling for changes get only the changed job records from
+	 * slurmctld, merged into those cached from the previous poll.
+	 * Filtered responses are small, those are always sent in full. */
+	if (update_time && !filtered)
+		req.delta_version = _job_delta_version(show_flags, field_mask);
+	else
+		req.delta_version = 0;
+	req.cond         = cond;
 	req.last_update  = update_time;
 	req.show_flags   = show_flags;
+	/* Filtered responses come with repeated strings sent once. The others
+	 * are shared by all callers with the same field mask through one
+	 * snapshot of plain records, from which deltas are built. */
+	if (filtered)
+		req.show_flags |= SHOW_COMPACT;
+again:
+	slurm_msg_t_init(&req_msg);
+	slurm_msg_t_init(&resp_msg);
 	req_msg.msg_type = REQUEST_JOB_INFO;
 	req_msg.data     = &req;
 
@@ -1022,8 +1229,21 @@ slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 
 	switch (resp_msg.msg_type) {
 	case RESPONSE_JOB_INFO:
+	case RESPONSE_JOB_INFO_COMPACT:
 		*job_info_msg_pptr = (job_info_msg_t *)resp_msg.data;
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		rc = _job_delta_apply(resp_msg.data, resp_msg.protocol_version,
+				      show_flags, field_mask,
+				      job_info_msg_pptr);
+		slurm_free_job_info_delta_msg(resp_msg.data);
+		if (rc != SLURM_SUCCESS) {
+			if (req.delta_version == NO_VAL)
+				slurm_seterrno_ret(SLURM_UNEXPECTED_MSG_ERROR);
+			req.delta_version = NO_VAL;
+			goto again;
+		}
+		break;
 	case RESPONSE_SLURM_RC:
 		rc = ((return_code_msg_t *) resp_msg.data)->return_code;
 		slurm_free_return_code_msg(resp_msg.data);
@@ -1059,7 +1279,7 @@ extern int slurm_load_job_user (job_info_msg_t **job_info_msg_pptr,
 	slurm_msg_t_init(&req_msg);
 	slurm_msg_t_init(&resp_msg);
 
-	req.show_flags   = show_flags;
+	req.show_flags   = show_flags | SHOW_COMPACT;
 	req.user_id      = user_id;
 	req_msg.msg_type = REQUEST_JOB_USER_INFO;
 	req_msg.data     = &req;
@@ -1069,6 +1289,7 @@ extern int slurm_load_job_user (job_info_msg_t **job_info_msg_pptr,
 
 	switch (resp_msg.msg_type) {
 	case RESPONSE_JOB_INFO:
+	case RESPONSE_JOB_INFO_COMPACT:
 		*job_info_msg_pptr = (job_info_msg_t *)resp_msg.data;
 		break;
 	case RESPONSE_SLURM_RC:
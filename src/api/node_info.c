@@ -449,6 +449,22 @@ static void _set_node_mixed(node_info_msg_t *resp)
  */
 extern int slurm_load_node (time_t update_time,
 			    node_info_msg_t **resp, uint16_t show_flags)
+{
+	return slurm_load_node_cond(update_time, resp, show_flags, NULL);
+}
+
+/*
+ * slurm_load_node_cond - same as slurm_load_node(), but slurmctld only
+ *	sends the information of nodes matching the filters of cond
+ * IN update_time - time of current configuration data
+ * OUT resp - place to store a node configuration pointer
+ * IN show_flags - node filtering options
+ * IN cond - nodes to report, NULL for all
+ * RET 0 or a slurm error code
+ * NOTE: free the response using slurm_free_node_info_msg
+ */
+extern int slurm_load_node_cond(time_t update_time, node_info_msg_t **resp,
+				uint16_t show_flags, node_info_cond_t *cond)
 {
 	int rc;
 	slurm_msg_t req_msg;
@@ -457,6 +473,7 @@ extern int slurm_load_node (time_t update_time,
 
 	slurm_msg_t_init(&req_msg);
 	slurm_msg_t_init(&resp_msg);
+	req.cond         = cond;
 	req.last_update  = update_time;
 	req.show_flags   = show_flags;
 	req_msg.msg_type = REQUEST_NODE_INFO;
@@ -49,6 +49,7 @@ extern pid_t getsid(pid_t pid);		/* missing from <unistd.h> */
 
 #include "src/common/read_config.h"
 #include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
 
 /*
  * slurm_submit_batch_job - issue RPC to submit a job for later execution
@@ -114,3 +115,87 @@ slurm_submit_batch_job (job_desc_msg_t *req,
 
 	return SLURM_PROTOCOL_SUCCESS;
 }
+
+/*
+ * slurm_submit_batch_jobs - issue one RPC to submit many jobs for later
+ *	execution, each job being accepted or rejected individually
+ * NOTE: free the response using slurm_free_submit_jobs_response_msg
+ * IN job_desc_msg - array of job_cnt batch job descriptions
+ * IN job_cnt - number of jobs to submit
+ * OUT resp - job ID and error code of each job, in request order
+ * RET 0 on success, otherwise return -1 and set errno to indicate the error
+ */
+int
+slurm_submit_batch_jobs(job_desc_msg_t **job_desc_msg, uint32_t job_cnt,
+			submit_jobs_response_msg_t **resp)
+{
+	int i, rc;
+	slurm_msg_t req_msg;
+	slurm_msg_t resp_msg;
+	job_desc_array_msg_t req;
+	bool *host_set;
+	char host[64];
+	uint32_t sid = NO_VAL;
+
+	if (!job_desc_msg || (job_cnt == 0) ||
+	    (job_cnt > MAX_SUBMIT_BATCH_JOBS))
+		slurm_seterrno_ret(EINVAL);
+
+	slurm_msg_t_init(&req_msg);
+	slurm_msg_t_init(&resp_msg);
+
+	/*
+	 * set Node and session id for each job of this request
+	 */
+	if (gethostname_short(host, sizeof(host)))
+		host[0] = '\0';
+	host_set = xmalloc(sizeof(bool) * job_cnt);
+	for (i = 0; i < job_cnt; i++) {
+		if (job_desc_msg[i]->alloc_sid == NO_VAL) {
+			if (sid == NO_VAL)
+				sid = getsid(0);
+			job_desc_msg[i]->alloc_sid = sid;
+		}
+		if ((job_desc_msg[i]->alloc_node == NULL) && host[0]) {
+			job_desc_msg[i]->alloc_node = host;
+			host_set[i] = true;
+		}
+	}
+
+	req.job_cnt      = job_cnt;
+	req.job_desc     = job_desc_msg;
+	req_msg.msg_type = REQUEST_SUBMIT_BATCH_JOBS;
+	req_msg.data     = &req;
+
+	rc = slurm_send_recv_controller_msg(&req_msg, &resp_msg);
+
+	/*
+	 *  Clear the hostnames set internally to this function
+	 *    (memory is on the stack)
+	 */
+	for (i = 0; i < job_cnt; i++) {
+		if (host_set[i])
+			job_desc_msg[i]->alloc_node = NULL;
+	}
+	xfree(host_set);
+
+	if (rc == SLURM_SOCKET_ERROR)
+		return SLURM_ERROR;
+
+	switch (resp_msg.msg_type) {
+	case RESPONSE_SLURM_RC:
+		rc = ((return_code_msg_t *) resp_msg.data)->return_code;
+		slurm_free_return_code_msg(resp_msg.data);
+		*resp = NULL;
+		if (rc)
+			slurm_seterrno_ret(rc);
+		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		*resp = (submit_jobs_response_msg_t *) resp_msg.data;
+		break;
+	default:
+		slurm_seterrno_ret(SLURM_UNEXPECTED_MSG_ERROR);
+	}
+
+	return SLURM_PROTOCOL_SUCCESS;
+}
@@ -48,6 +48,7 @@
 
 #include "src/common/forward.h"
 #include "src/common/macros.h"
+#include "src/common/net.h"
 #include "src/common/slurm_auth.h"
 #include "src/common/slurm_route.h"
 #include "src/common/read_config.h"
@@ -74,6 +75,9 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 				  forward_struct_t *fwd_struct,
 				  header_t *header, int timeout,
 				  int hl_count);
+static void _forward_msg_resplit(hostlist_t hl, forward_struct_t *fwd_struct,
+				 header_t *header);
+static void _start_msg_tree_resplit(hostlist_t hl, fwd_tree_t *fwd_tree);
 
 void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
 {
@@ -108,6 +112,7 @@ void *_forward_thread(void *arg)
 	char *buf = NULL;
 	int steps = 0;
 	int start_timeout = fwd_msg->timeout;
+	struct iovec iov[2];
 
 	/* repeat until we are sure the message was sent */
 	while ((name = hostlist_shift(hl))) {
@@ -126,6 +131,7 @@ void *_forward_thread(void *arg)
 		}
 		if ((fd = slurm_open_msg_conn(&addr)) < 0) {
 			error("forward_thread to %s: %m", name);
+			route_node_failed(name);
 
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(
@@ -139,13 +145,14 @@ void *_forward_thread(void *arg)
 				 * don't have to time out for each
 				 * node serially.
 				 */
-				_forward_msg_internal(hl, NULL, fwd_struct,
-						      &fwd_msg->header, 0,
-						      hostlist_count(hl));
+				_forward_msg_resplit(hl, fwd_struct,
+						     &fwd_msg->header);
 				continue;
 			}
 			goto cleanup;
 		}
+		if (hostlist_count(hl) > 0)
+			net_set_relay_keep_alive(fd);
 		buf = hostlist_ranged_string_xmalloc(hl);
 
 		xfree(fwd_msg->header.forward.nodelist);
@@ -162,37 +169,28 @@ void *_forward_thread(void *arg)
 		} else
 			debug3("forward: send to %s ", name);
 
+		set_buf_offset(buffer, 0);
 		pack_header(&fwd_msg->header, buffer);
 
-		/* add forward data to buffer */
-		if (remaining_buf(buffer) < fwd_struct->buf_len) {
-			int new_size = buffer->processed + fwd_struct->buf_len;
-			new_size += 1024; /* padded for paranoia */
-			xrealloc_nz(buffer->head, new_size);
-			buffer->size = new_size;
-		}
-		if (fwd_struct->buf_len) {
-			memcpy(&buffer->head[buffer->processed],
-			       fwd_struct->buf, fwd_struct->buf_len);
-			buffer->processed += fwd_struct->buf_len;
-		}
-
 		/*
-		 * forward message
+		 * forward message, sending the shared body straight from
+		 * the received message rather than a copy per relay
 		 */
-		if (slurm_msg_sendto(fd,
-				     get_buf_data(buffer),
-				     get_buf_offset(buffer),
-				     SLURM_PROTOCOL_NO_SEND_RECV_FLAGS ) < 0) {
-			error("forward_thread: slurm_msg_sendto: %m");
+		iov[0].iov_base = get_buf_data(buffer);
+		iov[0].iov_len  = get_buf_offset(buffer);
+		iov[1].iov_base = fwd_struct->buf;
+		iov[1].iov_len  = fwd_struct->buf_len;
+		if (slurm_msg_sendv_timeout(fd, iov, 2,
+					    slurm_get_msg_timeout() * 1000)
+		    < 0) {
+			error("forward_thread: slurm_msg_sendv_timeout: %m");
+			route_node_failed(name);
 
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(&fwd_struct->ret_list, name,
 					       errno);
 			free(name);
 			if (hostlist_count(hl) > 0) {
-				free_buf(buffer);
-				buffer = init_buf(fwd_struct->buf_len);
 				slurm_mutex_unlock(&fwd_struct->forward_mutex);
 				slurm_close(fd);
 				fd = -1;
@@ -201,9 +199,8 @@ void *_forward_thread(void *arg)
 				 * don't have to time out for each
 				 * node serially.
 				 */
-				_forward_msg_internal(hl, NULL, fwd_struct,
-						      &fwd_msg->header, 0,
-						      hostlist_count(hl));
+				_forward_msg_resplit(hl, fwd_struct,
+						     &fwd_msg->header);
 				continue;
 			}
 			goto cleanup;
@@ -256,17 +253,23 @@ void *_forward_thread(void *arg)
 
 		if (!ret_list || (fwd_msg->header.forward.cnt != 0
 				  && list_count(ret_list) <= 1)) {
+			route_node_failed(name);
 			slurm_mutex_lock(&fwd_struct->forward_mutex);
 			mark_as_failed_forward(&fwd_struct->ret_list, name,
 					       errno);
 			free(name);
 			FREE_NULL_LIST(ret_list);
 			if (hostlist_count(hl) > 0) {
-				free_buf(buffer);
-				buffer = init_buf(fwd_struct->buf_len);
 				slurm_mutex_unlock(&fwd_struct->forward_mutex);
 				slurm_close(fd);
 				fd = -1;
+				/* Re-parent the children of the failed
+				 * relay rather than trying them one after
+				 * the other as relays, each with the full
+				 * timeout.
+				 */
+				_forward_msg_resplit(hl, fwd_struct,
+						     &fwd_msg->header);
 				continue;
 			}
 			goto cleanup;
@@ -320,6 +323,8 @@ void *_forward_thread(void *arg)
 		}
 		break;
 	}
+	route_node_responded(name);
+	route_note_responses(ret_list);
 	slurm_mutex_lock(&fwd_struct->forward_mutex);
 	if (ret_list) {
 		while ((ret_data_info = list_pop(ret_list)) != NULL) {
@@ -396,6 +401,7 @@ void *_fwd_tree_thread(void *arg)
 
 		if (ret_list) {
 			int ret_cnt = list_count(ret_list);
+			route_note_responses(ret_list);
 			/* This is most common if a slurmd is running
 			   an older version of Slurm than the
 			   originator of the message.
@@ -437,10 +443,8 @@ void *_fwd_tree_thread(void *arg)
 				 * don't have to time out for each
 				 * node serially.
 				 */
-				_start_msg_tree_internal(
-					fwd_tree->tree_hl, NULL,
-					fwd_tree,
-					hostlist_count(fwd_tree->tree_hl));
+				_start_msg_tree_resplit(fwd_tree->tree_hl,
+							fwd_tree);
 				continue;
 			}
 		} else {
@@ -575,7 +579,8 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 		       sizeof(slurm_addr_t));
 
 		fwd_msg->header.version = header->version;
-		fwd_msg->header.flags = header->flags;
+		/* Connections to forwarded nodes are not reused */
+		fwd_msg->header.flags = header->flags & (~SLURM_MSG_KEEP_OPEN);
 		fwd_msg->header.msg_type = header->msg_type;
 		fwd_msg->header.body_length = header->body_length;
 		fwd_msg->header.ret_list = NULL;
@@ -604,6 +609,43 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 	}
 }
 
+/* Forward the message to the nodes of hl through a new tree, re-parenting
+ * them after the node which was to relay the message to them failed.
+ * hl is empty on return. */
+static void _forward_msg_resplit(hostlist_t hl, forward_struct_t *fwd_struct,
+				 header_t *header)
+{
+	hostlist_t *sp_hl;
+	int hl_count = 0;
+
+	if (route_g_split_hostlist(hl, &sp_hl, &hl_count, 0)) {
+		error("unable to split forward hostlist");
+		_forward_msg_internal(hl, NULL, fwd_struct, header, 0,
+				      hostlist_count(hl));
+		return;
+	}
+	_forward_msg_internal(NULL, sp_hl, fwd_struct, header, 0, hl_count);
+	xfree(sp_hl);
+}
+
+/* Send the message to the nodes of hl through a new tree, as done by
+ * _forward_msg_resplit(). hl is empty on return. */
+static void _start_msg_tree_resplit(hostlist_t hl, fwd_tree_t *fwd_tree)
+{
+	hostlist_t *sp_hl;
+	int hl_count = 0;
+
+	if (route_g_split_hostlist(hl, &sp_hl, &hl_count,
+				   fwd_tree->orig_msg->forward.tree_width)) {
+		error("unable to split forward hostlist");
+		_start_msg_tree_internal(hl, NULL, fwd_tree,
+					 hostlist_count(hl));
+		return;
+	}
+	_start_msg_tree_internal(NULL, sp_hl, fwd_tree, hl_count);
+	xfree(sp_hl);
+}
+
 /*
  * forward_init    - initilize forward structure
  * IN: forward     - forward_t *   - struct to store forward info
@@ -811,7 +853,7 @@ void destroy_forward(forward_t *forward)
 void destroy_forward_struct(forward_struct_t *forward_struct)
 {
 	if (forward_struct) {
-		xfree(forward_struct->buf);
+		free_buf(forward_struct->buffer);
 		slurm_mutex_destroy(&forward_struct->forward_mutex);
 		slurm_cond_destroy(&forward_struct->notify);
 		xfree(forward_struct);
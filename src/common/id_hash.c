@@ -0,0 +1,175 @@
+/*****************************************************************************\
+ *  id_hash.c - open addressing hash table of pointers keyed by numeric IDs
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "src/common/id_hash.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+
+#define ID_HASH_MIN_BITS	4
+
+typedef struct {
+	uint64_t id;
+	void *item;		/* NULL if slot is empty */
+} id_hash_slot_t;
+
+struct id_hash {
+	uint32_t bits;		/* log2 of size */
+	uint32_t count;		/* slots in use */
+	uint32_t mask;		/* size - 1 */
+	id_hash_slot_t *slot;
+};
+
+/*
+ * IDs below 2^32 (job IDs) map directly to slots, so the mostly sequential
+ * IDs slurmctld assigns occupy neighbouring slots without colliding. Any
+ * upper half (e.g. a job array task key) is scattered with a Fibonacci
+ * multiplier so that tasks of different arrays do not pile up on the same
+ * slots.
+ */
+static inline uint32_t _home_slot(id_hash_t *table, uint64_t id)
+{
+	return ((uint32_t) id + (uint32_t) (id >> 32) * 0x9E3779B9U) &
+	       table->mask;
+}
+
+static void _alloc_slots(id_hash_t *table, uint32_t bits)
+{
+	table->bits = bits;
+	table->mask = (1U << bits) - 1;
+	table->slot = xmalloc(sizeof(id_hash_slot_t) * (table->mask + 1));
+}
+
+static void _insert(id_hash_t *table, uint64_t id, void *item)
+{
+	uint32_t i = _home_slot(table, id);
+
+	while (table->slot[i].item)
+		i = (i + 1) & table->mask;
+	table->slot[i].id = id;
+	table->slot[i].item = item;
+}
+
+static void _grow(id_hash_t *table)
+{
+	id_hash_slot_t *old_slot = table->slot;
+	uint32_t i, old_size = table->mask + 1;
+
+	_alloc_slots(table, table->bits + 1);
+	for (i = 0; i < old_size; i++) {
+		if (old_slot[i].item)
+			_insert(table, old_slot[i].id, old_slot[i].item);
+	}
+	xfree(old_slot);
+}
+
+extern id_hash_t *id_hash_init(uint32_t size)
+{
+	id_hash_t *table = xmalloc(sizeof(id_hash_t));
+	uint32_t bits = ID_HASH_MIN_BITS;
+
+	/* Keep the table no more than half full */
+	while ((bits < 31) && ((1U << (bits - 1)) < size))
+		bits++;
+	_alloc_slots(table, bits);
+
+	return table;
+}
+
+extern void id_hash_free(id_hash_t *table)
+{
+	if (table) {
+		xfree(table->slot);
+		xfree(table);
+	}
+}
+
+extern void id_hash_add(id_hash_t *table, uint64_t id, void *item)
+{
+	xassert(item);
+
+	if ((table->count + 1) > ((table->mask + 1) / 2))
+		_grow(table);
+	_insert(table, id, item);
+	table->count++;
+}
+
+extern void *id_hash_find(id_hash_t *table, uint64_t id)
+{
+	uint32_t i = _home_slot(table, id);
+
+	while (table->slot[i].item) {
+		if (table->slot[i].id == id)
+			return table->slot[i].item;
+		i = (i + 1) & table->mask;
+	}
+	return NULL;
+}
+
+extern void *id_hash_remove(id_hash_t *table, uint64_t id, void *item)
+{
+	uint32_t i = _home_slot(table, id), j, home;
+	void *found;
+
+	while (table->slot[i].item) {
+		if ((table->slot[i].id == id) &&
+		    (!item || (table->slot[i].item == item)))
+			break;
+		i = (i + 1) & table->mask;
+	}
+	if (!(found = table->slot[i].item))
+		return NULL;
+
+	/* Shift later entries of the probe sequence back into the hole so
+	 * that no tombstones are needed */
+	j = i;
+	while (1) {
+		j = (j + 1) & table->mask;
+		if (!table->slot[j].item)
+			break;
+		home = _home_slot(table, table->slot[j].id);
+		if ((i <= j) ? ((i < home) && (home <= j)) :
+			       ((i < home) || (home <= j)))
+			continue;	/* Entry can not move before its home */
+		table->slot[i] = table->slot[j];
+		i = j;
+	}
+	table->slot[i].item = NULL;
+	table->count--;
+
+	return found;
+}
+
+extern uint32_t id_hash_count(id_hash_t *table)
+{
+	return table->count;
+}
@@ -0,0 +1,71 @@
+/*****************************************************************************\
+ *  id_hash.h - open addressing hash table of pointers keyed by numeric IDs
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _ID_HASH_H
+#define _ID_HASH_H
+
+#include <inttypes.h>
+
+/*
+ * An id_hash maps 64-bit IDs (e.g. job IDs) to pointers using linear probing
+ * in a single array, so a lookup normally touches one or two cache lines
+ * rather than walking a chain of records. The table doubles in size when it
+ * becomes half full. An ID may be added more than once, in which case
+ * id_hash_find() returns one of its items and id_hash_remove() is used with
+ * the specific item to remove.
+ */
+typedef struct id_hash id_hash_t;
+
+/* Create a table sized for size items, grown as needed */
+extern id_hash_t *id_hash_init(uint32_t size);
+
+/* Free a table, not the items it references */
+extern void id_hash_free(id_hash_t *table);
+
+/* Add an item to a table, item must not be NULL */
+extern void id_hash_add(id_hash_t *table, uint64_t id, void *item);
+
+/* RET an item with the given ID or NULL if none */
+extern void *id_hash_find(id_hash_t *table, uint64_t id);
+
+/*
+ * Remove an item from a table
+ * IN item - item to remove, NULL to remove any item with this ID
+ * RET the item removed or NULL if not found
+ */
+extern void *id_hash_remove(id_hash_t *table, uint64_t id, void *item);
+
+/* RET count of items in a table */
+extern uint32_t id_hash_count(id_hash_t *table);
+
+#endif
@@ -61,6 +61,9 @@
 #include "src/common/net.h"
 #include "src/common/slurm_protocol_api.h"
 
+/* Unanswered keep alive probes before a relaying node is considered dead */
+#define RELAY_KEEP_ALIVE_PROBES	3
+
 /*
  * Define slurm-specific aliases for use by plugins, see slurm_xlator.h
  * for details.
@@ -238,6 +241,42 @@ extern int net_set_keep_alive(int sock)
 	return 0;
 }
 
+/* Probe the peer of a connection which relays a message to other nodes.
+ * The connection is idle until all of them have answered, this lets the
+ * death of the relaying node be noticed within a few TCPTimeout periods
+ * instead of at the end of the whole forwarding timeout. */
+extern int net_set_relay_keep_alive(int sock)
+{
+	int opt_int;
+	socklen_t opt_len = sizeof(int);
+	static int probe_time = 0;
+
+	if (probe_time == 0)
+		probe_time = MAX(slurm_get_tcp_timeout(), 1);
+
+	opt_int = 1;
+	if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &opt_int, opt_len) < 0) {
+		error("Unable to set keep alive socket option: %m");
+		return -1;
+	}
+
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+	opt_int = probe_time;
+	if ((setsockopt(sock, SOL_TCP, TCP_KEEPIDLE, &opt_int, opt_len) < 0) ||
+	    (setsockopt(sock, SOL_TCP, TCP_KEEPINTVL, &opt_int, opt_len) < 0)) {
+		error("Unable to set keep alive socket time: %m");
+		return -1;
+	}
+	opt_int = RELAY_KEEP_ALIVE_PROBES;
+	if (setsockopt(sock, SOL_TCP, TCP_KEEPCNT, &opt_int, opt_len) < 0) {
+		error("Unable to set keep alive socket probes: %m");
+		return -1;
+	}
+#endif
+
+	return 0;
+}
+
 /* net_stream_listen_ports()
  */
 int
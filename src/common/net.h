@@ -65,6 +65,10 @@ extern int net_set_low_water(int sock, socklen_t size);
 /* set keep alive time on socket */
 extern int net_set_keep_alive(int sock);
 
+/* set short keep alive probes on the connection to a node relaying a message
+ * to other nodes, so its failure is detected quickly */
+extern int net_set_relay_keep_alive(int sock);
+
 extern int net_stream_listen_ports(int *, uint16_t *, uint16_t *);
 
 #endif /* !_NET_H */
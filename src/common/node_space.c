@@ -0,0 +1,281 @@
+/*****************************************************************************\
+ *  node_space.c - timeline of nodes available to the backfill scheduler
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <string.h>
+
+#include "src/common/macros.h"
+#include "src/common/node_space.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+
+/*
+ * Records are kept both in a list ordered by time, used to walk the
+ * timeline, and in a treap keyed by begin_time, used to find the record
+ * holding a given time. Treap priorities are pseudo-random so the tree is
+ * balanced with high probability whatever order reservations arrive in.
+ */
+struct node_space {
+	node_space_rec_t *head;		/* first record by time */
+	node_space_rec_t *root;		/* root of the treap */
+	node_space_rec_t *free_list;	/* records for reuse */
+	uint32_t count;			/* records in use */
+	uint32_t seed;			/* treap priority generator state */
+};
+
+static uint32_t _next_prio(node_space_t *space)
+{
+	/* xorshift32 */
+	space->seed ^= space->seed << 13;
+	space->seed ^= space->seed >> 17;
+	space->seed ^= space->seed << 5;
+	return space->seed;
+}
+
+static node_space_rec_t *_rotate_left(node_space_rec_t *rec)
+{
+	node_space_rec_t *right = rec->right;
+
+	rec->right = right->left;
+	right->left = rec;
+	return right;
+}
+
+static node_space_rec_t *_rotate_right(node_space_rec_t *rec)
+{
+	node_space_rec_t *left = rec->left;
+
+	rec->left = left->right;
+	left->right = rec;
+	return left;
+}
+
+/* Insert rec into the treap below root, RET the new root */
+static node_space_rec_t *_tree_insert(node_space_rec_t *root,
+				      node_space_rec_t *rec)
+{
+	if (!root)
+		return rec;
+	if (rec->begin_time < root->begin_time) {
+		root->left = _tree_insert(root->left, rec);
+		if (root->left->prio > root->prio)
+			root = _rotate_right(root);
+	} else {
+		root->right = _tree_insert(root->right, rec);
+		if (root->right->prio > root->prio)
+			root = _rotate_left(root);
+	}
+	return root;
+}
+
+/* Remove rec from the treap below root, RET the new root */
+static node_space_rec_t *_tree_remove(node_space_rec_t *root,
+				      node_space_rec_t *rec)
+{
+	xassert(root);
+
+	if (root != rec) {
+		if (rec->begin_time < root->begin_time)
+			root->left = _tree_remove(root->left, rec);
+		else
+			root->right = _tree_remove(root->right, rec);
+		return root;
+	}
+
+	/* Rotate rec down until it has at most one child */
+	if (!rec->left)
+		return rec->right;
+	if (!rec->right)
+		return rec->left;
+	if (rec->left->prio > rec->right->prio) {
+		root = _rotate_right(rec);
+		root->right = _tree_remove(root->right, rec);
+	} else {
+		root = _rotate_left(rec);
+		root->left = _tree_remove(root->left, rec);
+	}
+	return root;
+}
+
+static node_space_rec_t *_alloc_rec(node_space_t *space)
+{
+	node_space_rec_t *rec;
+
+	if ((rec = space->free_list)) {
+		space->free_list = rec->next;
+		memset(rec, 0, sizeof(node_space_rec_t));
+	} else
+		rec = xmalloc(sizeof(node_space_rec_t));
+	rec->prio = _next_prio(space);
+	space->count++;
+
+	return rec;
+}
+
+/* Split a record at time when, which must fall inside of it.
+ * RET the new record, starting at when */
+static node_space_rec_t *_split(node_space_t *space, node_space_rec_t *rec,
+				time_t when)
+{
+	node_space_rec_t *new_rec = _alloc_rec(space);
+
+	xassert((rec->begin_time < when) && (when < rec->end_time));
+
+	new_rec->begin_time = when;
+	new_rec->end_time = rec->end_time;
+	new_rec->avail_bitmap = bit_copy(rec->avail_bitmap);
+	rec->end_time = when;
+
+	new_rec->prev = rec;
+	new_rec->next = rec->next;
+	if (rec->next)
+		rec->next->prev = new_rec;
+	rec->next = new_rec;
+	space->root = _tree_insert(space->root, new_rec);
+
+	return new_rec;
+}
+
+/* Merge the record following rec into rec */
+static void _merge_next(node_space_t *space, node_space_rec_t *rec)
+{
+	node_space_rec_t *old_rec = rec->next;
+
+	rec->end_time = old_rec->end_time;
+	rec->next = old_rec->next;
+	if (old_rec->next)
+		old_rec->next->prev = rec;
+	space->root = _tree_remove(space->root, old_rec);
+
+	FREE_NULL_BITMAP(old_rec->avail_bitmap);
+	old_rec->next = space->free_list;
+	space->free_list = old_rec;
+	space->count--;
+}
+
+extern node_space_t *node_space_init(time_t begin_time, time_t end_time,
+				     bitstr_t *avail_bitmap)
+{
+	node_space_t *space = xmalloc(sizeof(node_space_t));
+	node_space_rec_t *rec;
+
+	space->seed = 2463534242U;
+	rec = _alloc_rec(space);
+	rec->begin_time = begin_time;
+	rec->end_time = end_time;
+	rec->avail_bitmap = bit_copy(avail_bitmap);
+	space->head = space->root = rec;
+
+	return space;
+}
+
+extern void node_space_free(node_space_t *space)
+{
+	node_space_rec_t *rec, *next;
+
+	if (!space)
+		return;
+	for (rec = space->head; rec; rec = next) {
+		next = rec->next;
+		FREE_NULL_BITMAP(rec->avail_bitmap);
+		xfree(rec);
+	}
+	for (rec = space->free_list; rec; rec = next) {
+		next = rec->next;
+		xfree(rec);
+	}
+	xfree(space);
+}
+
+extern node_space_rec_t *node_space_first(node_space_t *space)
+{
+	return space->head;
+}
+
+extern node_space_rec_t *node_space_find(node_space_t *space, time_t when)
+{
+	node_space_rec_t *rec = space->root, *found = space->head;
+
+	while (rec) {
+		if (rec->begin_time <= when) {
+			found = rec;
+			rec = rec->right;
+		} else
+			rec = rec->left;
+	}
+	return found;
+}
+
+extern void node_space_reserve(node_space_t *space, time_t start_time,
+			       time_t end_time, bitstr_t *avail_bitmap)
+{
+	node_space_rec_t *rec, *first, *last = NULL, *stop, *next;
+
+	start_time = MAX(start_time, space->head->begin_time);
+	if (end_time <= start_time)
+		return;
+	rec = node_space_find(space, start_time);
+	if (start_time >= rec->end_time)
+		return;		/* Beyond the end of the window */
+	if (rec->begin_time < start_time)
+		rec = _split(space, rec, start_time);
+
+	for (first = rec; rec && (rec->begin_time < end_time);
+	     rec = rec->next) {
+		if (rec->end_time > end_time)
+			(void) _split(space, rec, end_time);
+		bit_and(rec->avail_bitmap, avail_bitmap);
+		last = rec;
+	}
+
+	/* Merge adjacent records left with identical bitmaps, from the one
+	 * preceding the reservation through the one following it. Records
+	 * outside of that range were not changed. */
+	stop = last->next;
+	rec = first->prev ? first->prev : first;
+	while ((next = rec->next)) {
+		if (bit_equal(rec->avail_bitmap, next->avail_bitmap)) {
+			_merge_next(space, rec);
+			if (next == stop)
+				break;
+			continue;
+		}
+		if (next == stop)
+			break;
+		rec = next;
+	}
+}
+
+extern uint32_t node_space_count(node_space_t *space)
+{
+	return space->count;
+}
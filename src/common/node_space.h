@@ -0,0 +1,93 @@
+/*****************************************************************************\
+ *  node_space.h - timeline of nodes available to the backfill scheduler
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+#ifndef _NODE_SPACE_H
+#define _NODE_SPACE_H
+
+#include <inttypes.h>
+#include <time.h>
+
+#include "src/common/bitstring.h"
+
+/*
+ * A node_space describes which nodes are available over a window of time as
+ * a sequence of adjacent records, each holding the nodes available from its
+ * begin_time up to its end_time. Reserving nodes splits the records at the
+ * reservation's start and end and neighbouring records left with identical
+ * bitmaps are merged again. Records are indexed by begin_time in a balanced
+ * search tree, so finding the record holding a given time, adding a record
+ * or removing one takes O(log n) regardless of how many reservations were
+ * made.
+ */
+typedef struct node_space node_space_t;
+
+typedef struct node_space_rec node_space_rec_t;
+struct node_space_rec {
+	time_t begin_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;		/* nodes available in this interval */
+	node_space_rec_t *next;		/* next record by time, NULL if last */
+
+	/* Private to node_space.c */
+	node_space_rec_t *prev;
+	node_space_rec_t *left;
+	node_space_rec_t *right;
+	uint32_t prio;
+};
+
+/* Create a node_space with a single record holding a copy of avail_bitmap
+ * from begin_time up to end_time */
+extern node_space_t *node_space_init(time_t begin_time, time_t end_time,
+				     bitstr_t *avail_bitmap);
+
+/* Free a node_space and all of its records */
+extern void node_space_free(node_space_t *space);
+
+/* RET the first record of a node_space */
+extern node_space_rec_t *node_space_first(node_space_t *space);
+
+/* RET the record holding time when, the first record if when is earlier and
+ *	the last record if when is later */
+extern node_space_rec_t *node_space_find(node_space_t *space, time_t when);
+
+/*
+ * Reserve nodes from start_time up to end_time
+ * IN avail_bitmap - nodes which remain available, all others are removed
+ *	from the records in this interval
+ */
+extern void node_space_reserve(node_space_t *space, time_t start_time,
+			       time_t end_time, bitstr_t *avail_bitmap);
+
+/* RET count of records in a node_space */
+extern uint32_t node_space_count(node_space_t *space);
+
+#endif
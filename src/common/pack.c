@@ -90,6 +90,29 @@ strong_alias(unpackstr_array,	slurm_unpackstr_array);
 strong_alias(packmem_array,	slurm_packmem_array);
 strong_alias(unpackmem_array,	slurm_unpackmem_array);
 
+/* Longest string or memory block interned in a compact buffer. Longer ones
+ * (e.g. batch scripts) rarely repeat and would only cost hashing time. */
+#define PACK_INTERN_MAX	1024
+
+/* Integers in compact form are offset so NO_VAL and INFINITE (and their
+ * 16 and 64-bit forms) pack into a single byte */
+#define PACK_VAR_BIAS	2
+
+struct pack_dict {
+	uint32_t cnt;		/* strings in the dictionary */
+	uint32_t alloc;		/* entries allocated in offset and len */
+	uint32_t *offset;	/* buffer offset of each string */
+	uint32_t *len;		/* size of each string */
+	uint32_t tbl_size;	/* slots in tbl, a power of two */
+	uint32_t *tbl;		/* index + 1 of each string by content, open
+				 * addressing, only used when packing */
+};
+
+static void _dict_free(struct pack_dict *dict);
+static void _pack_var(uint64_t val, Buf buffer);
+static int  _unpack_var(uint64_t *valp, int max_bytes, Buf buffer);
+static void _pack_compact_mem(char *valp, uint32_t size_val, Buf buffer);
+
 /* Basic buffer management routines */
 /* create_buf - create a buffer with the supplied contents, contents must
  * be xalloc'ed */
@@ -108,6 +131,7 @@ Buf create_buf(char *data, uint32_t size)
 	my_buf->size = size;
 	my_buf->processed = 0;
 	my_buf->head = data;
+	my_buf->dict = NULL;
 
 	return my_buf;
 }
@@ -118,6 +142,7 @@ void free_buf(Buf my_buf)
 	if (!my_buf)
 		return;
 	assert(my_buf->magic == BUF_MAGIC);
+	_dict_free(my_buf->dict);
 	xfree(my_buf->head);
 	xfree(my_buf);
 }
@@ -152,6 +177,7 @@ Buf init_buf(uint32_t size)
 	my_buf->size = size;
 	my_buf->processed = 0;
 	my_buf->head = xmalloc(sizeof(char)*size);
+	my_buf->dict = NULL;
 	return my_buf;
 }
 
@@ -163,10 +189,189 @@ void *xfer_buf_data(Buf my_buf)
 
 	assert(my_buf->magic == BUF_MAGIC);
 	data_ptr = (void *) my_buf->head;
+	_dict_free(my_buf->dict);
 	xfree(my_buf);
 	return data_ptr;
 }
 
+static void _dict_free(struct pack_dict *dict)
+{
+	if (!dict)
+		return;
+	xfree(dict->offset);
+	xfree(dict->len);
+	xfree(dict->tbl);
+	xfree(dict);
+}
+
+/* compact_buf_start - pack or unpack following data in compact form */
+void compact_buf_start(Buf buffer)
+{
+	assert(buffer->magic == BUF_MAGIC);
+	_dict_free(buffer->dict);
+	buffer->dict = xmalloc(sizeof(struct pack_dict));
+}
+
+/* compact_buf_end - pack or unpack following data in the regular form */
+void compact_buf_end(Buf buffer)
+{
+	assert(buffer->magic == BUF_MAGIC);
+	_dict_free(buffer->dict);
+	buffer->dict = NULL;
+}
+
+/* FNV-1a hash of a string to intern */
+static uint32_t _dict_hash(char *valp, uint32_t size_val)
+{
+	uint32_t hash = 2166136261U;
+	uint32_t i;
+
+	for (i = 0; i < size_val; i++) {
+		hash ^= (uint8_t) valp[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+/* Insert dictionary entry idx into the packing index, the index must have
+ * a free slot */
+static void _dict_tbl_insert(struct pack_dict *dict, char *head, uint32_t idx)
+{
+	uint32_t mask = dict->tbl_size - 1;
+	uint32_t slot = _dict_hash(head + dict->offset[idx], dict->len[idx]);
+
+	slot &= mask;
+	while (dict->tbl[slot])
+		slot = (slot + 1) & mask;
+	dict->tbl[slot] = idx + 1;
+}
+
+/* Add the string packed or unpacked at offset to the dictionary */
+static void _dict_add(Buf buffer, uint32_t offset, uint32_t size_val)
+{
+	struct pack_dict *dict = buffer->dict;
+	uint32_t i;
+
+	if (dict->cnt >= dict->alloc) {
+		dict->alloc = MAX(dict->alloc * 2, 256);
+		xrealloc_nz(dict->offset, sizeof(uint32_t) * dict->alloc);
+		xrealloc_nz(dict->len, sizeof(uint32_t) * dict->alloc);
+	}
+	dict->offset[dict->cnt] = offset;
+	dict->len[dict->cnt] = size_val;
+	dict->cnt++;
+
+	if (!dict->tbl)
+		return;
+	if ((dict->cnt * 2) > dict->tbl_size) {
+		xfree(dict->tbl);
+		dict->tbl_size *= 2;
+		dict->tbl = xmalloc(sizeof(uint32_t) * dict->tbl_size);
+		for (i = 0; i < dict->cnt; i++)
+			_dict_tbl_insert(dict, buffer->head, i);
+	} else
+		_dict_tbl_insert(dict, buffer->head, dict->cnt - 1);
+}
+
+/* Find a string already packed in the buffer
+ * RET index in the dictionary or -1 if not found */
+static int64_t _dict_find(Buf buffer, char *valp, uint32_t size_val)
+{
+	struct pack_dict *dict = buffer->dict;
+	uint32_t mask, slot, idx;
+
+	if (!dict->tbl) {
+		dict->tbl_size = 1024;
+		dict->tbl = xmalloc(sizeof(uint32_t) * dict->tbl_size);
+		return -1;
+	}
+	mask = dict->tbl_size - 1;
+	slot = _dict_hash(valp, size_val) & mask;
+	while ((idx = dict->tbl[slot])) {
+		idx--;
+		if ((dict->len[idx] == size_val) &&
+		    !memcmp(buffer->head + dict->offset[idx], valp, size_val))
+			return idx;
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+/* Pack an integer in compact form: 7 bits per byte, low order bits first,
+ * high bit set on all but the last byte */
+static void _pack_var(uint64_t val, Buf buffer)
+{
+	if (remaining_buf(buffer) < 10) {
+		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
+			error("%s: Buffer size limit exceeded (%u > %u)",
+			      __func__, (buffer->size + BUF_SIZE),
+			      MAX_BUF_SIZE);
+			return;
+		}
+		buffer->size += BUF_SIZE;
+		xrealloc_nz(buffer->head, buffer->size);
+	}
+
+	while (val >= 0x80) {
+		buffer->head[buffer->processed++] = (char) (val | 0x80);
+		val >>= 7;
+	}
+	buffer->head[buffer->processed++] = (char) val;
+}
+
+/* Unpack an integer in compact form of at most max_bytes bytes */
+static int _unpack_var(uint64_t *valp, int max_bytes, Buf buffer)
+{
+	uint64_t val = 0;
+	uint8_t byte;
+	int i;
+
+	for (i = 0; i < max_bytes; i++) {
+		if (remaining_buf(buffer) < 1)
+			return SLURM_ERROR;
+		byte = (uint8_t) buffer->head[buffer->processed++];
+		val |= ((uint64_t) (byte & 0x7f)) << (7 * i);
+		if (!(byte & 0x80)) {
+			*valp = val;
+			return SLURM_SUCCESS;
+		}
+	}
+	return SLURM_ERROR;
+}
+
+/*
+ * Pack memory in compact form. A single value precedes the data:
+ *	0 for no data,
+ *	(size << 1) for data which follows,
+ *	(index << 1) | 1 for a reference to the index'th string interned
+ *	in the buffer, with no data following.
+ */
+static void _pack_compact_mem(char *valp, uint32_t size_val, Buf buffer)
+{
+	uint32_t offset;
+	int64_t idx;
+
+	if (!size_val) {
+		_pack_var(0, buffer);
+		return;
+	}
+	if (size_val > PACK_INTERN_MAX) {
+		_pack_var((uint64_t) size_val << 1, buffer);
+		packmem_array(valp, size_val, buffer);
+		return;
+	}
+
+	if ((idx = _dict_find(buffer, valp, size_val)) >= 0) {
+		_pack_var(((uint64_t) idx << 1) | 1, buffer);
+		return;
+	}
+	_pack_var((uint64_t) size_val << 1, buffer);
+	offset = get_buf_offset(buffer);
+	packmem_array(valp, size_val, buffer);
+	if (get_buf_offset(buffer) == (offset + size_val))
+		_dict_add(buffer, offset, size_val);
+}
+
 /*
  * Given a time_t in host byte order, promote it to int64_t, convert to
  * network byte order, store in buffer and adjust buffer acc'd'ngly
@@ -175,6 +380,11 @@ void pack_time(time_t val, Buf buffer)
 {
 	int64_t n64 = HTON_int64((int64_t) val);
 
+	if (buffer->dict) {
+		_pack_var((uint64_t) val, buffer);
+		return;
+	}
+
 	if (remaining_buf(buffer) < sizeof(n64)) {
 		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
 			error("%s: Buffer size limit exceeded (%u > %u)",
@@ -193,6 +403,14 @@ void pack_time(time_t val, Buf buffer)
 int unpack_time(time_t * valp, Buf buffer)
 {
 	int64_t n64;
+	uint64_t val;
+
+	if (buffer->dict) {
+		if (_unpack_var(&val, 10, buffer))
+			return SLURM_ERROR;
+		*valp = (time_t) val;
+		return SLURM_SUCCESS;
+	}
 
 	if (remaining_buf(buffer) < sizeof(n64))
 		return SLURM_ERROR;
@@ -303,6 +521,11 @@ void pack64(uint64_t val, Buf buffer)
 {
 	uint64_t nl =  HTON_uint64(val);
 
+	if (buffer->dict) {
+		_pack_var(val + PACK_VAR_BIAS, buffer);
+		return;
+	}
+
 	if (remaining_buf(buffer) < sizeof(nl)) {
 		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
 			error("%s: Buffer size limit exceeded (%u > %u)",
@@ -325,6 +548,14 @@ void pack64(uint64_t val, Buf buffer)
 int unpack64(uint64_t * valp, Buf buffer)
 {
 	uint64_t nl;
+
+	if (buffer->dict) {
+		if (_unpack_var(&nl, 10, buffer))
+			return SLURM_ERROR;
+		*valp = nl - PACK_VAR_BIAS;
+		return SLURM_SUCCESS;
+	}
+
 	if (remaining_buf(buffer) < sizeof(nl))
 		return SLURM_ERROR;
 
@@ -342,6 +573,11 @@ void pack32(uint32_t val, Buf buffer)
 {
 	uint32_t nl = htonl(val);
 
+	if (buffer->dict) {
+		_pack_var((uint32_t) (val + PACK_VAR_BIAS), buffer);
+		return;
+	}
+
 	if (remaining_buf(buffer) < sizeof(nl)) {
 		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
 			error("%s: Buffer size limit exceeded (%u > %u)",
@@ -364,6 +600,15 @@ void pack32(uint32_t val, Buf buffer)
 int unpack32(uint32_t * valp, Buf buffer)
 {
 	uint32_t nl;
+	uint64_t val;
+
+	if (buffer->dict) {
+		if (_unpack_var(&val, 5, buffer) || (val > 0xffffffff))
+			return SLURM_ERROR;
+		*valp = (uint32_t) (val - PACK_VAR_BIAS);
+		return SLURM_SUCCESS;
+	}
+
 	if (remaining_buf(buffer) < sizeof(nl))
 		return SLURM_ERROR;
 
@@ -553,6 +798,11 @@ void pack16(uint16_t val, Buf buffer)
 {
 	uint16_t ns = htons(val);
 
+	if (buffer->dict) {
+		_pack_var((uint16_t) (val + PACK_VAR_BIAS), buffer);
+		return;
+	}
+
 	if (remaining_buf(buffer) < sizeof(ns)) {
 		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
 			error("%s: Buffer size limit exceeded (%u > %u)",
@@ -575,6 +825,14 @@ void pack16(uint16_t val, Buf buffer)
 int unpack16(uint16_t * valp, Buf buffer)
 {
 	uint16_t ns;
+	uint64_t val;
+
+	if (buffer->dict) {
+		if (_unpack_var(&val, 3, buffer) || (val > 0xffff))
+			return SLURM_ERROR;
+		*valp = (uint16_t) (val - PACK_VAR_BIAS);
+		return SLURM_SUCCESS;
+	}
 
 	if (remaining_buf(buffer) < sizeof(ns))
 		return SLURM_ERROR;
@@ -634,6 +892,10 @@ void packmem(char *valp, uint32_t size_val, Buf buffer)
 		      __func__, size_val, MAX_PACK_MEM_LEN);
 		return;
 	}
+	if (buffer->dict) {
+		_pack_compact_mem(valp, size_val, buffer);
+		return;
+	}
 	if (remaining_buf(buffer) < (sizeof(ns) + size_val)) {
 		if ((buffer->size + size_val + BUF_SIZE) > MAX_BUF_SIZE) {
 			error("%s: Buffer size limit exceeded (%u > %u)",
@@ -665,14 +927,30 @@ void packmem(char *valp, uint32_t size_val, Buf buffer)
  */
 int unpackmem_ptr(char **valp, uint32_t * size_valp, Buf buffer)
 {
+	struct pack_dict *dict = buffer->dict;
 	uint32_t ns;
+	uint64_t tag;
 
-	if (remaining_buf(buffer) < sizeof(ns))
-		return SLURM_ERROR;
+	if (dict) {
+		if (_unpack_var(&tag, 5, buffer) || (tag > 0xffffffff))
+			return SLURM_ERROR;
+		if (tag & 1) {
+			tag >>= 1;
+			if (tag >= dict->cnt)
+				return SLURM_ERROR;
+			*valp = &buffer->head[dict->offset[tag]];
+			*size_valp = dict->len[tag];
+			return SLURM_SUCCESS;
+		}
+		*size_valp = tag >> 1;
+	} else {
+		if (remaining_buf(buffer) < sizeof(ns))
+			return SLURM_ERROR;
 
-	memcpy(&ns, &buffer->head[buffer->processed], sizeof(ns));
-	*size_valp = ntohl(ns);
-	buffer->processed += sizeof(ns);
+		memcpy(&ns, &buffer->head[buffer->processed], sizeof(ns));
+		*size_valp = ntohl(ns);
+		buffer->processed += sizeof(ns);
+	}
 
 	if (*size_valp > MAX_PACK_MEM_LEN) {
 		error("%s: Buffer to be unpacked is too large (%u > %u)",
@@ -683,6 +961,8 @@ int unpackmem_ptr(char **valp, uint32_t * size_valp, Buf buffer)
 		if (remaining_buf(buffer) < *size_valp)
 			return SLURM_ERROR;
 		*valp = &buffer->head[buffer->processed];
+		if (dict && (*size_valp <= PACK_INTERN_MAX))
+			_dict_add(buffer, buffer->processed, *size_valp);
 		buffer->processed += *size_valp;
 	} else
 		*valp = NULL;
@@ -700,26 +980,14 @@ int unpackmem_ptr(char **valp, uint32_t * size_valp, Buf buffer)
  */
 int unpackmem(char *valp, uint32_t * size_valp, Buf buffer)
 {
-	uint32_t ns;
+	char *data;
 
-	if (remaining_buf(buffer) < sizeof(ns))
+	if (unpackmem_ptr(&data, size_valp, buffer))
 		return SLURM_ERROR;
 
-	memcpy(&ns, &buffer->head[buffer->processed], sizeof(ns));
-	*size_valp = ntohl(ns);
-	buffer->processed += sizeof(ns);
-
-	if (*size_valp > MAX_PACK_MEM_LEN) {
-		error("%s: Buffer to be unpacked is too large (%u > %u)",
-		      __func__, *size_valp, MAX_PACK_MEM_LEN);
-		return SLURM_ERROR;
-	}
-	else if (*size_valp > 0) {
-		if (remaining_buf(buffer) < *size_valp)
-			return SLURM_ERROR;
-		memcpy(valp, &buffer->head[buffer->processed], *size_valp);
-		buffer->processed += *size_valp;
-	} else
+	if (*size_valp > 0)
+		memcpy(valp, data, *size_valp);
+	else
 		*valp = 0;
 	return SLURM_SUCCESS;
 }
@@ -735,27 +1003,14 @@ int unpackmem(char *valp, uint32_t * size_valp, Buf buffer)
  */
 int unpackmem_xmalloc(char **valp, uint32_t * size_valp, Buf buffer)
 {
-	uint32_t ns;
+	char *data;
 
-	if (remaining_buf(buffer) < sizeof(ns))
+	if (unpackmem_ptr(&data, size_valp, buffer))
 		return SLURM_ERROR;
 
-	memcpy(&ns, &buffer->head[buffer->processed], sizeof(ns));
-	*size_valp = ntohl(ns);
-	buffer->processed += sizeof(ns);
-
-	if (*size_valp > MAX_PACK_MEM_LEN) {
-		error("%s: Buffer to be unpacked is too large (%u > %u)",
-		      __func__, *size_valp, MAX_PACK_MEM_LEN);
-		return SLURM_ERROR;
-	}
-	else if (*size_valp > 0) {
-		if (remaining_buf(buffer) < *size_valp)
-			return SLURM_ERROR;
+	if (*size_valp > 0) {
 		*valp = xmalloc_nz(*size_valp);
-		memcpy(*valp, &buffer->head[buffer->processed],
-		       *size_valp);
-		buffer->processed += *size_valp;
+		memcpy(*valp, data, *size_valp);
 	} else
 		*valp = NULL;
 	return SLURM_SUCCESS;
@@ -772,30 +1027,18 @@ int unpackmem_xmalloc(char **valp, uint32_t * size_valp, Buf buffer)
  */
 int unpackmem_malloc(char **valp, uint32_t * size_valp, Buf buffer)
 {
-	uint32_t ns;
+	char *data;
 
-	if (remaining_buf(buffer) < sizeof(ns))
+	if (unpackmem_ptr(&data, size_valp, buffer))
 		return SLURM_ERROR;
 
-	memcpy(&ns, &buffer->head[buffer->processed], sizeof(ns));
-	*size_valp = ntohl(ns);
-	buffer->processed += sizeof(ns);
-	if (*size_valp > MAX_PACK_MEM_LEN) {
-		error("%s: Buffer to be unpacked is too large (%u > %u)",
-		      __func__, *size_valp, MAX_PACK_MEM_LEN);
-		return SLURM_ERROR;
-	}
-	else if (*size_valp > 0) {
-		if (remaining_buf(buffer) < *size_valp)
-			return SLURM_ERROR;
+	if (*size_valp > 0) {
 		*valp = malloc(*size_valp);
 		if (*valp == NULL) {
 			log_oom(__FILE__, __LINE__, __func__);
 			abort();
 		}
-		memcpy(*valp, &buffer->head[buffer->processed],
-		       *size_valp);
-		buffer->processed += *size_valp;
+		memcpy(*valp, data, *size_valp);
 	} else
 		*valp = NULL;
 	return SLURM_SUCCESS;
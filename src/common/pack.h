@@ -58,11 +58,16 @@
 #define MAX_PACK_ARRAY_LEN	(128 * 1024)
 #define MAX_PACK_MEM_LEN	(1024 * 1024 * 1024)
 
+/* Strings interned in a buffer packed or unpacked in compact form */
+struct pack_dict;
+
 struct slurm_buf {
 	uint32_t magic;
 	char *head;
 	uint32_t size;
 	uint32_t processed;
+	struct pack_dict *dict;	/* set while in compact form, see
+				 * compact_buf_start() */
 };
 
 typedef struct slurm_buf * Buf;
@@ -79,6 +84,16 @@ Buf	init_buf(uint32_t size);
 void    grow_buf (Buf my_buf, uint32_t size);
 void	*xfer_buf_data(Buf my_buf);
 
+/*
+ * Switch a buffer to and from compact form. While in compact form, 16, 32
+ * and 64-bit integers and times are packed as variable length values and a
+ * string or memory block already packed since compact_buf_start() is packed
+ * as a reference to the earlier copy. Data packed in compact form must be
+ * unpacked in compact form, starting at the same place in the buffer.
+ */
+void	compact_buf_start(Buf buffer);
+void	compact_buf_end(Buf buffer);
+
 void	pack_time(time_t val, Buf buffer);
 int	unpack_time(time_t *valp, Buf buffer);
 
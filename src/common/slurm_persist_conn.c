@@ -39,6 +39,7 @@
 
 #include <poll.h>
 #include <pthread.h>
+#include <sys/uio.h>
 
 #if HAVE_SYS_PRCTL_H
 #include <sys/prctl.h>
@@ -785,6 +786,7 @@ extern int slurm_persist_send_msg(
 	uint32_t msg_size, nw_size;
 	char *msg;
 	ssize_t msg_wrote;
+	struct iovec iov[2];
 	int rc, retry_cnt = 0;
 
 	xassert(persist_conn);
@@ -813,11 +815,21 @@ extern int slurm_persist_send_msg(
 
 	msg_size = get_buf_offset(buffer);
 	nw_size = htonl(msg_size);
-	msg_wrote = write(persist_conn->fd, &nw_size, sizeof(nw_size));
-	if (msg_wrote != sizeof(nw_size))
+	msg = get_buf_data(buffer);
+
+	/* Write the length along with the message. A separate small write
+	 * can be held back by Nagle until the peer acknowledges it. */
+	iov[0].iov_base = &nw_size;
+	iov[0].iov_len  = sizeof(nw_size);
+	iov[1].iov_base = msg;
+	iov[1].iov_len  = msg_size;
+	msg_wrote = writev(persist_conn->fd, iov, 2);
+	if (msg_wrote < (ssize_t) sizeof(nw_size))
 		return EAGAIN;
+	msg_wrote -= sizeof(nw_size);
+	msg += msg_wrote;
+	msg_size -= msg_wrote;
 
-	msg = get_buf_data(buffer);
 	while (msg_size > 0) {
 		rc = slurm_persist_conn_writeable(persist_conn);
 		if (rc == -1)
@@ -61,6 +61,7 @@
 #include "src/common/log.h"
 #include "src/common/macros.h"
 #include "src/common/msg_aggr.h"
+#include "src/common/net.h"
 #include "src/common/pack.h"
 #include "src/common/read_config.h"
 #include "src/common/slurm_accounting_storage.h"
@@ -491,6 +492,25 @@ char *slurm_get_mpi_params(void)
 	return mpi_params;
 }
 
+/* slurm_get_comm_params
+ * get communication parameters value from slurmctld_conf object
+ * RET char *   - communication parameters from slurm.conf,
+ * MUST be xfreed by caller
+ */
+char *slurm_get_comm_params(void)
+{
+	char *comm_params = NULL;
+	slurm_ctl_conf_t *conf;
+
+	if (slurmdbd_conf) {
+	} else {
+		conf = slurm_conf_lock();
+		comm_params = xstrdup(conf->comm_params);
+		slurm_conf_unlock();
+	}
+	return comm_params;
+}
+
 /* slurm_get_msg_aggr_params
  * get message aggregation parameters value from slurmctld_conf object
  * RET char *   - message aggregation value from slurm.conf,
@@ -3342,20 +3362,13 @@ List slurm_receive_msgs(int fd, int steps, int timeout)
 {
 	char *buf = NULL;
 	size_t buflen = 0;
-	header_t header;
 	int rc;
-	void *auth_cred = NULL;
-	slurm_msg_t msg;
 	Buf buffer;
-	ret_data_info_t *ret_data_info = NULL;
 	List ret_list = NULL;
 	int orig_timeout = timeout;
 
 	xassert(fd >= 0);
 
-	slurm_msg_t_init(&msg);
-	msg.conn_fd = fd;
-
 	if (timeout <= 0) {
 		/* convert secs to msec */
 		timeout  = slurm_get_msg_timeout() * 1000;
@@ -3394,9 +3407,11 @@ List slurm_receive_msgs(int fd, int steps, int timeout)
 	 *  the message.
 	 */
 	if (slurm_msg_recvfrom_timeout(fd, &buf, &buflen, 0, timeout) < 0) {
-		forward_init(&header.forward, NULL);
 		rc = errno;
-		goto total_return;
+		error("slurm_receive_msgs: %s", slurm_strerror(rc));
+		usleep(10000);	/* Discourage brute force attack */
+		errno = rc;
+		return NULL;
 	}
 
 #if	_DEBUG
@@ -3404,6 +3419,33 @@ List slurm_receive_msgs(int fd, int steps, int timeout)
 #endif
 	buffer = create_buf(buf, buflen);
 
+	ret_list = slurm_unpack_received_msgs(fd, buffer);
+	if (errno != SLURM_SUCCESS) {
+		rc = errno;
+		usleep(10000);	/* Discourage brute force attack */
+		errno = rc;
+	}
+	return ret_list;
+}
+
+/*
+ * Unpack a response read from fd into a List of ret_data_info_t
+ * IN fd	- file descriptor the message came from
+ * IN buffer	- message less its length prefix, always freed
+ * RET List	- responses of the peer and its children, NULL on failure
+ */
+extern List slurm_unpack_received_msgs(int fd, Buf buffer)
+{
+	header_t header;
+	int rc;
+	void *auth_cred = NULL;
+	slurm_msg_t msg;
+	ret_data_info_t *ret_data_info = NULL;
+	List ret_list = NULL;
+
+	slurm_msg_t_init(&msg);
+	msg.conn_fd = fd;
+
 	if (unpack_header(&header, buffer) == SLURM_ERROR) {
 		free_buf(buffer);
 		rc = SLURM_COMMUNICATIONS_RECEIVE_ERROR;
@@ -3501,7 +3543,6 @@ total_return:
 			list_push(ret_list, ret_data_info);
 		}
 		error("slurm_receive_msgs: %s", slurm_strerror(rc));
-		usleep(10000);	/* Discourage brute force attack */
 	} else {
 		if (!ret_list)
 			ret_list = list_create(destroy_data_info);
@@ -3657,12 +3698,12 @@ int slurm_receive_msg_and_forward(int fd, slurm_addr_t *orig_addr,
 		slurm_mutex_init(&msg->forward_struct->forward_mutex);
 		slurm_cond_init(&msg->forward_struct->notify, NULL);
 
+		/* The forward threads send the rest of the message straight
+		 * from the receive buffer, which the forward_struct owns
+		 * from here on. Unpacking it below only reads it. */
 		msg->forward_struct->buf_len = remaining_buf(buffer);
-		msg->forward_struct->buf =
-			xmalloc(sizeof(char) * msg->forward_struct->buf_len);
-		memcpy(msg->forward_struct->buf,
-		       &buffer->head[buffer->processed],
-		       msg->forward_struct->buf_len);
+		msg->forward_struct->buf = &buffer->head[buffer->processed];
+		msg->forward_struct->buffer = buffer;
 
 		msg->forward_struct->ret_list = msg->ret_list;
 		/* take out the amount of timeout from this hop */
@@ -3683,7 +3724,8 @@ int slurm_receive_msg_and_forward(int fd, slurm_addr_t *orig_addr,
 	if ((auth_cred = g_slurm_auth_unpack(buffer)) == NULL) {
 		error( "authentication: %s ",
 		       g_slurm_auth_errstr(g_slurm_auth_errno(NULL)));
-		free_buf(buffer);
+		if (!msg->forward_struct)
+			free_buf(buffer);
 		rc = ESLURM_PROTOCOL_INCOMPLETE_PACKET;
 		goto total_return;
 	}
@@ -3700,7 +3742,8 @@ int slurm_receive_msg_and_forward(int fd, slurm_addr_t *orig_addr,
 		error( "authentication: %s ",
 		       g_slurm_auth_errstr(g_slurm_auth_errno(auth_cred)));
 		(void) g_slurm_auth_destroy(auth_cred);
-		free_buf(buffer);
+		if (!msg->forward_struct)
+			free_buf(buffer);
 		rc = SLURM_PROTOCOL_AUTHENTICATION_ERROR;
 		goto total_return;
 	}
@@ -3713,6 +3756,14 @@ int slurm_receive_msg_and_forward(int fd, slurm_addr_t *orig_addr,
 	msg->flags = header.flags;
 
 	if (header.msg_type == MESSAGE_COMPOSITE) {
+		if (msg->forward_struct) {
+			/* msg_aggr takes the buffer, give it its own */
+			uint32_t offset = get_buf_offset(buffer);
+			char *data = xmalloc_nz(size_buf(buffer));
+			memcpy(data, get_buf_data(buffer), size_buf(buffer));
+			buffer = create_buf(data, size_buf(buffer));
+			set_buf_offset(buffer, offset);
+		}
 		msg_aggr_add_comp(buffer, auth_cred, &header);
 		goto total_return;
 	}
@@ -3720,13 +3771,15 @@ int slurm_receive_msg_and_forward(int fd, slurm_addr_t *orig_addr,
 	if ( (header.body_length > remaining_buf(buffer)) ||
 	     (unpack_msg(msg, buffer) != SLURM_SUCCESS) ) {
 		(void) g_slurm_auth_destroy(auth_cred);
-		free_buf(buffer);
+		if (!msg->forward_struct)
+			free_buf(buffer);
 		rc = ESLURM_PROTOCOL_INCOMPLETE_PACKET;
 		goto total_return;
 	}
 	msg->auth_cred = (void *) auth_cred;
 
-	free_buf(buffer);
+	if (!msg->forward_struct)
+		free_buf(buffer);
 	rc = SLURM_SUCCESS;
 
 total_return:
@@ -3778,7 +3831,11 @@ _pack_msg(slurm_msg_t *msg, header_t *hdr, Buf buffer)
  *  Send a slurm message over an open file descriptor `fd'
  *    Returns the size of the message sent in bytes, or -1 on failure.
  */
-int slurm_send_node_msg(int fd, slurm_msg_t * msg)
+/*
+ * Pack a message header, auth credential and body for transmission
+ * RET packed buffer, NULL on error with errno set
+ */
+extern Buf slurm_pack_node_msg(slurm_msg_t *msg)
 {
 	header_t header;
 	Buf      buffer;
@@ -3786,36 +3843,6 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 	void *   auth_cred;
 	time_t   start_time = time(NULL);
 
-	if (msg->conn) {
-		persist_msg_t persist_msg;
-
-		memset(&persist_msg, 0, sizeof(persist_msg_t));
-		persist_msg.msg_type = msg->msg_type;
-		persist_msg.data = msg->data;
-
-		buffer = slurm_persist_msg_pack(msg->conn, &persist_msg);
-		rc = slurm_persist_send_msg(msg->conn, buffer);
-		free_buf(buffer);
-
-		if ((rc < 0) && (errno == ENOTCONN)) {
-			debug3("slurm_persist_send_msg: pesistant connection has disappeared for msg_type=%u",
-			       msg->msg_type);
-		} else if (rc < 0) {
-			slurm_addr_t peer_addr;
-			char addr_str[32];
-			if (!slurm_get_peer_addr(msg->conn->fd, &peer_addr)) {
-				slurm_print_slurm_addr(
-					&peer_addr, addr_str, sizeof(addr_str));
-				error("slurm_persist_send_msg: address:port=%s msg_type=%u: %m",
-				      addr_str, msg->msg_type);
-			} else
-				error("slurm_persist_send_msg: msg_type=%u: %m",
-				      msg->msg_type);
-		}
-
-		return rc;
-	}
-
 	/*
 	 * Initialize header with Auth credential and message type.
 	 * We get the credential now rather than later so the work can
@@ -3855,7 +3882,8 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 	if (auth_cred == NULL) {
 		error("authentication: %s",
 		      g_slurm_auth_errstr(g_slurm_auth_errno(NULL)) );
-		slurm_seterrno_ret(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		slurm_seterrno(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		return NULL;
 	}
 
 	init_header(&header, msg, msg->flags);
@@ -3875,7 +3903,8 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 		error("authentication: %s",
 		      g_slurm_auth_errstr(g_slurm_auth_errno(auth_cred)));
 		free_buf(buffer);
-		slurm_seterrno_ret(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		slurm_seterrno(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		return NULL;
 	}
 
 	/*
@@ -3883,6 +3912,47 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 	 */
 	_pack_msg(msg, &header, buffer);
 
+	return buffer;
+}
+
+int slurm_send_node_msg(int fd, slurm_msg_t * msg)
+{
+	Buf      buffer;
+	int      rc;
+
+	if (msg->conn) {
+		persist_msg_t persist_msg;
+
+		memset(&persist_msg, 0, sizeof(persist_msg_t));
+		persist_msg.msg_type = msg->msg_type;
+		persist_msg.data = msg->data;
+
+		buffer = slurm_persist_msg_pack(msg->conn, &persist_msg);
+		rc = slurm_persist_send_msg(msg->conn, buffer);
+		free_buf(buffer);
+
+		if ((rc < 0) && (errno == ENOTCONN)) {
+			debug3("slurm_persist_send_msg: pesistant connection has disappeared for msg_type=%u",
+			       msg->msg_type);
+		} else if (rc < 0) {
+			slurm_addr_t peer_addr;
+			char addr_str[32];
+			if (!slurm_get_peer_addr(msg->conn->fd, &peer_addr)) {
+				slurm_print_slurm_addr(
+					&peer_addr, addr_str, sizeof(addr_str));
+				error("slurm_persist_send_msg: address:port=%s msg_type=%u: %m",
+				      addr_str, msg->msg_type);
+			} else
+				error("slurm_persist_send_msg: msg_type=%u: %m",
+				      msg->msg_type);
+		}
+
+		return rc;
+	}
+
+	if (!(buffer = slurm_pack_node_msg(msg)))
+		return SLURM_ERROR;
+
 #if	_DEBUG
 	_print_data (get_buf_data(buffer),get_buf_offset(buffer));
 #endif
@@ -4550,6 +4620,8 @@ List slurm_send_addr_recv_msgs(slurm_msg_t *msg, char *name, int timeout)
 		errno = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
 		return ret_list;
 	}
+	if (msg->forward.cnt > 0)
+		net_set_relay_keep_alive(fd);
 
 	msg->ret_list = NULL;
 	msg->forward_struct = NULL;
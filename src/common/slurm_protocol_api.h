@@ -201,6 +201,13 @@ char *slurm_get_mpi_default(void);
  */
 char *slurm_get_mpi_params(void);
 
+/* slurm_get_comm_params
+ * get communication parameters value from slurmctld_conf object
+ * RET char *   - communication parameters from slurm.conf,
+ *                MUST be xfreed by caller
+ */
+char *slurm_get_comm_params(void);
+
 /* slurm_get_msg_aggr_params
  * get message aggregation parameters value from slurmctld_conf object
  * RET char *   - msg aggregation parameters default value from slurm.conf,
@@ -1023,6 +1030,18 @@ int slurm_receive_msg(int fd, slurm_msg_t *msg, int timeout);
  */
 List slurm_receive_msgs(int fd, int steps, int timeout);
 
+/*
+ *  Unpack a response already read from "fd" (less its length prefix)
+ *    the same way slurm_receive_msgs() does, for callers that do their
+ *    own non-blocking I/O.
+ *
+ * IN fd	- file descriptor the message came from, used for logging
+ * IN buffer	- Buf holding the message, always consumed
+ * RET List	- List containing type (ret_data_info_t), NULL on failure
+ *                with errno set.
+ */
+extern List slurm_unpack_received_msgs(int fd, Buf buffer);
+
 /*
  *  Receive a slurm message on the open slurm descriptor "fd" waiting
  *    at most "timeout" seconds for the message data. This will also
@@ -1055,6 +1074,15 @@ int slurm_receive_msg_and_forward(int fd, slurm_addr_t *orig_addr,
  */
 int slurm_send_node_msg(int open_fd, slurm_msg_t *msg);
 
+/* pack a message header, auth credential and body into a new buffer,
+ * exactly as slurm_send_node_msg() would send it (less the length prefix)
+ *
+ * IN msg		- a slurm msg struct to be packed
+ * RET Buf		- packed message, NULL on failure and sets errno,
+ *			  must be freed with free_buf()
+ */
+extern Buf slurm_pack_node_msg(slurm_msg_t *msg);
+
 /**********************************************************************\
  * msg connection establishment functions used by msg clients
 \**********************************************************************/
@@ -105,6 +105,11 @@
 #define SLURM_GLOBAL_AUTH_KEY   0x0001
 #define SLURMDBD_CONNECTION     0x0002
 #define SLURM_MSG_KEEP_BUFFER   0x0004
+#define SLURM_MSG_KEEP_OPEN     0x0008	/* sender will reuse the connection
+					 * for further requests */
+
+/* Seconds an idle connection flagged SLURM_MSG_KEEP_OPEN is held open */
+#define SLURM_KEEP_OPEN_IDLE	300
 
 #include "src/common/slurm_protocol_socket_common.h"
 
@@ -132,6 +132,14 @@ extern void slurm_msg_t_copy(slurm_msg_t *dest, slurm_msg_t *src)
 	return;
 }
 
+extern bool slurm_job_info_cond_filtered(job_info_cond_t *cond)
+{
+	if (!cond)
+		return false;
+	return (cond->accounts || cond->job_id_cnt || cond->nodes ||
+		cond->partitions || cond->state_cnt || cond->user_cnt);
+}
+
 extern void slurm_destroy_char(void *object)
 {
 	char *tmp = (char *)object;
@@ -691,9 +699,25 @@ extern void slurm_free_job_step_kill_msg(job_step_kill_msg_t * msg)
 	xfree(msg);
 }
 
+extern void slurm_free_job_info_cond(job_info_cond_t *cond)
+{
+	if (cond) {
+		xfree(cond->accounts);
+		xfree(cond->job_ids);
+		xfree(cond->nodes);
+		xfree(cond->partitions);
+		xfree(cond->states);
+		xfree(cond->user_ids);
+		xfree(cond);
+	}
+}
+
 extern void slurm_free_job_info_request_msg(job_info_request_msg_t *msg)
 {
-	xfree(msg);
+	if (msg) {
+		slurm_free_job_info_cond(msg->cond);
+		xfree(msg);
+	}
 }
 
 extern void slurm_free_job_step_info_request_msg(job_step_info_request_msg_t *msg)
@@ -707,9 +731,21 @@ extern void slurm_free_front_end_info_request_msg
 	xfree(msg);
 }
 
+extern void slurm_free_node_info_cond(node_info_cond_t *cond)
+{
+	if (cond) {
+		xfree(cond->nodes);
+		xfree(cond->partitions);
+		xfree(cond);
+	}
+}
+
 extern void slurm_free_node_info_request_msg(node_info_request_msg_t *msg)
 {
-	xfree(msg);
+	if (msg) {
+		slurm_free_node_info_cond(msg->cond);
+		xfree(msg);
+	}
 }
 
 extern void slurm_free_node_info_single_msg(node_info_single_msg_t *msg)
@@ -789,6 +825,20 @@ extern void slurm_free_job_desc_msg(job_desc_msg_t * msg)
 	}
 }
 
+extern void slurm_free_job_desc_array_msg(job_desc_array_msg_t *msg)
+{
+	int i;
+
+	if (msg) {
+		if (msg->job_desc) {
+			for (i = 0; i < msg->job_cnt; i++)
+				slurm_free_job_desc_msg(msg->job_desc[i]);
+			xfree(msg->job_desc);
+		}
+		xfree(msg);
+	}
+}
+
 extern void slurm_free_sib_msg(sib_msg_t *msg)
 {
 	if (msg) {
@@ -1288,6 +1338,7 @@ extern void slurm_free_checkpoint_tasks_msg(checkpoint_tasks_msg_t * msg)
 extern void slurm_free_epilog_complete_msg(epilog_complete_msg_t * msg)
 {
 	if (msg) {
+		acct_gather_energy_destroy(msg->energy);
 		xfree(msg->node_name);
 		xfree(msg);
 	}
@@ -1413,12 +1464,24 @@ extern void slurm_free_suspend_int_msg(suspend_int_msg_t *msg)
 extern void slurm_free_stats_response_msg(stats_info_response_msg_t *msg)
 {
 	if (msg) {
+		xfree(msg->bf_thread_tests);
+		xfree(msg->bf_thread_usec);
 		xfree(msg->rpc_type_id);
 		xfree(msg->rpc_type_cnt);
 		xfree(msg->rpc_type_time);
 		xfree(msg->rpc_user_id);
 		xfree(msg->rpc_user_cnt);
 		xfree(msg->rpc_user_time);
+		xfree(msg->rpc_queue_type_id);
+		xfree(msg->rpc_queue_type_depth);
+		xfree(msg->rpc_queue_type_max);
+		xfree(msg->rpc_type_max);
+		xfree(msg->rpc_type_hist);
+		xfree(msg->lock_cnt);
+		xfree(msg->lock_wait_usec);
+		xfree(msg->lock_wait_max);
+		xfree(msg->lock_hold_usec);
+		xfree(msg->lock_hold_max);
 		xfree(msg);
 	}
 }
@@ -1877,7 +1940,10 @@ inline void slurm_free_forward_data_msg(forward_data_msg_t *msg)
 
 extern void slurm_free_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg)
 {
-	xfree(msg);
+	if (msg) {
+		acct_gather_energy_destroy(msg->energy);
+		xfree(msg);
+	}
 }
 
 extern char *preempt_mode_string(uint16_t preempt_mode)
@@ -3178,6 +3244,29 @@ extern void slurm_free_submit_response_response_msg(submit_response_msg_t * msg)
 	xfree(msg);
 }
 
+/*
+ * slurm_free_submit_jobs_response_msg - free slurm multiple job submit
+ *	response message
+ * IN msg - pointer to job submit response message
+ * NOTE: buffer is loaded by slurm_submit_batch_jobs
+ */
+extern void slurm_free_submit_jobs_response_msg(
+	submit_jobs_response_msg_t *msg)
+{
+	uint32_t i;
+
+	if (msg) {
+		xfree(msg->job_id);
+		xfree(msg->error_code);
+		if (msg->err_msg) {
+			for (i = 0; i < msg->job_cnt; i++)
+				xfree(msg->err_msg[i]);
+			xfree(msg->err_msg);
+		}
+		xfree(msg);
+	}
+}
+
 
 /*
  * slurm_free_ctl_conf - free slurm control information response message
@@ -3224,6 +3313,21 @@ extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr)
 	}
 }
 
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg)
+{
+	int i;
+
+	if (msg) {
+		for (i = 0; msg->update_rec && (i < msg->update_cnt); i++)
+			xfree(msg->update_rec[i]);
+		xfree(msg->update_rec);
+		xfree(msg->update_id);
+		xfree(msg->update_size);
+		xfree(msg->purge_id);
+		xfree(msg);
+	}
+}
+
 static void _free_all_job_info(job_info_msg_t *msg)
 {
 	int i;
@@ -3892,6 +3996,12 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case REQUEST_SIB_RESOURCE_ALLOCATION:
 		slurm_free_sib_msg(data);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		slurm_free_job_desc_array_msg(data);
+		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		slurm_free_submit_jobs_response_msg(data);
+		break;
 	case RESPONSE_JOB_WILL_RUN:
 		slurm_free_will_run_response_msg(data);
 		break;
@@ -4080,6 +4190,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case RESPONSE_FED_INFO:
 		slurmdb_destroy_federation_rec(data);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		slurm_free_job_info_delta_msg(data);
+		break;
 	case REQUEST_PERSIST_INIT:
 		slurm_persist_free_init_req_msg(data);
 		break;
@@ -4122,6 +4235,7 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		break;
 	case MESSAGE_COMPOSITE:
 	case RESPONSE_MESSAGE_COMPOSITE:
+	case REQUEST_MESSAGE_COMPOSITE:
 		slurm_free_composite_msg(data);
 		break;
 	case REQUEST_UPDATE_BLOCK:
@@ -4441,6 +4555,10 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_FED_INFO";
 	case RESPONSE_FED_INFO:
 		return "RESPONSE_FED_INFO";
+	case RESPONSE_JOB_INFO_DELTA:
+		return "RESPONSE_JOB_INFO_DELTA";
+	case RESPONSE_JOB_INFO_COMPACT:
+		return "RESPONSE_JOB_INFO_COMPACT";
 
 	case REQUEST_UPDATE_JOB:				/* 3001 */
 		return "REQUEST_UPDATE_JOB";
@@ -4499,6 +4617,10 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_SIB_SUBMIT_BATCH_JOB";
 	case REQUEST_SIB_RESOURCE_ALLOCATION:
 		return "REQUEST_SIB_RESOURCE_ALLOCATION";
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		return "REQUEST_SUBMIT_BATCH_JOBS";
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		return "RESPONSE_SUBMIT_BATCH_JOBS";
 	case RESPONSE_JOB_WILL_RUN:
 		return "RESPONSE_JOB_WILL_RUN";
 	case REQUEST_JOB_ALLOCATION_INFO:
@@ -4686,6 +4808,8 @@ rpc_num2string(uint16_t opcode)
 		return "MESSAGE_COMPOSITE";
 	case RESPONSE_MESSAGE_COMPOSITE:
 		return "RESPONSE_MESSAGE_COMPOSITE";
+	case REQUEST_MESSAGE_COMPOSITE:
+		return "REQUEST_MESSAGE_COMPOSITE";
 
 	case REQUEST_PERSIST_INIT:
 		return "REQUEST_PERSIST_INIT";
@@ -249,6 +249,8 @@ typedef enum {
 	RESPONSE_LAYOUT_INFO,
 	REQUEST_FED_INFO,
 	RESPONSE_FED_INFO,		/* 2050 */
+	RESPONSE_JOB_INFO_DELTA,
+	RESPONSE_JOB_INFO_COMPACT,
 
 	REQUEST_UPDATE_JOB = 3001,
 	REQUEST_UPDATE_NODE,
@@ -291,6 +293,8 @@ typedef enum {
 	REQUEST_SIB_JOB_WILL_RUN,
 	REQUEST_SIB_SUBMIT_BATCH_JOB,
 	REQUEST_SIB_RESOURCE_ALLOCATION,
+	REQUEST_SUBMIT_BATCH_JOBS,
+	RESPONSE_SUBMIT_BATCH_JOBS,
 
 	REQUEST_JOB_STEP_CREATE = 5001,
 	RESPONSE_JOB_STEP_CREATE,
@@ -382,6 +386,7 @@ typedef enum {
 
 	MESSAGE_COMPOSITE = 11001,
 	RESPONSE_MESSAGE_COMPOSITE,
+	REQUEST_MESSAGE_COMPOSITE,
 } slurm_msg_type_t;
 
 typedef enum {
@@ -415,8 +420,9 @@ typedef struct slurm_protocol_header {
 } header_t;
 
 typedef struct forward_struct {
-	char *buf;
+	char *buf;		/* message to forward, points into buffer */
 	int buf_len;
+	Buf buffer;		/* received message, freed with this struct */
 	uint16_t fwd_cnt;
 	pthread_mutex_t forward_mutex;
 	pthread_cond_t notify;
@@ -592,10 +598,29 @@ typedef struct job_step_id_msg {
 } job_step_id_msg_t;
 
 typedef struct job_info_request_msg {
+	uint32_t delta_version;	/* 0 for a full response, else version of
+				 * the client's cached records to send
+				 * changes against, NO_VAL if none cached */
+	job_info_cond_t *cond;	/* jobs and fields to report, NULL for all */
 	time_t last_update;
 	uint16_t show_flags;
 } job_info_request_msg_t;
 
+/* Changes to the job records of a previous job information response */
+typedef struct job_info_delta_msg {
+	uint32_t base_version;	/* version the changes apply to, 0 if the
+				 * records replace all cached records */
+	time_t last_update;
+	uint32_t purge_cnt;	/* count of jobs no longer reported */
+	uint32_t *purge_id;	/* sorted job IDs of removed records */
+	uint32_t record_count;	/* job records after applying changes */
+	uint32_t update_cnt;	/* count of added or changed records */
+	uint32_t *update_id;	/* sorted job IDs of updated records */
+	char **update_rec;	/* packed job_info_t of each updated record */
+	uint32_t *update_size;	/* size of each update_rec */
+	uint32_t version;	/* version of the resulting records */
+} job_info_delta_msg_t;
+
 typedef struct job_step_info_request_msg {
 	time_t last_update;
 	uint32_t job_id;
@@ -604,6 +629,7 @@ typedef struct job_step_info_request_msg {
 } job_step_info_request_msg_t;
 
 typedef struct node_info_request_msg {
+	node_info_cond_t *cond;	/* nodes to report, NULL for all */
 	time_t last_update;
 	uint16_t show_flags;
 } node_info_request_msg_t;
@@ -682,6 +708,9 @@ typedef struct checkpoint_tasks_msg {
 } checkpoint_tasks_msg_t;
 
 typedef struct epilog_complete_msg {
+	uint32_t cpu_load;	/* CPU load * 100 */
+	acct_gather_energy_t *energy; /* node energy, may be NULL */
+	uint64_t free_mem;	/* Free memory in MiB */
 	uint32_t job_id;
 	uint32_t return_code;
 	char    *node_name;
@@ -1154,6 +1183,7 @@ typedef struct suspend_int_msg {
 
 typedef struct ping_slurmd_resp_msg {
 	uint32_t cpu_load;	/* CPU load * 100 */
+	acct_gather_energy_t *energy; /* node energy, may be NULL */
 	uint64_t free_mem;	/* Free memory in MiB */
 } ping_slurmd_resp_msg_t;
 
@@ -1220,6 +1250,15 @@ typedef struct {
 				 * side */
 } sib_msg_t;
 
+/* Many batch jobs submitted with one RPC, see slurm_submit_batch_jobs() */
+typedef struct job_desc_array_msg {
+	uint32_t job_cnt;
+	job_desc_msg_t **job_desc;
+} job_desc_array_msg_t;
+
+/* Largest job_cnt accepted in a job_desc_array_msg_t */
+#define MAX_SUBMIT_BATCH_JOBS	10000
+
 /*****************************************************************************\
  *      ACCOUNTING PUSHS
 \*****************************************************************************/
@@ -1259,6 +1298,14 @@ extern void slurm_msg_t_init (slurm_msg_t *msg);
  */
 extern void slurm_msg_t_copy(slurm_msg_t *dest, slurm_msg_t *src);
 
+/*
+ * slurm_job_info_cond_filtered - determine if a job information request
+ *	selects jobs (by account, job ID, node, partition, state or user)
+ *	rather than only the fields to report
+ * RET true if cond is not NULL and has any job filter set
+ */
+extern bool slurm_job_info_cond_filtered(job_info_cond_t *cond);
+
 extern void slurm_destroy_char(void *object);
 extern void slurm_destroy_uint32_ptr(void *object);
 /* here to add \\ to all \" in a string this needs to be xfreed later */
@@ -1275,11 +1322,13 @@ extern void slurm_free_checkpoint_tasks_msg(checkpoint_tasks_msg_t * msg);
 extern void slurm_free_last_update_msg(last_update_msg_t * msg);
 extern void slurm_free_return_code_msg(return_code_msg_t * msg);
 extern void slurm_free_job_alloc_info_msg(job_alloc_info_msg_t * msg);
+extern void slurm_free_job_info_cond(job_info_cond_t *cond);
 extern void slurm_free_job_info_request_msg(job_info_request_msg_t *msg);
 extern void slurm_free_job_step_info_request_msg(
 		job_step_info_request_msg_t *msg);
 extern void slurm_free_front_end_info_request_msg(
 		front_end_info_request_msg_t *msg);
+extern void slurm_free_node_info_cond(node_info_cond_t *cond);
 extern void slurm_free_node_info_request_msg(node_info_request_msg_t *msg);
 extern void slurm_free_node_info_single_msg(node_info_single_msg_t *msg);
 extern void slurm_free_part_info_request_msg(part_info_request_msg_t *msg);
@@ -1313,6 +1362,7 @@ extern void slurm_free_reboot_msg(reboot_msg_t * msg);
 extern void slurm_free_shutdown_msg(shutdown_msg_t * msg);
 
 extern void slurm_free_job_desc_msg(job_desc_msg_t * msg);
+extern void slurm_free_job_desc_array_msg(job_desc_array_msg_t *msg);
 extern void slurm_free_event_log_msg(slurm_event_log_msg_t * msg);
 
 extern void
@@ -1394,6 +1444,7 @@ extern void slurm_free_submit_response_response_msg(
 		submit_response_msg_t * msg);
 extern void slurm_free_ctl_conf(slurm_ctl_conf_info_msg_t * config_ptr);
 extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr);
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg);
 extern void slurm_free_job_step_info_response_msg(
 		job_step_info_response_msg_t * msg);
 extern void slurm_free_job_step_info_members (job_step_info_t * msg);
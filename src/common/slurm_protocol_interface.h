@@ -48,6 +48,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "src/common/macros.h"
@@ -80,6 +81,12 @@ typedef enum slurm_socket_type {
 /* msg functions */
 /*****************/
 
+/*
+ *  Maximum message size. Messages larger than this value (in bytes)
+ *  will not be received.
+ */
+#define SLURM_MAX_MSG_SIZE (1024*1024*1024)
+
 /* slurm_msg_recvfrom_timeout reads len bytes from file descriptor fd
  * timing out after `timeout' milliseconds.
  *
@@ -107,6 +114,23 @@ extern ssize_t slurm_msg_sendto_timeout(int open_fd,
 					uint32_t flags,
 					int timeout);
 
+/* Most pieces slurm_msg_sendv_timeout() accepts for one message */
+#define MSG_IOV_MAX 8
+
+/* slurm_msg_sendv_timeout
+ * Send a message whose pieces (e.g. header and forwarded body) are held
+ * in separate buffers, without concatenating them first
+ * IN open_fd - an open file descriptor
+ * IN iov - pieces of the message, in order
+ * IN iovcnt - count of pieces, at most MSG_IOV_MAX
+ * IN timeout - maximum time to wait for a message in milliseconds
+ * RET number of bytes written, excluding the length prefix, or -1 on error
+ */
+extern ssize_t slurm_msg_sendv_timeout(int open_fd,
+				       struct iovec *iov,
+				       int iovcnt,
+				       int timeout);
+
 /********************/
 /* stream functions */
 /********************/
@@ -69,6 +69,7 @@
 
 
 #define _pack_job_info_msg(msg,buf)		_pack_buffer_msg(msg,buf)
+#define _pack_job_info_delta_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_job_step_info_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_block_info_resp_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_burst_buffer_info_resp_msg(msg,buf) _pack_buffer_msg(msg,buf)
@@ -458,7 +459,9 @@ static int _unpack_job_desc_msg(job_desc_msg_t ** job_desc_buffer_ptr,
 				Buf buffer,
 				uint16_t protocol_version);
 static int _unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer,
-				uint16_t protocol_version);
+				bool compact, uint16_t protocol_version);
+static int _unpack_job_info_delta_msg(job_info_delta_msg_t **msg,
+				      Buf buffer, uint16_t protocol_version);
 
 static void _pack_last_update_msg(last_update_msg_t * msg, Buf buffer,
 				  uint16_t protocol_version);
@@ -632,6 +635,16 @@ static void _pack_sib_msg(sib_msg_t *sib_msg_ptr, Buf buffer,
 			  uint16_t protocol_version);
 static int _unpack_sib_msg(sib_msg_t **sib_msg_buffer_ptr, Buf buffer,
 			   uint16_t protocol_version);
+static void _pack_job_desc_array_msg(job_desc_array_msg_t *msg, Buf buffer,
+				     uint16_t protocol_version);
+static int _unpack_job_desc_array_msg(job_desc_array_msg_t **msg_ptr,
+				      Buf buffer, uint16_t protocol_version);
+static void _pack_submit_jobs_response_msg(submit_jobs_response_msg_t *msg,
+					   Buf buffer,
+					   uint16_t protocol_version);
+static int _unpack_submit_jobs_response_msg(submit_jobs_response_msg_t **msg,
+					    Buf buffer,
+					    uint16_t protocol_version);
 
 static void _pack_accounting_update_msg(accounting_update_msg_t *msg,
 					Buf buffer,
@@ -1062,8 +1075,12 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 					 msg->protocol_version);
 		break;
 	case RESPONSE_JOB_INFO:
+	case RESPONSE_JOB_INFO_COMPACT:
 		_pack_job_info_msg((slurm_msg_t *) msg, buffer);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		_pack_job_info_delta_msg((slurm_msg_t *) msg, buffer);
+		break;
 	case RESPONSE_PARTITION_INFO:
 		_pack_partition_info_msg((slurm_msg_t *) msg, buffer);
 		break;
@@ -1096,6 +1113,10 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		_pack_sib_msg((sib_msg_t *)msg->data, buffer,
 			      msg->protocol_version);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		_pack_job_desc_array_msg((job_desc_array_msg_t *) msg->data,
+					 buffer, msg->protocol_version);
+		break;
 	case REQUEST_UPDATE_JOB_STEP:
 		_pack_update_job_step_msg((step_update_request_msg_t *)
 					  msg->data, buffer,
@@ -1158,6 +1179,11 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 					  msg->data, buffer,
 					  msg->protocol_version);
 		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		_pack_submit_jobs_response_msg((submit_jobs_response_msg_t *)
+					       msg->data, buffer,
+					       msg->protocol_version);
+		break;
 	case RESPONSE_JOB_ALLOCATION_INFO_LITE:
 	case RESPONSE_RESOURCE_ALLOCATION:
 		_pack_resource_allocation_response_msg
@@ -1643,6 +1669,7 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		break;
 	case MESSAGE_COMPOSITE:
 	case RESPONSE_MESSAGE_COMPOSITE:
+	case REQUEST_MESSAGE_COMPOSITE:
 		_pack_composite_msg((composite_msg_t *) msg->data, buffer,
 				     msg->protocol_version);
 		break;
@@ -1734,9 +1761,19 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		break;
 	case RESPONSE_JOB_INFO:
 		rc = _unpack_job_info_msg((job_info_msg_t **) & (msg->data),
-					  buffer,
+					  buffer, false,
+					  msg->protocol_version);
+		break;
+	case RESPONSE_JOB_INFO_COMPACT:
+		rc = _unpack_job_info_msg((job_info_msg_t **) & (msg->data),
+					  buffer, true,
 					  msg->protocol_version);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		rc = _unpack_job_info_delta_msg(
+			(job_info_delta_msg_t **) &msg->data, buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_PARTITION_INFO:
 		rc = _unpack_partition_info_msg((partition_info_msg_t **) &
 						(msg->data), buffer,
@@ -1773,6 +1810,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		rc = _unpack_sib_msg((sib_msg_t **)&(msg->data), buffer,
 				     msg->protocol_version);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		rc = _unpack_job_desc_array_msg(
+			(job_desc_array_msg_t **) &(msg->data),
+			buffer, msg->protocol_version);
+		break;
 	case REQUEST_UPDATE_JOB_STEP:
 		rc = _unpack_update_job_step_msg(
 			(step_update_request_msg_t **) & (msg->data),
@@ -1837,6 +1879,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 						 & (msg->data), buffer,
 						 msg->protocol_version);
 		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		rc = _unpack_submit_jobs_response_msg(
+			(submit_jobs_response_msg_t **) & (msg->data),
+			buffer, msg->protocol_version);
+		break;
 	case RESPONSE_JOB_ALLOCATION_INFO_LITE:
 	case RESPONSE_RESOURCE_ALLOCATION:
 		rc = _unpack_resource_allocation_response_msg(
@@ -2372,6 +2419,7 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		break;
 	case MESSAGE_COMPOSITE:
 	case RESPONSE_MESSAGE_COMPOSITE:
+	case REQUEST_MESSAGE_COMPOSITE:
 		rc = _unpack_composite_msg((composite_msg_t **) &(msg->data),
 					    buffer, msg->protocol_version);
 		break;
@@ -4147,6 +4195,64 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void
+_pack_submit_jobs_response_msg(submit_jobs_response_msg_t *msg, Buf buffer,
+			       uint16_t protocol_version)
+{
+	uint32_t i;
+
+	xassert(msg != NULL);
+
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		pack32_array(msg->job_id, msg->job_cnt, buffer);
+		pack32_array(msg->error_code, msg->job_cnt, buffer);
+		for (i = 0; i < msg->job_cnt; i++) {
+			if (msg->err_msg)
+				packstr(msg->err_msg[i], buffer);
+			else
+				packnull(buffer);
+		}
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+	}
+}
+
+static int
+_unpack_submit_jobs_response_msg(submit_jobs_response_msg_t **msg,
+				 Buf buffer, uint16_t protocol_version)
+{
+	submit_jobs_response_msg_t *tmp_ptr;
+	uint32_t i, uint32_tmp;
+
+	xassert(msg != NULL);
+	tmp_ptr = xmalloc(sizeof(submit_jobs_response_msg_t));
+	*msg = tmp_ptr;
+
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack32_array(&tmp_ptr->job_id, &tmp_ptr->job_cnt,
+				    buffer);
+		safe_unpack32_array(&tmp_ptr->error_code, &uint32_tmp, buffer);
+		if (uint32_tmp != tmp_ptr->job_cnt)
+			goto unpack_error;
+		tmp_ptr->err_msg = xmalloc(sizeof(char *) * tmp_ptr->job_cnt);
+		for (i = 0; i < tmp_ptr->job_cnt; i++) {
+			safe_unpackstr_xmalloc(&tmp_ptr->err_msg[i],
+					       &uint32_tmp, buffer);
+		}
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		goto unpack_error;
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_submit_jobs_response_msg(tmp_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static int
 _unpack_node_info_msg(node_info_msg_t ** msg, Buf buffer,
 		      uint16_t protocol_version)
@@ -5199,7 +5305,14 @@ _pack_epilog_comp_msg(epilog_complete_msg_t * msg, Buf buffer,
 		      uint16_t protocol_version)
 {
 	xassert(msg != NULL);
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		pack32((uint32_t)msg->job_id, buffer);
+		pack32((uint32_t)msg->return_code, buffer);
+		packstr(msg->node_name, buffer);
+		pack32(msg->cpu_load, buffer);
+		pack64(msg->free_mem, buffer);
+		acct_gather_energy_pack(msg->energy, buffer, protocol_version);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32((uint32_t)msg->job_id, buffer);
 		pack32((uint32_t)msg->return_code, buffer);
 		packstr(msg->node_name, buffer);
@@ -5217,7 +5330,18 @@ _unpack_epilog_comp_msg(epilog_complete_msg_t ** msg, Buf buffer,
 	tmp_ptr = xmalloc(sizeof(epilog_complete_msg_t));
 	*msg = tmp_ptr;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack32(&(tmp_ptr->job_id), buffer);
+		safe_unpack32(&(tmp_ptr->return_code), buffer);
+		safe_unpackstr_xmalloc(&(tmp_ptr->node_name),
+				       &uint32_tmp, buffer);
+		safe_unpack32(&tmp_ptr->cpu_load, buffer);
+		safe_unpack64(&tmp_ptr->free_mem, buffer);
+		if (acct_gather_energy_unpack(&tmp_ptr->energy, buffer,
+					      protocol_version, 1)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&(tmp_ptr->job_id), buffer);
 		safe_unpack32(&(tmp_ptr->return_code), buffer);
 		safe_unpackstr_xmalloc(&(tmp_ptr->node_name),
@@ -6015,7 +6139,7 @@ _pack_buffer_msg(slurm_msg_t * msg, Buf buffer)
 }
 
 static int
-_unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer,
+_unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer, bool compact,
 		     uint16_t protocol_version)
 {
 	int i;
@@ -6032,12 +6156,18 @@ _unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer,
 		if ((*msg)->record_count)
 			job = (*msg)->job_array = xmalloc(sizeof(job_info_t) *
 							  (*msg)->record_count);
+		/* job records of RESPONSE_JOB_INFO_COMPACT, see
+		 * pack_all_jobs() */
+		if (compact)
+			compact_buf_start(buffer);
 		/* load individual job info */
 		for (i = 0; i < (*msg)->record_count; i++) {
 			if (_unpack_job_info_members(&job[i], buffer,
 						     protocol_version))
 				goto unpack_error;
 		}
+		if (compact)
+			compact_buf_end(buffer);
 	} else {
 		error("_unpack_job_info_msg: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -6051,6 +6181,53 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static int _unpack_job_info_delta_msg(job_info_delta_msg_t **msg,
+				      Buf buffer, uint16_t protocol_version)
+{
+	job_info_delta_msg_t *delta;
+	uint32_t uint32_tmp;
+	int i;
+
+	xassert(msg != NULL);
+	delta = xmalloc(sizeof(job_info_delta_msg_t));
+	*msg = delta;
+
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack32(&delta->version, buffer);
+		safe_unpack32(&delta->base_version, buffer);
+		safe_unpack_time(&delta->last_update, buffer);
+		safe_unpack32(&delta->record_count, buffer);
+		safe_unpack32(&delta->update_cnt, buffer);
+		if (delta->update_cnt > remaining_buf(buffer))
+			goto unpack_error;
+		if (delta->update_cnt) {
+			delta->update_id = xmalloc(sizeof(uint32_t) *
+						   delta->update_cnt);
+			delta->update_rec = xmalloc(sizeof(char *) *
+						    delta->update_cnt);
+			delta->update_size = xmalloc(sizeof(uint32_t) *
+						     delta->update_cnt);
+		}
+		for (i = 0; i < delta->update_cnt; i++) {
+			safe_unpack32(&delta->update_id[i], buffer);
+			safe_unpackmem_xmalloc(&delta->update_rec[i],
+					       &delta->update_size[i], buffer);
+		}
+		safe_unpack32_array(&delta->purge_id, &uint32_tmp, buffer);
+		delta->purge_cnt = uint32_tmp;
+	} else {
+		error("_unpack_job_info_delta_msg: protocol_version "
+		      "%hu not supported", protocol_version);
+		goto unpack_error;
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_job_info_delta_msg(delta);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 /* Translate bitmap representation from hex to decimal format, replacing
  * array_task_str and store the bitmap in job->array_bitmap. */
 static void _xlate_task_str(job_info_t *job_ptr)
@@ -6682,6 +6859,7 @@ _pack_slurm_ctl_conf_msg(slurm_ctl_conf_info_msg_t * build_ptr, Buf buffer,
 		packstr(build_ptr->checkpoint_type, buffer);
 		packstr(build_ptr->chos_loc, buffer);
 		packstr(build_ptr->cluster_name, buffer);
+		packstr(build_ptr->comm_params, buffer);
 		pack16(build_ptr->complete_wait, buffer);
 		packstr(build_ptr->control_addr, buffer);
 		packstr(build_ptr->control_machine, buffer);
@@ -7565,6 +7743,8 @@ _unpack_slurm_ctl_conf_msg(slurm_ctl_conf_info_msg_t **build_buffer_ptr,
 				       &uint32_tmp, buffer);
 		safe_unpackstr_xmalloc(&build_ptr->cluster_name,
 				       &uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&build_ptr->comm_params,
+				       &uint32_tmp, buffer);
 		safe_unpack16(&build_ptr->complete_wait, buffer);
 		safe_unpackstr_xmalloc(&build_ptr->control_addr,
 				       &uint32_tmp, buffer);
@@ -8772,6 +8952,61 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void
+_pack_job_desc_array_msg(job_desc_array_msg_t *msg, Buf buffer,
+			 uint16_t protocol_version)
+{
+	int i;
+
+	xassert(msg);
+
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		pack32(msg->job_cnt, buffer);
+		for (i = 0; i < msg->job_cnt; i++) {
+			_pack_job_desc_msg(msg->job_desc[i], buffer,
+					   protocol_version);
+		}
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+	}
+}
+
+static int
+_unpack_job_desc_array_msg(job_desc_array_msg_t **msg_ptr, Buf buffer,
+			   uint16_t protocol_version)
+{
+	job_desc_array_msg_t *msg;
+	int i;
+
+	xassert(msg_ptr);
+	msg = xmalloc(sizeof(job_desc_array_msg_t));
+	*msg_ptr = msg;
+
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack32(&msg->job_cnt, buffer);
+		if (msg->job_cnt > MAX_SUBMIT_BATCH_JOBS)
+			goto unpack_error;
+		msg->job_desc = xmalloc(sizeof(job_desc_msg_t *) *
+					msg->job_cnt);
+		for (i = 0; i < msg->job_cnt; i++) {
+			if (_unpack_job_desc_msg(&msg->job_desc[i], buffer,
+						 protocol_version))
+				goto unpack_error;
+		}
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		goto unpack_error;
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_job_desc_array_msg(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
 /* _pack_job_desc_msg
  * packs a job_desc struct
  * IN job_desc_ptr - pointer to the job descriptor to pack
@@ -11551,12 +11786,62 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* Pack the filters of a job information request, NULL if none */
+static void _pack_job_info_cond(job_info_cond_t *cond, Buf buffer)
+{
+	if (!cond) {
+		pack8((uint8_t) 0, buffer);
+		return;
+	}
+	pack8((uint8_t) 1, buffer);
+	packstr(cond->accounts, buffer);
+	pack32(cond->field_mask, buffer);
+	pack32_array(cond->job_ids, cond->job_id_cnt, buffer);
+	packstr(cond->nodes, buffer);
+	packstr(cond->partitions, buffer);
+	pack32_array(cond->states, cond->state_cnt, buffer);
+	pack32_array(cond->user_ids, cond->user_cnt, buffer);
+}
+
+static int _unpack_job_info_cond(job_info_cond_t **cond_pptr, Buf buffer)
+{
+	job_info_cond_t *cond;
+	uint32_t uint32_tmp;
+	uint8_t uint8_tmp;
+
+	*cond_pptr = NULL;
+	safe_unpack8(&uint8_tmp, buffer);
+	if (!uint8_tmp)
+		return SLURM_SUCCESS;
+
+	cond = xmalloc(sizeof(job_info_cond_t));
+	*cond_pptr = cond;
+	safe_unpackstr_xmalloc(&cond->accounts, &uint32_tmp, buffer);
+	safe_unpack32(&cond->field_mask, buffer);
+	safe_unpack32_array(&cond->job_ids, &cond->job_id_cnt, buffer);
+	safe_unpackstr_xmalloc(&cond->nodes, &uint32_tmp, buffer);
+	safe_unpackstr_xmalloc(&cond->partitions, &uint32_tmp, buffer);
+	safe_unpack32_array(&cond->states, &cond->state_cnt, buffer);
+	safe_unpack32_array(&cond->user_ids, &cond->user_cnt, buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
 static void
 _pack_job_info_request_msg(job_info_request_msg_t * msg, Buf buffer,
 			   uint16_t protocol_version)
 {
-	pack_time(msg->last_update, buffer);
-	pack16((uint16_t)msg->show_flags, buffer);
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		pack_time(msg->last_update, buffer);
+		pack16((uint16_t)msg->show_flags, buffer);
+		pack32(msg->delta_version, buffer);
+		_pack_job_info_cond(msg->cond, buffer);
+	} else {
+		pack_time(msg->last_update, buffer);
+		pack16((uint16_t)msg->show_flags, buffer);
+	}
 }
 
 static int
@@ -11566,11 +11851,19 @@ _unpack_job_info_request_msg(job_info_request_msg_t** msg,
 {
 	job_info_request_msg_t*job_info;
 
-	job_info = xmalloc(sizeof(job_step_info_request_msg_t));
+	job_info = xmalloc(sizeof(job_info_request_msg_t));
 	*msg = job_info;
 
-	safe_unpack_time(&job_info->last_update, buffer);
-	safe_unpack16(&job_info->show_flags, buffer);
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack_time(&job_info->last_update, buffer);
+		safe_unpack16(&job_info->show_flags, buffer);
+		safe_unpack32(&job_info->delta_version, buffer);
+		if (_unpack_job_info_cond(&job_info->cond, buffer))
+			goto unpack_error;
+	} else {
+		safe_unpack_time(&job_info->last_update, buffer);
+		safe_unpack16(&job_info->show_flags, buffer);
+	}
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -12243,6 +12536,14 @@ _pack_node_info_request_msg(node_info_request_msg_t * msg, Buf buffer,
 {
 	pack_time(msg->last_update, buffer);
 	pack16(msg->show_flags, buffer);
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		if (msg->cond) {
+			pack8((uint8_t) 1, buffer);
+			packstr(msg->cond->nodes, buffer);
+			packstr(msg->cond->partitions, buffer);
+		} else
+			pack8((uint8_t) 0, buffer);
+	}
 }
 
 static int
@@ -12250,12 +12551,24 @@ _unpack_node_info_request_msg(node_info_request_msg_t ** msg, Buf buffer,
 			      uint16_t protocol_version)
 {
 	node_info_request_msg_t* node_info;
+	uint32_t uint32_tmp;
+	uint8_t uint8_tmp;
 
 	node_info = xmalloc(sizeof(node_info_request_msg_t));
 	*msg = node_info;
 
 	safe_unpack_time(&node_info->last_update, buffer);
 	safe_unpack16(&node_info->show_flags, buffer);
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack8(&uint8_tmp, buffer);
+		if (uint8_tmp) {
+			node_info->cond = xmalloc(sizeof(node_info_cond_t));
+			safe_unpackstr_xmalloc(&node_info->cond->nodes,
+					       &uint32_tmp, buffer);
+			safe_unpackstr_xmalloc(&node_info->cond->partitions,
+					       &uint32_tmp, buffer);
+		}
+	}
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -13566,6 +13879,7 @@ static void _pack_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg,
 	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		pack32(msg->cpu_load, buffer);
 		pack64(msg->free_mem, buffer);
+		acct_gather_energy_pack(msg->energy, buffer, protocol_version);
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32(msg->cpu_load, buffer);
 		pack32(xlate_mem_new2old(msg->free_mem), buffer);
@@ -13584,6 +13898,10 @@ static int _unpack_ping_slurmd_resp(ping_slurmd_resp_msg_t **msg_ptr,
 	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		safe_unpack32(&msg->cpu_load, buffer);
 		safe_unpack64(&msg->free_mem, buffer);
+		if (acct_gather_energy_unpack(&msg->energy, buffer,
+					      protocol_version, 1)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		uint32_t tmp_mem;
 		safe_unpack32(&msg->cpu_load, buffer);
@@ -14765,6 +15083,27 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 			safe_unpack32(&msg->bf_depth_try_sum,	buffer);
 			safe_unpack32(&msg->bf_queue_len_sum,	buffer);
 			safe_unpack32(&msg->bf_active,		buffer);
+			if (protocol_version >=
+			    SLURM_17_02_PROTOCOL_VERSION) {
+				safe_unpack32(&msg->bf_thread_cnt, buffer);
+				safe_unpack32_array(&msg->bf_thread_tests,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->bf_thread_cnt)
+					goto unpack_error;
+				safe_unpack64_array(&msg->bf_thread_usec,
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != msg->bf_thread_cnt)
+					goto unpack_error;
+				safe_unpack32(&msg->bf_spec_used, buffer);
+				safe_unpack32(&msg->bf_spec_discard, buffer);
+				safe_unpack32(&msg->bf_plan_used, buffer);
+				safe_unpack32(&msg->bf_plan_cnt, buffer);
+				safe_unpack64(&msg->schedule_lock_last,
+					      buffer);
+				safe_unpack64(&msg->schedule_lock_sum, buffer);
+				safe_unpack64(&msg->bf_lock_last, buffer);
+				safe_unpack64(&msg->bf_lock_sum, buffer);
+			}
 		}
 
 		safe_unpack32(&msg->rpc_type_size,		buffer);
@@ -14776,6 +15115,49 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 		safe_unpack32_array(&msg->rpc_user_id,   &uint32_tmp, buffer);
 		safe_unpack32_array(&msg->rpc_user_cnt,  &uint32_tmp, buffer);
 		safe_unpack64_array(&msg->rpc_user_time, &uint32_tmp, buffer);
+
+		if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+			safe_unpack32(&msg->rpc_queue_type_size, buffer);
+			safe_unpack16_array(&msg->rpc_queue_type_id,
+					    &uint32_tmp, buffer);
+			safe_unpack32_array(&msg->rpc_queue_type_depth,
+					    &uint32_tmp, buffer);
+			safe_unpack32_array(&msg->rpc_queue_type_max,
+					    &uint32_tmp, buffer);
+
+			safe_unpack64_array(&msg->rpc_type_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_type_size)
+				goto unpack_error;
+			safe_unpack32(&msg->rpc_hist_size, buffer);
+			safe_unpack32_array(&msg->rpc_type_hist,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp !=
+			    (msg->rpc_type_size * msg->rpc_hist_size))
+				goto unpack_error;
+
+			safe_unpack32(&msg->lock_stat_size, buffer);
+			safe_unpack32_array(&msg->lock_cnt,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_stat_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_wait_usec,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_stat_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_wait_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_stat_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_hold_usec,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_stat_size)
+				goto unpack_error;
+			safe_unpack64_array(&msg->lock_hold_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->lock_stat_size)
+				goto unpack_error;
+		}
 	} else {
 		error("_unpack_stats_response_msg: protocol_version "
 		      "%hu not supported", protocol_version);
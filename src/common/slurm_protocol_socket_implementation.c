@@ -54,6 +54,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "slurm/slurm_errno.h"
@@ -72,11 +73,6 @@
 #define RANDOM_USER_PORT ((uint16_t) ((lrand48() % \
 		(MAX_USER_PORT - MIN_USER_PORT + 1)) + MIN_USER_PORT))
 
-/*
- *  Maximum message size. Messages larger than this value (in bytes)
- *  will not be received.
- */
-#define MAX_MSG_SIZE     (1024*1024*1024)
 
 
 /* Static functions */
@@ -86,8 +82,8 @@ static int _slurm_create_socket ( slurm_socket_type_t type );
 static int _slurm_vfcntl(int fd, int cmd, va_list va );
 static int _slurm_fcntl(int fd, int cmd, ... );
 static int _slurm_socket (int __domain, int __type, int __protocol);
-static ssize_t _slurm_send (int __fd, __const void *__buf, size_t __n,
-			    int __flags);
+static int _send_iov_timeout(int fd, struct iovec *iov, int iovcnt,
+			     uint32_t flags, int timeout);
 static ssize_t _slurm_recv (int __fd, void *__buf, size_t __n, int __flags);
 static int _slurm_setsockopt (int __fd, int __level, int __optname,
 			      __const void *__optval, socklen_t __optlen);
@@ -153,7 +149,7 @@ extern ssize_t slurm_msg_recvfrom_timeout(int fd, char **pbuf, size_t *lenp,
 
 	msglen = ntohl(msglen);
 
-	if (msglen > MAX_MSG_SIZE)
+	if (msglen > SLURM_MAX_MSG_SIZE)
 		slurm_seterrno_ret(SLURM_PROTOCOL_INSANE_MSG_LENGTH);
 
 	/*
@@ -182,9 +178,40 @@ extern ssize_t slurm_msg_sendto(int fd, char *buffer, size_t size,
 ssize_t slurm_msg_sendto_timeout(int fd, char *buffer, size_t size,
 				 uint32_t flags, int timeout)
 {
-	int   len;
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len  = size;
+
+	return slurm_msg_sendv_timeout(fd, &iov, 1, timeout);
+}
+
+/*
+ * Send the length prefix and all pieces of a message with as few system
+ * calls as possible, without first copying them into one buffer.
+ * RET size of the message (excluding the length prefix) or SLURM_ERROR
+ */
+extern ssize_t slurm_msg_sendv_timeout(int fd, struct iovec *iov, int iovcnt,
+				       int timeout)
+{
+	struct iovec msg_iov[MSG_IOV_MAX + 1];
+	size_t size = 0;
 	uint32_t usize;
+	ssize_t len;
 	SigFunc *ohandler;
+	int i;
+
+	if ((iovcnt < 1) || (iovcnt > MSG_IOV_MAX)) {
+		slurm_seterrno(EINVAL);
+		return SLURM_ERROR;
+	}
+	for (i = 0; i < iovcnt; i++) {
+		size += iov[i].iov_len;
+		msg_iov[i + 1] = iov[i];
+	}
+	usize = htonl(size);
+	msg_iov[0].iov_base = &usize;
+	msg_iov[0].iov_len  = sizeof(usize);
 
 	/*
 	 *  Ignore SIGPIPE so that send can return a error code if the
@@ -192,18 +219,10 @@ ssize_t slurm_msg_sendto_timeout(int fd, char *buffer, size_t size,
 	 */
 	ohandler = xsignal(SIGPIPE, SIG_IGN);
 
-	usize = htonl(size);
+	len = _send_iov_timeout(fd, msg_iov, iovcnt + 1, 0, timeout);
+	if (len >= 0)
+		len -= sizeof(usize);
 
-	if ((len = slurm_send_timeout(
-				fd, (char *)&usize, sizeof(usize), 0,
-				timeout)) < 0)
-		goto done;
-
-	if ((len = slurm_send_timeout(fd, buffer, size, 0, timeout)) < 0)
-		goto done;
-
-
-     done:
 	xsignal(SIGPIPE, ohandler);
 	return len;
 }
@@ -212,14 +231,39 @@ ssize_t slurm_msg_sendto_timeout(int fd, char *buffer, size_t size,
  * RET message size (as specified in argument) or SLURM_ERROR on error */
 extern int slurm_send_timeout(int fd, char *buf, size_t size,
 			      uint32_t flags, int timeout)
+{
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len  = size;
+
+	return _send_iov_timeout(fd, &iov, 1, flags, timeout);
+}
+
+/* Send an array of buffers with timeout, one sendmsg() per writable poll
+ * RET total size of the buffers or SLURM_ERROR on error */
+static int _send_iov_timeout(int fd, struct iovec *iov, int iovcnt,
+			     uint32_t flags, int timeout)
 {
 	int rc;
 	int sent = 0;
+	size_t size = 0;
 	int fd_flags;
+	int i;
 	struct pollfd ufds;
 	struct timeval tstart;
 	int timeleft = timeout;
 	char temp[2];
+	struct msghdr msghdr;
+
+	for (i = 0; i < iovcnt; i++)
+		size += iov[i].iov_len;
+	/* Skip leading empty buffers, sendmsg() advances through the rest */
+	while ((iovcnt > 0) && (iov->iov_len == 0)) {
+		iov++;
+		iovcnt--;
+	}
+	memset(&msghdr, 0, sizeof(msghdr));
 
 	ufds.fd     = fd;
 	ufds.events = POLLOUT;
@@ -277,7 +321,9 @@ extern int slurm_send_timeout(int fd, char *buf, size_t size,
 			      ufds.revents);
 		}
 
-		rc = _slurm_send(fd, &buf[sent], (size - sent), flags);
+		msghdr.msg_iov    = iov;
+		msghdr.msg_iovlen = iovcnt;
+		rc = sendmsg(fd, &msghdr, flags);
 		if (rc < 0) {
  			if (errno == EINTR)
 				continue;
@@ -301,6 +347,16 @@ extern int slurm_send_timeout(int fd, char *buf, size_t size,
 		}
 
 		sent += rc;
+		/* Advance past what was sent, possibly mid buffer */
+		while ((iovcnt > 0) && (rc >= iov->iov_len)) {
+			rc -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (rc) {
+			iov->iov_base = (char *) iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
 	}
 
     done:
@@ -639,13 +695,6 @@ extern int slurm_getpeername (int __fd, struct sockaddr * __addr,
 	return getpeername ( __fd , __addr , __len ) ;
 }
 
-/* Send N bytes of BUF to socket FD.  Returns the number sent or -1.  */
-static ssize_t _slurm_send (int __fd, __const void *__buf, size_t __n,
-			    int __flags)
-{
-	return send ( __fd , __buf , __n , __flags ) ;
-}
-
 /* Read N bytes into BUF from socket FD.
  * Returns the number read or -1 for errors.  */
 static ssize_t _slurm_recv (int __fd, void *__buf, size_t __n, int __flags)
@@ -53,6 +53,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_route.h"
 #include "src/common/timers.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -90,6 +91,107 @@ static slurm_addr_t *msg_collect_node = NULL; /* address of node to aggregate
 static slurm_addr_t *msg_collect_backup = NULL; /* address of backup node to
 						   aggregate messages from this node */
 
+/* Seconds a node which failed to respond is avoided as a relay */
+#define ROUTE_SUSPECT_TIME 300
+
+/* Nodes which recently failed to respond to a message, not picked to forward
+ * messages to other nodes while another node of their branch can */
+typedef struct {
+	char *name;
+	time_t fail_time;
+} route_suspect_t;
+
+static pthread_mutex_t suspect_lock = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *suspect_hash = NULL;
+
+static const char *_suspect_id(void *item)
+{
+	route_suspect_t *suspect = (route_suspect_t *) item;
+
+	return suspect->name;
+}
+
+static void _suspect_free(void *item)
+{
+	route_suspect_t *suspect = (route_suspect_t *) item;
+
+	xfree(suspect->name);
+	xfree(suspect);
+}
+
+/* Return true if a node recently failed to respond.
+ * Call with suspect_lock held. */
+static bool _node_suspect(const char *name, time_t now)
+{
+	route_suspect_t *suspect = xhash_get(suspect_hash, name);
+
+	if (!suspect)
+		return false;
+	if (difftime(now, suspect->fail_time) < ROUTE_SUSPECT_TIME)
+		return true;
+	if ((suspect = xhash_pop(suspect_hash, name)))
+		_suspect_free(suspect);
+	return false;
+}
+
+/* The first node of a branch relays the message to the others. If it recently
+ * failed to respond, make the first responsive node of the branch the relay
+ * instead so a dead relay does not delay the whole branch.
+ * Call with suspect_lock held. */
+static void _pick_relay(hostlist_t *hl_ptr, time_t now)
+{
+	hostlist_t hl = *hl_ptr, new_hl;
+	hostlist_iterator_t itr;
+	char *name, *relay = NULL;
+
+	name = hostlist_nth(hl, 0);
+	if (!name || !_node_suspect(name, now)) {
+		free(name);
+		return;
+	}
+	free(name);
+
+	itr = hostlist_iterator_create(hl);
+	while ((name = hostlist_next(itr))) {
+		if (!_node_suspect(name, now)) {
+			relay = name;
+			break;
+		}
+		free(name);
+	}
+	hostlist_iterator_destroy(itr);
+	if (!relay)
+		return;		/* No better choice */
+
+	new_hl = hostlist_create(relay);
+	while ((name = hostlist_shift(hl))) {
+		if (xstrcmp(name, relay))
+			hostlist_push_host(new_hl, name);
+		free(name);
+	}
+	if (debug_flags & DEBUG_FLAG_ROUTE)
+		info("ROUTE: relaying through %s, avoiding unresponsive "
+		     "nodes", relay);
+	free(relay);
+	hostlist_destroy(hl);
+	*hl_ptr = new_hl;
+}
+
+/* Avoid unresponsive nodes as relays of the branches of a split hostlist */
+static void _pick_relays(hostlist_t *sp_hl, int count)
+{
+	time_t now;
+	int i;
+
+	slurm_mutex_lock(&suspect_lock);
+	if (suspect_hash && xhash_count(suspect_hash)) {
+		now = time(NULL);
+		for (i = 0; i < count; i++)
+			_pick_relay(&sp_hl[i], now);
+	}
+	slurm_mutex_unlock(&suspect_lock);
+}
+
 
 /* _get_all_nodes creates a hostlist containing all the nodes in the
  * node_record_table.
@@ -363,6 +465,8 @@ extern int route_g_split_hostlist(hostlist_t hl,
 
 	rc = (*(ops.split_hostlist))(hl, sp_hl, count,
 				     tree_width ? tree_width : g_tree_width);
+	if (rc == SLURM_SUCCESS)
+		_pick_relays(*sp_hl, *count);
 	if (debug_flags & DEBUG_FLAG_ROUTE) {
 		/* Sanity check to make sure all nodes in msg list are in
 		 * a child list */
@@ -379,6 +483,73 @@ extern int route_g_split_hostlist(hostlist_t hl,
 	return rc;
 }
 
+/*
+ * route_node_failed - record that a node failed to respond to a message,
+ *	route_g_split_hostlist() avoids it as a relay for a while
+ *
+ * IN: name - name of the node
+ */
+extern void route_node_failed(const char *name)
+{
+	route_suspect_t *suspect;
+
+	if (!name)
+		return;
+	slurm_mutex_lock(&suspect_lock);
+	if (!suspect_hash)
+		suspect_hash = xhash_init(_suspect_id, _suspect_free, NULL, 0);
+	if (!(suspect = xhash_get(suspect_hash, name))) {
+		suspect = xmalloc(sizeof(route_suspect_t));
+		suspect->name = xstrdup(name);
+		xhash_add(suspect_hash, suspect);
+	}
+	suspect->fail_time = time(NULL);
+	slurm_mutex_unlock(&suspect_lock);
+}
+
+/*
+ * route_node_responded - record that a node responded to a message,
+ *	making it a candidate relay again
+ *
+ * IN: name - name of the node
+ */
+extern void route_node_responded(const char *name)
+{
+	route_suspect_t *suspect = NULL;
+
+	if (!name)
+		return;
+	slurm_mutex_lock(&suspect_lock);
+	if (suspect_hash && xhash_count(suspect_hash))
+		suspect = xhash_pop(suspect_hash, name);
+	slurm_mutex_unlock(&suspect_lock);
+	if (suspect)
+		_suspect_free(suspect);
+}
+
+/*
+ * route_note_responses - record which nodes responded to a message and which
+ *	failed to, see route_node_failed() and route_node_responded()
+ *
+ * IN: ret_list - List of ret_data_info_t from a forwarded message
+ */
+extern void route_note_responses(List ret_list)
+{
+	ListIterator itr;
+	ret_data_info_t *ret_data_info;
+
+	if (!ret_list)
+		return;
+	itr = list_iterator_create(ret_list);
+	while ((ret_data_info = list_next(itr))) {
+		if (ret_data_info->type == RESPONSE_FORWARD_FAILED)
+			route_node_failed(ret_data_info->node_name);
+		else
+			route_node_responded(ret_data_info->node_name);
+	}
+	list_iterator_destroy(itr);
+}
+
 /*
  * route_g_reconfigure - reset during reconfigure
  *
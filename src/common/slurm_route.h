@@ -106,6 +106,30 @@ extern slurm_addr_t* route_g_next_collector ( bool *is_collector );
  */
 extern slurm_addr_t* route_g_next_collector_backup ( void );
 
+/*
+ * route_node_failed - record that a node failed to respond to a message.
+ *	route_g_split_hostlist() does not pick it to relay messages to other
+ *	nodes of its branch for a few minutes, unless it responds again.
+ *
+ * IN: name - name of the node
+ */
+extern void route_node_failed(const char *name);
+
+/*
+ * route_node_responded - record that a node responded to a message
+ *
+ * IN: name - name of the node
+ */
+extern void route_node_responded(const char *name);
+
+/*
+ * route_note_responses - call route_node_failed() or route_node_responded()
+ *	for each node of the responses to a forwarded message
+ *
+ * IN: ret_list - List of ret_data_info_t
+ */
+extern void route_note_responses(List ret_list);
+
 
 /*****************************************************************************\
  *  Plugin Common Functions
@@ -44,6 +44,7 @@
 
 #include <dirent.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <regex.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -74,6 +75,20 @@ strong_alias(stepd_connect, slurm_stepd_connect);
 strong_alias(stepd_get_uid, slurm_stepd_get_uid);
 strong_alias(stepd_add_extern_pid, slurm_stepd_add_extern_pid);
 
+/*
+ * Registry of the running slurmstepds of the slurmd in this process, so
+ * stepd_available() need not scan the spool directory. Entries are added
+ * as slurmd starts each slurmstepd and removed once the slurmstepd is found
+ * gone, either by the slurmd or by a failed connect to its socket.
+ */
+static List            stepd_reg      = NULL;	/* step_loc_t records */
+static char           *stepd_reg_dir  = NULL;
+static char           *stepd_reg_node = NULL;
+static pthread_mutex_t stepd_reg_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void _free_step_loc_t(step_loc_t *loc);
+static List _scan_available(const char *directory, const char *nodename);
+
 static bool
 _slurm_authorized_user()
 {
@@ -144,6 +159,35 @@ static void _handle_stray_script(const char *directory, uint32_t job_id)
 	(void) rmdir(dir_path);
 }
 
+typedef struct {
+	uint32_t jobid;
+	uint32_t stepid;
+	bool all_steps;
+} step_key_t;
+
+static int _find_step_loc(void *x, void *key)
+{
+	step_loc_t *loc = (step_loc_t *) x;
+	step_key_t *match = (step_key_t *) key;
+
+	if (loc->jobid != match->jobid)
+		return 0;
+	return (match->all_steps || (loc->stepid == match->stepid));
+}
+
+/* Remove a step, or all steps of a job, from the registry. Call with
+ * stepd_reg_mutex locked. */
+static void _registry_remove(uint32_t jobid, uint32_t stepid, bool all_steps)
+{
+	step_key_t key;
+
+	key.jobid  = jobid;
+	key.stepid = stepid;
+	key.all_steps = all_steps;
+	if (stepd_reg && list_delete_all(stepd_reg, _find_step_loc, &key))
+		debug4("%s: removed job %u step %u", __func__, jobid, stepid);
+}
+
 static int
 _step_connect(const char *directory, const char *nodename,
 	      uint32_t jobid, uint32_t stepid)
@@ -171,6 +215,17 @@ _step_connect(const char *directory, const char *nodename,
 		/* Can indicate race condition at step termination */
 		debug("%s: connect() failed dir %s node %s step %u.%u %m",
 		      __func__, directory, nodename, jobid, stepid);
+		if ((errno == ECONNREFUSED) || (errno == ENOENT)) {
+			int save_errno = errno;
+
+			/* The slurmstepd is gone */
+			slurm_mutex_lock(&stepd_reg_mutex);
+			if (!xstrcmp(directory, stepd_reg_dir) &&
+			    !xstrcmp(nodename, stepd_reg_node))
+				_registry_remove(jobid, stepid, false);
+			slurm_mutex_unlock(&stepd_reg_mutex);
+			errno = save_errno;
+		}
 		if (errno == ECONNREFUSED) {
 			_handle_stray_socket(name);
 			if (stepid == SLURM_BATCH_SCRIPT)
@@ -581,6 +636,90 @@ _sockname_regex(regex_t *re, const char *filename,
  */
 extern List
 stepd_available(const char *directory, const char *nodename)
+{
+	List l = NULL;
+	ListIterator itr;
+	step_loc_t *loc, *copy;
+
+	slurm_mutex_lock(&stepd_reg_mutex);
+	if (stepd_reg && !xstrcmp(directory, stepd_reg_dir) &&
+	    !xstrcmp(nodename, stepd_reg_node)) {
+		l = list_create((ListDelF) _free_step_loc_t);
+		itr = list_iterator_create(stepd_reg);
+		while ((loc = list_next(itr))) {
+			copy = xmalloc(sizeof(step_loc_t));
+			copy->directory = xstrdup(stepd_reg_dir);
+			copy->nodename = xstrdup(stepd_reg_node);
+			copy->jobid = loc->jobid;
+			copy->stepid = loc->stepid;
+			list_append(l, copy);
+		}
+		list_iterator_destroy(itr);
+	}
+	slurm_mutex_unlock(&stepd_reg_mutex);
+	if (l)
+		return l;
+
+	return _scan_available(directory, nodename);
+}
+
+/*
+ * Start keeping the registry of running slurmstepds for "directory" and
+ * "nodename", filled from a scan of "directory" to find those left running
+ * by an earlier slurmd
+ */
+extern void stepd_registry_init(const char *directory, const char *nodename)
+{
+	List l = _scan_available(directory, nodename);
+
+	slurm_mutex_lock(&stepd_reg_mutex);
+	FREE_NULL_LIST(stepd_reg);
+	xfree(stepd_reg_dir);
+	xfree(stepd_reg_node);
+	stepd_reg = l;
+	stepd_reg_dir = xstrdup(directory);
+	stepd_reg_node = xstrdup(nodename);
+	debug("%s: found %d running steps in %s", __func__,
+	      list_count(stepd_reg), directory);
+	slurm_mutex_unlock(&stepd_reg_mutex);
+}
+
+extern void stepd_registry_fini(void)
+{
+	slurm_mutex_lock(&stepd_reg_mutex);
+	FREE_NULL_LIST(stepd_reg);
+	xfree(stepd_reg_dir);
+	xfree(stepd_reg_node);
+	slurm_mutex_unlock(&stepd_reg_mutex);
+}
+
+extern void stepd_registry_add(uint32_t jobid, uint32_t stepid)
+{
+	step_loc_t *loc;
+	step_key_t key;
+
+	key.jobid  = jobid;
+	key.stepid = stepid;
+	key.all_steps = false;
+	slurm_mutex_lock(&stepd_reg_mutex);
+	if (stepd_reg && !list_find_first(stepd_reg, _find_step_loc, &key)) {
+		loc = xmalloc(sizeof(step_loc_t));
+		loc->jobid = jobid;
+		loc->stepid = stepid;
+		list_append(stepd_reg, loc);
+	}
+	slurm_mutex_unlock(&stepd_reg_mutex);
+}
+
+extern void stepd_registry_remove_job(uint32_t jobid)
+{
+	slurm_mutex_lock(&stepd_reg_mutex);
+	_registry_remove(jobid, 0, true);
+	slurm_mutex_unlock(&stepd_reg_mutex);
+}
+
+static List
+_scan_available(const char *directory, const char *nodename)
 {
 	List l;
 	DIR *dp;
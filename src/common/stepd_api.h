@@ -202,6 +202,23 @@ int stepd_attach(int fd, uint16_t protocol_version,
  */
 extern List stepd_available(const char *directory, const char *nodename);
 
+/*
+ * Keep a registry of the running step daemons of "directory" and
+ * "nodename", so stepd_available() can answer for them without scanning
+ * the directory. Used by slurmd, which scans the directory once here to
+ * recover the steps started before it was restarted, then adds each step
+ * it starts. Steps are removed with stepd_registry_remove_job() or when a
+ * connect to their socket finds them gone.
+ */
+extern void stepd_registry_init(const char *directory, const char *nodename);
+extern void stepd_registry_fini(void);
+
+/* Add a step daemon started by slurmd to the registry */
+extern void stepd_registry_add(uint32_t jobid, uint32_t stepid);
+
+/* Remove all steps of a job from the registry */
+extern void stepd_registry_remove_job(uint32_t jobid);
+
 /*
  * Return true if the process with process ID "pid" is found in
  * the proctrack container of the slurmstepd "step".
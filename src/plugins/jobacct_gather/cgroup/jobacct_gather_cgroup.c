@@ -99,48 +99,55 @@ const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 /* Other useful declarations */
 static slurm_cgroup_conf_t slurm_cgroup_conf;
 
-static void _prec_extra(jag_prec_t *prec)
+/* Read the aggregate cpu and memory usage of all processes of a task
+ * from its cgroups. RET SLURM_SUCCESS if the cpu usage could be read. */
+static int _get_task_stats(uint32_t taskid, jag_prec_t *prec)
 {
 	unsigned long utime, stime, total_rss, total_pgpgin;
 	char *cpu_time = NULL, *memory_stat = NULL, *ptr;
 	size_t cpu_time_size = 0, memory_stat_size = 0;
-
-	//DEF_TIMERS;
-	//START_TIMER;
-	/* info("before"); */
-	/* print_jag_prec(prec); */
-	xcgroup_get_param(&task_cpuacct_cg, "cpuacct.stat",
-			  &cpu_time, &cpu_time_size);
+	xcgroup_t task_cg;
+	int rc = SLURM_ERROR;
+
+	if (jobacct_gather_cgroup_cpuacct_task_cg(taskid, &task_cg) ==
+	    SLURM_SUCCESS) {
+		xcgroup_get_param(&task_cg, "cpuacct.stat",
+				  &cpu_time, &cpu_time_size);
+		xcgroup_destroy(&task_cg);
+	}
 	if (cpu_time == NULL) {
-		debug2("%s: failed to collect cpuacct.stat pid %d ppid %d",
-		       __func__, prec->pid, prec->ppid);
-	} else {
-		sscanf(cpu_time, "%*s %lu %*s %lu", &utime, &stime);
+		debug2("%s: failed to collect cpuacct.stat task %u pid %d",
+		       __func__, taskid, prec->pid);
+	} else if (sscanf(cpu_time, "%*s %lu %*s %lu", &utime, &stime) == 2) {
 		prec->usec = utime;
 		prec->ssec = stime;
+		rc = SLURM_SUCCESS;
 	}
 
-	xcgroup_get_param(&task_memory_cg, "memory.stat",
-			  &memory_stat, &memory_stat_size);
+	if (jobacct_gather_cgroup_memory_task_cg(taskid, &task_cg) ==
+	    SLURM_SUCCESS) {
+		xcgroup_get_param(&task_cg, "memory.stat",
+				  &memory_stat, &memory_stat_size);
+		xcgroup_destroy(&task_cg);
+	}
 	if (memory_stat == NULL) {
-		debug2("%s: failed to collect memory.stat  pid %d ppid %d",
-		       __func__, prec->pid, prec->ppid);
+		debug2("%s: failed to collect memory.stat task %u pid %d",
+		       __func__, taskid, prec->pid);
 	} else {
 		/* This number represents the amount of "dirty" private memory
 		   used by the cgroup.  From our experience this is slightly
 		   different than what proc presents, but is probably more
 		   accurate on what the user is actually using.
 		*/
-		ptr = strstr(memory_stat, "total_rss");
-		sscanf(ptr, "total_rss %lu", &total_rss);
-		prec->rss = total_rss / 1024; /* convert from bytes to KB */
+		if ((ptr = strstr(memory_stat, "total_rss")) &&
+		    (sscanf(ptr, "total_rss %lu", &total_rss) == 1))
+			prec->rss = total_rss / 1024; /* convert bytes to KB */
 
 		/* total_pgmajfault is what is reported in proc, so we use
 		 * the same thing here. */
-		if ((ptr = strstr(memory_stat, "total_pgmajfault"))) {
-			sscanf(ptr, "total_pgmajfault %lu", &total_pgpgin);
+		if ((ptr = strstr(memory_stat, "total_pgmajfault")) &&
+		    (sscanf(ptr, "total_pgmajfault %lu", &total_pgpgin) == 1))
 			prec->pages = total_pgpgin;
-		}
 	}
 
 	xfree(cpu_time);
@@ -175,12 +182,85 @@ static void _prec_extra(jag_prec_t *prec)
 	/* prec->disk_read = (double)tot_read / (double)1048576; */
 	/* prec->disk_write = (double)tot_write / (double)1048576; */
 
-	/* info("after %d %d", total_rss); */
-	/* print_jag_prec(prec); */
-	//END_TIMER;
-	//info("took %s", TIME_STR);
-	return;
+	return rc;
+}
+
+/* Add the virtual memory size and local disk I/O of every process of a
+ * task, which the cgroups do not account, from /proc */
+static void _get_task_proc_detail(uint32_t taskid, jag_prec_t *prec)
+{
+	static jag_callbacks_t proc_callbacks;
+	List proc_list;
+	ListIterator itr;
+	jag_prec_t *proc;
+	xcgroup_t task_cg;
+	pid_t *pids = NULL;
+	int npids = 0;
+
+	if (jobacct_gather_cgroup_cpuacct_task_cg(taskid, &task_cg) !=
+	    SLURM_SUCCESS)
+		return;
+	xcgroup_get_pids(&task_cg, &pids, &npids);
+	xcgroup_destroy(&task_cg);
+	if (!npids)
+		return;
+
+	proc_list = list_create(destroy_jag_prec);
+	jag_common_get_pid_precs(proc_list, pids, npids, &proc_callbacks);
+	xfree(pids);
+
+	itr = list_iterator_create(proc_list);
+	while ((proc = list_next(itr))) {
+		prec->vsize += proc->vsize;
+		prec->disk_read += proc->disk_read;
+		prec->disk_write += proc->disk_write;
+		if (proc->pid == prec->pid)
+			prec->last_cpu = proc->last_cpu;
+	}
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(proc_list);
+}
+
+/* Build one record per task from its cgroups rather than one per process
+ * from /proc, so a poll costs a few reads per task no matter how many
+ * processes the node or the step runs. */
+static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
+		       jag_callbacks_t *callbacks)
+{
+	static int proc_detail = -1;
+	List prec_list = list_create(destroy_jag_prec);
+	ListIterator itr;
+	struct jobacctinfo *jobacct;
+	jag_prec_t *prec;
+
+	if (proc_detail == -1) {
+		char *acct_params = slurm_get_jobacct_gather_params();
+		if (acct_params && strstr(acct_params, "ProcDetail"))
+			proc_detail = 1;
+		else
+			proc_detail = 0;
+		xfree(acct_params);
+	}
+
+	if (!task_list)
+		return prec_list;
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		prec = xmalloc(sizeof(jag_prec_t));
+		prec->pid = jobacct->pid;
+		if (_get_task_stats(jobacct->id.taskid, prec) !=
+		    SLURM_SUCCESS) {
+			xfree(prec);
+			continue;
+		}
+		if (proc_detail)
+			_get_task_proc_detail(jobacct->id.taskid, prec);
+		list_append(prec_list, prec);
+	}
+	list_iterator_destroy(itr);
 
+	return prec_list;
 }
 
 static bool _run_in_daemon(void)
@@ -265,7 +345,7 @@ extern int fini (void)
 }
 
 /*
- * jobacct_gather_p_poll_data() - Build a table of all current processes
+ * jobacct_gather_p_poll_data() - Build a table of all current tasks
  *
  * IN/OUT: task_list - list containing current processes.
  * IN: pgid_plugin - if we are running with the pgid plugin.
@@ -276,10 +356,9 @@ extern int fini (void)
  * THREADSAFE! Only one thread ever gets here.  It is locked in
  * slurm_jobacct_gather.
  *
- * Assumption:
- *    Any file with a name of the form "/proc/[0-9]+/stat"
- *    is a Linux-style stat entry. We disregard the data if they look
- *    wrong.
+ * Usage is read from the cpuacct and memory cgroups of each task. /proc
+ * is only read, for the processes of the step's tasks, with
+ * JobAcctGatherParams=ProcDetail.
  */
 extern void jobacct_gather_p_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id, bool profile)
@@ -290,7 +369,7 @@ extern void jobacct_gather_p_poll_data(
 	if (first) {
 		memset(&callbacks, 0, sizeof(jag_callbacks_t));
 		first = 0;
-		callbacks.prec_extra = _prec_extra;
+		callbacks.get_precs = _get_precs;
 	}
 
 	jag_common_poll_data(task_list, pgid_plugin, cont_id, &callbacks,
@@ -55,6 +55,11 @@ extern int jobacct_gather_cgroup_cpuacct_fini(
 extern int jobacct_gather_cgroup_cpuacct_attach_task(
 	pid_t pid, jobacct_id_t *jobacct_id);
 
+/* Fill in cg with the cpuacct cgroup of the given task of this step,
+ * release it with xcgroup_destroy() */
+extern int jobacct_gather_cgroup_cpuacct_task_cg(
+	uint32_t taskid, xcgroup_t *cg);
+
 extern int jobacct_gather_cgroup_memory_init(
 	slurm_cgroup_conf_t *slurm_cgroup_conf);
 
@@ -64,6 +69,11 @@ extern int jobacct_gather_cgroup_memory_fini(
 extern int jobacct_gather_cgroup_memory_attach_task(
 	pid_t pid, jobacct_id_t *jobacct_id);
 
+/* Fill in cg with the memory cgroup of the given task of this step,
+ * release it with xcgroup_destroy() */
+extern int jobacct_gather_cgroup_memory_task_cg(
+	uint32_t taskid, xcgroup_t *cg);
+
 /* FIXME: Enable when kernel support ready. */
  /* extern xcgroup_t task_blkio_cg; */
 /* extern int jobacct_gather_cgroup_blkio_init( */
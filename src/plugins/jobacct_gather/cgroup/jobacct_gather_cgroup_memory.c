@@ -401,3 +401,24 @@ error:
 	xcgroup_destroy(&memory_cg);
 	return fstatus;
 }
+
+extern int
+jobacct_gather_cgroup_memory_task_cg(uint32_t taskid, xcgroup_t *cg)
+{
+	char buf[PATH_MAX];
+
+	if (jobstep_cgroup_path[0] == '\0')
+		return SLURM_ERROR;
+
+	if (snprintf(buf, PATH_MAX, "%s/task_%u",
+		     jobstep_cgroup_path, taskid) >= PATH_MAX) {
+		debug2("%s: unable to build task %u memory cg relative path",
+		       __func__, taskid);
+		return SLURM_ERROR;
+	}
+
+	if (xcgroup_create(&memory_ns, cg, buf, 0, 0) != XCGROUP_SUCCESS)
+		return SLURM_ERROR;
+
+	return SLURM_SUCCESS;
+}
@@ -515,6 +515,23 @@ static void _handle_stats(List prec_list, char *proc_stat_file, char *proc_io_fi
 		(*(callbacks->prec_extra))(prec);
 }
 
+extern void jag_common_get_pid_precs(List prec_list, pid_t *pids, int npids,
+				     jag_callbacks_t *callbacks)
+{
+	char	proc_stat_file[256];	/* Allow ~20x extra length */
+	char	proc_io_file[256];	/* Allow ~20x extra length */
+	char	proc_smaps_file[256];	/* Allow ~20x extra length */
+	int i;
+
+	for (i = 0; i < npids; i++) {
+		snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
+		snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
+		snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
+		_handle_stats(prec_list, proc_stat_file, proc_io_file,
+			      proc_smaps_file, callbacks);
+	}
+}
+
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
@@ -544,13 +561,7 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			debug4("no pids in this container %"PRIu64"", cont_id);
 			goto finished;
 		}
-		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks);
-		}
+		jag_common_get_pid_precs(prec_list, pids, npids, callbacks);
 		xfree(pids);
 	} else {
 		struct dirent *slash_proc_entry;
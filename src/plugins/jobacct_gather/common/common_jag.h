@@ -70,6 +70,10 @@ extern void jag_common_fini(void);
 extern void destroy_jag_prec(void *object);
 extern void print_jag_prec(jag_prec_t *prec);
 
+/* Append a record read from /proc for each of the given processes */
+extern void jag_common_get_pid_precs(List prec_list, pid_t *pids, int npids,
+				     jag_callbacks_t *callbacks);
+
 extern void jag_common_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id,
 	jag_callbacks_t *callbacks, bool profile);
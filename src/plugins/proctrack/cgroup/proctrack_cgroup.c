@@ -42,12 +42,15 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "slurm/slurm.h"
 #include "slurm/slurm_errno.h"
 #include "src/common/log.h"
 #include "src/common/xcgroup_read_config.h"
 #include "src/common/xstring.h"
+#include "src/slurmd/common/proc_events.h"
 #include "src/slurmd/common/xcpuinfo.h"
 #include "src/slurmd/common/xcgroup.h"
 #include "src/slurmd/slurmd/slurmd.h"
@@ -86,6 +89,10 @@ const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 #define PATH_MAX 256
 #endif
 
+/* Time for proctrack_p_wait() to give up on a container, the sum of its
+ * 1 to 128 second retry delays */
+#define WAIT_MAX_SEC 255
+
 static slurm_cgroup_conf_t slurm_cgroup_conf;
 
 static char user_cgroup_path[PATH_MAX];
@@ -565,26 +572,49 @@ extern bool proctrack_p_has_pid(uint64_t cont_id, pid_t pid)
 
 extern int proctrack_p_wait(uint64_t cont_id)
 {
-	int delay = 1;
+	int delay = 1, events_fd, wait_time;
+	pid_t *pids = NULL;
+	int npids = 0;
+	time_t start = time(NULL);
+	bool exited;
 
 	if (cont_id == 0 || cont_id == 1) {
 		errno = EINVAL;
 		return SLURM_ERROR;
 	}
 
+	/* Subscribe before looking at the container so that no exit
+	 * can be missed between the check and the wait */
+	events_fd = proc_events_open();
+
 	/* Spin until the container is successfully destroyed */
 	/* This indicates that all tasks have exited the container */
 	while (proctrack_p_destroy(cont_id) != SLURM_SUCCESS) {
 		proctrack_p_signal(cont_id, SIGKILL);
-		sleep(delay);
-		if (delay < 120) {
-			delay *= 2;
-		} else {
+		wait_time = WAIT_MAX_SEC - (int) difftime(time(NULL), start);
+		if (wait_time <= 0) {
 			error("%s: Unable to destroy container %"PRIu64" in cgroup plugin, giving up after %d sec",
-			      __func__, cont_id, delay);
+			      __func__, cont_id, WAIT_MAX_SEC);
 			break;
 		}
+		if (wait_time > delay)
+			wait_time = delay;
+		/* Retry as soon as one of the remaining processes exits */
+		_slurm_cgroup_get_pids(cont_id, &pids, &npids);
+		if (npids) {
+			exited = proc_events_wait_exit(events_fd, pids, npids,
+						       wait_time);
+		} else {
+			/* Nothing to wait on, the cgroup is just slow
+			 * to empty */
+			sleep(wait_time);
+			exited = false;
+		}
+		xfree(pids);
+		if (!exited)
+			delay *= 2;
 	}
+	proc_events_close(events_fd);
 
 	return SLURM_SUCCESS;
 }
@@ -47,13 +47,21 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "slurm/slurm.h"
 #include "slurm/slurm_errno.h"
 #include "src/common/log.h"
+#include "src/slurmd/common/proc_events.h"
 #include "src/slurmd/slurmstepd/slurmstepd_job.h"
 
+/* Time for proctrack_p_wait() to give up on a process group, the sum of its
+ * 1 to 128 second retry delays */
+#define WAIT_MAX_SEC 255
+
+extern int proctrack_p_get_pids(uint64_t cont_id, pid_t **pids, int *npids);
+
 /*
  * These variables are required by the generic plugin interface.  If they
  * are not found in the plugin, the plugin loader will ignore it.
@@ -155,26 +163,48 @@ extern int
 proctrack_p_wait(uint64_t cont_id)
 {
 	pid_t pgid = (pid_t)cont_id;
-	int delay = 1;
+	pid_t *pids = NULL;
+	int delay = 1, events_fd, npids = 0, wait_time;
+	time_t start = time(NULL);
+	bool exited;
 
 	if (cont_id == 0 || cont_id == 1) {
 		slurm_seterrno(EINVAL);
 		return SLURM_ERROR;
 	}
 
-	/* Spin until the process group is gone. */
+	/* Subscribe before looking at the process group so that no exit
+	 * can be missed between the check and the wait */
+	events_fd = proc_events_open();
+
+	/* Spin until the process group is gone, retrying as soon as one of
+	 * its remaining processes exits. Give up after WAIT_MAX_SEC however
+	 * often that happens. */
 	while (killpg(pgid, 0) == 0) {
 		proctrack_p_signal(cont_id, SIGKILL);
-		sleep(delay);
-		if (delay < 120) {
-			delay *= 2;
-		} else {
+		wait_time = WAIT_MAX_SEC - (int) difftime(time(NULL), start);
+		if (wait_time <= 0) {
 			error("%s: Unable to destroy container %"PRIu64" "
 			      "in pgid plugin, giving up after %d sec",
-			      __func__, cont_id, delay);
+			      __func__, cont_id, WAIT_MAX_SEC);
 			break;
 		}
+		if (wait_time > delay)
+			wait_time = delay;
+		proctrack_p_get_pids(cont_id, &pids, &npids);
+		if (npids) {
+			exited = proc_events_wait_exit(events_fd, pids, npids,
+						       wait_time);
+		} else {
+			/* Only zombies left, nothing to wait on */
+			sleep(wait_time);
+			exited = false;
+		}
+		xfree(pids);
+		if (!exited)
+			delay *= 2;
 	}
+	proc_events_close(events_fd);
 
 	return SLURM_SUCCESS;
 }
@@ -68,9 +68,11 @@
 #include "slurm/slurm_errno.h"
 
 #include "src/common/assoc_mgr.h"
+#include "src/common/id_hash.h"
 #include "src/common/list.h"
 #include "src/common/macros.h"
 #include "src/common/node_select.h"
+#include "src/common/node_space.h"
 #include "src/common/parse_time.h"
 #include "src/common/power.h"
 #include "src/common/read_config.h"
@@ -102,17 +104,73 @@
 #define SLURMCTLD_THREAD_LIMIT	5
 #define SCHED_TIMEOUT		2000000	/* time in micro-seconds */
 #define YIELD_SLEEP		500000;	/* time in micro-seconds */
+#define BF_SPEC_PER_THREAD	4	/* look-ahead job tests per thread */
 
-typedef struct node_space_map {
-	time_t begin_time;
-	time_t end_time;
+/*
+ * Result of a job test run ahead of the job's turn in the backfill queue,
+ * in parallel with the test of the job currently being considered. The
+ * result is used only if the job is reached with identical test inputs and
+ * no job has been started nor locks released since (spec_gen unchanged).
+ */
+typedef struct bf_spec {
+	struct job_record *job_ptr;	/* NULL if entry is unused */
+	uint32_t job_id;
+	uint32_t gen;			/* spec_gen when prepared */
+	bool lookahead;			/* not the job which triggered it */
+	bool tested;
+	/* Test inputs */
+	struct part_record *part_ptr;
+	uint32_t priority;
+	uint32_t time_limit;
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	uint32_t req_nodes;
+	uint32_t job_no_reserve;
+	bitstr_t *test_bitmap;
+	bitstr_t *exc_core_bitmap;
+	/* Test results */
+	int rc;
+	bitstr_t *avail_bitmap;
+	time_t start_time;
+	uint32_t total_cpus;
+	bool best_switch;
+} bf_spec_t;
+
+/*
+ * Result of a job test kept from one backfill cycle to the next with
+ * bf_incremental. The result is used only if the job is tested with identical
+ * inputs, the job's own requirements have not changed (see _plan_job_sig())
+ * and no node set in test_bitmap has changed (see _plan_scan()) since the
+ * test was run. Changes to other jobs or nodes do not discard it.
+ */
+typedef struct bf_plan {
+	uint64_t key;			/* job ID and test number in cycle */
+	uint64_t gen;			/* plan_gen when tested */
+	time_t test_time;
+	uint32_t cycle;			/* plan_cycle when last used */
+	uint64_t job_sig;		/* _plan_job_sig() when tested */
+	/* Test inputs */
+	struct part_record *part_ptr;
+	uint32_t priority;
+	uint32_t time_limit;
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	uint32_t req_nodes;
+	uint32_t job_no_reserve;
+	bitstr_t *test_bitmap;
+	bitstr_t *exc_core_bitmap;
+	/* Test results */
+	int rc;
 	bitstr_t *avail_bitmap;
-	int next;	/* next record, by time, zero termination */
-} node_space_map_t;
+	time_t start_time;
+	uint32_t total_cpus;
+	bool best_switch;
+} bf_plan_t;
 
 /* Diag statistics */
 extern diag_stats_t slurmctld_diag_stats;
 uint32_t bf_sleep_usec = 0;
+static uint64_t bf_lock_usec = 0;	/* lock hold time at cycle start */
 
 /*********************** local variables *********************/
 static bool stop_backfill = false;
@@ -137,32 +195,102 @@ static bool backfill_continue = false;
 static int defer_rpc_cnt = 0;
 static int sched_timeout = SCHED_TIMEOUT;
 static int yield_sleep   = YIELD_SLEEP;
+static int bf_threads = 1;
+
+static pthread_mutex_t spec_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bf_spec_t *spec_tab = NULL;	/* look-ahead tests */
+static int spec_size = 0;		/* size of spec_tab */
+static bf_spec_t **spec_todo = NULL;	/* entries to test in this batch */
+static int spec_todo_cnt = 0;
+static int spec_todo_next = 0;		/* next spec_todo entry to test */
+static uint32_t spec_gen = 0;		/* changed when results are stale */
+
+static bool bf_incremental = false;
+static bool plan_preempt = false;	/* job priority affects test result */
+static List plan_list = NULL;		/* bf_plan_t records */
+static id_hash_t *plan_hash = NULL;	/* plan_list records by key */
+static uint64_t plan_gen = 0;		/* changed when any node changes */
+static uint64_t *plan_node_gen = NULL;	/* plan_gen when each node changed */
+static uint64_t *plan_node_sig = NULL;	/* signature of each node's state */
+static int plan_node_cnt = 0;		/* size of plan_node_gen/sig */
+static uint32_t plan_cycle = 0;
+static time_t plan_conf_update = 0;
+static time_t plan_part_update = 0;
+static time_t plan_resv_update = 0;
+static struct job_record *plan_test_job = NULL;	/* last job tested */
+static uint32_t plan_test_inx = 0;	/* tests of plan_test_job in cycle */
 
 /*********************** local functions *********************/
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs);
 static int  _attempt_backfill(void);
 static void _clear_job_start_times(void);
 static int  _delta_tv(struct timeval *tv);
 static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2);
+static bool _job_node_limits(struct job_record *job_ptr,
+			     struct part_record *part_ptr, uint32_t *min_nodes,
+			     uint32_t *max_nodes, uint32_t *req_nodes);
+static uint32_t _job_no_reserve(struct job_record *job_ptr);
 static bool _job_part_valid(struct job_record *job_ptr,
 			    struct part_record *part_ptr);
+static uint32_t _job_time_limit(struct job_record *job_ptr,
+				struct part_record *part_ptr);
 static void _load_config(void);
 static bool _many_pending_rpcs(void);
 static bool _more_work(time_t last_backfill_time);
 static uint32_t _my_sleep(int usec);
+static time_t _node_space_filter(node_space_t *node_space,
+				 time_t start_res, uint32_t end_time,
+				 bitstr_t *avail_bitmap);
 static int  _num_feature_count(struct job_record *job_ptr, bool *has_xor);
+static void _plan_clear(void);
+static bf_plan_t *_plan_find(struct job_record *job_ptr, uint32_t test_inx,
+			     bitstr_t *avail_bitmap, uint32_t min_nodes,
+			     uint32_t max_nodes, uint32_t req_nodes,
+			     bitstr_t *exc_core_bitmap, uint32_t job_no_reserve,
+			     time_t now);
+static void _plan_fini(void);
+static void _plan_nodes_changed(bitstr_t *node_bitmap);
+static void _plan_purge(void);
+static void _plan_scan(time_t now);
+static void _plan_store(struct job_record *job_ptr, uint32_t test_inx,
+			bitstr_t *test_bitmap, uint32_t min_nodes,
+			uint32_t max_nodes, uint32_t req_nodes,
+			bitstr_t *exc_core_bitmap, uint32_t job_no_reserve,
+			int rc, bitstr_t *avail_bitmap);
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
-				  node_space_map_t *node_space);
+				  node_space_t *node_space);
+static void *_spec_agent(void *arg);
+static void _spec_clear(bool all);
+static bf_spec_t *_spec_find(struct job_record *job_ptr,
+			     bitstr_t *avail_bitmap, uint32_t min_nodes,
+			     uint32_t max_nodes, uint32_t req_nodes,
+			     bitstr_t *exc_core_bitmap,
+			     uint32_t job_no_reserve);
+static void _spec_free(bf_spec_t *spec);
+static bool _spec_prepare(bf_spec_t *spec, job_queue_rec_t *rec,
+			  node_space_t *node_space, bool filter_root);
+static void _spec_run(struct job_record *job_ptr, bitstr_t *avail_bitmap,
+		      uint32_t min_nodes, uint32_t max_nodes,
+		      uint32_t req_nodes, bitstr_t *exc_core_bitmap,
+		      uint32_t job_no_reserve, List job_queue,
+		      node_space_t *node_space, bool filter_root);
+static void _spec_test(bf_spec_t *spec);
+static void _spec_work(int thread_inx);
 static int  _start_job(struct job_record *job_ptr, bitstr_t *avail_bitmap);
-static bool _test_resv_overlap(node_space_map_t *node_space,
+static int  _test_job(struct job_record *job_ptr, bitstr_t **avail_bitmap,
+		      uint32_t min_nodes, uint32_t max_nodes,
+		      uint32_t req_nodes, bitstr_t *exc_core_bitmap,
+		      uint32_t job_no_reserve, List job_queue,
+		      node_space_t *node_space, bool filter_root);
+static bool _test_resv_overlap(node_space_t *node_space,
 			       bitstr_t *use_bitmap, uint32_t start_time,
 			       uint32_t end_reserve);
 static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 		       uint32_t min_nodes, uint32_t max_nodes,
 		       uint32_t req_nodes, bitstr_t *exc_core_bitmap);
+static int  _try_sched_job(struct job_record *job_ptr,
+			   bitstr_t **avail_bitmap, uint32_t min_nodes,
+			   uint32_t max_nodes, uint32_t req_nodes,
+			   bitstr_t *exc_core_bitmap, uint32_t job_no_reserve);
 static int  _yield_locks(int usec);
 
 /* Log resources to be allocated to a pending job */
@@ -194,23 +322,21 @@ static void _dump_job_test(struct job_record *job_ptr, bitstr_t *avail_bitmap,
 }
 
 /* Log resource allocate table */
-static void _dump_node_space_table(node_space_map_t *node_space_ptr)
+static void _dump_node_space_table(node_space_t *node_space)
 {
-	int i = 0;
+	node_space_rec_t *rec;
 	char begin_buf[32], end_buf[32], *node_list;
 
 	info("=========================================");
-	while (1) {
-		slurm_make_time_str(&node_space_ptr[i].begin_time,
+	for (rec = node_space_first(node_space); rec; rec = rec->next) {
+		slurm_make_time_str(&rec->begin_time,
 				    begin_buf, sizeof(begin_buf));
-		slurm_make_time_str(&node_space_ptr[i].end_time,
+		slurm_make_time_str(&rec->end_time,
 				    end_buf, sizeof(end_buf));
-		node_list = bitmap2node_name(node_space_ptr[i].avail_bitmap);
+		node_list = bitmap2node_name(rec->avail_bitmap);
 		info("Begin:%s End:%s Nodes:%s",
 		     begin_buf, end_buf, node_list);
 		xfree(node_list);
-		if ((i = node_space_ptr[i].next) == 0)
-			break;
 	}
 	info("=========================================");
 }
@@ -443,6 +569,58 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 	return rc;
 }
 
+/* Test when and where a job can start, first on nodes with currently active
+ * features then on all usable nodes. Only modifies job_ptr's own data, so
+ * several jobs may be tested at once while the caller holds the locks.
+ * IN job_ptr - job to schedule
+ * IN/OUT avail_bitmap - nodes available/selected to use
+ * IN exc_core_bitmap - cores which can not be used
+ * IN job_no_reserve - 0 or TEST_NOW_ONLY
+ * RET SLURM_SUCCESS on success, otherwise an error code
+ */
+static int  _try_sched_job(struct job_record *job_ptr,
+			   bitstr_t **avail_bitmap, uint32_t min_nodes,
+			   uint32_t max_nodes, uint32_t req_nodes,
+			   bitstr_t *exc_core_bitmap, uint32_t job_no_reserve)
+{
+	bitstr_t *active_bitmap = NULL;
+	uint8_t save_share_res = 0, save_whole_node = 0;
+	int rc = SLURM_SUCCESS, test_fini = -1;
+
+	build_active_feature_bitmap(job_ptr, *avail_bitmap, &active_bitmap);
+	job_ptr->bit_flags |= BACKFILL_TEST;
+	job_ptr->bit_flags |= job_no_reserve;	/* 0 or TEST_NOW_ONLY */
+	if (active_bitmap) {
+		rc = _try_sched(job_ptr, &active_bitmap, min_nodes,
+				max_nodes, req_nodes, exc_core_bitmap);
+		if (rc != SLURM_SUCCESS) {
+			FREE_NULL_BITMAP(*avail_bitmap);
+			*avail_bitmap = active_bitmap;
+			active_bitmap = NULL;
+			test_fini = 1;
+		} else {
+			FREE_NULL_BITMAP(active_bitmap);
+			save_share_res  = job_ptr->details->share_res;
+			save_whole_node = job_ptr->details->whole_node;
+			job_ptr->details->share_res = 0;
+			job_ptr->details->whole_node = 1;
+			test_fini = 0;
+		}
+	}
+	if (test_fini != 1) {
+		rc = _try_sched(job_ptr, avail_bitmap, min_nodes,
+				max_nodes, req_nodes, exc_core_bitmap);
+		if (test_fini == 0) {
+			job_ptr->details->share_res = save_share_res;
+			job_ptr->details->whole_node = save_whole_node;
+		}
+	}
+	job_ptr->bit_flags &= ~BACKFILL_TEST;
+	job_ptr->bit_flags &= ~TEST_NOW_ONLY;
+
+	return rc;
+}
+
 /* Terminate backfill_agent */
 extern void stop_backfill_agent(void)
 {
@@ -674,6 +852,31 @@ static void _load_config(void)
 		yield_sleep = YIELD_SLEEP;
 	}
 
+	bf_threads = 1;
+	if (sched_params && (tmp_ptr = strstr(sched_params, "bf_threads="))) {
+		char *select_type = slurm_get_select_type();
+		int threads = atoi(tmp_ptr + 11);
+		if ((threads < 1) || (threads > BF_MAX_THREADS)) {
+			error("Invalid SchedulerParameters bf_threads: %d",
+			      threads);
+		} else if ((threads > 1) &&
+			   xstrcmp(select_type, "select/cons_res")) {
+			error("SchedulerParameters bf_threads requires "
+			      "select/cons_res, using one thread");
+		} else {
+			bf_threads = threads;
+		}
+		xfree(select_type);
+	}
+
+	if (sched_params && strstr(sched_params, "bf_incremental"))
+		bf_incremental = true;
+	else
+		bf_incremental = false;
+	tmp_ptr = slurm_get_preempt_type();
+	plan_preempt = (tmp_ptr && xstrcmp(tmp_ptr, "preempt/none"));
+	xfree(tmp_ptr);
+
 	if (sched_params && (tmp_ptr = strstr(sched_params, "max_rpc_cnt=")))
 		defer_rpc_cnt = atoi(tmp_ptr + 12);
 	else if (sched_params &&
@@ -705,15 +908,19 @@ extern void backfill_reconfig(void)
 static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2)
 {
 	uint32_t delta_t, real_time;
+	uint64_t lock_usec;
 
 	delta_t  = (tv2->tv_sec - tv1->tv_sec) * 1000000;
 	delta_t +=  tv2->tv_usec;
 	delta_t -=  tv1->tv_usec;
 	real_time = delta_t - bf_sleep_usec;
+	lock_usec = lock_thread_hold_usec() - bf_lock_usec;
 
 	slurmctld_diag_stats.bf_cycle_counter++;
 	slurmctld_diag_stats.bf_cycle_sum += real_time;
 	slurmctld_diag_stats.bf_cycle_last = real_time;
+	slurmctld_diag_stats.bf_lock_last = lock_usec;
+	slurmctld_diag_stats.bf_lock_sum += lock_usec;
 
 	slurmctld_diag_stats.bf_depth_sum += slurmctld_diag_stats.bf_last_depth;
 	slurmctld_diag_stats.bf_depth_try_sum +=
@@ -779,6 +986,7 @@ extern void *backfill_agent(void *args)
 		unlock_slurmctld(all_locks);
 		short_sleep = false;
 	}
+	_plan_fini();
 	return NULL;
 }
 
@@ -823,6 +1031,9 @@ static int _yield_locks(int usec)
 			slurmctld_config.server_thread_count);
 	}
 	lock_slurmctld(all_locks);
+	spec_gen++;	/* Look-ahead test results are now stale */
+	if (bf_incremental)
+		_plan_scan(time(NULL));
 	slurm_mutex_lock(&config_lock);
 	if (config_flag)
 		load_config = true;
@@ -890,20 +1101,20 @@ static int _attempt_backfill(void)
 	List job_queue;
 	job_queue_rec_t *job_queue_rec;
 	slurmdb_qos_rec_t *qos_ptr = NULL;
-	int bb, i, j, node_space_recs, mcs_select = 0;
+	int bb, i, j, mcs_select = 0;
 	struct job_record *job_ptr;
 	struct part_record *part_ptr, **bf_part_ptr = NULL;
 	uint32_t end_time, end_reserve, deadline_time_limit;
-	uint32_t time_limit, comp_time_limit, orig_time_limit, part_time_limit;
+	uint32_t time_limit, comp_time_limit, orig_time_limit;
 	uint32_t min_nodes, max_nodes, req_nodes;
-	bitstr_t *active_bitmap = NULL, *avail_bitmap = NULL;
+	bitstr_t *avail_bitmap = NULL;
 	bitstr_t *exc_core_bitmap = NULL, *resv_bitmap = NULL;
 	time_t now, sched_start, later_start, start_res, resv_end, window_end;
 	time_t orig_sched_start, orig_start_time = (time_t) 0;
-	node_space_map_t *node_space;
+	node_space_t *node_space;
 	struct timeval bf_time1, bf_time2;
 	int rc = 0;
-	int job_test_count = 0, test_time_count = 0, pend_time;
+	int job_test_count = 0, test_time_count = 0;
 	uint32_t *uid = NULL, nuser = 0, bf_parts = 0;
 	uint32_t *bf_part_jobs = NULL, *bf_part_resv = NULL;
 	uint16_t *njobs = NULL;
@@ -918,10 +1129,9 @@ static int _attempt_backfill(void)
 	uint32_t test_array_count = 0;
 	uint32_t acct_max_nodes, wait_reason = 0, job_no_reserve;
 	bool resv_overlap = false;
-	uint8_t save_share_res, save_whole_node;
-	int test_fini;
 
 	bf_sleep_usec = 0;
+	bf_lock_usec = lock_thread_hold_usec();
 #ifdef HAVE_ALPS_CRAY
 	/*
 	 * Run a Basil Inventory immediately before setting up the schedule
@@ -980,15 +1190,30 @@ static int _attempt_backfill(void)
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_when_last_cycle = now;
 	slurmctld_diag_stats.bf_active = 1;
+	slurmctld_diag_stats.bf_thread_cnt = bf_threads;
+	memset(slurmctld_diag_stats.bf_thread_tests, 0,
+	       sizeof(slurmctld_diag_stats.bf_thread_tests));
+	memset(slurmctld_diag_stats.bf_thread_usec, 0,
+	       sizeof(slurmctld_diag_stats.bf_thread_usec));
+	slurmctld_diag_stats.bf_spec_used = 0;
+	slurmctld_diag_stats.bf_spec_discard = 0;
+	slurmctld_diag_stats.bf_plan_used = 0;
+	if (bf_incremental) {
+		plan_cycle++;
+		plan_test_job = NULL;
+		_plan_scan(now);
+	} else if (plan_list) {
+		_plan_fini();
+	}
+	if (bf_threads > 1) {
+		spec_size = bf_threads * BF_SPEC_PER_THREAD;
+		spec_tab  = xmalloc(sizeof(bf_spec_t) * spec_size);
+		spec_todo = xmalloc(sizeof(bf_spec_t *) * spec_size);
+	}
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt * 2 + 1));
-	node_space[0].begin_time = sched_start;
 	window_end = sched_start + backfill_window;
-	node_space[0].end_time = window_end;
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
-	node_space[0].next = 0;
-	node_space_recs = 1;
+	node_space = node_space_init(sched_start, window_end,
+				     avail_node_bitmap);
 	if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 		_dump_node_space_table(node_space);
 
@@ -1144,17 +1369,7 @@ static int _attempt_backfill(void)
 		    !acct_policy_job_runnable_pre_select(job_ptr))
 			continue;
 
-		job_no_reserve = 0;
-		if (bf_min_prio_reserve &&
-		    (job_ptr->priority < bf_min_prio_reserve)) {
-			job_no_reserve = TEST_NOW_ONLY;
-		} else if (bf_min_age_reserve && job_ptr->details->begin_time) {
-			pend_time = difftime(time(NULL),
-					     job_ptr->details->begin_time);
-			if (pend_time < bf_min_age_reserve)
-				job_no_reserve = TEST_NOW_ONLY;
-		}
-
+		job_no_reserve = _job_no_reserve(job_ptr);
 		if ((job_no_reserve == 0) && bf_job_part_count_reserve) {
 			for (j = 0; j < bf_parts; j++) {
 				if (bf_part_ptr[j] != job_ptr->part_ptr)
@@ -1287,19 +1502,8 @@ next_task:
 		}
 
 		/* Determine minimum and maximum node counts */
-		min_nodes = MAX(job_ptr->details->min_nodes,
-				part_ptr->min_nodes);
-		if (job_ptr->details->max_nodes == 0)
-			max_nodes = part_ptr->max_nodes;
-		else
-			max_nodes = MIN(job_ptr->details->max_nodes,
-					part_ptr->max_nodes);
-		max_nodes = MIN(max_nodes, 500000);     /* prevent overflows */
-		if (job_ptr->details->max_nodes)
-			req_nodes = max_nodes;
-		else
-			req_nodes = min_nodes;
-		if (min_nodes > max_nodes) {
+		if (!_job_node_limits(job_ptr, part_ptr, &min_nodes,
+				      &max_nodes, &req_nodes)) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
 				info("backfill: job %u node count too high",
 				     job_ptr->job_id);
@@ -1326,21 +1530,10 @@ next_task:
 		}
 
 		/* Determine job's expected completion time */
-		if (part_ptr->max_time == INFINITE)
-			part_time_limit = YEAR_MINUTES;
-		else
-			part_time_limit = part_ptr->max_time;
+		time_limit = _job_time_limit(job_ptr, part_ptr);
 		if ((job_ptr->time_limit == NO_VAL) ||
-		    (job_ptr->time_limit == INFINITE)) {
-			time_limit = part_time_limit;
+		    (job_ptr->time_limit == INFINITE))
 			job_ptr->limit_set.time = 1;
-		} else {
-			if (part_ptr->max_time == INFINITE)
-				time_limit = job_ptr->time_limit;
-			else
-				time_limit = MIN(job_ptr->time_limit,
-						 part_time_limit);
-		}
 		if (deadline_time_limit)
 			comp_time_limit = MIN(time_limit, deadline_time_limit);
 		else
@@ -1440,20 +1633,8 @@ next_task:
 		bit_and(avail_bitmap, up_node_bitmap);
 		filter_by_node_owner(job_ptr, avail_bitmap);
 		filter_by_node_mcs(job_ptr, mcs_select, avail_bitmap);
-		for (j=0; ; ) {
-			if ((node_space[j].end_time > start_res) &&
-			     node_space[j].next && (later_start == 0))
-				later_start = node_space[j].end_time;
-			if (node_space[j].end_time <= start_res)
-				;
-			else if (node_space[j].begin_time <= end_time) {
-				bit_and(avail_bitmap,
-					node_space[j].avail_bitmap);
-			} else
-				break;
-			if ((j = node_space[j].next) == 0)
-				break;
-		}
+		later_start = _node_space_filter(node_space, start_res,
+						 end_time, avail_bitmap);
 		if (resv_end && (++resv_end < window_end) &&
 		    ((later_start == 0) || (resv_end < later_start))) {
 			later_start = resv_end;
@@ -1507,38 +1688,9 @@ next_task:
 		}
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_job_test(job_ptr, avail_bitmap, start_res);
-		test_fini = -1;
-		build_active_feature_bitmap(job_ptr, avail_bitmap,
-					    &active_bitmap);
-		job_ptr->bit_flags |= BACKFILL_TEST;
-		job_ptr->bit_flags |= job_no_reserve;	/* 0 or TEST_NOW_ONLY */
-		if (active_bitmap) {
-			j = _try_sched(job_ptr, &active_bitmap, min_nodes,
-				       max_nodes, req_nodes, exc_core_bitmap);
-			if (j != SLURM_SUCCESS) {
-				FREE_NULL_BITMAP(avail_bitmap);
-				avail_bitmap = active_bitmap;
-				active_bitmap = NULL;
-				test_fini = 1;
-			} else {
-				FREE_NULL_BITMAP(active_bitmap);
-				save_share_res  = job_ptr->details->share_res;
-				save_whole_node = job_ptr->details->whole_node;
-				job_ptr->details->share_res = 0;
-				job_ptr->details->whole_node = 1;
-				test_fini = 0;
-			}
-		}
-		if (test_fini != 1) {
-			j = _try_sched(job_ptr, &avail_bitmap, min_nodes,
-				       max_nodes, req_nodes, exc_core_bitmap);
-			if (test_fini == 0) {
-				job_ptr->details->share_res = save_share_res;
-				job_ptr->details->whole_node = save_whole_node;
-			}
-		}
-		job_ptr->bit_flags &= ~BACKFILL_TEST;
-		job_ptr->bit_flags &= ~TEST_NOW_ONLY;
+		j = _test_job(job_ptr, &avail_bitmap, min_nodes, max_nodes,
+			      req_nodes, exc_core_bitmap, job_no_reserve,
+			      job_queue, node_space, filter_root);
 
 		now = time(NULL);
 		if (j != SLURM_SUCCESS) {
@@ -1591,6 +1743,9 @@ next_task:
 			uint32_t hard_limit;
 			bool reset_time = false;
 			int rc = _start_job(job_ptr, resv_bitmap);
+			spec_gen++;	/* Select plugin state changed */
+			if (bf_incremental && (rc == SLURM_SUCCESS))
+				_plan_nodes_changed(job_ptr->node_bitmap);
 			if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE)) {
 				if (orig_time_limit == NO_VAL) {
 					acct_policy_alter_job(
@@ -1724,7 +1879,7 @@ next_task:
 			continue;
 		}
 
-		if (node_space_recs >= max_backfill_job_cnt) {
+		if (node_space_count(node_space) >= max_backfill_job_cnt) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				info("backfill: table size limit of %u reached",
 				     max_backfill_job_cnt);
@@ -1783,8 +1938,8 @@ next_task:
 		xfree(job_ptr->sched_nodes);
 		job_ptr->sched_nodes = bitmap2node_name(avail_bitmap);
 		bit_not(avail_bitmap);
-		_add_reservation(start_time, end_reserve,
-				 avail_bitmap, node_space, &node_space_recs);
+		node_space_reserve(node_space, start_time, end_reserve,
+				   avail_bitmap);
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_node_space_table(node_space);
 		if ((orig_start_time != 0) &&
@@ -1814,13 +1969,19 @@ next_task:
 	FREE_NULL_BITMAP(exc_core_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
 
-	for (i=0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
-	}
-	xfree(node_space);
+	node_space_free(node_space);
+	if (bf_incremental) {
+		_plan_purge();
+		slurmctld_diag_stats.bf_plan_cnt = list_count(plan_list);
+	} else
+		slurmctld_diag_stats.bf_plan_cnt = 0;
 	FREE_NULL_LIST(job_queue);
+	if (spec_tab) {
+		_spec_clear(true);
+		xfree(spec_tab);
+		xfree(spec_todo);
+		spec_size = 0;
+	}
 	gettimeofday(&bf_time2, NULL);
 	_do_diag_stats(&bf_time1, &bf_time2);
 	if (debug_flags & DEBUG_FLAG_BACKFILL) {
@@ -1920,25 +2081,24 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
  *	Avoid using resources reserved for pending jobs or in resource
  *	reservations */
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
-				  node_space_map_t *node_space)
+				  node_space_t *node_space)
 {
-	int32_t j, resv_delay;
+	node_space_rec_t *rec;
+	int32_t resv_delay;
 	uint32_t orig_time_limit = job_ptr->time_limit;
 	uint32_t new_time_limit;
 
-	for (j=0; ; ) {
-		if ((node_space[j].begin_time != now) &&
-		    (node_space[j].begin_time < job_ptr->end_time) &&
+	for (rec = node_space_first(node_space);
+	     rec && (rec->begin_time < job_ptr->end_time); rec = rec->next) {
+		if ((rec->begin_time != now) &&
 		    (!bit_super_set(job_ptr->node_bitmap,
-				    node_space[j].avail_bitmap))) {
+				    rec->avail_bitmap))) {
 			/* Job overlaps pending job's resource reservation */
-			resv_delay = difftime(node_space[j].begin_time, now);
+			resv_delay = difftime(rec->begin_time, now);
 			resv_delay /= 60;	/* seconds to minutes */
 			if (resv_delay < job_ptr->time_limit)
 				job_ptr->time_limit = resv_delay;
 		}
-		if ((j = node_space[j].next) == 0)
-			break;
 	}
 	new_time_limit = MAX(job_ptr->time_min, job_ptr->time_limit);
 	acct_policy_alter_job(job_ptr, new_time_limit);
@@ -1968,122 +2128,772 @@ static bool _more_work (time_t last_backfill_time)
 	return rc;
 }
 
-/* Create a reservation for a job in the future */
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs)
+/*
+ * Determine if the resource specification for a new job overlaps with a
+ *	reservation that the backfill scheduler has made for a job to be
+ *	started in the future.
+ * IN use_bitmap - nodes to be allocated
+ * IN start_time - start time of job
+ * IN end_reserve - end time of job
+ */
+static bool _test_resv_overlap(node_space_t *node_space,
+			       bitstr_t *use_bitmap, uint32_t start_time,
+			       uint32_t end_reserve)
 {
-	bool placed = false;
-	int i, j;
-
-#if 0	
-	info("add job start:%u end:%u", start_time, end_reserve);
-	for (j = 0; ; ) {
-		info("node start:%u end:%u",
-		     (uint32_t) node_space[j].begin_time,
-		     (uint32_t) node_space[j].end_time);
-		if ((j = node_space[j].next) == 0)
-			break;
+	node_space_rec_t *rec;
+
+	for (rec = node_space_find(node_space, start_time);
+	     rec && (rec->begin_time < end_reserve); rec = rec->next) {
+		if ((rec->end_time > start_time) &&
+		    (!bit_super_set(use_bitmap, rec->avail_bitmap)))
+			return true;
 	}
-#endif
+	return false;
+}
 
-	start_time = MAX(start_time, node_space[0].begin_time);
-	for (j = 0; ; ) {
-		if (node_space[j].end_time > start_time) {
-			/* insert start entry record */
-			i = *node_space_recs;
-			node_space[i].begin_time = start_time;
-			node_space[i].end_time = node_space[j].end_time;
-			node_space[j].end_time = start_time;
-			node_space[i].avail_bitmap =
-				bit_copy(node_space[j].avail_bitmap);
-			node_space[i].next = node_space[j].next;
-			node_space[j].next = i;
-			(*node_space_recs)++;
-			placed = true;
-		}
-		if (node_space[j].end_time == start_time) {
-			/* no need to insert new start entry record */
-			placed = true;
-		}
-		if (placed == true) {
-			while ((j = node_space[j].next)) {
-				if (end_reserve < node_space[j].end_time) {
-					/* insert end entry record */
-					i = *node_space_recs;
-					node_space[i].begin_time = end_reserve;
-					node_space[i].end_time = node_space[j].
-								 end_time;
-					node_space[j].end_time = end_reserve;
-					node_space[i].avail_bitmap =
-						bit_copy(node_space[j].
-							 avail_bitmap);
-					node_space[i].next = node_space[j].next;
-					node_space[j].next = i;
-					(*node_space_recs)++;
-					break;
-				}
-				if (end_reserve == node_space[j].end_time) {
-					break;
-				}
-			}
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
+/* Determine a job's node count limits in a partition.
+ * RET false if the job can not run in the partition */
+static bool _job_node_limits(struct job_record *job_ptr,
+			     struct part_record *part_ptr, uint32_t *min_nodes,
+			     uint32_t *max_nodes, uint32_t *req_nodes)
+{
+	*min_nodes = MAX(job_ptr->details->min_nodes, part_ptr->min_nodes);
+	if (job_ptr->details->max_nodes == 0)
+		*max_nodes = part_ptr->max_nodes;
+	else
+		*max_nodes = MIN(job_ptr->details->max_nodes,
+				 part_ptr->max_nodes);
+	*max_nodes = MIN(*max_nodes, 500000);	/* prevent overflows */
+	if (job_ptr->details->max_nodes)
+		*req_nodes = *max_nodes;
+	else
+		*req_nodes = *min_nodes;
+
+	return (*min_nodes <= *max_nodes);
+}
+
+/* RET TEST_NOW_ONLY if resources should not be reserved for a job based upon
+ * bf_min_prio_reserve and bf_min_age_reserve, otherwise zero */
+static uint32_t _job_no_reserve(struct job_record *job_ptr)
+{
+	int pend_time;
+
+	if (bf_min_prio_reserve && (job_ptr->priority < bf_min_prio_reserve))
+		return TEST_NOW_ONLY;
+	if (bf_min_age_reserve && job_ptr->details->begin_time) {
+		pend_time = difftime(time(NULL), job_ptr->details->begin_time);
+		if (pend_time < bf_min_age_reserve)
+			return TEST_NOW_ONLY;
+	}
+	return 0;
+}
+
+/* RET a job's time limit in a partition, in minutes */
+static uint32_t _job_time_limit(struct job_record *job_ptr,
+				struct part_record *part_ptr)
+{
+	uint32_t part_time_limit;
+
+	if (part_ptr->max_time == INFINITE)
+		part_time_limit = YEAR_MINUTES;
+	else
+		part_time_limit = part_ptr->max_time;
+	if ((job_ptr->time_limit == NO_VAL) ||
+	    (job_ptr->time_limit == INFINITE))
+		return part_time_limit;
+	if (part_ptr->max_time == INFINITE)
+		return job_ptr->time_limit;
+	return MIN(job_ptr->time_limit, part_time_limit);
+}
+
+/* Clear nodes from avail_bitmap which are reserved for pending jobs between
+ * start_res and end_time.
+ * RET end of the first node_space record after start_res, zero if none */
+static time_t _node_space_filter(node_space_t *node_space,
+				 time_t start_res, uint32_t end_time,
+				 bitstr_t *avail_bitmap)
+{
+	node_space_rec_t *rec;
+	time_t later_start = 0;
+
+	for (rec = node_space_find(node_space, start_res); rec;
+	     rec = rec->next) {
+		if ((rec->end_time > start_res) && rec->next &&
+		    (later_start == 0))
+			later_start = rec->end_time;
+		if (rec->end_time <= start_res)
+			;
+		else if (rec->begin_time <= end_time) {
+			bit_and(avail_bitmap, rec->avail_bitmap);
+		} else
 			break;
 	}
+	return later_start;
+}
 
-	for (j = 0; ; ) {
-		if ((node_space[j].begin_time >= start_time) &&
-		    (node_space[j].end_time <= end_reserve))
-			bit_and(node_space[j].avail_bitmap, res_bitmap);
-		if ((node_space[j].begin_time >= end_reserve) ||
-		    ((j = node_space[j].next) == 0))
+static void _spec_free(bf_spec_t *spec)
+{
+	if (spec->job_ptr && spec->lookahead)
+		slurmctld_diag_stats.bf_spec_discard++;
+	spec->job_ptr = NULL;
+	FREE_NULL_BITMAP(spec->test_bitmap);
+	FREE_NULL_BITMAP(spec->exc_core_bitmap);
+	FREE_NULL_BITMAP(spec->avail_bitmap);
+}
+
+/* Release look-ahead test results
+ * IN all - release all results, otherwise only those which are stale */
+static void _spec_clear(bool all)
+{
+	int i;
+
+	for (i = 0; i < spec_size; i++) {
+		if (all || (spec_tab[i].gen != spec_gen))
+			_spec_free(&spec_tab[i]);
+	}
+}
+
+/* Find a current look-ahead test result for a job with these test inputs.
+ * A result for the same job with different inputs is released. */
+static bf_spec_t *_spec_find(struct job_record *job_ptr,
+			     bitstr_t *avail_bitmap, uint32_t min_nodes,
+			     uint32_t max_nodes, uint32_t req_nodes,
+			     bitstr_t *exc_core_bitmap, uint32_t job_no_reserve)
+{
+	bf_spec_t *spec;
+	int i;
+
+	for (i = 0, spec = spec_tab; i < spec_size; i++, spec++) {
+		if ((spec->job_ptr == job_ptr) && (spec->gen == spec_gen))
 			break;
 	}
+	if (i >= spec_size)
+		return NULL;
+
+	if ((spec->job_id    == job_ptr->job_id)   &&
+	    (spec->part_ptr  == job_ptr->part_ptr) &&
+	    (spec->priority  == job_ptr->priority) &&
+	    (spec->time_limit == job_ptr->time_limit) &&
+	    (spec->min_nodes == min_nodes) &&
+	    (spec->max_nodes == max_nodes) &&
+	    (spec->req_nodes == req_nodes) &&
+	    (spec->job_no_reserve == job_no_reserve) &&
+	    bit_equal(spec->test_bitmap, avail_bitmap) &&
+	    (exc_core_bitmap ?
+	     (spec->exc_core_bitmap &&
+	      bit_equal(spec->exc_core_bitmap, exc_core_bitmap)) :
+	     !spec->exc_core_bitmap))
+		return spec;
+
+	_spec_free(spec);
+	return NULL;
+}
+
+/* Record the test inputs of a look-ahead job. Only jobs in a single
+ * partition and without reservation, deadline, dependency, time_min or
+ * NoReserve QOS are tested ahead of their turn since the main loop may
+ * change their state before testing them or testing them has side effects.
+ * RET true if the job should be tested */
+static bool _spec_prepare(bf_spec_t *spec, job_queue_rec_t *rec,
+			  node_space_t *node_space, bool filter_root)
+{
+	struct job_record *job_ptr = rec->job_ptr;
+	struct part_record *part_ptr = rec->part_ptr;
+	slurmdb_qos_rec_t *qos_ptr;
+	bitstr_t *avail_bitmap = NULL, *exc_core_bitmap = NULL;
+	uint32_t min_nodes, max_nodes, req_nodes, end_time;
+	time_t now = time(NULL), start_res = now;
+	bool resv_overlap = false;
+
+	if ((job_ptr->magic  != JOB_MAGIC) ||
+	    (job_ptr->job_id != rec->job_id) ||
+	    (job_ptr->array_task_id != rec->array_task_id) ||
+	    job_ptr->array_recs)
+		return false;
+	if (!_job_runnable_now(job_ptr) || job_ptr->preempt_in_progress)
+		return false;
+	if (job_ptr->part_ptr_list || (job_ptr->part_ptr != part_ptr) ||
+	    (job_ptr->priority != rec->priority))
+		return false;
+	if (job_ptr->resv_name || job_ptr->time_min ||
+	    (job_ptr->deadline && (job_ptr->deadline != NO_VAL)))
+		return false;
+	if (job_ptr->details->depend_list &&
+	    list_count(job_ptr->details->depend_list))
+		return false;
+	qos_ptr = job_ptr->qos_ptr;
+	if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE))
+		return false;
+	if (((part_ptr->state_up & PARTITION_SCHED) == 0) ||
+	    (part_ptr->node_bitmap == NULL) ||
+	    ((part_ptr->flags & PART_FLAG_ROOT_ONLY) && filter_root))
+		return false;
+	if (!_job_node_limits(job_ptr, part_ptr, &min_nodes, &max_nodes,
+			      &req_nodes))
+		return false;
+
+	/* Build the node bitmap as the main loop will for its first test */
+	if (job_test_resv(job_ptr, &start_res, true, &avail_bitmap,
+			  &exc_core_bitmap, &resv_overlap) != SLURM_SUCCESS) {
+		FREE_NULL_BITMAP(avail_bitmap);
+		FREE_NULL_BITMAP(exc_core_bitmap);
+		return false;
+	}
+	end_time = (_job_time_limit(job_ptr, part_ptr) * 60) +
+		   MAX(start_res, now);
+	if (end_time < now)	/* Overflow 32-bits */
+		end_time = INFINITE;
+	bit_and(avail_bitmap, part_ptr->node_bitmap);
+	bit_and(avail_bitmap, up_node_bitmap);
+	filter_by_node_owner(job_ptr, avail_bitmap);
+	filter_by_node_mcs(job_ptr, slurm_mcs_get_select(job_ptr),
+			   avail_bitmap);
+	(void) _node_space_filter(node_space, start_res, end_time,
+				  avail_bitmap);
+	if (job_ptr->details->exc_node_bitmap) {
+		bit_not(job_ptr->details->exc_node_bitmap);
+		bit_and(avail_bitmap, job_ptr->details->exc_node_bitmap);
+		bit_not(job_ptr->details->exc_node_bitmap);
+	}
+	if ((bit_set_count(avail_bitmap) < min_nodes) ||
+	    ((job_ptr->details->req_node_bitmap) &&
+	     (!bit_super_set(job_ptr->details->req_node_bitmap,
+			     avail_bitmap))) ||
+	    (job_req_node_filter(job_ptr, avail_bitmap, true))) {
+		FREE_NULL_BITMAP(avail_bitmap);
+		FREE_NULL_BITMAP(exc_core_bitmap);
+		return false;
+	}
+	/* Result of an earlier cycle to be used instead */
+	if (bf_incremental &&
+	    _plan_find(job_ptr, 0, avail_bitmap, min_nodes, max_nodes,
+		       req_nodes, exc_core_bitmap, _job_no_reserve(job_ptr),
+		       now)) {
+		FREE_NULL_BITMAP(avail_bitmap);
+		FREE_NULL_BITMAP(exc_core_bitmap);
+		return false;
+	}
+
+	spec->job_ptr    = job_ptr;
+	spec->job_id     = job_ptr->job_id;
+	spec->gen        = spec_gen;
+	spec->lookahead  = true;
+	spec->tested     = false;
+	spec->part_ptr   = part_ptr;
+	spec->priority   = job_ptr->priority;
+	spec->time_limit = job_ptr->time_limit;
+	spec->min_nodes  = min_nodes;
+	spec->max_nodes  = max_nodes;
+	spec->req_nodes  = req_nodes;
+	spec->job_no_reserve  = _job_no_reserve(job_ptr);
+	spec->test_bitmap     = avail_bitmap;
+	spec->exc_core_bitmap = exc_core_bitmap;
+	return true;
+}
+
+/* Run the test of one look-ahead entry, leaving the job as it was */
+static void _spec_test(bf_spec_t *spec)
+{
+	struct job_record *job_ptr = spec->job_ptr;
+	time_t save_start_time = job_ptr->start_time;
+	uint32_t save_total_cpus = job_ptr->total_cpus;
+	bool save_best_switch = job_ptr->best_switch;
+
+	spec->avail_bitmap = bit_copy(spec->test_bitmap);
+	spec->rc = _try_sched_job(job_ptr, &spec->avail_bitmap,
+				  spec->min_nodes, spec->max_nodes,
+				  spec->req_nodes, spec->exc_core_bitmap,
+				  spec->job_no_reserve);
+	spec->start_time  = job_ptr->start_time;
+	spec->total_cpus  = job_ptr->total_cpus;
+	spec->best_switch = job_ptr->best_switch;
+	spec->tested = true;
+
+	job_ptr->start_time  = save_start_time;
+	job_ptr->total_cpus  = save_total_cpus;
+	job_ptr->best_switch = save_best_switch;
+}
+
+/* Test look-ahead entries until none remain.
+ * IN thread_inx - index of the calling thread for statistics */
+static void _spec_work(int thread_inx)
+{
+	struct timeval tv1;
+	bf_spec_t *spec;
 
-	/* Drop records with identical bitmaps (up to one record).
-	 * This can significantly improve performance of the backfill tests. */
-	for (i = 0; ; ) {
-		if ((j = node_space[i].next) == 0)
+	while (1) {
+		slurm_mutex_lock(&spec_mutex);
+		if (spec_todo_next >= spec_todo_cnt) {
+			slurm_mutex_unlock(&spec_mutex);
 			break;
-		if (!bit_equal(node_space[i].avail_bitmap,
-			       node_space[j].avail_bitmap)) {
-			i = j;
+		}
+		spec = spec_todo[spec_todo_next++];
+		slurm_mutex_unlock(&spec_mutex);
+
+		gettimeofday(&tv1, NULL);
+		_spec_test(spec);
+		slurmctld_diag_stats.bf_thread_tests[thread_inx]++;
+		slurmctld_diag_stats.bf_thread_usec[thread_inx] +=
+			_delta_tv(&tv1);
+	}
+}
+
+static void *_spec_agent(void *arg)
+{
+	_spec_work((int) (intptr_t) arg);
+	return NULL;
+}
+
+/* Test a job together with jobs further down the queue, using bf_threads
+ * threads. The calling thread holds the slurmctld locks throughout, so all
+ * jobs see the same node, partition and running job state and node_space
+ * plan; the results are only used later after checking their inputs are
+ * unchanged. */
+static void _spec_run(struct job_record *job_ptr, bitstr_t *avail_bitmap,
+		      uint32_t min_nodes, uint32_t max_nodes,
+		      uint32_t req_nodes, bitstr_t *exc_core_bitmap,
+		      uint32_t job_no_reserve, List job_queue,
+		      node_space_t *node_space, bool filter_root)
+{
+	ListIterator job_iterator;
+	job_queue_rec_t *rec;
+	pthread_attr_t attr;
+	pthread_t thread_id[BF_MAX_THREADS];
+	bf_spec_t *spec;
+	int i, free_cnt = 0, scan_cnt = 0, thread_cnt;
+
+	_spec_clear(false);
+	for (i = 0; i < spec_size; i++) {
+		if (!spec_tab[i].job_ptr)
+			free_cnt++;
+	}
+	if (free_cnt == 0) {
+		_spec_clear(true);
+		free_cnt = spec_size;
+	}
+
+	/* The job whose turn it is comes first */
+	spec_todo_cnt = spec_todo_next = 0;
+	for (i = 0, spec = spec_tab; spec->job_ptr; i++, spec++)
+		;
+	spec->job_ptr    = job_ptr;
+	spec->job_id     = job_ptr->job_id;
+	spec->gen        = spec_gen;
+	spec->lookahead  = false;
+	spec->tested     = false;
+	spec->part_ptr   = job_ptr->part_ptr;
+	spec->priority   = job_ptr->priority;
+	spec->time_limit = job_ptr->time_limit;
+	spec->min_nodes  = min_nodes;
+	spec->max_nodes  = max_nodes;
+	spec->req_nodes  = req_nodes;
+	spec->job_no_reserve  = job_no_reserve;
+	spec->test_bitmap     = bit_copy(avail_bitmap);
+	if (exc_core_bitmap)
+		spec->exc_core_bitmap = bit_copy(exc_core_bitmap);
+	spec_todo[spec_todo_cnt++] = spec;
+	free_cnt--;
+
+	/* Fill the remaining slots from the head of the queue, skipping jobs
+	 * which already have a current result */
+	job_iterator = list_iterator_create(job_queue);
+	while ((free_cnt > 0) && (scan_cnt++ < (spec_size * 4)) &&
+	       (rec = (job_queue_rec_t *) list_next(job_iterator))) {
+		for (i = 0; i < spec_size; i++) {
+			if (spec_tab[i].job_ptr == rec->job_ptr)
+				break;
+		}
+		if (i < spec_size)
+			continue;
+		for (i = 0, spec = spec_tab; spec->job_ptr; i++, spec++)
+			;
+		if (!_spec_prepare(spec, rec, node_space, filter_root))
 			continue;
+		spec_todo[spec_todo_cnt++] = spec;
+		free_cnt--;
+	}
+	list_iterator_destroy(job_iterator);
+
+	thread_cnt = MIN(bf_threads, spec_todo_cnt);
+	for (i = 1; i < thread_cnt; i++) {
+		slurm_attr_init(&attr);
+		if (pthread_create(&thread_id[i], &attr, _spec_agent,
+				   (void *) (intptr_t) i)) {
+			error("backfill: pthread_create: %m");
+			thread_cnt = i;
+		}
+		slurm_attr_destroy(&attr);
+	}
+	_spec_work(0);
+	for (i = 1; i < thread_cnt; i++)
+		pthread_join(thread_id[i], NULL);
+}
+
+/* Test when and where a job can start, using a result from an earlier
+ * look-ahead test if its inputs are unchanged.
+ * IN/OUT avail_bitmap - nodes available/selected to use
+ * RET SLURM_SUCCESS on success, otherwise an error code */
+static int  _test_job(struct job_record *job_ptr, bitstr_t **avail_bitmap,
+		      uint32_t min_nodes, uint32_t max_nodes,
+		      uint32_t req_nodes, bitstr_t *exc_core_bitmap,
+		      uint32_t job_no_reserve, List job_queue,
+		      node_space_t *node_space, bool filter_root)
+{
+	struct timeval tv1;
+	bf_spec_t *spec = NULL;
+	bf_plan_t *plan;
+	bitstr_t *test_bitmap = NULL;
+	int rc;
+
+	if (bf_incremental) {
+		if (job_ptr == plan_test_job) {
+			plan_test_inx++;
+		} else {
+			plan_test_job = job_ptr;
+			plan_test_inx = 0;
+		}
+		plan = _plan_find(job_ptr, plan_test_inx, *avail_bitmap,
+				  min_nodes, max_nodes, req_nodes,
+				  exc_core_bitmap, job_no_reserve, time(NULL));
+		if (plan) {
+			slurmctld_diag_stats.bf_plan_used++;
+			plan->cycle = plan_cycle;
+			FREE_NULL_BITMAP(*avail_bitmap);
+			if (plan->avail_bitmap)
+				*avail_bitmap = bit_copy(plan->avail_bitmap);
+			job_ptr->start_time  = plan->start_time;
+			job_ptr->total_cpus  = plan->total_cpus;
+			job_ptr->best_switch = plan->best_switch;
+			return plan->rc;
+		}
+		test_bitmap = bit_copy(*avail_bitmap);
+	}
+
+	if (spec_tab) {
+		spec = _spec_find(job_ptr, *avail_bitmap, min_nodes,
+				  max_nodes, req_nodes, exc_core_bitmap,
+				  job_no_reserve);
+		if (!spec) {
+			_spec_run(job_ptr, *avail_bitmap, min_nodes,
+				  max_nodes, req_nodes, exc_core_bitmap,
+				  job_no_reserve, job_queue, node_space,
+				  filter_root);
+			spec = _spec_find(job_ptr, *avail_bitmap, min_nodes,
+					  max_nodes, req_nodes,
+					  exc_core_bitmap, job_no_reserve);
 		}
-		node_space[i].end_time = node_space[j].end_time;
-		node_space[i].next = node_space[j].next;
-		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
-		break;
 	}
+	if (spec && spec->tested) {
+		if (spec->lookahead)
+			slurmctld_diag_stats.bf_spec_used++;
+		FREE_NULL_BITMAP(*avail_bitmap);
+		*avail_bitmap = spec->avail_bitmap;
+		spec->avail_bitmap = NULL;
+		job_ptr->start_time  = spec->start_time;
+		job_ptr->total_cpus  = spec->total_cpus;
+		job_ptr->best_switch = spec->best_switch;
+		rc = spec->rc;
+		spec->lookahead = false;	/* Not discarded */
+		_spec_free(spec);
+	} else {
+		gettimeofday(&tv1, NULL);
+		rc = _try_sched_job(job_ptr, avail_bitmap, min_nodes,
+				    max_nodes, req_nodes, exc_core_bitmap,
+				    job_no_reserve);
+		slurmctld_diag_stats.bf_thread_tests[0]++;
+		slurmctld_diag_stats.bf_thread_usec[0] += _delta_tv(&tv1);
+	}
+
+	if (test_bitmap) {
+		_plan_store(job_ptr, plan_test_inx, test_bitmap, min_nodes,
+			    max_nodes, req_nodes, exc_core_bitmap,
+			    job_no_reserve, rc, *avail_bitmap);
+	}
+	return rc;
+}
+
+static uint64_t _plan_mix(uint64_t a, uint64_t b)
+{
+	uint64_t h = (a * 0x9E3779B97F4A7C15ULL) ^ b;
+
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return h;
+}
+
+static uint64_t _plan_str_hash(char *str)
+{
+	uint64_t h = 0xCBF29CE484222325ULL;	/* FNV-1a */
+
+	while (str && *str) {
+		h ^= (unsigned char) *str++;
+		h *= 0x100000001B3ULL;
+	}
+	return h;
 }
 
 /*
- * Determine if the resource specification for a new job overlaps with a
- *	reservation that the backfill scheduler has made for a job to be
- *	started in the future.
- * IN use_bitmap - nodes to be allocated
- * IN start_time - start time of job
- * IN end_reserve - end time of job
+ * Signature of the job requirements a test result depends on. Not all of
+ * them are changed through _update_job(), which sets job_ptr->last_update
+ * (e.g. the job_submit plugin, requeue or reservation changes).
  */
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve)
+static uint64_t _plan_job_sig(struct job_record *job_ptr)
 {
-	bool overlap = false;
-	int j;
-
-	for (j=0; ; ) {
-		if ((node_space[j].end_time   > start_time) &&
-		    (node_space[j].begin_time < end_reserve) &&
-		    (!bit_super_set(use_bitmap, node_space[j].avail_bitmap))) {
-			overlap = true;
-			break;
+	struct job_details *detail_ptr = job_ptr->details;
+	uint64_t sig;
+
+	sig = _plan_mix((uint64_t) job_ptr->job_state,
+			_plan_str_hash(job_ptr->gres));
+	sig = _plan_mix(sig, _plan_str_hash(job_ptr->licenses));
+	sig = _plan_mix(sig, (uint64_t) (uintptr_t) job_ptr->resv_ptr);
+	sig = _plan_mix(sig, (uint64_t) (uintptr_t) job_ptr->qos_ptr);
+	sig = _plan_mix(sig, ((uint64_t) job_ptr->req_switch << 32) |
+			     job_ptr->wait4switch);
+	if (!detail_ptr)
+		return sig;
+	sig = _plan_mix(sig, ((uint64_t) detail_ptr->min_cpus << 32) |
+			     detail_ptr->max_cpus);
+	sig = _plan_mix(sig, ((uint64_t) detail_ptr->pn_min_cpus << 32) |
+			     detail_ptr->pn_min_tmp_disk);
+	sig = _plan_mix(sig, detail_ptr->pn_min_memory);
+	sig = _plan_mix(sig, ((uint64_t) detail_ptr->num_tasks << 32) |
+			     ((uint64_t) detail_ptr->cpus_per_task << 16) |
+			     detail_ptr->ntasks_per_node);
+	sig = _plan_mix(sig, ((uint64_t) detail_ptr->contiguous << 32) |
+			     ((uint64_t) detail_ptr->core_spec << 16) |
+			     ((uint64_t) detail_ptr->share_res << 8) |
+			     detail_ptr->whole_node);
+	sig = _plan_mix(sig, _plan_str_hash(detail_ptr->features));
+	return sig;
+}
+
+static uint64_t _plan_key(uint32_t job_id, uint32_t test_inx)
+{
+	return ((uint64_t) test_inx << 32) | job_id;
+}
+
+static void _plan_free(void *x)
+{
+	bf_plan_t *plan = (bf_plan_t *) x;
+
+	FREE_NULL_BITMAP(plan->test_bitmap);
+	FREE_NULL_BITMAP(plan->exc_core_bitmap);
+	FREE_NULL_BITMAP(plan->avail_bitmap);
+	xfree(plan);
+}
+
+/* Discard all test results kept from earlier cycles */
+static void _plan_clear(void)
+{
+	if (plan_list)
+		list_flush(plan_list);
+	else
+		plan_list = list_create(_plan_free);
+	id_hash_free(plan_hash);
+	plan_hash = id_hash_init(0);
+}
+
+static void _plan_fini(void)
+{
+	FREE_NULL_LIST(plan_list);
+	id_hash_free(plan_hash);
+	plan_hash = NULL;
+	xfree(plan_node_gen);
+	xfree(plan_node_sig);
+	plan_node_cnt = 0;
+}
+
+/* Note that allocations on these nodes changed */
+static void _plan_nodes_changed(bitstr_t *node_bitmap)
+{
+	int i, i_last;
+
+	if (!node_bitmap || !plan_node_gen)
+		return;
+	plan_gen++;
+	i_last = bit_fls(node_bitmap);
+	for (i = bit_ffs(node_bitmap); (i >= 0) && (i <= i_last); i++) {
+		if (bit_test(node_bitmap, i))
+			plan_node_gen[i] = plan_gen;
+	}
+}
+
+/*
+ * Find the nodes whose state changed since the last scan. A node's
+ * signature covers its state, active features and the jobs allocated to it
+ * with their expected end times. Jobs running past their end time change
+ * their nodes' signatures at every scan, since the time the select plugin
+ * expects them to end moves with the current time. Partition, reservation or
+ * configuration changes discard all results.
+ */
+static void _plan_scan(time_t now)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	struct node_record *node_ptr;
+	bitstr_t *node_bitmap;
+	uint64_t *node_sig, job_sig;
+	int i, i_last;
+
+	if ((plan_node_cnt != node_record_count) ||
+	    (plan_conf_update != slurmctld_conf.last_update) ||
+	    (plan_part_update != last_part_update) ||
+	    (plan_resv_update != last_resv_update)) {
+		_plan_clear();
+		xfree(plan_node_gen);
+		xfree(plan_node_sig);
+		plan_node_cnt = node_record_count;
+		plan_node_gen = xmalloc(sizeof(uint64_t) * plan_node_cnt);
+		plan_node_sig = xmalloc(sizeof(uint64_t) * plan_node_cnt);
+		plan_conf_update = slurmctld_conf.last_update;
+		plan_part_update = last_part_update;
+		plan_resv_update = last_resv_update;
+	}
+
+	node_sig = xmalloc(sizeof(uint64_t) * plan_node_cnt);
+	for (i = 0, node_ptr = node_record_table_ptr; i < plan_node_cnt;
+	     i++, node_ptr++) {
+		node_sig[i] = _plan_mix(node_ptr->node_state,
+					_plan_str_hash(node_ptr->features_act));
+	}
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (IS_JOB_COMPLETING(job_ptr) && job_ptr->node_bitmap_cg)
+			node_bitmap = job_ptr->node_bitmap_cg;
+		else if (IS_JOB_RUNNING(job_ptr) ||
+			 IS_JOB_SUSPENDED(job_ptr) ||
+			 IS_JOB_COMPLETING(job_ptr))
+			node_bitmap = job_ptr->node_bitmap;
+		else
+			continue;
+		if (!node_bitmap)
+			continue;
+		job_sig = _plan_mix(((uint64_t) job_ptr->job_id << 32) |
+				    job_ptr->job_state,
+				    MAX(job_ptr->end_time, now));
+		i_last = bit_fls(node_bitmap);
+		for (i = bit_ffs(node_bitmap); (i >= 0) && (i <= i_last);
+		     i++) {
+			if (bit_test(node_bitmap, i))
+				node_sig[i] += job_sig;
 		}
-		if ((j = node_space[j].next) == 0)
-			break;
 	}
-	return overlap;
+	list_iterator_destroy(job_iterator);
+
+	plan_gen++;
+	for (i = 0; i < plan_node_cnt; i++) {
+		if (node_sig[i] != plan_node_sig[i]) {
+			plan_node_sig[i] = node_sig[i];
+			plan_node_gen[i] = plan_gen;
+		}
+	}
+	xfree(node_sig);
+}
+
+/* Find a still valid test result of an earlier cycle for a job's test_inx
+ * test of this cycle with these inputs. Jobs which could start now are
+ * always tested again. */
+static bf_plan_t *_plan_find(struct job_record *job_ptr, uint32_t test_inx,
+			     bitstr_t *avail_bitmap, uint32_t min_nodes,
+			     uint32_t max_nodes, uint32_t req_nodes,
+			     bitstr_t *exc_core_bitmap, uint32_t job_no_reserve,
+			     time_t now)
+{
+	bf_plan_t *plan;
+	int i, i_last;
+
+	if (!plan_hash ||
+	    !(plan = id_hash_find(plan_hash, _plan_key(job_ptr->job_id,
+							 test_inx))))
+		return NULL;
+
+	if ((plan->part_ptr   != job_ptr->part_ptr) ||
+	    (plan->time_limit != job_ptr->time_limit) ||
+	    (plan_preempt && (plan->priority != job_ptr->priority)) ||
+	    (plan->min_nodes  != min_nodes) ||
+	    (plan->max_nodes  != max_nodes) ||
+	    (plan->req_nodes  != req_nodes) ||
+	    (plan->job_no_reserve != job_no_reserve) ||
+	    (job_ptr->last_update >= plan->test_time) ||
+	    (plan->job_sig != _plan_job_sig(job_ptr)) ||
+	    !bit_equal(plan->test_bitmap, avail_bitmap) ||
+	    (exc_core_bitmap ?
+	     !(plan->exc_core_bitmap &&
+	       bit_equal(plan->exc_core_bitmap, exc_core_bitmap)) :
+	     (plan->exc_core_bitmap != NULL)))
+		return NULL;
+	if ((plan->rc == SLURM_SUCCESS) && (plan->start_time <= now))
+		return NULL;
+
+	i_last = bit_fls(plan->test_bitmap);
+	for (i = bit_ffs(plan->test_bitmap); (i >= 0) && (i <= i_last);
+	     i++) {
+		if (bit_test(plan->test_bitmap, i) &&
+		    (plan_node_gen[i] > plan->gen))
+			return NULL;
+	}
+	return plan;
+}
+
+/* Keep a job's test result for later cycles. test_bitmap is consumed. */
+static void _plan_store(struct job_record *job_ptr, uint32_t test_inx,
+			bitstr_t *test_bitmap, uint32_t min_nodes,
+			uint32_t max_nodes, uint32_t req_nodes,
+			bitstr_t *exc_core_bitmap, uint32_t job_no_reserve,
+			int rc, bitstr_t *avail_bitmap)
+{
+	uint64_t key = _plan_key(job_ptr->job_id, test_inx);
+	bf_plan_t *plan;
+
+	if ((plan = id_hash_find(plan_hash, key))) {
+		FREE_NULL_BITMAP(plan->test_bitmap);
+		FREE_NULL_BITMAP(plan->exc_core_bitmap);
+		FREE_NULL_BITMAP(plan->avail_bitmap);
+	} else {
+		plan = xmalloc(sizeof(bf_plan_t));
+		plan->key = key;
+		list_append(plan_list, plan);
+		id_hash_add(plan_hash, key, plan);
+	}
+	plan->gen        = plan_gen;
+	plan->test_time  = time(NULL);
+	plan->cycle      = plan_cycle;
+	plan->job_sig    = _plan_job_sig(job_ptr);
+	plan->part_ptr   = job_ptr->part_ptr;
+	plan->priority   = job_ptr->priority;
+	plan->time_limit = job_ptr->time_limit;
+	plan->min_nodes  = min_nodes;
+	plan->max_nodes  = max_nodes;
+	plan->req_nodes  = req_nodes;
+	plan->job_no_reserve  = job_no_reserve;
+	plan->test_bitmap     = test_bitmap;
+	if (exc_core_bitmap)
+		plan->exc_core_bitmap = bit_copy(exc_core_bitmap);
+	plan->rc          = rc;
+	if (avail_bitmap)
+		plan->avail_bitmap = bit_copy(avail_bitmap);
+	plan->start_time  = job_ptr->start_time;
+	plan->total_cpus  = job_ptr->total_cpus;
+	plan->best_switch = job_ptr->best_switch;
+}
+
+/* Discard results not used in this cycle or the previous one, normally
+ * those of jobs no longer pending */
+static void _plan_purge(void)
+{
+	ListIterator plan_iterator;
+	bf_plan_t *plan;
+
+	plan_iterator = list_iterator_create(plan_list);
+	while ((plan = (bf_plan_t *) list_next(plan_iterator))) {
+		if ((plan->cycle + 1) >= plan_cycle)
+			continue;
+		id_hash_remove(plan_hash, plan->key, plan);
+		list_delete_item(plan_iterator);
+	}
+	list_iterator_destroy(plan_iterator);
 }
@@ -59,7 +59,13 @@ bool sort_by_time2 = false;
 stats_info_response_msg_t *buf;
 uint32_t *rpc_type_ave_time = NULL, *rpc_user_ave_time = NULL;
 
+/* RPC latency percentiles, in the order the types were received */
+uint16_t *rpc_lat_id = NULL;
+uint64_t *rpc_lat_p50 = NULL, *rpc_lat_p99 = NULL;
+
+static uint64_t _hist_percentile(uint32_t *hist, uint64_t max, int pct);
 static int  _print_stats(void);
+static void _rpc_latency(void);
 static void _sort_rpc(void);
 
 stats_info_request_msg_t req;
@@ -85,6 +91,7 @@ int main(int argc, char *argv[])
 		rc = slurm_get_statistics(&buf,
 					  (stats_info_request_msg_t *)&req);
 		if (rc == SLURM_SUCCESS) {
+			_rpc_latency();
 			_sort_rpc();
 			rc = _print_stats();
 #ifdef MEMORY_LEAK_DEBUG
@@ -92,6 +99,9 @@ int main(int argc, char *argv[])
 			slurm_free_stats_response_msg(buf);
 			xfree(rpc_type_ave_time);
 			xfree(rpc_user_ave_time);
+			xfree(rpc_lat_id);
+			xfree(rpc_lat_p50);
+			xfree(rpc_lat_p99);
 #endif
 		} else
 			slurm_perror("slurm_get_statistics");
@@ -102,7 +112,10 @@ int main(int argc, char *argv[])
 
 static int _print_stats(void)
 {
-	int i;
+	static const char *lock_names[] = {
+		"Config", "Job", "Node", "Partition", "Federation"
+	};
+	int i, j;
 
 	if (!buf) {
 		printf("No data available. Probably slurmctld is not working\n");
@@ -137,6 +150,11 @@ static int _print_stats(void)
 		       ((buf->req_time - buf->req_time_start) / 60)));
 	}
 	printf("\tLast queue length: %u\n", buf->schedule_queue_len);
+	printf("\tLast cycle lock hold: %"PRIu64"\n", buf->schedule_lock_last);
+	if (buf->schedule_cycle_counter > 0) {
+		printf("\tMean cycle lock hold: %"PRIu64"\n",
+		       buf->schedule_lock_sum / buf->schedule_cycle_counter);
+	}
 
 	if (buf->bf_active) {
 		printf("\nBackfilling stats (WARNING: data obtained"
@@ -169,6 +187,24 @@ static int _print_stats(void)
 		printf("\tQueue length mean: %u\n",
 		       buf->bf_queue_len_sum / buf->bf_cycle_counter);
 	}
+	printf("\tLast cycle lock hold: %"PRIu64"\n", buf->bf_lock_last);
+	if (buf->bf_cycle_counter > 0) {
+		printf("\tMean cycle lock hold: %"PRIu64"\n",
+		       buf->bf_lock_sum / buf->bf_cycle_counter);
+	}
+	if (buf->bf_thread_cnt > 1) {
+		printf("\tLast cycle look-ahead tests used: %u discarded: %u\n",
+		       buf->bf_spec_used, buf->bf_spec_discard);
+	}
+	if (buf->bf_plan_used || buf->bf_plan_cnt) {
+		printf("\tLast cycle earlier tests used: %u kept: %u\n",
+		       buf->bf_plan_used, buf->bf_plan_cnt);
+	}
+	for (i = 0; i < buf->bf_thread_cnt; i++) {
+		printf("\tLast cycle thread %d: tests:%-6u test_time:%"PRIu64
+		       "\n", i, buf->bf_thread_tests[i],
+		       buf->bf_thread_usec[i]);
+	}
 
 	printf("\nRemote Procedure Call statistics by message type\n");
 	for (i = 0; i < buf->rpc_type_size; i++) {
@@ -179,6 +215,24 @@ static int _print_stats(void)
 		       rpc_type_ave_time[i], buf->rpc_type_time[i]);
 	}
 
+	if (buf->rpc_hist_size) {
+		printf("\nRemote Procedure Call latency by message type "
+		       "(microseconds)\n");
+	}
+	for (i = 0; buf->rpc_hist_size && (i < buf->rpc_type_size); i++) {
+		for (j = 0; j < buf->rpc_type_size; j++) {
+			if (rpc_lat_id[j] == buf->rpc_type_id[i])
+				break;
+		}
+		if (j >= buf->rpc_type_size)
+			continue;
+		printf("\t%-40s(%5u) p50:%-8"PRIu64" p99:%-8"PRIu64
+		       " max:%"PRIu64"\n",
+		       rpc_num2string(buf->rpc_type_id[i]),
+		       buf->rpc_type_id[i], rpc_lat_p50[j], rpc_lat_p99[j],
+		       buf->rpc_type_max[j]);
+	}
+
 	printf("\nRemote Procedure Call statistics by user\n");
 	for (i = 0; i < buf->rpc_user_size; i++) {
 		printf("\t%-16s(%8u) count:%-6u "
@@ -188,9 +242,86 @@ static int _print_stats(void)
 		       rpc_user_ave_time[i], buf->rpc_user_time[i]);
 	}
 
+	printf("\nPending RPC statistics by message type\n");
+	for (i = 0; i < buf->rpc_queue_type_size; i++) {
+		printf("\t%-40s(%5u) queued:%-6u max_queued:%u\n",
+		       rpc_num2string(buf->rpc_queue_type_id[i]),
+		       buf->rpc_queue_type_id[i],
+		       buf->rpc_queue_type_depth[i],
+		       buf->rpc_queue_type_max[i]);
+	}
+
+	if (buf->lock_stat_size)
+		printf("\nLock statistics (microseconds)\n");
+	for (i = 0; i < buf->lock_stat_size; i++) {
+		if (!buf->lock_cnt[i])
+			continue;
+		printf("\t%-10s %-5s count:%-8u ave_wait:%-6"PRIu64
+		       " max_wait:%-8"PRIu64" ave_hold:%-6"PRIu64
+		       " max_hold:%"PRIu64"\n",
+		       ((i / 2) < (sizeof(lock_names) / sizeof(char *))) ?
+		       lock_names[i / 2] : "Unknown",
+		       (i % 2) ? "write" : "read", buf->lock_cnt[i],
+		       buf->lock_wait_usec[i] / buf->lock_cnt[i],
+		       buf->lock_wait_max[i],
+		       buf->lock_hold_usec[i] / buf->lock_cnt[i],
+		       buf->lock_hold_max[i]);
+	}
+
 	return 0;
 }
 
+/*
+ * Estimate a percentile of RPC latency from its histogram, bucket b holding
+ * RPCs of 2^(b-1) to 2^b - 1 microseconds. Report the upper bound of the
+ * bucket reaching the percentile, capped by the recorded maximum.
+ */
+static uint64_t _hist_percentile(uint32_t *hist, uint64_t max, int pct)
+{
+	uint64_t total = 0, target, sum = 0, bound;
+	int b;
+
+	for (b = 0; b < buf->rpc_hist_size; b++)
+		total += hist[b];
+	if (total == 0)
+		return 0;
+	target = (total * pct + 99) / 100;
+	for (b = 0; b < buf->rpc_hist_size; b++) {
+		sum += hist[b];
+		if (sum >= target)
+			break;
+	}
+	if (b == 0)
+		bound = 0;
+	else if ((b >= buf->rpc_hist_size - 1) || (b >= 63))
+		bound = max;	/* last bucket is open ended */
+	else
+		bound = ((uint64_t) 1 << b) - 1;
+	return MIN(bound, max);
+}
+
+/* Compute RPC latency percentiles before _sort_rpc() reorders the types */
+static void _rpc_latency(void)
+{
+	uint32_t *hist;
+	int i;
+
+	if (!buf->rpc_hist_size)
+		return;
+
+	rpc_lat_id  = xmalloc(sizeof(uint16_t) * buf->rpc_type_size);
+	rpc_lat_p50 = xmalloc(sizeof(uint64_t) * buf->rpc_type_size);
+	rpc_lat_p99 = xmalloc(sizeof(uint64_t) * buf->rpc_type_size);
+	for (i = 0; i < buf->rpc_type_size; i++) {
+		hist = buf->rpc_type_hist + (i * buf->rpc_hist_size);
+		rpc_lat_id[i]  = buf->rpc_type_id[i];
+		rpc_lat_p50[i] = _hist_percentile(hist, buf->rpc_type_max[i],
+						  50);
+		rpc_lat_p99[i] = _hist_percentile(hist, buf->rpc_type_max[i],
+						  99);
+	}
+}
+
 static void _sort_rpc(void)
 {
 	int i, j;
@@ -67,6 +67,7 @@ static pthread_mutex_t sinfo_list_mutex = PTHREAD_MUTEX_INITIALIZER;
  * Functions *
  *************/
 static int  _bg_report(block_info_msg_t *block_ptr);
+static node_info_cond_t *_build_node_cond(void);
 void *      _build_part_info(void *args);
 static int  _build_sinfo_data(List sinfo_list,
 			      partition_info_msg_t *partition_msg,
@@ -232,6 +233,23 @@ static int _reservation_report(reserve_info_msg_t *resv_ptr)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * _build_node_cond - build the node filters of the node information request
+ *	from the sinfo options, so slurmctld only sends the nodes we might
+ *	report. The nodes received still go through _filter_out().
+ * RET the filters or NULL for all nodes
+ */
+static node_info_cond_t *_build_node_cond(void)
+{
+	static node_info_cond_t cond;
+
+	if (!params.nodes && !params.partition)
+		return NULL;
+	cond.nodes = params.nodes;
+	cond.partitions = params.partition;
+	return &cond;
+}
+
 /*
  * _query_server - download the current server state
  * part_pptr IN/OUT - partition information message
@@ -292,8 +310,10 @@ _query_server(partition_info_msg_t ** part_pptr,
 							    params.nodes,
 							    show_flags);
 		} else {
-			error_code = slurm_load_node(old_node_ptr->last_update,
-						     &new_node_ptr, show_flags);
+			error_code = slurm_load_node_cond(
+						old_node_ptr->last_update,
+						&new_node_ptr, show_flags,
+						_build_node_cond());
 		}
 		if (error_code == SLURM_SUCCESS)
 			slurm_free_node_info_msg(old_node_ptr);
@@ -305,8 +325,9 @@ _query_server(partition_info_msg_t ** part_pptr,
 		error_code = slurm_load_node_single(&new_node_ptr, params.nodes,
 						    show_flags);
 	} else {
-		error_code = slurm_load_node((time_t) NULL, &new_node_ptr,
-					     show_flags);
+		error_code = slurm_load_node_cond((time_t) NULL, &new_node_ptr,
+						  show_flags,
+						  _build_node_cond());
 	}
 
 	if (error_code) {
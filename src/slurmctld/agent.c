@@ -51,15 +51,21 @@
  *  be possible to execute the agent as an pthread, process, or even a daemon
  *  on some other computer.
  *
- *  The main agent thread creates a separate thread for each node to be
- *  communicated with up to AGENT_THREAD_COUNT. A special watchdog thread
- *  sends SIGLARM to any threads that have been active (in DSH_ACTIVE state)
- *  for more than MessageTimeout seconds.
+ *  The agent thread splits the nodes into groups and drives every
+ *  connection for every group itself, keeping up to AGENT_CONN_COUNT
+ *  non-blocking connections outstanding and multiplexing them with poll().
+ *  Each connection carries its own deadline, so nodes which do not respond
+ *  are timed out individually without a watchdog thread. Where the message
+ *  is forwarded by slurmd, each connection carries the message for a whole
+ *  branch of the forwarding tree.
+ *  With CommunicationParameters=slurmd_persist_conn, connections used for
+ *  the periodic and job termination RPCs are kept open once answered and
+ *  parked in a pool, one per node, for the next agent to reuse.
  *  The agent responds to slurmctld via a function call or an RPC as required.
  *  For example, informing slurmctld that some node is not responding.
  *
- *  All the state for each thread is maintained in thd_t struct, which is
- *  used by the watchdog thread as well as the communication threads.
+ *  All the state for each group of nodes is maintained in thd_t struct and
+ *  the state of each connection in agent_conn_t.
 \*****************************************************************************/
 
 #include "config.h"
@@ -68,27 +74,38 @@
 #include <sys/prctl.h>
 #endif
 
+#include <arpa/inet.h>
 #include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
 #include <pthread.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "src/common/fd.h"
 #include "src/common/forward.h"
 #include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
+#include "src/common/net.h"
 #include "src/common/node_select.h"
 #include "src/common/parse_time.h"
+#include "src/common/slurm_auth.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
+#include "src/common/slurm_route.h"
 #include "src/common/uid.h"
 #include "src/common/xsignal.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/slurmctld/agent.h"
@@ -111,59 +128,100 @@ typedef enum {
 	DSH_DUP_JOBID	/* Request resulted in duplicate job ID error */
 } state_t;
 
+typedef enum {
+	CONN_WAIT,	/* Waiting to retry a refused connection */
+	CONN_CONNECT,	/* Non-blocking connect in progress */
+	CONN_SEND,	/* Writing request */
+	CONN_RECV	/* Reading response */
+} conn_state_t;
+
 typedef struct thd_complete {
-	bool work_done; 	/* assume all threads complete */
 	int fail_cnt;		/* assume no threads failures */
 	int no_resp_cnt;	/* assume all threads respond */
 	int retry_cnt;		/* assume no required retries */
 	int max_delay;
-	time_t now;
 } thd_complete_t;
 
 typedef struct thd {
-	pthread_t thread;		/* thread ID */
-	pthread_attr_t attr;		/* thread attributes */
-	state_t state;			/* thread state */
+	state_t state;			/* group state */
 	time_t start_time;		/* start time */
 	time_t end_time;		/* end time or delta time
 					 * upon termination */
 	slurm_addr_t *addr;		/* specific addr to send to
 					 * will not do nodelist if set */
 	char *nodelist;			/* list of nodes to send to */
+	int conn_cnt;			/* connections still in progress */
 	List ret_list;
 } thd_t;
 
 typedef struct agent_info {
-	pthread_mutex_t thread_mutex;	/* agent specific mutex */
-	pthread_cond_t thread_cond;	/* agent specific condition */
-	uint32_t thread_count;		/* number of threads records */
-	uint32_t threads_active;	/* currently active threads */
+	uint32_t thread_count;		/* number of group records */
 	uint16_t retry;			/* if set, keep trying */
-	thd_t *thread_struct;		/* thread structures */
+	thd_t *thread_struct;		/* group structures */
 	bool get_reply;			/* flag if reply expected */
 	slurm_msg_type_t msg_type;	/* RPC to be issued */
 	void **msg_args_pptr;		/* RPC data to be used */
 	uint16_t protocol_version;	/* if set, use this version */
+	int msg_timeout;		/* MessageTimeout in msec */
+	int conn_retry;			/* connect retries if refused */
+	uint16_t tree_width;		/* TreeWidth */
+	bool persist_conn;		/* reuse pooled slurmd connections */
+	List comm_err_list;		/* ret_data_info_t of nodes which
+					 * failed when no reply is expected */
 } agent_info_t;
 
-typedef struct task_info {
-	pthread_mutex_t *thread_mutex_ptr; /* pointer to agent specific
-					    * mutex */
-	pthread_cond_t *thread_cond_ptr;/* pointer to agent specific
-					 * condition */
-	uint32_t *threads_active_ptr;	/* currently active thread ptr */
-	thd_t *thread_struct_ptr;	/* thread structures ptr */
-	bool get_reply;			/* flag if reply expected */
-	slurm_msg_type_t msg_type;	/* RPC to be issued */
-	void *msg_args_ptr;		/* ptr to RPC data to be used */
-	uint16_t protocol_version;	/* if set, use this version */
-} task_info_t;
+typedef struct agent_conn {
+	conn_state_t state;
+	int fd;
+	thd_t *thread_ptr;		/* group the connection reports to */
+	char *name;			/* node contacted directly */
+	slurm_addr_t addr;		/* its address */
+	hostlist_t fwd_hl;		/* nodes it forwards the message to */
+	int fwd_cnt;			/* count of nodes forwarded to */
+	int retry_cnt;			/* refused connection attempts */
+	Buf buffer;			/* packed request */
+	uint32_t msg_len;		/* length prefix, network byte order */
+	char *resp;			/* response being read */
+	uint32_t io_off;		/* bytes moved, with length prefix */
+	uint64_t deadline;		/* msec, see _msec_now() */
+	bool reused;			/* fd taken from the pool */
+} agent_conn_t;
+
+typedef struct pool_conn {
+	char *name;			/* node name, the table key */
+	int fd;
+	time_t last_used;
+} pool_conn_t;
+
+/* A request bundled into REQUEST_MESSAGE_COMPOSITE messages, shared by the
+ * composite messages sent to its nodes and by its retry_list entry */
+typedef struct aggr_part {
+	agent_arg_t *agent_arg_ptr;	/* the request */
+	int refcnt;			/* protected by aggr_mutex */
+} aggr_part_t;
+
+/* Request of a composite message, see _aggr_msg_free() */
+typedef struct aggr_msg {
+	slurm_msg_t msg;		/* must be first */
+	aggr_part_t *part;		/* its data is part's msg_args */
+} aggr_msg_t;
+
+/* Nodes of a request bundled with the same requests */
+typedef struct aggr_group {
+	bitstr_t *parts;		/* requests, index in the bundle */
+	hostlist_t hl;
+} aggr_group_t;
 
 typedef struct queued_request {
 	agent_arg_t* agent_arg_ptr;	/* The queued request */
 	time_t       first_attempt;	/* Time of first check for batch
 					 * launch RPC *only* */
 	time_t       last_attempt;	/* Time of last xmit attempt */
+	uint64_t     queue_time;	/* msec, see _msec_now() */
+	bool         aggr;		/* may be bundled into composite
+					 * msgs, per node */
+	aggr_part_t *part;		/* set once bundled for some of its
+					 * nodes, hostlist holds the rest */
 } queued_request_t;
 
 typedef struct mail_info {
@@ -171,13 +229,26 @@ typedef struct mail_info {
 	char *message;
 } mail_info_t;
 
-static void _sig_handler(int dummy);
+static void _agent_comm(agent_info_t *agent_ptr);
+static void _agent_complete(agent_info_t *agent_ptr);
+static List _aggr_bundle(queued_request_t *first_req, int *del_cnt);
+static void _aggr_config(void);
+static bool _aggr_defer(queued_request_t *queued_req_ptr, uint64_t now_msec);
+static bool _aggr_msg_type(slurm_msg_type_t msg_type);
+static void _aggr_part_unref(aggr_part_t *part);
+static void _aggr_reset_auth(composite_msg_t *comp_msg);
+static int  _aggr_ret_list(agent_info_t *agent_ptr,
+			   ret_data_info_t *ret_data_info);
 static int  _batch_launch_defer(queued_request_t *queued_req_ptr);
 static inline int _comm_err(char *node_name, slurm_msg_type_t msg_type);
+static state_t _group_ret_list(agent_info_t *agent_ptr, thd_t *thread_ptr);
 static void _list_delete_retry(void *retry_entry);
 static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr);
-static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx);
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr);
+static bool _persist_conn_type(slurm_msg_type_t msg_type);
+static void _pool_fini(void);
+static int  _pool_get(char *name);
+static void _pool_put(char *name, int fd);
 static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
 		int no_resp_cnt, int retry_cnt);
 static void _purge_agent_args(agent_arg_t *agent_arg_ptr);
@@ -185,9 +256,7 @@ static void _queue_agent_retry(agent_info_t * agent_info_ptr, int count);
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
 			  int *count, int *spot);
 static void _spawn_retry_agent(agent_arg_t * agent_arg_ptr);
-static void *_thread_per_group_rpc(void *args);
 static int   _valid_agent_arg(agent_arg_t *agent_arg_ptr);
-static void *_wdog(void *args);
 
 static mail_info_t *_mail_alloc(void);
 static void  _mail_free(void *arg);
@@ -203,12 +272,22 @@ static pthread_mutex_t agent_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
 static int agent_cnt = 0;
 static int agent_thread_cnt = 0;
-static uint16_t message_timeout = (uint16_t) NO_VAL;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *conn_pool = NULL;	/* idle slurmd connections */
+static time_t pool_purge_time = 0;
 
 static bool run_scheduler    = false;
 static bool wiki2_sched      = false;
 static bool wiki2_sched_test = false;
 
+/* Bundling of queued requests into composite messages, from
+ * MsgAggregationParams, protected by retry_mutex */
+static uint64_t aggr_window_msgs = DEFAULT_MSG_AGGR_WINDOW_MSGS;
+static uint64_t aggr_window_time = DEFAULT_MSG_AGGR_WINDOW_TIME;
+static uint64_t aggr_wake = 0;		/* msec, first window to expire */
+static pthread_mutex_t aggr_mutex = PTHREAD_MUTEX_INITIALIZER; /* refcnt */
+
 /*
  * agent - party responsible for transmitting an common RPC in parallel
  *	across a set of nodes. Use agent_queue_request() if immediate
@@ -219,16 +298,11 @@ static bool wiki2_sched_test = false;
  */
 void *agent(void *args)
 {
-	int i, delay, rc, retries = 0;
-	pthread_attr_t attr_wdog;
-	pthread_t thread_wdog = 0;
+	int delay;
 	agent_arg_t *agent_arg_ptr = args;
 	agent_info_t *agent_info_ptr = NULL;
-	thd_t *thread_ptr;
-	task_info_t *task_specific_ptr;
 	time_t begin_time;
 	bool spawn_retry_agent = false;
-	int rpc_thread_cnt;
 
 #if HAVE_SYS_PRCTL_H
 	if (prctl(PR_SET_NAME, "agent", NULL, NULL, NULL) < 0) {
@@ -250,12 +324,11 @@ void *agent(void *args)
 		wiki2_sched_test = true;
 	}
 
-	rpc_thread_cnt = 2 + MIN(agent_arg_ptr->node_count, AGENT_THREAD_COUNT);
 	while (1) {
 		if (slurmctld_config.shutdown_time ||
-		    ((agent_thread_cnt+rpc_thread_cnt) <= MAX_SERVER_THREADS)) {
+		    (agent_thread_cnt < MAX_SERVER_THREADS)) {
 			agent_cnt++;
-			agent_thread_cnt += rpc_thread_cnt;
+			agent_thread_cnt++;
 			break;
 		} else {	/* wait for state change and retry */
 			slurm_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
@@ -270,78 +343,22 @@ void *agent(void *args)
 	if (_valid_agent_arg(agent_arg_ptr))
 		goto cleanup;
 
+	/* credentials of bundled requests may have expired while queued */
+	if (agent_arg_ptr->msg_type == REQUEST_MESSAGE_COMPOSITE)
+		_aggr_reset_auth(agent_arg_ptr->msg_args);
+
 	/* initialize the agent data structures */
 	agent_info_ptr = _make_agent_info(agent_arg_ptr);
-	thread_ptr = agent_info_ptr->thread_struct;
-
-	/* start the watchdog thread */
-	slurm_attr_init(&attr_wdog);
-	if (pthread_attr_setdetachstate
-	    (&attr_wdog, PTHREAD_CREATE_JOINABLE))
-		error("pthread_attr_setdetachstate error %m");
-	while (pthread_create(&thread_wdog, &attr_wdog, _wdog,
-			      (void *) agent_info_ptr)) {
-		error("pthread_create error %m");
-		if (++retries > MAX_RETRIES)
-			fatal("Can't create pthread");
-		usleep(10000);	/* sleep and retry */
-	}
-	slurm_attr_destroy(&attr_wdog);
-
-	debug2("got %d threads to send out", agent_info_ptr->thread_count);
-	/* start all the other threads (up to AGENT_THREAD_COUNT active) */
-	for (i = 0; i < agent_info_ptr->thread_count; i++) {
-
-		/* wait until "room" for another thread */
-		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-		while (agent_info_ptr->threads_active >=
-		       AGENT_THREAD_COUNT) {
-			slurm_cond_wait(&agent_info_ptr->thread_cond,
-					&agent_info_ptr->thread_mutex);
-		}
 
-		/* create thread specific data, NOTE: freed from
-		 *      _thread_per_group_rpc() */
-		task_specific_ptr = _make_task_data(agent_info_ptr, i);
-
-		slurm_attr_init(&thread_ptr[i].attr);
-		if (pthread_attr_setdetachstate(&thread_ptr[i].attr,
-						PTHREAD_CREATE_DETACHED))
-			error("pthread_attr_setdetachstate error %m");
-		while ((rc = pthread_create(&thread_ptr[i].thread,
-					    &thread_ptr[i].attr,
-					    _thread_per_group_rpc,
-					    (void *) task_specific_ptr))) {
-			error("pthread_create error %m");
-			if (agent_info_ptr->threads_active)
-				slurm_cond_wait(&agent_info_ptr->thread_cond,
-						&agent_info_ptr->thread_mutex);
-			else {
-				slurm_mutex_unlock(&agent_info_ptr->
-						     thread_mutex);
-				usleep(10000);	/* sleep and retry */
-				slurm_mutex_lock(&agent_info_ptr->
-						   thread_mutex);
-			}
-		}
-		slurm_attr_destroy(&thread_ptr[i].attr);
-		agent_info_ptr->threads_active++;
-		slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
-	}
+	debug2("got %d groups to send out", agent_info_ptr->thread_count);
+	_agent_comm(agent_info_ptr);
 
-	/* Wait for termination of remaining threads */
-	pthread_join(thread_wdog, NULL);
 	delay = (int) difftime(time(NULL), begin_time);
 	if (delay > (slurm_get_msg_timeout() * 2)) {
 		info("agent msg_type=%u ran for %d seconds",
 			agent_arg_ptr->msg_type,  delay);
 	}
-	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-	while (agent_info_ptr->threads_active != 0) {
-		slurm_cond_wait(&agent_info_ptr->thread_cond,
-				&agent_info_ptr->thread_mutex);
-	}
-	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+	_agent_complete(agent_info_ptr);
 
       cleanup:
 	_purge_agent_args(agent_arg_ptr);
@@ -358,14 +375,14 @@ void *agent(void *args)
 		error("agent_cnt underflow");
 		agent_cnt = 0;
 	}
-	if (agent_thread_cnt >= rpc_thread_cnt) {
-		agent_thread_cnt -= rpc_thread_cnt;
+	if (agent_thread_cnt > 0) {
+		agent_thread_cnt--;
 	} else {
 		error("agent_thread_cnt underflow");
 		agent_thread_cnt = 0;
 	}
 
-	if ((agent_thread_cnt + AGENT_THREAD_COUNT + 2) < MAX_SERVER_THREADS)
+	if ((agent_thread_cnt + 1) < MAX_SERVER_THREADS)
 		spawn_retry_agent = true;
 
 	slurm_cond_broadcast(&agent_cnt_cond);
@@ -404,20 +421,27 @@ static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr)
 	int *span = NULL;
 	int thr_count = 0;
 	hostlist_t hl = NULL;
-	char *name = NULL;
+	char *name = NULL, *comm_params;
 
 	agent_info_ptr = xmalloc(sizeof(agent_info_t));
-	slurm_mutex_init(&agent_info_ptr->thread_mutex);
-	slurm_cond_init(&agent_info_ptr->thread_cond, NULL);
 	agent_info_ptr->thread_count   = agent_arg_ptr->node_count;
 	agent_info_ptr->retry          = agent_arg_ptr->retry;
-	agent_info_ptr->threads_active = 0;
 	thread_ptr = xmalloc(agent_info_ptr->thread_count * sizeof(thd_t));
 	memset(thread_ptr, 0, (agent_info_ptr->thread_count * sizeof(thd_t)));
 	agent_info_ptr->thread_struct  = thread_ptr;
 	agent_info_ptr->msg_type       = agent_arg_ptr->msg_type;
 	agent_info_ptr->msg_args_pptr  = &agent_arg_ptr->msg_args;
 	agent_info_ptr->protocol_version = agent_arg_ptr->protocol_version;
+	agent_info_ptr->msg_timeout    = slurm_get_msg_timeout() * 1000;
+	agent_info_ptr->conn_retry     = MIN(slurm_get_msg_timeout(), 10);
+	agent_info_ptr->tree_width     = slurm_get_tree_width();
+	comm_params = slurm_get_comm_params();
+	if (xstrcasestr(comm_params, "slurmd_persist_conn")) {
+		agent_info_ptr->persist_conn = !agent_arg_ptr->addr &&
+			_persist_conn_type(agent_arg_ptr->msg_type);
+	} else
+		_pool_fini();
+	xfree(comm_params);
 
 	if ((agent_arg_ptr->msg_type != REQUEST_JOB_NOTIFY)	&&
 	    (agent_arg_ptr->msg_type != REQUEST_REBOOT_NODES)	&&
@@ -488,42 +512,10 @@ static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr)
 	return agent_info_ptr;
 }
 
-static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx)
-{
-	task_info_t *task_info_ptr;
-	task_info_ptr = xmalloc(sizeof(task_info_t));
-
-	task_info_ptr->thread_mutex_ptr  = &agent_info_ptr->thread_mutex;
-	task_info_ptr->thread_cond_ptr   = &agent_info_ptr->thread_cond;
-	task_info_ptr->threads_active_ptr= &agent_info_ptr->threads_active;
-	task_info_ptr->thread_struct_ptr = &agent_info_ptr->thread_struct[inx];
-	task_info_ptr->get_reply         = agent_info_ptr->get_reply;
-	task_info_ptr->msg_type          = agent_info_ptr->msg_type;
-	task_info_ptr->msg_args_ptr      = *agent_info_ptr->msg_args_pptr;
-	task_info_ptr->protocol_version  = agent_info_ptr->protocol_version;
-
-	return task_info_ptr;
-}
-
-static void _update_wdog_state(thd_t *thread_ptr,
-			       state_t *state,
+static void _update_comp_state(thd_t *thread_ptr, state_t state,
 			       thd_complete_t *thd_comp)
 {
-	switch (*state) {
-	case DSH_ACTIVE:
-		thd_comp->work_done = false;
-		if (thread_ptr->end_time <= thd_comp->now) {
-			debug3("agent thread %lu timed out",
-			       (unsigned long) thread_ptr->thread);
-			if (pthread_kill(thread_ptr->thread, SIGUSR1) == ESRCH)
-				*state = DSH_NO_RESP;
-			else
-				thread_ptr->end_time += message_timeout;
-		}
-		break;
-	case DSH_NEW:
-		thd_comp->work_done = false;
-		break;
+	switch (state) {
 	case DSH_DONE:
 		if (thd_comp->max_delay < (int)thread_ptr->end_time)
 			thd_comp->max_delay = (int)thread_ptr->end_time;
@@ -536,25 +528,48 @@ static void _update_wdog_state(thd_t *thread_ptr,
 	case DSH_DUP_JOBID:
 		thd_comp->fail_cnt++;
 		break;
+	default:
+		break;
 	}
 }
 
 /*
- * _wdog - Watchdog thread. Send SIGUSR1 to threads which have been active
- *	for too long.
- * IN args - pointer to agent_info_t with info on threads to watch
- * Sleep between polls with exponential times (from 0.125 to 1.0 second)
+ * _agent_complete - Report the results of all node groups to slurmctld,
+ *	queue retries of failed RPCs and free the results
+ * IN agent_ptr - pointer to agent_info_t with all groups complete
  */
-static void *_wdog(void *args)
+static void _agent_complete(agent_info_t *agent_ptr)
 {
 	bool srun_agent = false;
 	int i;
-	agent_info_t *agent_ptr = (agent_info_t *) args;
 	thd_t *thread_ptr = agent_ptr->thread_struct;
-	unsigned long usec = 5000;
 	ListIterator itr;
 	thd_complete_t thd_comp;
 	ret_data_info_t *ret_data_info = NULL;
+	/* Lock: Read node */
+	slurmctld_lock_t node_read_lock = {
+		NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+
+	/* Apply the responses now that no connection waits on slurmctld
+	 * locks taken while doing so */
+	if (agent_ptr->get_reply) {
+		for (i = 0; i < agent_ptr->thread_count; i++) {
+			thread_ptr[i].state =
+				_group_ret_list(agent_ptr, &thread_ptr[i]);
+		}
+	}
+	if (agent_ptr->comm_err_list) {
+		lock_slurmctld(node_read_lock);
+		itr = list_iterator_create(agent_ptr->comm_err_list);
+		while ((ret_data_info = list_next(itr))) {
+			errno = ret_data_info->err;
+			_comm_err(ret_data_info->node_name,
+				  agent_ptr->msg_type);
+		}
+		list_iterator_destroy(itr);
+		unlock_slurmctld(node_read_lock);
+		FREE_NULL_LIST(agent_ptr->comm_err_list);
+	}
 
 	if ( (agent_ptr->msg_type == SRUN_JOB_COMPLETE)			||
 	     (agent_ptr->msg_type == SRUN_REQUEST_SUSPEND)		||
@@ -568,40 +583,20 @@ static void *_wdog(void *args)
 	     (agent_ptr->msg_type == RESPONSE_RESOURCE_ALLOCATION) )
 		srun_agent = true;
 
-	thd_comp.max_delay = 0;
-
-	while (1) {
-		thd_comp.work_done   = true;/* assume all threads complete */
-		thd_comp.fail_cnt    = 0;   /* assume no threads failures */
-		thd_comp.no_resp_cnt = 0;   /* assume all threads respond */
-		thd_comp.retry_cnt   = 0;   /* assume no required retries */
-		thd_comp.now         = time(NULL);
-
-		usleep(usec);
-		usec = MIN((usec * 2), 1000000);
-
-		slurm_mutex_lock(&agent_ptr->thread_mutex);
-		for (i = 0; i < agent_ptr->thread_count; i++) {
-			//info("thread name %s",thread_ptr[i].node_name);
-			if (!thread_ptr[i].ret_list) {
-				_update_wdog_state(&thread_ptr[i],
-						   &thread_ptr[i].state,
+	memset(&thd_comp, 0, sizeof(thd_complete_t));
+	for (i = 0; i < agent_ptr->thread_count; i++) {
+		if (!thread_ptr[i].ret_list) {
+			_update_comp_state(&thread_ptr[i], thread_ptr[i].state,
+					   &thd_comp);
+		} else {
+			itr = list_iterator_create(thread_ptr[i].ret_list);
+			while ((ret_data_info = list_next(itr))) {
+				_update_comp_state(&thread_ptr[i],
+						   ret_data_info->err,
 						   &thd_comp);
-			} else {
-				itr = list_iterator_create(
-					thread_ptr[i].ret_list);
-				while ((ret_data_info = list_next(itr))) {
-					_update_wdog_state(&thread_ptr[i],
-							   &ret_data_info->err,
-							   &thd_comp);
-				}
-				list_iterator_destroy(itr);
 			}
+			list_iterator_destroy(itr);
 		}
-		if (thd_comp.work_done)
-			break;
-
-		slurm_mutex_unlock(&agent_ptr->thread_mutex);
 	}
 
 	if (srun_agent) {
@@ -619,9 +614,6 @@ static void *_wdog(void *args)
 
 	if (thd_comp.max_delay)
 		debug2("agent maximum delay %d seconds", thd_comp.max_delay);
-
-	slurm_mutex_unlock(&agent_ptr->thread_mutex);
-	return (void *) NULL;
 }
 
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr)
@@ -810,32 +802,20 @@ static int _wif_status(void)
 }
 
 /*
- * _thread_per_group_rpc - thread to issue an RPC for a group of nodes
- *                         sending message out to one and forwarding it to
- *                         others if necessary.
- * IN/OUT args - pointer to task_info_t, xfree'd on completion
+ * _group_ret_list - process the responses gathered for one group of nodes
+ * IN agent_ptr - pointer to agent_info_t of the RPC issued
+ * IN/OUT thread_ptr - group, the err field of each response is set to its
+ *	resulting state
+ * RET state of the group as a whole
  */
-static void *_thread_per_group_rpc(void *args)
+static state_t _group_ret_list(agent_info_t *agent_ptr, thd_t *thread_ptr)
 {
 	int rc = SLURM_SUCCESS;
-	slurm_msg_t msg;
-	task_info_t *task_ptr = (task_info_t *) args;
-	/* we cache some pointers from task_info_t because we need
-	 * to xfree args before being finished with their use. xfree
-	 * is required for timely termination of this pthread because
-	 * xfree could lock it at the end, preventing a timely
-	 * thread_exit */
-	pthread_mutex_t *thread_mutex_ptr   = task_ptr->thread_mutex_ptr;
-	pthread_cond_t  *thread_cond_ptr    = task_ptr->thread_cond_ptr;
-	uint32_t        *threads_active_ptr = task_ptr->threads_active_ptr;
-	thd_t           *thread_ptr         = task_ptr->thread_struct_ptr;
 	state_t thread_state = DSH_NO_RESP;
-	slurm_msg_type_t msg_type = task_ptr->msg_type;
+	slurm_msg_type_t msg_type = agent_ptr->msg_type;
 	bool is_kill_msg, srun_agent;
-	List ret_list = NULL;
 	ListIterator itr;
 	ret_data_info_t *ret_data_info = NULL;
-	int sig_array[2] = {SIGUSR1, 0};
 	/* Locks: Write job, write node */
 	slurmctld_lock_t job_write_lock = {
 		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
@@ -846,9 +826,6 @@ static void *_thread_per_group_rpc(void *args)
 	slurmctld_lock_t node_write_lock = {
 		NO_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
 
-	xassert(args != NULL);
-	xsignal(SIGUSR1, _sig_handler);
-	xsignal_unblock(sig_array);
 	is_kill_msg = (	(msg_type == REQUEST_KILL_TIMELIMIT)	||
 			(msg_type == REQUEST_KILL_PREEMPTED)	||
 			(msg_type == REQUEST_TERMINATE_JOB) );
@@ -862,79 +839,20 @@ static void *_thread_per_group_rpc(void *args)
 			(msg_type == RESPONSE_RESOURCE_ALLOCATION) ||
 			(msg_type == SRUN_NODE_FAIL) );
 
-	thread_ptr->start_time = time(NULL);
-
-	slurm_mutex_lock(thread_mutex_ptr);
-	thread_ptr->state = DSH_ACTIVE;
-	thread_ptr->end_time = thread_ptr->start_time + message_timeout;
-	slurm_mutex_unlock(thread_mutex_ptr);
-
-	/* send request message */
-	slurm_msg_t_init(&msg);
-
-	if (task_ptr->protocol_version)
-		msg.protocol_version = task_ptr->protocol_version;
-
-	msg.msg_type = msg_type;
-	msg.data     = task_ptr->msg_args_ptr;
-#if 0
- 	info("sending message type %u to %s", msg_type, thread_ptr->nodelist);
-#endif
-	if (task_ptr->get_reply) {
-		if (thread_ptr->addr) {
-			msg.address = *thread_ptr->addr;
-
-			if (!(ret_list = slurm_send_addr_recv_msgs(
-				     &msg, thread_ptr->nodelist, 0))) {
-				error("_thread_per_group_rpc: "
-				      "no ret_list given");
-				goto cleanup;
-			}
-
-
-		} else {
-			if (!(ret_list = slurm_send_recv_msgs(
-				     thread_ptr->nodelist,
-				     &msg, 0, true))) {
-				error("_thread_per_group_rpc: "
-				      "no ret_list given");
-				goto cleanup;
-			}
-		}
-	} else {
-		if (thread_ptr->addr) {
-			//info("got the address");
-			msg.address = *thread_ptr->addr;
-		} else {
-			//info("no address given");
-			if (slurm_conf_get_addr(thread_ptr->nodelist,
-					       &msg.address) == SLURM_ERROR) {
-				error("_thread_per_group_rpc: "
-				      "can't find address for host %s, "
-				      "check slurm.conf",
-				      thread_ptr->nodelist);
-				goto cleanup;
-			}
-		}
-		//info("sending %u to %s", msg_type, thread_ptr->nodelist);
-		if (slurm_send_only_node_msg(&msg) == SLURM_SUCCESS) {
-			thread_state = DSH_DONE;
-		} else {
-			if (!srun_agent) {
-				lock_slurmctld(node_read_lock);
-				_comm_err(thread_ptr->nodelist, msg_type);
-				unlock_slurmctld(node_read_lock);
-			}
-		}
-		goto cleanup;
+	if (!thread_ptr->ret_list) {
+		error("%s: no ret_list given", __func__);
+		return thread_state;
 	}
 
-	//info("got %d messages back", list_count(ret_list));
-	itr = list_iterator_create(ret_list);
+	//info("got %d messages back", list_count(thread_ptr->ret_list));
+	itr = list_iterator_create(thread_ptr->ret_list);
 	while ((ret_data_info = list_next(itr)) != NULL) {
-		rc = slurm_get_return_code(ret_data_info->type,
-					   ret_data_info->data);
-		/* SPECIAL CASE: Record node's CPU load */
+		if (ret_data_info->type == RESPONSE_MESSAGE_COMPOSITE)
+			rc = _aggr_ret_list(agent_ptr, ret_data_info);
+		else
+			rc = slurm_get_return_code(ret_data_info->type,
+						   ret_data_info->data);
+		/* SPECIAL CASE: Record node's CPU load and energy use */
 		if (ret_data_info->type == RESPONSE_PING_SLURMD) {
 			ping_slurmd_resp_msg_t *ping_resp;
 			ping_resp = (ping_slurmd_resp_msg_t *)
@@ -944,6 +862,8 @@ static void *_thread_per_group_rpc(void *args)
 					ping_resp->cpu_load);
 			reset_node_free_mem(ret_data_info->node_name,
 					    ping_resp->free_mem);
+			reset_node_energy(ret_data_info->node_name,
+					  ping_resp->energy);
 			unlock_slurmctld(node_write_lock);
 		}
 		/* SPECIAL CASE: Mark node as IDLE if job already complete */
@@ -951,7 +871,7 @@ static void *_thread_per_group_rpc(void *args)
 		    (rc == ESLURMD_KILL_JOB_ALREADY_COMPLETE)) {
 			kill_job_msg_t *kill_job;
 			kill_job = (kill_job_msg_t *)
-				task_ptr->msg_args_ptr;
+				*agent_ptr->msg_args_pptr;
 			rc = SLURM_SUCCESS;
 			lock_slurmctld(job_write_lock);
 			if (job_epilog_complete(kill_job->job_id,
@@ -977,7 +897,7 @@ static void *_thread_per_group_rpc(void *args)
 		    (rc != ESLURM_DUPLICATE_JOB_ID) &&
 		    (ret_data_info->type != RESPONSE_FORWARD_FAILED)) {
 			batch_job_launch_msg_t *launch_msg_ptr =
-				task_ptr->msg_args_ptr;
+				*agent_ptr->msg_args_pptr;
 			uint32_t job_id = launch_msg_ptr->job_id;
 			info("Killing non-startable batch job %u: %s",
 			     job_id, slurm_strerror(rc));
@@ -1060,29 +980,699 @@ static void *_thread_per_group_rpc(void *args)
 	}
 	list_iterator_destroy(itr);
 
-cleanup:
-	xfree(args);
+	return thread_state;
+}
+
+/* RPCs sent to slurmd often enough for their connections to be worth
+ * keeping open, and for which slurmd releases the connection promptly */
+static bool _persist_conn_type(slurm_msg_type_t msg_type)
+{
+	switch (msg_type) {
+	case REQUEST_PING:
+	case REQUEST_NODE_REGISTRATION_STATUS:
+	case REQUEST_HEALTH_CHECK:
+	case REQUEST_ACCT_GATHER_UPDATE:
+	case REQUEST_TERMINATE_JOB:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_ABORT_JOB:
+	case REQUEST_SUSPEND_INT:
+	case REQUEST_MESSAGE_COMPOSITE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static const char *_pool_conn_id(void *item)
+{
+	pool_conn_t *pool_conn = (pool_conn_t *) item;
+
+	return pool_conn->name;
+}
+
+static void _pool_conn_free(void *item)
+{
+	pool_conn_t *pool_conn = (pool_conn_t *) item;
+
+	if (pool_conn->fd >= 0)
+		(void) close(pool_conn->fd);
+	xfree(pool_conn->name);
+	xfree(pool_conn);
+}
+
+/* Pooled connections are dropped well before slurmd closes them as idle */
+static bool _pool_conn_stale(pool_conn_t *pool_conn, time_t now)
+{
+	return (difftime(now, pool_conn->last_used) >=
+		(SLURM_KEEP_OPEN_IDLE / 2));
+}
+
+static void _pool_find_stale(void *item, void *arg)
+{
+	pool_conn_t *pool_conn = (pool_conn_t *) item;
+	List stale_list = (List) arg;
+
+	if (_pool_conn_stale(pool_conn, time(NULL)))
+		list_append(stale_list, pool_conn->name);
+}
+
+/* Close pooled connections unused for too long. Call with pool_mutex. */
+static void _pool_purge(void)
+{
+	List stale_list = list_create(NULL);
+	char *name;
+
+	xhash_walk(conn_pool, _pool_find_stale, stale_list);
+	while ((name = list_pop(stale_list)))
+		xhash_delete(conn_pool, name);
+	FREE_NULL_LIST(stale_list);
+}
+
+/* Take the idle connection to a node from the pool
+ * RET its file descriptor or -1 if there is none usable */
+static int _pool_get(char *name)
+{
+	pool_conn_t *pool_conn = NULL;
+	struct pollfd pfd;
+	int fd = -1;
+
+	slurm_mutex_lock(&pool_mutex);
+	if (conn_pool)
+		pool_conn = xhash_pop(conn_pool, name);
+	slurm_mutex_unlock(&pool_mutex);
+	if (!pool_conn)
+		return -1;
+
+	/* Nothing is sent on an idle connection, anything readable means
+	 * slurmd has closed it */
+	pfd.fd = pool_conn->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (!_pool_conn_stale(pool_conn, time(NULL)) &&
+	    (poll(&pfd, 1, 0) == 0)) {
+		fd = pool_conn->fd;
+		pool_conn->fd = -1;
+	}
+	_pool_conn_free(pool_conn);
+
+	return fd;
+}
+
+/* Park the connection to a node for reuse, replacing any other */
+static void _pool_put(char *name, int fd)
+{
+	pool_conn_t *pool_conn = xmalloc(sizeof(pool_conn_t)), *old_conn;
+	time_t now = time(NULL);
+
+	pool_conn->name = xstrdup(name);
+	pool_conn->fd = fd;
+	pool_conn->last_used = now;
+
+	slurm_mutex_lock(&pool_mutex);
+	if (!conn_pool) {
+		conn_pool = xhash_init(_pool_conn_id, _pool_conn_free,
+				       NULL, 0);
+		pool_purge_time = now;
+	}
+	if ((old_conn = xhash_pop(conn_pool, name)))
+		_pool_conn_free(old_conn);
+	xhash_add(conn_pool, pool_conn);
+	if (difftime(now, pool_purge_time) >= (SLURM_KEEP_OPEN_IDLE / 2)) {
+		_pool_purge();
+		pool_purge_time = now;
+	}
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+/* Close all pooled connections */
+static void _pool_fini(void)
+{
+	slurm_mutex_lock(&pool_mutex);
+	if (conn_pool)
+		xhash_free_ptr(&conn_pool);
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+/* Time in milliseconds used for connection deadlines */
+static uint64_t _msec_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((uint64_t) tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+/* Queue a connection for the nodes in hl, the first one is contacted
+ * directly and it forwards the message to the others */
+static void _queue_conn(thd_t *thread_ptr, hostlist_t hl, List pend_list)
+{
+	agent_conn_t *conn = xmalloc(sizeof(agent_conn_t));
+
+	conn->fd = -1;
+	conn->thread_ptr = thread_ptr;
+	conn->fwd_hl = hl;
+	thread_ptr->conn_cnt++;
+	list_enqueue(pend_list, conn);
+}
+
+/* Split the nodes in hl into branches of the forwarding tree, queueing
+ * one connection per branch. hl is empty on return. */
+static void _queue_tree(thd_t *thread_ptr, hostlist_t hl, List pend_list)
+{
+	hostlist_t *sp_hl;
+	int hl_count = 0, i;
+	char *name;
+
+	hostlist_uniq(hl);
+	if (route_g_split_hostlist(hl, &sp_hl, &hl_count, 0)) {
+		error("unable to split forward hostlist");
+		while ((name = hostlist_shift(hl))) {
+			mark_as_failed_forward(&thread_ptr->ret_list, name,
+					SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+			free(name);
+		}
+		return;
+	}
+	for (i = 0; i < hl_count; i++)
+		_queue_conn(thread_ptr, sp_hl[i], pend_list);
+	xfree(sp_hl);
+}
+
+/* Queue the connections required to send the RPC to one group of nodes */
+static void _queue_group(agent_info_t *agent_ptr, thd_t *thread_ptr,
+			 List pend_list)
+{
+	hostlist_t hl = hostlist_create(thread_ptr->nodelist);
 
-	/* handled at end of thread just in case resend is needed */
-	destroy_forward(&msg.forward);
-	slurm_mutex_lock(thread_mutex_ptr);
-	thread_ptr->ret_list = ret_list;
-	thread_ptr->state = thread_state;
+	thread_ptr->start_time = time(NULL);
+	thread_ptr->state = DSH_ACTIVE;
+	if (agent_ptr->get_reply && !thread_ptr->addr) {
+		_queue_tree(thread_ptr, hl, pend_list);
+		hostlist_destroy(hl);
+	} else
+		_queue_conn(thread_ptr, hl, pend_list);
+}
+
+/* All connections of a group have completed, record its final state.
+ * Responses are processed by _agent_complete(), outside of the poll loop. */
+static void _group_done(agent_info_t *agent_ptr, thd_t *thread_ptr)
+{
+	if (!agent_ptr->get_reply && (thread_ptr->state != DSH_DONE))
+		thread_ptr->state = DSH_NO_RESP;
 	thread_ptr->end_time = (time_t) difftime(time(NULL),
 						 thread_ptr->start_time);
-	/* Signal completion so another thread can replace us */
-	(*threads_active_ptr)--;
-	slurm_cond_signal(thread_cond_ptr);
-	slurm_mutex_unlock(thread_mutex_ptr);
-	return (void *) NULL;
+}
+
+static void _conn_release(agent_info_t *agent_ptr, agent_conn_t *conn)
+{
+	thd_t *thread_ptr = conn->thread_ptr;
+
+	if (conn->fd >= 0)
+		(void) close(conn->fd);
+	FREE_NULL_HOSTLIST(conn->fwd_hl);
+	free_buf(conn->buffer);
+	xfree(conn->resp);
+	xfree(conn->name);
+	xfree(conn);
+
+	if (--thread_ptr->conn_cnt == 0)
+		_group_done(agent_ptr, thread_ptr);
+}
+
+/* Record the failure of a connection. Nodes the message was to be forwarded
+ * to are tried again through new connections. */
+static void _conn_fail(agent_info_t *agent_ptr, agent_conn_t *conn, int err,
+		       List pend_list)
+{
+	thd_t *thread_ptr = conn->thread_ptr;
+
+	if (agent_ptr->get_reply) {
+		route_node_failed(conn->name);
+		mark_as_failed_forward(&thread_ptr->ret_list, conn->name, err);
+		if (hostlist_count(conn->fwd_hl))
+			_queue_tree(thread_ptr, conn->fwd_hl, pend_list);
+	} else if ((agent_ptr->msg_type != SRUN_PING)			&&
+		   (agent_ptr->msg_type != SRUN_EXEC)			&&
+		   (agent_ptr->msg_type != SRUN_JOB_COMPLETE)		&&
+		   (agent_ptr->msg_type != SRUN_STEP_MISSING)		&&
+		   (agent_ptr->msg_type != SRUN_STEP_SIGNAL)		&&
+		   (agent_ptr->msg_type != SRUN_TIMEOUT)		&&
+		   (agent_ptr->msg_type != SRUN_USER_MSG)		&&
+		   (agent_ptr->msg_type != RESPONSE_RESOURCE_ALLOCATION) &&
+		   (agent_ptr->msg_type != SRUN_NODE_FAIL)) {
+		/* Logged by _agent_complete() */
+		mark_as_failed_forward(&agent_ptr->comm_err_list, conn->name,
+				       err);
+	}
+	_conn_release(agent_ptr, conn);
+}
+
+/* Record the responses read from a connection. Nodes which the message
+ * should have been forwarded to, but which are missing from the responses,
+ * are tried again through new connections. */
+static void _conn_reply(agent_info_t *agent_ptr, agent_conn_t *conn,
+			List ret_list, List pend_list)
+{
+	thd_t *thread_ptr = conn->thread_ptr;
+	ListIterator itr;
+	ret_data_info_t *ret_data_info;
+	int ret_cnt = list_count(ret_list);
+
+	itr = list_iterator_create(ret_list);
+	while ((ret_data_info = list_next(itr))) {
+		if (!ret_data_info->node_name)
+			ret_data_info->node_name = xstrdup(conn->name);
+		else
+			hostlist_delete_host(conn->fwd_hl,
+					     ret_data_info->node_name);
+	}
+	list_iterator_destroy(itr);
+	route_note_responses(ret_list);
+
+	if (hostlist_count(conn->fwd_hl)) {
+		/* This is most common if a slurmd is running an older
+		 * version of Slurm than the originator of the message */
+		error("%s: %s failed to forward the message, expecting %d ret got only %d",
+		      __func__, conn->name, conn->fwd_cnt + 1, ret_cnt);
+		_queue_tree(thread_ptr, conn->fwd_hl, pend_list);
+	}
+
+	if (!thread_ptr->ret_list)
+		thread_ptr->ret_list = list_create(destroy_data_info);
+	list_transfer(thread_ptr->ret_list, ret_list);
+	FREE_NULL_LIST(ret_list);
+	_conn_release(agent_ptr, conn);
+}
+
+/* Pack the RPC for one connection, including its forwarding information */
+static Buf _conn_pack(agent_info_t *agent_ptr, agent_conn_t *conn)
+{
+	slurm_msg_t msg;
+	Buf buffer;
+
+	slurm_msg_t_init(&msg);
+	if (agent_ptr->protocol_version)
+		msg.protocol_version = agent_ptr->protocol_version;
+	msg.msg_type = agent_ptr->msg_type;
+	msg.data     = *agent_ptr->msg_args_pptr;
+	if (agent_ptr->persist_conn)
+		msg.flags |= SLURM_MSG_KEEP_OPEN;
+	if (agent_ptr->get_reply)
+		msg.forward.timeout = agent_ptr->msg_timeout;
+	if ((msg.forward.cnt = hostlist_count(conn->fwd_hl))) {
+		msg.forward.nodelist =
+			hostlist_ranged_string_xmalloc(conn->fwd_hl);
+		debug3("Tree sending to %s along with %s",
+		       conn->name, msg.forward.nodelist);
+	}
+	conn->fwd_cnt = msg.forward.cnt;
+
+	buffer = slurm_pack_node_msg(&msg);
+	xfree(msg.forward.nodelist);
+
+	return buffer;
+}
+
+/* Time allowed for the response, including that of forwarded messages,
+ * computed as done by slurm_send_recv_msgs() */
+static int _conn_recv_timeout(agent_info_t *agent_ptr, agent_conn_t *conn)
+{
+	int steps;
+
+	if (conn->fwd_cnt == 0)
+		return agent_ptr->msg_timeout;
+
+	steps = (conn->fwd_cnt + 1) / MAX(agent_ptr->tree_width, 1);
+	return (agent_ptr->msg_timeout * steps) +
+	       (agent_ptr->msg_timeout * (steps + 1));
+}
+
+/* Handle failure to connect, retrying if the connection was refused
+ * RET true if the connection is still in progress */
+static bool _conn_refused(agent_info_t *agent_ptr, agent_conn_t *conn,
+			  int err, uint64_t now, List pend_list)
+{
+	(void) close(conn->fd);
+	conn->fd = -1;
+
+	/* This connect retry logic permits Slurm hierarchical communications
+	 * to better survive slurmd restarts */
+	if ((err == ECONNREFUSED) && agent_ptr->get_reply &&
+	    (conn->retry_cnt < agent_ptr->conn_retry)) {
+		if (conn->retry_cnt++ == 0)
+			debug3("connect refused, retrying");
+		conn->state = CONN_WAIT;
+		conn->deadline = now + 1000;
+		return true;
+	}
+
+	errno = err;
+	debug3("%s: connect to %s: %m", __func__, conn->name);
+	_conn_fail(agent_ptr, conn, SLURM_COMMUNICATIONS_CONNECTION_ERROR,
+		   pend_list);
+	return false;
+}
+
+/* Begin a non-blocking connect to conn->addr
+ * RET true if the connection is still in progress */
+static bool _conn_connect(agent_info_t *agent_ptr, agent_conn_t *conn,
+			  uint64_t now, List pend_list)
+{
+	if (!conn->buffer && !(conn->buffer = _conn_pack(agent_ptr, conn))) {
+		_conn_fail(agent_ptr, conn, errno, pend_list);
+		return false;
+	}
+
+	if ((conn->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+		error("%s: socket: %m", __func__);
+		_conn_fail(agent_ptr, conn,
+			   SLURM_COMMUNICATIONS_CONNECTION_ERROR, pend_list);
+		return false;
+	}
+	fd_set_close_on_exec(conn->fd);
+	fd_set_nonblocking(conn->fd);
+	if (hostlist_count(conn->fwd_hl))
+		net_set_relay_keep_alive(conn->fd);
+
+	conn->io_off = 0;
+	conn->deadline = now + agent_ptr->msg_timeout;
+	if (connect(conn->fd, (struct sockaddr *) &conn->addr,
+		    sizeof(conn->addr)) == 0)
+		conn->state = CONN_SEND;
+	else if (errno == EINPROGRESS)
+		conn->state = CONN_CONNECT;
+	else
+		return _conn_refused(agent_ptr, conn, errno, now, pend_list);
+
+	return true;
+}
+
+/* Start a queued connection, picking the first node of its branch which
+ * has a known address.
+ * RET true if the connection is in progress */
+static bool _conn_start(agent_info_t *agent_ptr, agent_conn_t *conn,
+			uint64_t now, List pend_list)
+{
+	thd_t *thread_ptr = conn->thread_ptr;
+	char *name;
+
+	while (!conn->name) {
+		if (!(name = hostlist_shift(conn->fwd_hl))) {
+			_conn_release(agent_ptr, conn);
+			return false;
+		}
+		if (thread_ptr->addr) {
+			conn->addr = *thread_ptr->addr;
+		} else if (slurm_conf_get_addr(name, &conn->addr) ==
+			   SLURM_ERROR) {
+			error("%s: can't find address for host %s, "
+			      "check slurm.conf", __func__, name);
+			if (agent_ptr->get_reply) {
+				mark_as_failed_forward(&thread_ptr->ret_list,
+						       name,
+						       SLURM_UNKNOWN_FORWARD_ADDR);
+			}
+			free(name);
+			continue;
+		}
+		conn->name = xstrdup(name);
+		free(name);
+	}
+
+	if (agent_ptr->persist_conn &&
+	    ((conn->fd = _pool_get(conn->name)) >= 0)) {
+		if (!(conn->buffer = _conn_pack(agent_ptr, conn))) {
+			_conn_fail(agent_ptr, conn, errno, pend_list);
+			return false;
+		}
+		if (hostlist_count(conn->fwd_hl))
+			net_set_relay_keep_alive(conn->fd);
+		conn->reused = true;
+		conn->io_off = 0;
+		conn->deadline = now + agent_ptr->msg_timeout;
+		conn->state = CONN_SEND;
+		return true;
+	}
+
+	return _conn_connect(agent_ptr, conn, now, pend_list);
+}
+
+/* A connection taken from the pool failed before any response was read,
+ * most likely closed by slurmd meanwhile. Send the request again over a new
+ * connection.
+ * RET true if the connection is still in progress */
+static bool _conn_reconnect(agent_info_t *agent_ptr, agent_conn_t *conn,
+			    uint64_t now, List pend_list)
+{
+	debug3("%s: pooled connection to %s lost, reconnecting",
+	       __func__, conn->name);
+	(void) close(conn->fd);
+	conn->fd = -1;
+	conn->reused = false;
+	return _conn_connect(agent_ptr, conn, now, pend_list);
+}
+
+/* Write as much of the request as the socket will take
+ * RET true if the connection is still in progress */
+static bool _conn_send(agent_info_t *agent_ptr, agent_conn_t *conn,
+		       uint64_t now, List pend_list)
+{
+	uint32_t hdr = sizeof(conn->msg_len);
+	uint32_t size = get_buf_offset(conn->buffer);
+	struct iovec iov[2];
+	struct msghdr mh;
+	ssize_t len;
+
+	conn->msg_len = htonl(size);
+	while (conn->io_off < (hdr + size)) {
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		if (conn->io_off < hdr) {
+			iov[0].iov_base = (char *) &conn->msg_len +
+					  conn->io_off;
+			iov[0].iov_len  = hdr - conn->io_off;
+			iov[1].iov_base = get_buf_data(conn->buffer);
+			iov[1].iov_len  = size;
+			mh.msg_iovlen = 2;
+		} else {
+			iov[0].iov_base = get_buf_data(conn->buffer) +
+					  (conn->io_off - hdr);
+			iov[0].iov_len  = hdr + size - conn->io_off;
+			mh.msg_iovlen = 1;
+		}
+		len = sendmsg(conn->fd, &mh, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return true;
+			if (conn->reused)
+				return _conn_reconnect(agent_ptr, conn, now,
+						       pend_list);
+			debug3("%s: send to %s: %m", __func__, conn->name);
+			_conn_fail(agent_ptr, conn,
+				   SLURM_COMMUNICATIONS_SEND_ERROR, pend_list);
+			return false;
+		}
+		conn->io_off += len;
+	}
+
+	if (!agent_ptr->get_reply) {
+		conn->thread_ptr->state = DSH_DONE;
+		_conn_release(agent_ptr, conn);
+		return false;
+	}
+
+	if (!conn->reused) {	/* else kept in case of _conn_reconnect() */
+		free_buf(conn->buffer);
+		conn->buffer = NULL;
+	}
+	conn->state = CONN_RECV;
+	conn->io_off = 0;
+	conn->deadline = now + _conn_recv_timeout(agent_ptr, conn);
+	return true;
+}
+
+/* Read as much of the response as is available, processing it once complete
+ * RET true if the connection is still in progress */
+static bool _conn_recv(agent_info_t *agent_ptr, agent_conn_t *conn,
+		       uint64_t now, List pend_list)
+{
+	uint32_t hdr = sizeof(conn->msg_len), size = 0;
+	List ret_list;
+	char *ptr;
+	size_t want;
+	ssize_t len;
+
+	while (1) {
+		if (conn->io_off < hdr) {
+			ptr  = (char *) &conn->msg_len + conn->io_off;
+			want = hdr - conn->io_off;
+		} else {
+			size = ntohl(conn->msg_len);
+			if (!conn->resp) {
+				if ((size == 0) ||
+				    (size > SLURM_MAX_MSG_SIZE)) {
+					_conn_fail(agent_ptr, conn,
+					     SLURM_PROTOCOL_INSANE_MSG_LENGTH,
+					     pend_list);
+					return false;
+				}
+				conn->resp = xmalloc_nz(size);
+			}
+			if (conn->io_off == (hdr + size))
+				break;
+			ptr  = conn->resp + (conn->io_off - hdr);
+			want = hdr + size - conn->io_off;
+		}
+		len = read(conn->fd, ptr, want);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return true;
+		}
+		if ((len <= 0) && conn->reused && (conn->io_off == 0))
+			return _conn_reconnect(agent_ptr, conn, now,
+					       pend_list);
+		if (len <= 0) {
+			debug3("%s: receive from %s: %m", __func__,
+			       conn->name);
+			_conn_fail(agent_ptr, conn,
+				   SLURM_COMMUNICATIONS_RECEIVE_ERROR,
+				   pend_list);
+			return false;
+		}
+		conn->io_off += len;
+	}
+
+	ret_list = slurm_unpack_received_msgs(conn->fd,
+					      create_buf(conn->resp, size));
+	conn->resp = NULL;
+	if (!ret_list) {
+		_conn_fail(agent_ptr, conn, errno, pend_list);
+		return false;
+	}
+	if (agent_ptr->persist_conn) {
+		_pool_put(conn->name, conn->fd);
+		conn->fd = -1;
+	}
+	_conn_reply(agent_ptr, conn, ret_list, pend_list);
+	return false;
+}
+
+/* Progress a connection which poll() reported as ready
+ * RET true if the connection is still in progress */
+static bool _conn_io(agent_info_t *agent_ptr, agent_conn_t *conn,
+		     uint64_t now, List pend_list)
+{
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	switch (conn->state) {
+	case CONN_CONNECT:
+		if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+			err = errno;
+		if (err)
+			return _conn_refused(agent_ptr, conn, err, now,
+					     pend_list);
+		conn->state = CONN_SEND;
+		/* fall through */
+	case CONN_SEND:
+		return _conn_send(agent_ptr, conn, now, pend_list);
+	case CONN_RECV:
+		return _conn_recv(agent_ptr, conn, now, pend_list);
+	default:
+		return true;
+	}
+}
+
+/* Handle a connection whose deadline has passed
+ * RET true if the connection is still in progress */
+static bool _conn_timer(agent_info_t *agent_ptr, agent_conn_t *conn,
+			uint64_t now, List pend_list)
+{
+	if (conn->state == CONN_WAIT)
+		return _conn_connect(agent_ptr, conn, now, pend_list);
+
+	debug2("%s: RPC %s to %s timed out", __func__,
+	       rpc_num2string(agent_ptr->msg_type), conn->name);
+	_conn_fail(agent_ptr, conn, SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT,
+		   pend_list);
+	return false;
 }
 
 /*
- * Signal handler.  We are really interested in interrupting hung communictions
- * and causing them to return EINTR. Multiple interupts might be required.
+ * _agent_comm - issue the RPC to every group of nodes from this thread,
+ *	keeping up to AGENT_CONN_COUNT non-blocking connections outstanding
+ *	and applying each connection's deadline as it passes
+ * IN agent_ptr - pointer to agent_info_t with groups to send to, each has
+ *	its state and ret_list set on return
  */
-static void _sig_handler(int dummy)
+static void _agent_comm(agent_info_t *agent_ptr)
 {
+	agent_conn_t *conn[AGENT_CONN_COUNT], *new_conn;
+	struct pollfd pfd[AGENT_CONN_COUNT];
+	List pend_list = list_create(NULL);
+	int conn_cnt = 0, i, timeout;
+	uint64_t now, next;
+	bool active;
+
+	for (i = 0; i < agent_ptr->thread_count; i++)
+		_queue_group(agent_ptr, &agent_ptr->thread_struct[i],
+			     pend_list);
+
+	while (conn_cnt || list_count(pend_list)) {
+		now = _msec_now();
+		while ((conn_cnt < AGENT_CONN_COUNT) &&
+		       (new_conn = list_dequeue(pend_list))) {
+			if (_conn_start(agent_ptr, new_conn, now, pend_list))
+				conn[conn_cnt++] = new_conn;
+		}
+		if (!conn_cnt)
+			continue;
+
+		next = conn[0]->deadline;
+		for (i = 0; i < conn_cnt; i++) {
+			pfd[i].fd = conn[i]->fd;
+			pfd[i].revents = 0;
+			if (conn[i]->state == CONN_RECV)
+				pfd[i].events = POLLIN;
+			else if (conn[i]->state == CONN_WAIT)
+				pfd[i].fd = -1;	/* ignored by poll() */
+			else
+				pfd[i].events = POLLOUT;
+			next = MIN(next, conn[i]->deadline);
+		}
+		timeout = (next > now) ? (int) (next - now) : 0;
+		if ((poll(pfd, conn_cnt, timeout) < 0) && (errno != EINTR)) {
+			error("%s: poll: %m", __func__);
+			usleep(10000);
+			continue;
+		}
+
+		now = _msec_now();
+		for (i = 0; i < conn_cnt; ) {
+			if (pfd[i].revents)
+				active = _conn_io(agent_ptr, conn[i], now,
+						  pend_list);
+			else if (conn[i]->deadline <= now)
+				active = _conn_timer(agent_ptr, conn[i], now,
+						     pend_list);
+			else
+				active = true;
+			if (active) {
+				i++;
+				continue;
+			}
+			/* Replace with the last connection, not yet handled */
+			conn_cnt--;
+			conn[i] = conn[conn_cnt];
+			pfd[i]  = pfd[conn_cnt];
+		}
+	}
+	FREE_NULL_LIST(pend_list);
 }
 
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
@@ -1234,13 +1824,371 @@ static void _list_delete_retry(void *retry_entry)
 		return;
 
 	queued_req_ptr = (queued_request_t *) retry_entry;
-	_purge_agent_args(queued_req_ptr->agent_arg_ptr);
+	if (queued_req_ptr->part)
+		_aggr_part_unref(queued_req_ptr->part);
+	else
+		_purge_agent_args(queued_req_ptr->agent_arg_ptr);
 	xfree(queued_req_ptr);
 }
 
+/* Requests sent to a job's nodes which slurmd can process from a composite
+ * message, see _rpc_composite() in slurmd */
+static bool _aggr_msg_type(slurm_msg_type_t msg_type)
+{
+	switch (msg_type) {
+	case REQUEST_ABORT_JOB:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_SIGNAL_JOB:
+	case REQUEST_SIGNAL_TASKS:
+	case REQUEST_TERMINATE_JOB:
+	case REQUEST_TERMINATE_TASKS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Load the message collection window from MsgAggregationParams.
+ * Call with retry_mutex locked. */
+static void _aggr_config(void)
+{
+	static time_t config_update = 0;
+	char *params, *tmp_ptr;
+
+	if (config_update == slurmctld_conf.last_update)
+		return;
+	config_update = slurmctld_conf.last_update;
+
+	aggr_window_msgs = DEFAULT_MSG_AGGR_WINDOW_MSGS;
+	aggr_window_time = DEFAULT_MSG_AGGR_WINDOW_TIME;
+	params = slurm_get_msg_aggr_params();
+	if (params && (tmp_ptr = xstrcasestr(params, "WindowMsgs=")))
+		aggr_window_msgs = strtoull(tmp_ptr + 11, NULL, 10);
+	if (params && (tmp_ptr = xstrcasestr(params, "WindowTime=")))
+		aggr_window_time = strtoull(tmp_ptr + 11, NULL, 10);
+	xfree(params);
+}
+
+/* Hold a new request which may be bundled with others until its collection
+ * window expires. Call with retry_mutex locked. */
+static bool _aggr_defer(queued_request_t *queued_req_ptr, uint64_t now_msec)
+{
+	uint64_t expire;
+
+	if (!queued_req_ptr->aggr || (aggr_window_msgs <= 1))
+		return false;
+	expire = queued_req_ptr->queue_time + aggr_window_time;
+	if (now_msec >= expire)
+		return false;
+	if (!aggr_wake || (aggr_wake > expire))
+		aggr_wake = expire;
+	return true;
+}
+
+/* Share the request of a retry_list entry with the composite messages it
+ * is bundled into. Call with retry_mutex locked. */
+static aggr_part_t *_aggr_part(queued_request_t *queued_req_ptr)
+{
+	if (!queued_req_ptr->part) {
+		queued_req_ptr->part = xmalloc(sizeof(aggr_part_t));
+		queued_req_ptr->part->agent_arg_ptr =
+			queued_req_ptr->agent_arg_ptr;
+		queued_req_ptr->part->refcnt = 1;
+	}
+	return queued_req_ptr->part;
+}
+
+/* Drop a reference to a bundled request, freeing it with the last one */
+static void _aggr_part_unref(aggr_part_t *part)
+{
+	bool last;
+
+	slurm_mutex_lock(&aggr_mutex);
+	last = (--part->refcnt == 0);
+	slurm_mutex_unlock(&aggr_mutex);
+	if (last) {
+		_purge_agent_args(part->agent_arg_ptr);
+		xfree(part);
+	}
+}
+
+/* Free a request of a composite message, but not the data it shares with
+ * the other composite messages, see list.h */
+static void _aggr_msg_free(void *x)
+{
+	aggr_msg_t *aggr_msg = (aggr_msg_t *) x;
+
+	if (aggr_msg->msg.auth_cred)
+		(void) g_slurm_auth_destroy(aggr_msg->msg.auth_cred);
+	_aggr_part_unref(aggr_msg->part);
+	xfree(aggr_msg);
+}
+
+static void _aggr_add(composite_msg_t *comp_msg, aggr_part_t *part)
+{
+	aggr_msg_t *aggr_msg = xmalloc(sizeof(aggr_msg_t));
+	agent_arg_t *agent_arg_ptr = part->agent_arg_ptr;
+
+	slurm_msg_t_init(&aggr_msg->msg);
+	aggr_msg->msg.msg_type = agent_arg_ptr->msg_type;
+	if (agent_arg_ptr->protocol_version)
+		aggr_msg->msg.protocol_version =
+			agent_arg_ptr->protocol_version;
+	aggr_msg->msg.msg_index = list_count(comp_msg->msg_list) + 1;
+	aggr_msg->msg.data = agent_arg_ptr->msg_args;
+	slurm_mutex_lock(&aggr_mutex);
+	part->refcnt++;
+	slurm_mutex_unlock(&aggr_mutex);
+	aggr_msg->part = part;
+	list_append(comp_msg->msg_list, aggr_msg);
+}
+
+static void _aggr_group_free(void *x)
+{
+	aggr_group_t *group = (aggr_group_t *) x;
+
+	FREE_NULL_BITMAP(group->parts);
+	FREE_NULL_HOSTLIST(group->hl);
+	xfree(group);
+}
+
+static int _aggr_group_find(void *x, void *key)
+{
+	aggr_group_t *group = (aggr_group_t *) x;
+
+	return bit_equal(group->parts, (bitstr_t *) key);
+}
+
+/* RET true if any node of other_hl is in hl */
+static bool _aggr_overlap(hostlist_t hl, hostlist_t other_hl)
+{
+	hostlist_iterator_t hi = hostlist_iterator_create(other_hl);
+	char *name;
+	bool found = false;
+
+	while (!found && (name = hostlist_next(hi))) {
+		found = (hostlist_find(hl, name) != -1);
+		free(name);
+	}
+	hostlist_iterator_destroy(hi);
+	return found;
+}
+
+/*
+ * Bundle first_req, which has already been removed from the retry_list, with
+ * the new requests sharing some of its nodes. One REQUEST_MESSAGE_COMPOSITE
+ * is built for each set of first_req's nodes getting the same requests, and
+ * those nodes are removed from the other requests, which are issued to their
+ * remaining nodes later. Call with retry_mutex locked.
+ * OUT del_cnt - count of requests removed from the retry_list
+ * RET list of the agent_arg_t of the composite messages to issue in place of
+ *	first_req, or NULL to issue first_req as it is
+ */
+static List _aggr_bundle(queued_request_t *first_req, int *del_cnt)
+{
+	agent_arg_t *first_arg = first_req->agent_arg_ptr, *next_arg, *comp_arg;
+	queued_request_t *queued_req_ptr, **parts;
+	composite_msg_t *comp_msg;
+	aggr_group_t *group;
+	ListIterator iter;
+	List comp_list, group_list;
+	bitstr_t *node_parts;
+	char *name;
+	int i, part_cnt = 0, part_max;
+
+	*del_cnt = 0;
+	if (!first_req->aggr || (aggr_window_msgs <= 1))
+		return NULL;
+
+	part_max = MIN(aggr_window_msgs, list_count(retry_list) + 1);
+	parts = xmalloc(sizeof(queued_request_t *) * part_max);
+	parts[part_cnt++] = first_req;
+	iter = list_iterator_create(retry_list);
+	while ((part_cnt < part_max) && (queued_req_ptr = list_next(iter))) {
+		next_arg = queued_req_ptr->agent_arg_ptr;
+		if (queued_req_ptr->last_attempt || !queued_req_ptr->aggr ||
+		    (next_arg->protocol_version !=
+		     first_arg->protocol_version) ||
+		    !_aggr_overlap(first_arg->hostlist, next_arg->hostlist))
+			continue;
+		parts[part_cnt++] = queued_req_ptr;
+	}
+	list_iterator_destroy(iter);
+	if ((part_cnt == 1) && !first_req->part) {
+		xfree(parts);
+		return NULL;
+	}
+
+	/* Group first_req's nodes by the requests sent to them */
+	group_list = list_create(_aggr_group_free);
+	node_parts = bit_alloc(part_cnt);
+	while ((name = hostlist_shift(first_arg->hostlist))) {
+		bit_nclear(node_parts, 0, part_cnt - 1);
+		bit_set(node_parts, 0);
+		for (i = 1; i < part_cnt; i++) {
+			next_arg = parts[i]->agent_arg_ptr;
+			if (hostlist_delete_host(next_arg->hostlist, name) > 0)
+				bit_set(node_parts, i);
+		}
+		if (!(group = list_find_first(group_list, _aggr_group_find,
+					      node_parts))) {
+			group = xmalloc(sizeof(aggr_group_t));
+			group->parts = bit_copy(node_parts);
+			group->hl = hostlist_create(NULL);
+			list_append(group_list, group);
+		}
+		hostlist_push_host(group->hl, name);
+		free(name);
+	}
+	FREE_NULL_BITMAP(node_parts);
+	for (i = 0; i < part_cnt; i++) {
+		(void) _aggr_part(parts[i]);
+		next_arg = parts[i]->agent_arg_ptr;
+		next_arg->node_count = hostlist_count(next_arg->hostlist);
+	}
+
+	comp_list = list_create(NULL);
+	iter = list_iterator_create(group_list);
+	while ((group = list_next(iter))) {
+		comp_msg = xmalloc(sizeof(composite_msg_t));
+		comp_msg->msg_list = list_create(_aggr_msg_free);
+		comp_arg = xmalloc(sizeof(agent_arg_t));
+		comp_arg->hostlist = group->hl;
+		group->hl = NULL;
+		comp_arg->node_count = hostlist_count(comp_arg->hostlist);
+		comp_arg->protocol_version = first_arg->protocol_version;
+		comp_arg->msg_type = REQUEST_MESSAGE_COMPOSITE;
+		comp_arg->msg_args = comp_msg;
+		for (i = 0; i < part_cnt; i++) {
+			if (!bit_test(group->parts, i))
+				continue;
+			_aggr_add(comp_msg, parts[i]->part);
+			if (parts[i]->agent_arg_ptr->retry)
+				comp_arg->retry = 1;
+		}
+		debug2("agent: bundled %d requests for %u nodes",
+		       list_count(comp_msg->msg_list), comp_arg->node_count);
+		list_append(comp_list, comp_arg);
+	}
+	list_iterator_destroy(iter);
+	FREE_NULL_LIST(group_list);
+	xfree(parts);
+
+	/* Drop the requests sent to all of their nodes */
+	iter = list_iterator_create(retry_list);
+	while ((queued_req_ptr = list_next(iter))) {
+		if (queued_req_ptr->part &&
+		    !queued_req_ptr->agent_arg_ptr->node_count) {
+			list_delete_item(iter);
+			(*del_cnt)++;
+		}
+	}
+	list_iterator_destroy(iter);
+
+	return comp_list;
+}
+
+/* Sub-message credentials are created when the composite message is first
+ * packed, replace them on each attempt */
+static void _aggr_reset_auth(composite_msg_t *comp_msg)
+{
+	slurm_msg_t *msg;
+	ListIterator itr;
+
+	if (!comp_msg || !comp_msg->msg_list)
+		return;
+	itr = list_iterator_create(comp_msg->msg_list);
+	while ((msg = list_next(itr))) {
+		if (msg->auth_cred) {
+			(void) g_slurm_auth_destroy(msg->auth_cred);
+			msg->auth_cred = NULL;
+		}
+	}
+	list_iterator_destroy(itr);
+}
+
+static int _aggr_find_index(void *x, void *key)
+{
+	slurm_msg_t *msg = (slurm_msg_t *) x;
+
+	return (msg->msg_index == *(uint16_t *) key);
+}
+
+/*
+ * Process the return code of each request of a REQUEST_MESSAGE_COMPOSITE,
+ * reported by one node in a RESPONSE_MESSAGE_COMPOSITE, as it would be
+ * processed for the request on its own. Failures of a request are logged,
+ * they do not make the whole composite message be sent again.
+ * RET return code to process for the composite message
+ */
+static int _aggr_ret_list(agent_info_t *agent_ptr,
+			  ret_data_info_t *ret_data_info)
+{
+	composite_msg_t *comp_msg = *agent_ptr->msg_args_pptr;
+	composite_msg_t *resp_comp = ret_data_info->data;
+	slurm_msg_t *req, *resp;
+	ListIterator itr;
+	int rc, comp_rc = SLURM_SUCCESS;
+	/* Locks: Write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+
+	if (!comp_msg || !resp_comp || !resp_comp->msg_list)
+		return comp_rc;
+
+	itr = list_iterator_create(resp_comp->msg_list);
+	while ((resp = list_next(itr))) {
+		req = list_find_first(comp_msg->msg_list, _aggr_find_index,
+				      &resp->msg_index);
+		if (!req)
+			continue;
+		rc = slurm_get_return_code(resp->msg_type, resp->data);
+		switch (rc) {
+		case SLURM_SUCCESS:
+		case ESLURM_INVALID_JOB_ID:
+		case ESLURMD_JOB_NOTRUNNING:
+			break;
+		case ESLURMD_KILL_JOB_ALREADY_COMPLETE:
+			/* SPECIAL CASE: Mark node as IDLE */
+			if ((req->msg_type == REQUEST_KILL_TIMELIMIT) ||
+			    (req->msg_type == REQUEST_KILL_PREEMPTED) ||
+			    (req->msg_type == REQUEST_TERMINATE_JOB)) {
+				kill_job_msg_t *kill_job = req->data;
+				lock_slurmctld(job_write_lock);
+				if (job_epilog_complete(kill_job->job_id,
+							ret_data_info->
+							node_name,
+							SLURM_SUCCESS))
+					run_scheduler = true;
+				unlock_slurmctld(job_write_lock);
+			}
+			break;
+		case ESLURMD_EPILOG_FAILED:
+			comp_rc = rc;
+			break;
+		case ESRCH:
+			/* process is already dead, not a real error */
+			if ((req->msg_type == REQUEST_SIGNAL_TASKS) ||
+			    (req->msg_type == REQUEST_TERMINATE_TASKS))
+				break;
+			/* fall through */
+		default:
+			error("agent: %s to node %s failed: %s",
+			      rpc_num2string(req->msg_type),
+			      ret_data_info->node_name, slurm_strerror(rc));
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+
+	return comp_rc;
+}
+
 /*
  * agent_retry - Agent for retrying pending RPCs. One pending request is
- *	issued if it has been pending for at least min_wait seconds
+ *	issued if it has been pending for at least min_wait seconds, or the
+ *	composite messages it is bundled into with requests for its nodes
  * IN min_wait - Minimum wait time between re-issue of a pending RPC
  * IN mail_too - Send pending email too, note this performed using a
  *	fork/waitpid, so it can take longer than just creating a pthread
@@ -1249,11 +2197,12 @@ static void _list_delete_retry(void *retry_entry)
  */
 extern int agent_retry (int min_wait, bool mail_too)
 {
-	int list_size = 0, rc;
+	int del_cnt, list_size = 0, rc;
 	time_t now = time(NULL);
 	queued_request_t *queued_req_ptr = NULL;
 	agent_arg_t *agent_arg_ptr = NULL;
 	ListIterator retry_iter;
+	List comp_list = NULL;
 	pthread_t thread_mail = 0;
 	pthread_attr_t attr_mail;
 	mail_info_t *mi = NULL;
@@ -1285,7 +2234,7 @@ extern int agent_retry (int min_wait, bool mail_too)
 	}
 
 	slurm_mutex_lock(&agent_cnt_mutex);
-	if (agent_thread_cnt + AGENT_THREAD_COUNT + 2 > MAX_SERVER_THREADS) {
+	if (agent_thread_cnt + 1 > MAX_SERVER_THREADS) {
 		/* too much work already */
 		slurm_mutex_unlock(&agent_cnt_mutex);
 		slurm_mutex_unlock(&retry_mutex);
@@ -1295,7 +2244,9 @@ extern int agent_retry (int min_wait, bool mail_too)
 
 	if (retry_list) {
 		/* first try to find a new (never tried) record */
+		uint64_t now_msec = _msec_now();
 
+		_aggr_config();
 		retry_iter = list_iterator_create(retry_list);
 		while ((queued_req_ptr = (queued_request_t *)
 				list_next(retry_iter))) {
@@ -1311,15 +2262,23 @@ extern int agent_retry (int min_wait, bool mail_too)
 			if (rc > 0)
 				continue;
  			if (queued_req_ptr->last_attempt == 0) {
+				if (_aggr_defer(queued_req_ptr, now_msec))
+					continue;
 				list_remove(retry_iter);
 				list_size--;
 				break;
 			}
 		}
 		list_iterator_destroy(retry_iter);
+		if (queued_req_ptr &&
+		    (comp_list = _aggr_bundle(queued_req_ptr, &del_cnt))) {
+			list_size -= del_cnt;
+			_list_delete_retry(queued_req_ptr);
+			queued_req_ptr = NULL;
+		}
 	}
 
-	if (retry_list && (queued_req_ptr == NULL)) {
+	if (retry_list && (queued_req_ptr == NULL) && !comp_list) {
 		/* now try to find a requeue request that is
 		 * relatively old */
 		double age = 0;
@@ -1339,6 +2298,8 @@ extern int agent_retry (int min_wait, bool mail_too)
 			}
 			if (rc > 0)
 				continue;
+			if (queued_req_ptr->last_attempt == 0)
+				continue;	/* aggregation window open */
 			age = difftime(now, queued_req_ptr->last_attempt);
 			if (age > min_wait) {
 				list_remove(retry_iter);
@@ -1350,7 +2311,11 @@ extern int agent_retry (int min_wait, bool mail_too)
 	}
 	slurm_mutex_unlock(&retry_mutex);
 
-	if (queued_req_ptr) {
+	if (comp_list) {
+		while ((agent_arg_ptr = list_pop(comp_list)))
+			_spawn_retry_agent(agent_arg_ptr);
+		FREE_NULL_LIST(comp_list);
+	} else if (queued_req_ptr) {
 		agent_arg_ptr = queued_req_ptr->agent_arg_ptr;
 		xfree(queued_req_ptr);
 		if (agent_arg_ptr) {
@@ -1396,13 +2361,6 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 {
 	queued_request_t *queued_req_ptr = NULL;
 
-	if ((AGENT_THREAD_COUNT + 2) >= MAX_SERVER_THREADS)
-		fatal("AGENT_THREAD_COUNT value is too low relative to MAX_SERVER_THREADS");
-
-	if (message_timeout == (uint16_t) NO_VAL) {
-		message_timeout = MAX(slurm_get_msg_timeout(), 30);
-	}
-
 	if (agent_arg_ptr->msg_type == REQUEST_SHUTDOWN) {
 		/* execute now */
 		pthread_attr_t attr_agent;
@@ -1424,8 +2382,18 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 	queued_req_ptr = xmalloc(sizeof(queued_request_t));
 	queued_req_ptr->agent_arg_ptr = agent_arg_ptr;
 /*	queued_req_ptr->last_attempt  = 0; Implicit */
+	queued_req_ptr->queue_time = _msec_now();
 
 	slurm_mutex_lock(&retry_mutex);
+	_aggr_config();
+	if ((aggr_window_msgs > 1) && !agent_arg_ptr->addr &&
+	    _aggr_msg_type(agent_arg_ptr->msg_type) &&
+	    (!agent_arg_ptr->protocol_version ||
+	     (agent_arg_ptr->protocol_version >=
+	      SLURM_17_02_PROTOCOL_VERSION))) {
+		queued_req_ptr->aggr = true;
+		(void) _aggr_defer(queued_req_ptr, queued_req_ptr->queue_time);
+	}
 
 	if (retry_list == NULL) {
 		retry_list = list_create(_list_delete_retry);
@@ -1440,6 +2408,39 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 	agent_retry(999, false);
 }
 
+/*
+ * agent_aggr_retry - Issue queued requests whose message aggregation window
+ *	has expired
+ */
+extern void agent_aggr_retry(void)
+{
+	queued_request_t *queued_req_ptr;
+	ListIterator retry_iter;
+	uint64_t now_msec = _msec_now();
+	int cnt = 0;
+
+	slurm_mutex_lock(&retry_mutex);
+	if (!retry_list || !aggr_wake || (now_msec < aggr_wake)) {
+		slurm_mutex_unlock(&retry_mutex);
+		return;
+	}
+	aggr_wake = 0;
+	retry_iter = list_iterator_create(retry_list);
+	while ((queued_req_ptr = (queued_request_t *)
+			list_next(retry_iter))) {
+		if (queued_req_ptr->last_attempt || !queued_req_ptr->aggr)
+			continue;
+		if (!_aggr_defer(queued_req_ptr, now_msec))
+			cnt++;
+	}
+	list_iterator_destroy(retry_iter);
+	slurm_mutex_unlock(&retry_mutex);
+
+	/* each call issues at most one request, or one bundle of them */
+	while (cnt--)
+		agent_retry(RPC_RETRY_INTERVAL, false);
+}
+
 /* _spawn_retry_agent - pthread_create an agent for the given task */
 static void _spawn_retry_agent(agent_arg_t * agent_arg_ptr)
 {
@@ -1495,6 +2496,7 @@ void agent_purge(void)
 		FREE_NULL_LIST(mail_list);
 		slurm_mutex_unlock(&mail_mutex);
 	}
+	_pool_fini();
 }
 extern int get_agent_count(void)
 {
@@ -1545,6 +2547,8 @@ static void _purge_agent_args(agent_arg_t *agent_arg_ptr)
 			slurm_free_suspend_int_msg(agent_arg_ptr->msg_args);
 		else if (agent_arg_ptr->msg_type == REQUEST_LAUNCH_PROLOG)
 			slurm_free_prolog_launch_msg(agent_arg_ptr->msg_args);
+		else if (agent_arg_ptr->msg_type == REQUEST_MESSAGE_COMPOSITE)
+			slurm_free_composite_msg(agent_arg_ptr->msg_args);
 		else
 			xfree(agent_arg_ptr->msg_args);
 	}
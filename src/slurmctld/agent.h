@@ -44,7 +44,7 @@
 
 #include "src/slurmctld/slurmctld.h"
 
-#define AGENT_THREAD_COUNT	10	/* maximum active threads per agent */
+#define AGENT_CONN_COUNT	64	/* maximum connections per agent */
 #define COMMAND_TIMEOUT 	30	/* command requeue or error, seconds */
 
 #define LOTS_OF_AGENTS_CNT 50
@@ -91,6 +91,14 @@ extern void agent_queue_request(agent_arg_t *agent_arg_ptr);
  */
 extern int agent_retry (int min_wait, bool mail_too);
 
+/*
+ * agent_aggr_retry - Issue queued requests whose message aggregation window
+ *	has expired. Requests sent to a job's nodes are held for up to the
+ *	MsgAggregationParams WindowTime and bundled with others for the same
+ *	nodes into a composite message.
+ */
+extern void agent_aggr_retry(void);
+
 /* agent_purge - purge all pending RPC requests */
 extern void agent_purge (void);
 
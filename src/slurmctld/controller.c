@@ -46,6 +46,7 @@
 
 #include <errno.h>
 #include <grp.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
@@ -109,6 +110,7 @@
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
+#include "src/slurmctld/snapshot.h"
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/srun_comm.h"
 #include "src/slurmctld/state_save.h"
@@ -126,6 +128,32 @@
 				 * check-in before we ping them */
 #define SHUTDOWN_WAIT     2	/* Time to wait for backup server shutdown */
 
+#define RPC_IO_THREADS    4	/* Threads receiving and decoding RPCs */
+#define RPC_PRIO_BURST    8	/* Higher priority RPCs serviced before a
+				 * waiting lower priority RPC gets a turn */
+#define RPC_QUEUE_TYPES 100	/* RPC types tracked for queue depth */
+#define RPC_WORKER_IDLE  60	/* Seconds before an idle worker exits */
+
+/* RPC service classes, highest priority first */
+typedef enum {
+	RPC_PRIO_HIGH,		/* node state changes, job/step completion */
+	RPC_PRIO_NORMAL,	/* submissions, updates and everything else */
+	RPC_PRIO_LOW,		/* informational queries (squeue, sinfo, ...) */
+	RPC_PRIO_CNT
+} rpc_prio_t;
+
+/* A connection accepted by _slurmctld_rpc_mgr() awaiting its request */
+typedef struct {
+	connection_arg_t *conn_arg;
+	time_t accept_time;
+} rpc_pending_t;
+
+/* A received and decoded RPC awaiting a worker thread */
+typedef struct {
+	connection_arg_t *conn_arg;
+	slurm_msg_t *msg;
+} rpc_work_t;
+
 /**************************************************************************\
  * To test for memory leaks, set MEMORY_LEAK_DEBUG to 1 using
  * "configure --enable-memory-leak-debug" then execute
@@ -191,6 +219,24 @@ static char	node_name_long[MAX_SLURM_NAME];
 static int	recover   = DEFAULT_RECOVER;
 static pthread_mutex_t sched_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t server_thread_cond = PTHREAD_COND_INITIALIZER;
+
+/* RPC service pipeline state, protected by rpc_queue_mutex */
+static pthread_mutex_t rpc_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rpc_io_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t rpc_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t rpc_exit_cond = PTHREAD_COND_INITIALIZER;
+static List	rpc_io_list = NULL;
+static List	rpc_work_list[RPC_PRIO_CNT];
+static bool	rpc_queue_shutdown = false;
+static int	rpc_io_thread_cnt = 0;
+static int	rpc_worker_cnt = 0;
+static int	rpc_worker_idle = 0;
+static int	rpc_prio_streak = 0;
+static int	rpc_prio_turn = 0;	/* last class given a turn */
+static int	rpc_work_cnt = 0;	/* RPCs in rpc_work_list */
+static uint16_t	rpc_queue_type_id[RPC_QUEUE_TYPES];
+static uint32_t	rpc_queue_type_depth[RPC_QUEUE_TYPES];
+static uint32_t	rpc_queue_type_max[RPC_QUEUE_TYPES];
 static pid_t	slurmctld_pid;
 static char *	slurm_conf_filename;
 
@@ -222,7 +268,17 @@ static int          _init_tres(void);
 static void         _update_cluster_tres(void);
 
 inline static int   _report_locks_set(void);
-static void *       _service_connection(void *arg);
+static void         _rpc_dequeue_stats(uint16_t msg_type);
+static void         _rpc_enqueue_stats(uint16_t msg_type);
+static void *       _rpc_io_thread(void *no_data);
+static rpc_prio_t   _rpc_prio(uint16_t msg_type);
+static void         _rpc_queue_fini(void);
+static void         _rpc_queue_init(void);
+static void         _rpc_queue_work(connection_arg_t *conn_arg,
+				    slurm_msg_t *msg);
+static void *       _rpc_worker(void *no_data);
+static void         _service_connection(connection_arg_t *conn_arg,
+					slurm_msg_t *msg);
 static void         _set_work_dir(void);
 static int          _shutdown_backup_controller(int wait_time);
 static void *       _slurmctld_background(void *no_data);
@@ -235,7 +291,7 @@ static void	    _create_clustername_file(void);
 static void         _update_nice(void);
 inline static void  _usage(char *prog_name);
 static bool         _valid_controller(void);
-static bool         _wait_for_server_thread(void);
+static bool         _try_server_thread(void);
 
 /* main - slurmctld main function, start various threads and process RPCs */
 int main(int argc, char *argv[])
@@ -684,6 +740,7 @@ int main(int argc, char *argv[])
 	slurm_sched_fini();	/* Stop all scheduling */
 
 	/* Purge our local data structures */
+	job_queue_fini();
 	job_fini();
 	part_fini();	/* part_fini() must precede node_fini() */
 	node_fini();
@@ -697,6 +754,7 @@ int main(int argc, char *argv[])
 	xfree(dir_name);
 	reserve_port_config(NULL);
 	free_rpc_stats();
+	snapshot_fini();
 
 	/* Some plugins are needed to purge job/node data structures,
 	 * unplug after other data structures are purged */
@@ -917,7 +975,17 @@ static void _sig_handler(int signal)
 {
 }
 
-/* _slurmctld_rpc_mgr - Read incoming RPCs and create pthread for each */
+/*
+ * _slurmctld_rpc_mgr - Accept incoming connections and hand them to the
+ *	RPC service pipeline.
+ *
+ * Accepted connections are polled here until the client's request arrives,
+ * so idle or slow clients do not tie up a thread. Readable connections are
+ * queued for a small set of I/O threads which receive and decode the
+ * message, then queue it by priority class for a bounded pool of worker
+ * threads which process it with slurmctld_req(). Every accepted connection
+ * counts against max_server_threads until its RPC has been processed.
+ */
 static void *_slurmctld_rpc_mgr(void *no_data)
 {
 	int newsockfd;
@@ -925,11 +993,11 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	slurm_addr_t cli_addr, srv_addr;
 	uint16_t port;
 	char ip[32];
-	pthread_t thread_id_rpc_req;
-	pthread_attr_t thread_attr_rpc_req;
-	int no_thread;
-	int fd_next = 0, i, nports;
-	fd_set rfds;
+	int fd_next = 0, i, j, base, nports, nfds, pend_cnt = 0, timeout;
+	struct pollfd *pfds;
+	rpc_pending_t *pend;
+	bool throttled;
+	time_t now;
 	connection_arg_t *conn_arg = NULL;
 	/* Locks: Read config */
 	slurmctld_lock_t config_read_lock = {
@@ -947,12 +1015,6 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	(void) pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 	debug3("_slurmctld_rpc_mgr pid = %u", getpid());
 
-	/* threads to process individual RPC's are detached */
-	slurm_attr_init(&thread_attr_rpc_req);
-	if (pthread_attr_setdetachstate
-	    (&thread_attr_rpc_req, PTHREAD_CREATE_DETACHED))
-		fatal("pthread_attr_setdetachstate %m");
-
 	/* set node_addr to bind to (NULL means any) */
 	if (slurmctld_conf.backup_controller && slurmctld_conf.backup_addr &&
 	    ((xstrcmp(node_name_short,slurmctld_conf.backup_controller) == 0) ||
@@ -990,7 +1052,11 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	}
 	unlock_slurmctld(config_read_lock);
 
-	/* Prepare to catch SIGUSR1 to interrupt accept().
+	_rpc_queue_init();
+	pend = xmalloc(sizeof(rpc_pending_t) * max_server_threads);
+	pfds = xmalloc(sizeof(struct pollfd) * (nports + max_server_threads));
+
+	/* Prepare to catch SIGUSR1 to interrupt poll().
 	 * This signal is generated by the slurmctld signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
 	 * or SIGTERM. That thread does all processing of
@@ -1001,28 +1067,78 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while (_wait_for_server_thread()) {
-		int max_fd = -1;
-		FD_ZERO(&rfds);
-		for (i=0; i<nports; i++) {
-			FD_SET(sockfd[i], &rfds);
-			max_fd = MAX(sockfd[i], max_fd);
-		}
-		if (select(max_fd+1, &rfds, NULL, NULL, NULL) == -1) {
+	while (slurmctld_config.shutdown_time == 0) {
+		/* Stop accepting while at the thread limit, but keep
+		 * servicing connections which have already been accepted */
+		slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+		throttled = (slurmctld_config.server_thread_count >=
+			     max_server_threads);
+		slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+		nfds = 0;
+		if (!throttled) {
+			for (i = 0; i < nports; i++) {
+				pfds[nfds].fd = sockfd[i];
+				pfds[nfds].events = POLLIN;
+				pfds[nfds].revents = 0;
+				nfds++;
+			}
+		}
+		for (i = 0; i < pend_cnt; i++) {
+			pfds[nfds].fd = pend[i].conn_arg->newsockfd;
+			pfds[nfds].events = POLLIN;
+			pfds[nfds].revents = 0;
+			nfds++;
+		}
+		timeout = throttled ? 50 : 1000;
+		if (poll(pfds, nfds, timeout) == -1) {
 			if (errno != EINTR)
-				error("slurm_accept_msg_conn select: %m");
-			server_thread_decr();
+				error("%s: poll: %m", __func__);
 			continue;
 		}
+
+		/* Hand off connections whose request has arrived and
+		 * drop those which have not sent one within MessageTimeout */
+		now = time(NULL);
+		base = throttled ? 0 : nports;
+		for (i = 0, j = 0; i < pend_cnt; i++) {
+			if (pfds[base + i].revents) {
+				_rpc_queue_work(pend[i].conn_arg, NULL);
+				continue;
+			}
+			if (difftime(now, pend[i].accept_time) >
+			    slurmctld_conf.msg_timeout) {
+				char addr_buf[32];
+				slurm_print_slurm_addr(
+					&pend[i].conn_arg->cli_addr,
+					addr_buf, sizeof(addr_buf));
+				error("%s: no request from %s after %d seconds",
+				      __func__, addr_buf,
+				      slurmctld_conf.msg_timeout);
+				slurm_close(pend[i].conn_arg->newsockfd);
+				xfree(pend[i].conn_arg);
+				server_thread_decr();
+				continue;
+			}
+			pend[j++] = pend[i];
+		}
+		pend_cnt = j;
+		if (throttled)
+			continue;
+
 		/* find one to process */
-		for (i=0; i<nports; i++) {
-			if (FD_ISSET(sockfd[(fd_next+i) % nports], &rfds)) {
+		for (i = 0; i < nports; i++) {
+			if (pfds[(fd_next + i) % nports].revents) {
 				i = (fd_next + i) % nports;
 				break;
 			}
 		}
+		if (i >= nports)
+			continue;
 		fd_next = (i + 1) % nports;
 
+		if (!_try_server_thread())
+			continue;
 		/*
 		 * accept needed for stream implementation is a no-op in
 		 * message implementation that just passes sockfd to newsockfd
@@ -1049,126 +1165,445 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 			info("%s: accept() connection from %s", __func__, inetbuf);
 		}
 
-		if (slurmctld_config.shutdown_time)
-			no_thread = 1;
-		else if (pthread_create(&thread_id_rpc_req,
-					&thread_attr_rpc_req,
-					_service_connection,
-					(void *) conn_arg)) {
-			error("pthread_create: %m");
-			no_thread = 1;
-		} else
-			no_thread = 0;
-
-		if (no_thread) {
-			slurmctld_diag_stats.proc_req_raw++;
-		       	_service_connection((void *) conn_arg);
-	       	}
+		pend[pend_cnt].conn_arg = conn_arg;
+		pend[pend_cnt].accept_time = time(NULL);
+		pend_cnt++;
 	}
 
 	debug3("_slurmctld_rpc_mgr shutting down");
-	slurm_attr_destroy(&thread_attr_rpc_req);
+	/* Requests already accepted are still processed, as before */
+	for (i = 0; i < pend_cnt; i++)
+		_rpc_queue_work(pend[i].conn_arg, NULL);
+	_rpc_queue_fini();
 	for (i=0; i<nports; i++)
 		(void) slurm_shutdown_msg_engine(sockfd[i]);
 	xfree(sockfd);
+	xfree(pend);
+	xfree(pfds);
 	server_thread_decr();
 	pthread_exit((void *) 0);
 	return NULL;
 }
 
+/* Classify an RPC by the urgency with which it should be processed */
+static rpc_prio_t _rpc_prio(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case MESSAGE_NODE_REGISTRATION_STATUS:
+	case MESSAGE_EPILOG_COMPLETE:
+	case MESSAGE_COMPOSITE:
+	case REQUEST_COMPLETE_BATCH_SCRIPT:
+	case REQUEST_COMPLETE_JOB_ALLOCATION:
+	case REQUEST_COMPLETE_PROLOG:
+	case REQUEST_STEP_COMPLETE:
+	case REQUEST_STEP_COMPLETE_AGGR:
+	case REQUEST_CONTROL:
+	case REQUEST_SHUTDOWN:
+	case REQUEST_TAKEOVER:
+	case REQUEST_PING:
+		return RPC_PRIO_HIGH;
+	case REQUEST_BUILD_INFO:
+	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_INFO_SINGLE:
+	case REQUEST_JOB_USER_INFO:
+	case REQUEST_JOB_STEP_INFO:
+	case REQUEST_NODE_INFO:
+	case REQUEST_NODE_INFO_SINGLE:
+	case REQUEST_PARTITION_INFO:
+	case REQUEST_RESERVATION_INFO:
+	case REQUEST_FRONT_END_INFO:
+	case REQUEST_LICENSE_INFO:
+	case REQUEST_BURST_BUFFER_INFO:
+	case REQUEST_PRIORITY_FACTORS:
+	case REQUEST_SHARE_INFO:
+	case REQUEST_TRIGGER_GET:
+	case REQUEST_TOPO_INFO:
+	case REQUEST_POWERCAP_INFO:
+	case REQUEST_ASSOC_MGR_INFO:
+	case REQUEST_LAYOUT_INFO:
+	case REQUEST_FED_INFO:
+	case REQUEST_STATS_INFO:
+		return RPC_PRIO_LOW;
+	default:
+		return RPC_PRIO_NORMAL;
+	}
+}
+
+/* Create the RPC queues and start the I/O threads */
+static void _rpc_queue_init(void)
+{
+	pthread_attr_t thread_attr;
+	pthread_t thread_id;
+	int i;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	rpc_queue_shutdown = false;
+	if (!rpc_io_list) {
+		rpc_io_list = list_create(NULL);
+		for (i = 0; i < RPC_PRIO_CNT; i++)
+			rpc_work_list[i] = list_create(NULL);
+	}
+	slurm_attr_init(&thread_attr);
+	if (pthread_attr_setdetachstate(&thread_attr,
+					PTHREAD_CREATE_DETACHED))
+		fatal("pthread_attr_setdetachstate %m");
+	while (rpc_io_thread_cnt < RPC_IO_THREADS) {
+		if (pthread_create(&thread_id, &thread_attr,
+				   _rpc_io_thread, NULL)) {
+			error("pthread_create error %m");
+			if (rpc_io_thread_cnt)
+				break;
+			slurm_mutex_unlock(&rpc_queue_mutex);
+			sleep(1);
+			slurm_mutex_lock(&rpc_queue_mutex);
+			continue;
+		}
+		rpc_io_thread_cnt++;
+	}
+	slurm_attr_destroy(&thread_attr);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
 /*
- * _service_connection - service the RPC
- * IN/OUT arg - really just the connection's file descriptor, freed
- *	upon completion
- * RET - NULL
+ * Tell the I/O and worker threads to exit once all queued RPCs have been
+ * processed and wait (a bounded time) for them to do so.
+ */
+static void _rpc_queue_fini(void)
+{
+	struct timespec ts = {0, 0};
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	rpc_queue_shutdown = true;
+	slurm_cond_broadcast(&rpc_io_cond);
+	slurm_cond_broadcast(&rpc_work_cond);
+	ts.tv_sec = time(NULL) + CONTROL_TIMEOUT;
+	while (rpc_io_thread_cnt || rpc_worker_cnt) {
+		if (pthread_cond_timedwait(&rpc_exit_cond, &rpc_queue_mutex,
+					   &ts) == ETIMEDOUT) {
+			info("%s: %d RPC I/O and %d worker threads still active",
+			     __func__, rpc_io_thread_cnt, rpc_worker_cnt);
+			break;
+		}
+	}
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/*
+ * Queue an RPC for processing.
+ * IN conn_arg - accepted connection
+ * IN msg - decoded request, or NULL if the request has yet to be received,
+ *	in which case the connection is queued for an I/O thread
+ */
+static void _rpc_queue_work(connection_arg_t *conn_arg, slurm_msg_t *msg)
+{
+	pthread_attr_t thread_attr;
+	pthread_t thread_id;
+	rpc_work_t *work;
+	bool run_now = false;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	if (!msg) {
+		list_enqueue(rpc_io_list, conn_arg);
+		slurm_cond_signal(&rpc_io_cond);
+		slurm_mutex_unlock(&rpc_queue_mutex);
+		return;
+	}
+
+	/* Start another worker unless an idle one can take this RPC */
+	if ((rpc_work_cnt >= rpc_worker_idle) &&
+	    (rpc_worker_cnt < max_server_threads)) {
+		slurm_attr_init(&thread_attr);
+		if (pthread_attr_setdetachstate(&thread_attr,
+						PTHREAD_CREATE_DETACHED))
+			fatal("pthread_attr_setdetachstate %m");
+		if (pthread_create(&thread_id, &thread_attr, _rpc_worker,
+				   NULL)) {
+			error("pthread_create: %m");
+			/* Nobody to process it, do it ourselves */
+			if (rpc_worker_cnt == 0)
+				run_now = true;
+		} else
+			rpc_worker_cnt++;
+		slurm_attr_destroy(&thread_attr);
+	}
+	if (!run_now) {
+		work = xmalloc(sizeof(rpc_work_t));
+		work->conn_arg = conn_arg;
+		work->msg = msg;
+		list_enqueue(rpc_work_list[_rpc_prio(msg->msg_type)], work);
+		rpc_work_cnt++;
+		_rpc_enqueue_stats(msg->msg_type);
+		slurm_cond_signal(&rpc_work_cond);
+	}
+	slurm_mutex_unlock(&rpc_queue_mutex);
+
+	if (run_now) {
+		slurmctld_diag_stats.proc_req_raw++;
+		_service_connection(conn_arg, msg);
+	}
+}
+
+/*
+ * Remove the next RPC to process from the worker queues, favoring higher
+ * priority classes while never starving lower ones.
+ * NOTE: Caller must hold rpc_queue_mutex
  */
-static void *_service_connection(void *arg)
+static rpc_work_t *_rpc_dequeue(void)
 {
-	connection_arg_t *conn = (connection_arg_t *) arg;
-	void *return_code = NULL;
-	slurm_msg_t msg;
+	rpc_work_t *work;
+	int i, hi = -1, lo = -1;
+
+	for (i = 0; i < RPC_PRIO_CNT; i++) {
+		if (list_count(rpc_work_list[i]) == 0)
+			continue;
+		if (hi == -1)
+			hi = i;
+		else if (lo == -1)
+			lo = i;
+	}
+	if (hi == -1)
+		return NULL;
+
+	if ((lo != -1) && (rpc_prio_streak >= RPC_PRIO_BURST)) {
+		/* Give the waiting lower classes turns in rotation, so
+		 * RPC_PRIO_LOW is served even while HIGH and NORMAL are
+		 * both busy */
+		rpc_prio_streak = 0;
+		for (i = 0; i < RPC_PRIO_CNT; i++) {
+			rpc_prio_turn = (rpc_prio_turn + 1) % RPC_PRIO_CNT;
+			if ((rpc_prio_turn > hi) &&
+			    list_count(rpc_work_list[rpc_prio_turn]))
+				break;
+		}
+		hi = rpc_prio_turn;
+	} else if (lo != -1) {
+		rpc_prio_streak++;
+	} else
+		rpc_prio_streak = 0;
+
+	work = list_dequeue(rpc_work_list[hi]);
+	rpc_work_cnt--;
+	_rpc_dequeue_stats(work->msg->msg_type);
+	return work;
+}
+
+/* Receive and decode requests from connections with data available */
+static void *_rpc_io_thread(void *no_data)
+{
+	connection_arg_t *conn_arg;
+	slurm_msg_t *msg;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "rpcio", NULL, NULL, NULL) < 0) {
+		error("%s: cannot set my name to %s %m", __func__, "rpcio");
+	}
+#endif
+	while (1) {
+		slurm_mutex_lock(&rpc_queue_mutex);
+		while (!rpc_queue_shutdown &&
+		       (list_count(rpc_io_list) == 0))
+			slurm_cond_wait(&rpc_io_cond, &rpc_queue_mutex);
+		conn_arg = list_dequeue(rpc_io_list);
+		if (!conn_arg) {
+			rpc_io_thread_cnt--;
+			slurm_cond_broadcast(&rpc_exit_cond);
+			slurm_mutex_unlock(&rpc_queue_mutex);
+			break;
+		}
+		slurm_mutex_unlock(&rpc_queue_mutex);
+
+		msg = xmalloc(sizeof(slurm_msg_t));
+		slurm_msg_t_init(msg);
+		msg->flags |= SLURM_MSG_KEEP_BUFFER;
+		/*
+		 * slurm_receive_msg sets msg connection fd to accepted fd.
+		 * This allows possibility for slurmctld_req() to close
+		 * accepted connection. Large requests (e.g. batches of job
+		 * scripts) and slow links need the full MessageTimeout.
+		 */
+		if (slurm_receive_msg(conn_arg->newsockfd, msg, 0) != 0) {
+			char addr_buf[32];
+			slurm_print_slurm_addr(&conn_arg->cli_addr, addr_buf,
+					       sizeof(addr_buf));
+			error("slurm_receive_msg [%s]: %m", addr_buf);
+			/* close the new socket */
+			slurm_close(conn_arg->newsockfd);
+			slurm_free_msg(msg);
+			xfree(conn_arg);
+			server_thread_decr();
+			continue;
+		}
+
+		if (errno != SLURM_SUCCESS) {
+			if (errno == SLURM_PROTOCOL_VERSION_ERROR) {
+				slurm_send_rc_msg(msg,
+						  SLURM_PROTOCOL_VERSION_ERROR);
+			} else
+				info("_rpc_io_thread/slurm_receive_msg %m");
+			if (slurm_close(conn_arg->newsockfd) < 0)
+				error("close(%d): %m", conn_arg->newsockfd);
+			slurm_free_msg(msg);
+			xfree(conn_arg);
+			server_thread_decr();
+			continue;
+		}
+
+		_rpc_queue_work(conn_arg, msg);
+	}
+
+	return NULL;
+}
+
+/* Process queued RPCs, exit after RPC_WORKER_IDLE seconds without work */
+static void *_rpc_worker(void *no_data)
+{
+	rpc_work_t *work;
+	struct timespec ts = {0, 0};
+	int rc;
 
 #if HAVE_SYS_PRCTL_H
 	if (prctl(PR_SET_NAME, "srvcn", NULL, NULL, NULL) < 0) {
 		error("%s: cannot set my name to %s %m", __func__, "srvcn");
 	}
 #endif
-	slurm_msg_t_init(&msg);
-	msg.flags |= SLURM_MSG_KEEP_BUFFER;
-	/*
-	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
-	 * possibility for slurmctld_req() to close accepted connection.
-	 */
-	if (slurm_receive_msg(conn->newsockfd, &msg, 0) != 0) {
-		char addr_buf[32];
-		slurm_print_slurm_addr(&conn->cli_addr, addr_buf,
-				       sizeof(addr_buf));
-		error("slurm_receive_msg [%s]: %m", addr_buf);
-		/* close the new socket */
-		slurm_close(conn->newsockfd);
-		goto cleanup;
-	}
-
-	if (errno != SLURM_SUCCESS) {
-		if (errno == SLURM_PROTOCOL_VERSION_ERROR) {
-			slurm_send_rc_msg(&msg, SLURM_PROTOCOL_VERSION_ERROR);
-		} else
-			info("_service_connection/slurm_receive_msg %m");
-	} else {
-		/* process the request */
-		slurmctld_req(&msg, conn);
+	slurm_mutex_lock(&rpc_queue_mutex);
+	while (1) {
+		if ((work = _rpc_dequeue())) {
+			slurm_mutex_unlock(&rpc_queue_mutex);
+			_service_connection(work->conn_arg, work->msg);
+			xfree(work);
+			slurm_mutex_lock(&rpc_queue_mutex);
+			continue;
+		}
+		if (rpc_queue_shutdown)
+			break;
+
+		rpc_worker_idle++;
+		ts.tv_sec = time(NULL) + RPC_WORKER_IDLE;
+		rc = pthread_cond_timedwait(&rpc_work_cond, &rpc_queue_mutex,
+					    &ts);
+		rpc_worker_idle--;
+		if ((rc == ETIMEDOUT) && (rpc_work_cnt == 0))
+			break;
 	}
+	rpc_worker_cnt--;
+	slurm_cond_broadcast(&rpc_exit_cond);
+	slurm_mutex_unlock(&rpc_queue_mutex);
 
-	if ((conn->newsockfd >= 0) &&
-	    (slurm_close(conn->newsockfd) < 0))
-		error ("close(%d): %m",  conn->newsockfd);
+	return NULL;
+}
 
-cleanup:
-	slurm_free_msg_members(&msg);
-	xfree(arg);
+/*
+ * _service_connection - service the RPC
+ * IN conn_arg - the connection's file descriptor and address, freed
+ *	upon completion
+ * IN msg - the received request, freed upon completion
+ */
+static void _service_connection(connection_arg_t *conn_arg,
+				slurm_msg_t *msg)
+{
+	/* process the request */
+	slurmctld_req(msg, conn_arg);
+
+	if ((conn_arg->newsockfd >= 0) &&
+	    (slurm_close(conn_arg->newsockfd) < 0))
+		error ("close(%d): %m",  conn_arg->newsockfd);
+
+	slurm_free_msg(msg);
+	xfree(conn_arg);
 	server_thread_decr();
+}
+
+/* Find the queue depth slot for an RPC type, -1 if the table is full
+ * NOTE: Caller must hold rpc_queue_mutex */
+static int _rpc_queue_type_inx(uint16_t msg_type)
+{
+	int i;
+
+	for (i = 0; i < RPC_QUEUE_TYPES; i++) {
+		if (rpc_queue_type_id[i] == 0)
+			rpc_queue_type_id[i] = msg_type;
+		else if (rpc_queue_type_id[i] != msg_type)
+			continue;
+		return i;
+	}
+	return -1;
+}
+
+/* NOTE: Caller must hold rpc_queue_mutex */
+static void _rpc_enqueue_stats(uint16_t msg_type)
+{
+	int i = _rpc_queue_type_inx(msg_type);
+
+	if (i < 0)
+		return;
+	rpc_queue_type_depth[i]++;
+	if (rpc_queue_type_depth[i] > rpc_queue_type_max[i])
+		rpc_queue_type_max[i] = rpc_queue_type_depth[i];
+}
+
+/* NOTE: Caller must hold rpc_queue_mutex */
+static void _rpc_dequeue_stats(uint16_t msg_type)
+{
+	int i = _rpc_queue_type_inx(msg_type);
 
-	return return_code;
+	if ((i >= 0) && rpc_queue_type_depth[i])
+		rpc_queue_type_depth[i]--;
 }
 
-/* Increment slurmctld_config.server_thread_count and don't return
- * until its value is no larger than MAX_SERVER_THREADS,
- * RET true unless shutdown in progress */
-static bool _wait_for_server_thread(void)
+/* Pack the current and peak depth of the RPC queues by message type */
+extern void pack_rpc_queue_stats(Buf buffer)
+{
+	uint32_t i;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	for (i = 0; i < RPC_QUEUE_TYPES; i++) {
+		if (rpc_queue_type_id[i] == 0)
+			break;
+	}
+	pack32(i, buffer);
+	pack16_array(rpc_queue_type_id,    i, buffer);
+	pack32_array(rpc_queue_type_depth, i, buffer);
+	pack32_array(rpc_queue_type_max,   i, buffer);
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/* Reset the peak RPC queue depths to the current depths */
+extern void reset_rpc_queue_stats(void)
+{
+	int i;
+
+	slurm_mutex_lock(&rpc_queue_mutex);
+	for (i = 0; i < RPC_QUEUE_TYPES; i++)
+		rpc_queue_type_max[i] = rpc_queue_type_depth[i];
+	slurm_mutex_unlock(&rpc_queue_mutex);
+}
+
+/* Increment slurmctld_config.server_thread_count if its value is below
+ * max_server_threads. RET true if incremented, false if the limit has
+ * been reached or shutdown is in progress */
+static bool _try_server_thread(void)
 {
-	bool print_it = true;
 	bool rc = true;
 
 	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
-	while (1) {
-		if (slurmctld_config.shutdown_time) {
-			rc = false;
-			break;
-		}
-		if (slurmctld_config.server_thread_count < max_server_threads) {
-			slurmctld_config.server_thread_count++;
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("server_thread_count over "
-						"limit (%d), waiting",
-						slurmctld_config.
-						server_thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			slurm_cond_wait(&server_thread_cond,
-					&slurmctld_config.thread_count_lock);
+	if (slurmctld_config.shutdown_time) {
+		rc = false;
+	} else if (slurmctld_config.server_thread_count < max_server_threads) {
+		slurmctld_config.server_thread_count++;
+	} else {
+		/* just a delay and not an error.
+		 * This can happen when the epilog completes
+		 * on a bunch of nodes at the same time, which
+		 * can easily happen for highly parallel jobs. */
+		static time_t last_print_time = 0;
+		time_t now = time(NULL);
+		if (difftime(now, last_print_time) > 2) {
+			verbose("server_thread_count over limit (%d), waiting",
+				slurmctld_config.server_thread_count);
+			last_print_time = now;
 		}
+		rc = false;
 	}
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 	return rc;
@@ -1712,6 +2147,7 @@ static void *_slurmctld_background(void *no_data)
 		for (i = 0; ((i < 10) && (slurmctld_config.shutdown_time == 0));
 		     i++) {
 			usleep(100000);
+			agent_aggr_retry();
 		}
 
 		now = time(NULL);
@@ -67,6 +67,7 @@
 #include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/hostlist.h"
+#include "src/common/id_hash.h"
 #include "src/common/node_features.h"
 #include "src/common/node_select.h"
 #include "src/common/parse_time.h"
@@ -98,6 +99,7 @@
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
+#include "src/slurmctld/snapshot.h"
 #include "src/slurmctld/srun_comm.h"
 #include "src/slurmctld/state_save.h"
 #include "src/slurmctld/trigger_mgr.h"
@@ -109,16 +111,42 @@
 #define STEP_FLAG 0xbbbb
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 #define ONE_YEAR	(365 * 24 * 60 * 60)
+#define SLIPPED_RESEND	60	/* Seconds between delta resends of a pending
+				 * job whose expected start time has passed */
 
-#define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
-#define JOB_ARRAY_HASH_INX(_job_id, _task_id) \
-	((_job_id + _task_id) % hash_table_size)
+#define JOB_ARRAY_TASK_KEY(_job_id, _task_id) \
+	(((uint64_t) (_job_id) << 32) | (_task_id))
 
 /* No need to change we always pack SLURM_PROTOCOL_VERSION */
 #define JOB_STATE_VERSION       "PROTOCOL_VERSION"
 
 #define JOB_CKPT_VERSION      "PROTOCOL_VERSION"
 
+/*
+ * Between full checkpoints of job_state, the state of jobs reported through
+ * job_state_changed() is appended to job_state.journal, changes made without
+ * it are found by testing all jobs every JOB_JOURNAL_SWEEP seconds. Each
+ * journal record is framed by its length and checksum so a record torn by a
+ * crash ends the replay. The journal header holds the time stamp of the
+ * checkpoint it applies to.
+ */
+#define JOB_JOURNAL_JOB		1	/* Record holds the state of a job */
+#define JOB_JOURNAL_PURGE	2	/* Record removes a job */
+#define JOB_JOURNAL_MIN_SIZE	(4 * 1024 * 1024) /* Checkpoint when the
+						   * journal exceeds this and
+						   * the checkpoint size */
+#define JOB_JOURNAL_SWEEP	300	/* Seconds between tests of all jobs
+					 * for changes not reported through
+					 * job_state_changed() */
+
+/* Job records of the tasks of one job array, other than the META record of
+ * its pending tasks. Order is not preserved as records are removed. */
+typedef struct {
+	uint32_t task_cnt;
+	uint32_t task_size;
+	struct job_record **task_ptr;
+} job_array_tasks_t;
+
 typedef struct {
 	int resp_array_cnt;
 	int resp_array_size;
@@ -135,13 +163,23 @@ static int      bf_min_age_reserve = 0;
 static uint32_t delay_boot = 0;
 static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
-static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
-static struct   job_record **job_hash = NULL;
-static struct   job_record **job_array_hash_j = NULL;
-static struct   job_record **job_array_hash_t = NULL;
+static id_hash_t *job_hash = NULL;		/* job_record by job_id */
+static id_hash_t *job_array_hash_j = NULL;	/* job_array_tasks_t by
+						 * array_job_id */
+static id_hash_t *job_array_hash_t = NULL;	/* job_record by array_job_id
+						 * and array_task_id */
 static bool     kill_invalid_dep;
+static int      journal_fd = -1;	/* job_state.journal, -1 if the next
+					 * save must write a checkpoint */
+static uint32_t journal_size = 0;	/* bytes in job_state.journal */
+static uint32_t journal_ckpt_size = 0;	/* bytes in last checkpoint */
+static uint32_t *journal_purge = NULL;	/* IDs of jobs purged since save */
+static int      journal_purge_cnt = 0, journal_purge_size = 0;
+static uint32_t *journal_dirty = NULL;	/* IDs of jobs changed since save */
+static int      journal_dirty_cnt = 0, journal_dirty_size = 0;
+static time_t   journal_sweep_time = 0;	/* Time all jobs were tested */
 static time_t   last_file_write_time = (time_t) 0;
 static uint32_t max_array_size = NO_VAL;
 static bool	purge_quit = false;
@@ -193,18 +231,24 @@ static int  _list_find_job_id(void *job_entry, void *key);
 static int  _list_find_job_old(void *job_entry, void *key);
 static int  _load_job_details(struct job_record *job_ptr, Buf buffer,
 			      uint16_t protocol_version);
+static int  _load_job_journal(time_t ckpt_time, bool load_jobs);
 static int  _load_job_state(Buf buffer,	uint16_t protocol_version);
 static bitstr_t *_make_requeue_array(char *conf_buf);
 static uint32_t _max_switch_wait(uint32_t input_wait);
 static void _notify_srun_missing_step(struct job_record *job_ptr, int node_inx,
 				      time_t now, time_t node_boot_time);
 static int  _open_job_state_file(char **state_file);
+static void _pack_job(struct job_record *dump_job_ptr, uint16_t show_flags,
+		      uint32_t field_mask, Buf buffer,
+		      uint16_t protocol_version, uid_t uid,
+		      uint32_t *now_start, uint32_t *now_end);
 static void _pack_job_for_ckpt (struct job_record *job_ptr, Buf buffer);
 static void _pack_default_job_details(struct job_record *job_ptr,
-				      Buf buffer,
+				      uint32_t field_mask, Buf buffer,
 				      uint16_t protocol_version);
+static void _pack_field_str(char *str, bool send, Buf buffer);
 static void _pack_pending_job_details(struct job_details *detail_ptr,
-				      Buf buffer,
+				      uint32_t field_mask, Buf buffer,
 				      uint16_t protocol_version);
 static bool _parse_array_tok(char *tok, bitstr_t *array_bitmap, uint32_t max);
 static int  _purge_job_record(uint32_t job_id);
@@ -648,10 +692,268 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 	return qos_ptr;
 }
 
+/* Check that last state file was written at expected time.
+ * This is a check for two slurmctld daemons running at the same
+ * time in primary mode (a split-brain problem). */
+static void _check_state_write_time(void)
+{
+	time_t last_state_file_time = _get_last_state_write_time();
+
+	if (last_file_write_time && last_state_file_time &&
+	    (last_file_write_time != last_state_file_time)) {
+		error("Bad job state save file time. We wrote it at time %u, "
+		      "but the file contains a time stamp of %u.",
+		      (uint32_t) last_file_write_time,
+		      (uint32_t) last_state_file_time);
+		if (slurmctld_primary == 0) {
+			fatal("Two slurmctld daemons are running as primary. "
+			      "Shutting down this daemon to avoid inconsistent "
+			      "state due to split brain.");
+		}
+	}
+}
+
+/* RET a hash (FNV-1a) of len bytes of packed state */
+static uint64_t _state_hash(char *data, uint32_t len)
+{
+	unsigned char *ptr = (unsigned char *) data;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= ptr[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/* RET a hash of the data packed in buffer after offset */
+static uint64_t _job_state_hash(Buf buffer, uint32_t offset)
+{
+	return _state_hash(get_buf_data(buffer) + offset,
+			   get_buf_offset(buffer) - offset);
+}
+
+/* Fill in the length and checksum of a journal record started at offset */
+static void _journal_record_seal(Buf buffer, uint32_t offset)
+{
+	uint32_t end = get_buf_offset(buffer);
+	uint32_t body = offset + (2 * sizeof(uint32_t));
+	uint32_t check = (uint32_t) _job_state_hash(buffer, body);
+
+	set_buf_offset(buffer, offset);
+	pack32(end - body, buffer);
+	pack32(check, buffer);
+	set_buf_offset(buffer, end);
+}
+
+/* Start a journal record of the given type, RET its offset in buffer */
+static uint32_t _journal_record_start(uint16_t type, uint32_t job_id,
+				      Buf buffer)
+{
+	uint32_t offset = get_buf_offset(buffer);
+
+	pack32(0, buffer);		/* length, see _journal_record_seal() */
+	pack32(0, buffer);		/* checksum */
+	pack16(type, buffer);
+	pack32(job_id, buffer);
+	pack32(job_id_sequence, buffer);
+	return offset;
+}
+
+/* Note a job record being deleted for the next journal save */
+static void _journal_purge_add(uint32_t job_id)
+{
+	if (journal_purge_cnt >= journal_purge_size) {
+		journal_purge_size = MAX(64, journal_purge_size * 2);
+		xrealloc(journal_purge, sizeof(uint32_t) * journal_purge_size);
+	}
+	journal_purge[journal_purge_cnt++] = job_id;
+}
+
+/*
+ * job_state_changed - note that a job record changed so that the next
+ *	dump_all_job_state() journals it and the main scheduler re-tests it
+ * IN job_ptr - job which changed, job write lock must be held
+ */
+extern void job_state_changed(struct job_record *job_ptr)
+{
+	job_queue_update(job_ptr);
+
+	if (journal_dirty_cnt &&
+	    (journal_dirty[journal_dirty_cnt - 1] == job_ptr->job_id))
+		return;
+	if (journal_dirty_cnt >= MAX(1024, job_count)) {
+		journal_sweep_time = 0;	/* Test all jobs on next save */
+		return;
+	}
+	if (journal_dirty_cnt >= journal_dirty_size) {
+		journal_dirty_size = MAX(256, journal_dirty_size * 2);
+		xrealloc(journal_dirty, sizeof(uint32_t) * journal_dirty_size);
+	}
+	journal_dirty[journal_dirty_cnt++] = job_ptr->job_id;
+}
+
+static void _journal_close(void)
+{
+	if (journal_fd >= 0) {
+		(void) close(journal_fd);
+		journal_fd = -1;
+	}
+	journal_size = 0;
+}
+
+/* Write all of a buffer to a file, RET 0 or errno */
+static int _write_state_buf(int fd, Buf buffer, char *file_name)
+{
+	char *data = get_buf_data(buffer);
+	int pos = 0, nwrite = get_buf_offset(buffer), amount;
+
+	while (nwrite > 0) {
+		amount = write(fd, &data[pos], nwrite);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			error("Error writing file %s, %m", file_name);
+			return errno;
+		}
+		nwrite -= amount;
+		pos    += amount;
+	}
+	return 0;
+}
+
+/*
+ * Start an empty journal for the checkpoint written at ckpt_time
+ * NOTE: Call with lock_state_files()
+ */
+static void _journal_reset(time_t ckpt_time)
+{
+	char *journal_file;
+	Buf buffer;
+
+	_journal_close();
+	journal_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(journal_file, "/job_state.journal");
+	journal_fd = open(journal_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (journal_fd < 0) {
+		error("Can't save state, create file %s error %m",
+		      journal_file);
+		xfree(journal_file);
+		return;
+	}
+	fd_set_close_on_exec(journal_fd);
+
+	buffer = init_buf(BUF_SIZE);
+	packstr(JOB_STATE_VERSION, buffer);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(ckpt_time, buffer);
+	if (_write_state_buf(journal_fd, buffer, journal_file) ||
+	    fsync(journal_fd)) {
+		error("Can't initialize job state journal %s: %m",
+		      journal_file);
+		_journal_close();
+	} else
+		journal_size = get_buf_offset(buffer);
+	free_buf(buffer);
+	xfree(journal_file);
+}
+
+/* Add a job's state to the journal buffer if it changed since last saved,
+ * RET 1 if added, 0 otherwise */
+static int _journal_job_add(struct job_record *job_ptr, Buf buffer)
+{
+	uint32_t offset, state_offset;
+	uint64_t hash;
+
+	xassert (job_ptr->magic == JOB_MAGIC);
+	offset = _journal_record_start(JOB_JOURNAL_JOB, job_ptr->job_id,
+				       buffer);
+	state_offset = get_buf_offset(buffer);
+	_dump_job_state(job_ptr, buffer);
+	hash = _job_state_hash(buffer, state_offset);
+	if (hash == job_ptr->state_hash) {
+		set_buf_offset(buffer, offset);	/* unchanged */
+		return 0;
+	}
+	job_ptr->state_hash = hash;
+	_journal_record_seal(buffer, offset);
+	return 1;
+}
+
+/*
+ * Append the state of jobs which changed since the last save to the journal
+ * RET 0 or error code
+ */
+static int _dump_job_journal(void)
+{
+	/* Locks: Read config and job */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	int error_code = SLURM_SUCCESS, i, rec_cnt = 0;
+	Buf buffer = init_buf(BUF_SIZE);
+	time_t now = time(NULL);
+	DEF_TIMERS;
+
+	START_TIMER;
+	_check_state_write_time();
+	lock_slurmctld(job_read_lock);
+	/* Purges go first, a job ID purged and then reused within the
+	 * interval must be removed before its new job is recreated */
+	for (i = 0; i < journal_purge_cnt; i++) {
+		uint32_t offset = _journal_record_start(JOB_JOURNAL_PURGE,
+							journal_purge[i],
+							buffer);
+		_journal_record_seal(buffer, offset);
+		rec_cnt++;
+	}
+	journal_purge_cnt = 0;
+	if (difftime(now, journal_sweep_time) >= JOB_JOURNAL_SWEEP) {
+		journal_sweep_time = now;
+		job_iterator = list_iterator_create(job_list);
+		while ((job_ptr = (struct job_record *)
+				  list_next(job_iterator))) {
+			rec_cnt += _journal_job_add(job_ptr, buffer);
+		}
+		list_iterator_destroy(job_iterator);
+	} else {
+		for (i = 0; i < journal_dirty_cnt; i++) {
+			if ((job_ptr = find_job_record(journal_dirty[i])))
+				rec_cnt += _journal_job_add(job_ptr, buffer);
+		}
+	}
+	journal_dirty_cnt = 0;
+	unlock_slurmctld(job_read_lock);
+
+	if (rec_cnt) {
+		lock_state_files();
+		if ((error_code = _write_state_buf(journal_fd, buffer,
+						   "job_state.journal")) ||
+		    (fsync(journal_fd) && (error_code = errno))) {
+			error("Job state journal write failed, writing a "
+			      "checkpoint on next save: %m");
+			_journal_close();
+		} else
+			journal_size += get_buf_offset(buffer);
+		unlock_state_files();
+	}
+
+	free_buf(buffer);
+	END_TIMER2("dump_all_job_state");
+	debug3("Saved state of %d changed or purged jobs in %s",
+	       rec_cnt, TIME_STR);
+	return error_code;
+}
+
 /*
  * dump_all_job_state - save the state of all jobs to file for checkpoint
  *	Changes here should be reflected in load_last_job_id() and
  *	load_all_job_state().
+ *	Jobs which changed since the last save are normally appended to the
+ *	journal, the whole job_state file is written when the journal grows
+ *	larger than it or at shutdown.
  * RET 0 or error code */
 int dump_all_job_state(void)
 {
@@ -665,28 +967,18 @@ int dump_all_job_state(void)
 		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
-	Buf buffer = init_buf(high_buffer_size);
+	Buf buffer;
+	uint32_t offset;
 	time_t now = time(NULL);
-	time_t last_state_file_time;
 	DEF_TIMERS;
 
+	if ((journal_fd >= 0) && !slurmctld_config.shutdown_time &&
+	    (journal_size <= MAX(journal_ckpt_size, JOB_JOURNAL_MIN_SIZE)))
+		return _dump_job_journal();
+
 	START_TIMER;
-	/* Check that last state file was written at expected time.
-	 * This is a check for two slurmctld daemons running at the same
-	 * time in primary mode (a split-brain problem). */
-	last_state_file_time = _get_last_state_write_time();
-	if (last_file_write_time && last_state_file_time &&
-	    (last_file_write_time != last_state_file_time)) {
-		error("Bad job state save file time. We wrote it at time %u, "
-		      "but the file contains a time stamp of %u.",
-		      (uint32_t) last_file_write_time,
-		      (uint32_t) last_state_file_time);
-		if (slurmctld_primary == 0) {
-			fatal("Two slurmctld daemons are running as primary. "
-			      "Shutting down this daemon to avoid inconsistent "
-			      "state due to split brain.");
-		}
-	}
+	buffer = init_buf(high_buffer_size);
+	_check_state_write_time();
 
 	/* write header: version, time */
 	packstr(JOB_STATE_VERSION, buffer);
@@ -708,9 +1000,14 @@ int dump_all_job_state(void)
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
+		offset = get_buf_offset(buffer);
 		_dump_job_state(job_ptr, buffer);
+		job_ptr->state_hash = _job_state_hash(buffer, offset);
 	}
 	list_iterator_destroy(job_iterator);
+	journal_purge_cnt = 0;
+	journal_dirty_cnt = 0;
+	journal_sweep_time = now;
 
 	/* write the buffer to file */
 	old_file = xstrdup(slurmctld_conf.state_save_location);
@@ -743,31 +1040,20 @@ int dump_all_job_state(void)
 		      new_file);
 		error_code = errno;
 	} else {
-		int pos = 0, nwrite, amount, rc;
-		char *data;
+		int rc;
 
 		fd_set_close_on_exec(log_fd);
-		nwrite = get_buf_offset(buffer);
-		data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-
+		high_buffer_size = MAX(get_buf_offset(buffer),
+				       high_buffer_size);
+		error_code = _write_state_buf(log_fd, buffer, new_file);
 		rc = fsync_and_close(log_fd, "job");
 		if (rc && !error_code)
 			error_code = rc;
 	}
-	if (error_code)
+	if (error_code) {
 		(void) unlink(new_file);
-	else {			/* file shuffle */
+		_journal_close();	/* job state_hash values are stale */
+	} else {			/* file shuffle */
 		(void) unlink(old_file);
 		if (link(reg_file, old_file))
 			debug4("unable to create link for %s -> %s: %m",
@@ -778,6 +1064,8 @@ int dump_all_job_state(void)
 			       new_file, reg_file);
 		(void) unlink(new_file);
 		last_file_write_time = now;
+		journal_ckpt_size = get_buf_offset(buffer);
+		_journal_reset(now);
 	}
 	xfree(old_file);
 	xfree(reg_file);
@@ -823,6 +1111,7 @@ static int _open_job_state_file(char **state_file)
 extern void backup_slurmctld_restart(void)
 {
 	last_file_write_time = (time_t) 0;
+	_journal_close();	/* write a checkpoint on next save */
 }
 
 /* Return the time stamp in the current job state save file */
@@ -965,6 +1254,8 @@ extern int load_all_job_state(void)
 			goto unpack_error;
 		job_cnt++;
 	}
+	if (_load_job_journal(buf_time, true))
+		job_cnt = list_count(job_list);
 	assoc_mgr_unlock(&locks);
 	debug3("Set job_id_sequence to %u", job_id_sequence);
 
@@ -980,6 +1271,112 @@ unpack_error:
 	return SLURM_FAILURE;
 }
 
+/*
+ * Replay the job state journal written after the checkpoint of ckpt_time
+ * IN load_jobs - apply job records, otherwise only recover job_id_sequence
+ * RET count of records applied
+ * NOTE: Call with the assoc_mgr locks of load_all_job_state() if load_jobs
+ */
+static int _load_job_journal(time_t ckpt_time, bool load_jobs)
+{
+	int data_allocated, data_read = 0, journal_fd, rec_cnt = 0;
+	uint32_t data_size = 0, rec_len, rec_check, rec_end, job_id, seq;
+	uint16_t rec_type, protocol_version = (uint16_t) NO_VAL;
+	char *data = NULL, *journal_file, *ver_str = NULL;
+	uint32_t ver_str_len;
+	time_t buf_time = (time_t) 0;
+	Buf buffer;
+
+	journal_file = slurm_get_state_save_location();
+	xstrcat(journal_file, "/job_state.journal");
+	lock_state_files();
+	journal_fd = open(journal_file, O_RDONLY);
+	if (journal_fd < 0) {
+		debug("No job state journal file (%s) to recover",
+		      journal_file);
+	} else {
+		data_allocated = BUF_SIZE;
+		data = xmalloc(data_allocated);
+		while (1) {
+			data_read = read(journal_fd, &data[data_size],
+					 BUF_SIZE);
+			if (data_read < 0) {
+				if (errno == EINTR)
+					continue;
+				else {
+					error("Read error on %s: %m",
+					      journal_file);
+					break;
+				}
+			} else if (data_read == 0)	/* eof */
+				break;
+			data_size      += data_read;
+			data_allocated += data_read;
+			xrealloc(data, data_allocated);
+		}
+		close(journal_fd);
+	}
+	xfree(journal_file);
+	unlock_state_files();
+	if (!data)
+		return 0;
+
+	buffer = create_buf(data, data_size);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	if (ver_str && !xstrcmp(ver_str, JOB_STATE_VERSION))
+		safe_unpack16(&protocol_version, buffer);
+	xfree(ver_str);
+	safe_unpack_time(&buf_time, buffer);
+	if ((protocol_version == (uint16_t) NO_VAL) ||
+	    (buf_time != ckpt_time)) {
+		debug("Job state journal does not match job state file, "
+		      "ignoring it");
+		free_buf(buffer);
+		return 0;
+	}
+
+	while (remaining_buf(buffer) >= (2 * sizeof(uint32_t))) {
+		safe_unpack32(&rec_len, buffer);
+		safe_unpack32(&rec_check, buffer);
+		rec_end = get_buf_offset(buffer) + rec_len;
+		if ((rec_len > remaining_buf(buffer)) ||
+		    ((uint32_t) _state_hash(get_buf_data(buffer) +
+					    get_buf_offset(buffer), rec_len) !=
+		     rec_check)) {
+			error("Job state journal truncated after %d records",
+			      rec_cnt);
+			break;
+		}
+		safe_unpack16(&rec_type, buffer);
+		safe_unpack32(&job_id, buffer);
+		safe_unpack32(&seq, buffer);
+		if (seq <= slurmctld_conf.max_job_id)
+			job_id_sequence = MAX(seq, job_id_sequence);
+		if (!load_jobs) {
+			set_buf_offset(buffer, rec_end);
+			continue;
+		}
+		if (find_job_record(job_id))
+			(void) _purge_job_record(job_id);
+		if ((rec_type == JOB_JOURNAL_JOB) &&
+		    (_load_job_state(buffer, protocol_version) !=
+		     SLURM_SUCCESS))
+			error("Job state journal record for job %u invalid",
+			      job_id);
+		set_buf_offset(buffer, rec_end);
+		rec_cnt++;
+	}
+	if (load_jobs)
+		info("Recovered %d job state journal records", rec_cnt);
+	free_buf(buffer);
+	return rec_cnt;
+
+unpack_error:
+	error("Incomplete job state journal file");
+	free_buf(buffer);
+	return rec_cnt;
+}
+
 /*
  * load_last_job_id - load only the last job ID from state save file.
  *	Changes here should be reflected in load_all_job_state().
@@ -1052,7 +1449,9 @@ extern int load_last_job_id( void )
 	safe_unpack32( &job_id_sequence, buffer);
 	debug3("Job ID in job_state header is %u", job_id_sequence);
 
-	/* Ignore the state for individual jobs stored here */
+	/* Ignore the state for individual jobs stored here and in the
+	 * journal, other than job IDs assigned since the checkpoint */
+	(void) _load_job_journal(buf_time, false);
 
 	free_buf(buffer);
 	return error_code;
@@ -2657,11 +3056,8 @@ unpack_error:
  */
 static void _add_job_hash(struct job_record *job_ptr)
 {
-	int inx;
-
-	inx = JOB_HASH_INX(job_ptr->job_id);
-	job_ptr->job_next = job_hash[inx];
-	job_hash[inx] = job_ptr;
+	id_hash_add(job_hash, job_ptr->job_id, job_ptr);
+	job_state_changed(job_ptr);
 }
 
 /* _remove_job_hash - remove a job hash entry for given job record, job_id must
@@ -2671,19 +3067,8 @@ static void _add_job_hash(struct job_record *job_ptr)
  */
 static void _remove_job_hash(struct job_record *job_entry)
 {
-	struct job_record *job_ptr, **job_pptr;
-
-	job_pptr = &job_hash[JOB_HASH_INX(job_entry->job_id)];
-	while ((job_pptr != NULL) &&
-	       ((job_ptr = *job_pptr) != job_entry)) {
-		job_pptr = &job_ptr->job_next;
-	}
-	if (job_pptr == NULL) {
+	if (!id_hash_remove(job_hash, job_entry->job_id, job_entry))
 		fatal("job hash error");
-		return; /* Fix CLANG false positive error */
-	}
-	*job_pptr = job_entry->job_next;
-	job_entry->job_next = NULL;
 }
 
 /* _add_job_array_hash - add a job hash entry for given job record,
@@ -2693,18 +3078,72 @@ static void _remove_job_hash(struct job_record *job_entry)
  */
 void _add_job_array_hash(struct job_record *job_ptr)
 {
-	int inx;
+	job_array_tasks_t *tasks;
 
 	if (job_ptr->array_task_id == NO_VAL)
 		return;	/* Not a job array */
 
-	inx = JOB_HASH_INX(job_ptr->array_job_id);
-	job_ptr->job_array_next_j = job_array_hash_j[inx];
-	job_array_hash_j[inx] = job_ptr;
+	tasks = id_hash_find(job_array_hash_j, job_ptr->array_job_id);
+	if (!tasks) {
+		tasks = xmalloc(sizeof(job_array_tasks_t));
+		id_hash_add(job_array_hash_j, job_ptr->array_job_id, tasks);
+	}
+	if (tasks->task_cnt >= tasks->task_size) {
+		tasks->task_size = MAX(16, tasks->task_size * 2);
+		xrealloc(tasks->task_ptr,
+			 sizeof(struct job_record *) * tasks->task_size);
+	}
+	job_ptr->array_task_inx = tasks->task_cnt;
+	tasks->task_ptr[tasks->task_cnt++] = job_ptr;
+
+	id_hash_add(job_array_hash_t,
+		    JOB_ARRAY_TASK_KEY(job_ptr->array_job_id,
+				       job_ptr->array_task_id), job_ptr);
+}
+
+/* _remove_job_array_hash - remove the job array hash entries for given job
+ *	record, if any
+ * IN job_ptr - pointer to job record
+ * Globals: hash table updated
+ */
+static void _remove_job_array_hash(struct job_record *job_ptr)
+{
+	job_array_tasks_t *tasks;
+	uint32_t inx = job_ptr->array_task_inx;
+
+	if (job_ptr->array_task_id == NO_VAL)
+		return;	/* Not a job array */
+
+	tasks = id_hash_find(job_array_hash_j, job_ptr->array_job_id);
+	if (!tasks || (inx >= tasks->task_cnt) ||
+	    (tasks->task_ptr[inx] != job_ptr)) {
+		error("job array hash error");
+	} else {
+		/* Move the last record into the hole */
+		tasks->task_cnt--;
+		if (inx < tasks->task_cnt) {
+			tasks->task_ptr[inx] = tasks->task_ptr[tasks->task_cnt];
+			tasks->task_ptr[inx]->array_task_inx = inx;
+		}
+		if (tasks->task_cnt == 0) {
+			id_hash_remove(job_array_hash_j, job_ptr->array_job_id,
+				       tasks);
+			xfree(tasks->task_ptr);
+			xfree(tasks);
+		}
+	}
 
-	inx = JOB_ARRAY_HASH_INX(job_ptr->array_job_id,job_ptr->array_task_id);
-	job_ptr->job_array_next_t = job_array_hash_t[inx];
-	job_array_hash_t[inx] = job_ptr;
+	if (!id_hash_remove(job_array_hash_t,
+			    JOB_ARRAY_TASK_KEY(job_ptr->array_job_id,
+					       job_ptr->array_task_id),
+			    job_ptr))
+		error("job array, task ID hash error");
+}
+
+/* Return the job records of tasks of a job array or NULL if none */
+static job_array_tasks_t *_job_array_tasks(uint32_t array_job_id)
+{
+	return id_hash_find(job_array_hash_j, array_job_id);
 }
 
 /* For the job array data structure, build the string representation of the
@@ -2747,7 +3186,8 @@ extern void build_array_str(struct job_record *job_ptr)
 extern bool test_job_array_complete(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
+	job_array_tasks_t *tasks;
+	int i;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2758,14 +3198,11 @@ extern bool test_job_array_complete(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (!IS_JOB_COMPLETE(job_ptr))
-				return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	tasks = _job_array_tasks(array_job_id);
+	for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+		job_ptr = tasks->task_ptr[i];
+		if (!IS_JOB_COMPLETE(job_ptr))
+			return false;
 	}
 	return true;
 }
@@ -2774,7 +3211,8 @@ extern bool test_job_array_complete(uint32_t array_job_id)
 extern bool test_job_array_completed(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
+	job_array_tasks_t *tasks;
+	int i;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2783,14 +3221,11 @@ extern bool test_job_array_completed(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (!IS_JOB_COMPLETED(job_ptr))
-				return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	tasks = _job_array_tasks(array_job_id);
+	for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+		job_ptr = tasks->task_ptr[i];
+		if (!IS_JOB_COMPLETED(job_ptr))
+			return false;
 	}
 	return true;
 }
@@ -2799,7 +3234,8 @@ extern bool test_job_array_completed(uint32_t array_job_id)
 extern bool test_job_array_finished(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
+	job_array_tasks_t *tasks;
+	int i;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2808,14 +3244,11 @@ extern bool test_job_array_finished(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (!IS_JOB_FINISHED(job_ptr))
-				return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	tasks = _job_array_tasks(array_job_id);
+	for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+		job_ptr = tasks->task_ptr[i];
+		if (!IS_JOB_FINISHED(job_ptr))
+			return false;
 	}
 	return true;
 }
@@ -2824,7 +3257,8 @@ extern bool test_job_array_finished(uint32_t array_job_id)
 extern bool test_job_array_pending(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
+	job_array_tasks_t *tasks;
+	int i;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2835,14 +3269,11 @@ extern bool test_job_array_pending(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (IS_JOB_PENDING(job_ptr))
-				return true;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	tasks = _job_array_tasks(array_job_id);
+	for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+		job_ptr = tasks->task_ptr[i];
+		if (IS_JOB_PENDING(job_ptr))
+			return true;
 	}
 	return false;
 }
@@ -2851,16 +3282,13 @@ extern bool test_job_array_pending(uint32_t array_job_id)
  * own separate job_record (do not count tasks in pending META job record) */
 extern int num_pending_job_array_tasks(uint32_t array_job_id)
 {
-	struct job_record *job_ptr;
-	int count = 0, inx;
+	job_array_tasks_t *tasks;
+	int count = 0, i;
 
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if ((job_ptr->array_job_id == array_job_id) &&
-		    IS_JOB_PENDING(job_ptr))
+	tasks = _job_array_tasks(array_job_id);
+	for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+		if (IS_JOB_PENDING(tasks->task_ptr[i]))
 			count++;
-		job_ptr = job_ptr->job_array_next_j;
 	}
 
 	return count;
@@ -2879,7 +3307,8 @@ extern struct job_record *find_job_array_rec(uint32_t array_job_id,
 					     uint32_t array_task_id)
 {
 	struct job_record *job_ptr, *match_job_ptr = NULL;
-	int inx;
+	job_array_tasks_t *tasks;
+	int i, inx;
 
 	if (array_task_id == NO_VAL)
 		return find_job_record(array_job_id);
@@ -2891,28 +3320,20 @@ extern struct job_record *find_job_array_rec(uint32_t array_job_id,
 		    (job_ptr->array_job_id == array_job_id))
 			return job_ptr;
 
-		inx = JOB_HASH_INX(array_job_id);
-		job_ptr = job_array_hash_j[inx];
-		while (job_ptr) {
-			if (job_ptr->array_job_id == array_job_id) {
-				match_job_ptr = job_ptr;
-				if (!IS_JOB_FINISHED(job_ptr)) {
-					return job_ptr;
-				}
-			}
-			job_ptr = job_ptr->job_array_next_j;
+		tasks = _job_array_tasks(array_job_id);
+		for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+			job_ptr = tasks->task_ptr[i];
+			match_job_ptr = job_ptr;
+			if (!IS_JOB_FINISHED(job_ptr))
+				return job_ptr;
 		}
 		return match_job_ptr;
 	} else {		/* Find specific task ID */
-		inx = JOB_ARRAY_HASH_INX(array_job_id, array_task_id);
-		job_ptr = job_array_hash_t[inx];
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == array_job_id) &&
-			    (job_ptr->array_task_id == array_task_id)) {
-				return job_ptr;
-			}
-			job_ptr = job_ptr->job_array_next_t;
-		}
+		job_ptr = id_hash_find(job_array_hash_t,
+				       JOB_ARRAY_TASK_KEY(array_job_id,
+							  array_task_id));
+		if (job_ptr)
+			return job_ptr;
 		/* Look for job record with all of the pending tasks */
 		job_ptr = find_job_record(array_job_id);
 		if (job_ptr && job_ptr->array_recs &&
@@ -2935,16 +3356,7 @@ extern struct job_record *find_job_array_rec(uint32_t array_job_id,
  */
 struct job_record *find_job_record(uint32_t job_id)
 {
-	struct job_record *job_ptr;
-
-	job_ptr = job_hash[JOB_HASH_INX(job_id)];
-	while (job_ptr) {
-		if (job_ptr->job_id == job_id)
-			return job_ptr;
-		job_ptr = job_ptr->job_next;
-	}
-
-	return NULL;
+	return id_hash_find(job_hash, job_id);
 }
 
 /* rebuild a job's partition name list based upon the contents of its
@@ -3780,21 +4192,11 @@ int init_job_conf(void)
  */
 extern void rehash_jobs(void)
 {
+	/* The tables grow as needed, MaxJobCount is only a size hint */
 	if (job_hash == NULL) {
-		hash_table_size = slurmctld_conf.max_job_cnt;
-		job_hash = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-		job_array_hash_j = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-		job_array_hash_t = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
+		job_hash = id_hash_init(slurmctld_conf.max_job_cnt);
+		job_array_hash_j = id_hash_init(0);
+		job_array_hash_t = id_hash_init(0);
 	}
 }
 
@@ -3805,7 +4207,7 @@ extern void rehash_jobs(void)
  * RET - The new job record, which is the new META job record. */
 extern struct job_record *job_array_split(struct job_record *job_ptr)
 {
-	struct job_record *job_ptr_pend = NULL, *save_job_next;
+	struct job_record *job_ptr_pend = NULL;
 	struct job_details *job_details, *details_new, *save_details;
 	uint32_t save_job_id;
 	uint64_t save_db_index = job_ptr->db_index;
@@ -3836,14 +4238,12 @@ extern struct job_record *job_array_split(struct job_record *job_ptr)
 	/* Copy most of original job data.
 	 * This could be done in parallel, but performance was worse. */
 	save_job_id   = job_ptr_pend->job_id;
-	save_job_next = job_ptr_pend->job_next;
 	save_details  = job_ptr_pend->details;
 	save_prio_factors = job_ptr_pend->prio_factors;
 	save_step_list = job_ptr_pend->step_list;
 	memcpy(job_ptr_pend, job_ptr, sizeof(struct job_record));
 
 	job_ptr_pend->job_id   = save_job_id;
-	job_ptr_pend->job_next = save_job_next;
 	job_ptr_pend->details  = save_details;
 	job_ptr_pend->step_list = save_step_list;
 	job_ptr_pend->db_index = save_db_index;
@@ -3897,8 +4297,8 @@ extern struct job_record *job_array_split(struct job_record *job_ptr)
 	memcpy(job_ptr_pend->limit_set.tres, job_ptr->limit_set.tres,
 	       sizeof(uint16_t) * slurmctld_tres_cnt);
 
-	_add_job_hash(job_ptr);		/* Sets job_next */
-	_add_job_hash(job_ptr_pend);	/* Sets job_next */
+	_add_job_hash(job_ptr);
+	_add_job_hash(job_ptr_pend);
 	_add_job_array_hash(job_ptr);
 	job_ptr_pend->job_resrcs = NULL;
 
@@ -4539,6 +4939,7 @@ static int _job_signal(struct job_record *job_ptr, uint16_t signal,
 
 	if (IS_JOB_FINISHED(job_ptr))
 		return ESLURM_ALREADY_DONE;
+	job_state_changed(job_ptr);
 
 	/* let node select plugin do any state-dependent signalling actions */
 	select_g_job_signal(job_ptr, signal);
@@ -4712,6 +5113,7 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 {
 	slurm_ctl_conf_t *conf;
 	struct job_record *job_ptr;
+	job_array_tasks_t *tasks;
 	uint32_t job_id;
 	time_t now = time(NULL);
 	char *end_ptr = NULL, *tok, *tmp;
@@ -4789,19 +5191,14 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 		}
 
 		/* Signal all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		if (!job_ptr && !job_ptr_done) {
+		tasks = _job_array_tasks(job_id);
+		if (!tasks && !job_ptr_done) {
 			info("%s: 2 invalid job id %u", __func__, job_id);
 			return ESLURM_INVALID_JOB_ID;
 		}
-		while (job_ptr) {
-			if (job_ptr->array_job_id == job_id)
-				break;
-			job_ptr = job_ptr->job_array_next_j;
-		}
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+		for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+			job_ptr = tasks->task_ptr[i];
+			if (job_ptr != job_ptr_done) {
 				rc2 = _job_signal(job_ptr, signal, flags, uid,
 						  preempt);
 				jobs_signalled++;
@@ -4811,7 +5208,6 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 					rc = MAX(rc, rc2);
 				}
 			}
-			job_ptr = job_ptr->job_array_next_j;
 		}
 		if ((rc == SLURM_SUCCESS) && (jobs_done == jobs_signalled))
 			return ESLURM_ALREADY_DONE;
@@ -4841,14 +5237,8 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 
 	/* Find some job record and validate the user signalling the job */
 	job_ptr = find_job_record(job_id);
-	if (job_ptr == NULL) {
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		while (job_ptr) {
-			if (job_ptr->array_job_id == job_id)
-				break;
-			job_ptr = job_ptr->job_array_next_j;
-		}
-	}
+	if ((job_ptr == NULL) && (tasks = _job_array_tasks(job_id)))
+		job_ptr = tasks->task_ptr[0];
 	if ((job_ptr == NULL) ||
 	    ((job_ptr->array_task_id == NO_VAL) &&
 	     (job_ptr->array_recs == NULL))) {
@@ -5042,6 +5432,7 @@ extern int prolog_complete(uint32_t job_id,
 		error("Prolog launch failure, JobId=%u", job_ptr->job_id);
 
 	job_ptr->state_reason = WAIT_NO_REASON;
+	job_state_changed(job_ptr);
 
 	return SLURM_SUCCESS;
 }
@@ -8226,7 +8617,6 @@ _validate_min_mem_partition(job_desc_msg_t *job_desc_msg,
 static void _list_delete_job(void *job_entry)
 {
 	struct job_record *job_ptr = (struct job_record *) job_entry;
-	struct job_record **job_pptr, *tmp_ptr;
 	int job_array_size, i;
 
 	xassert(job_entry);
@@ -8234,16 +8624,10 @@ static void _list_delete_job(void *job_entry)
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
 
 	/* Remove the record from job hash table */
-	job_pptr = &job_hash[JOB_HASH_INX(job_ptr->job_id)];
-	while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-	       ((tmp_ptr = *job_pptr) != (struct job_record *) job_entry)) {
-		xassert(tmp_ptr->magic == JOB_MAGIC);
-		job_pptr = &tmp_ptr->job_next;
-	}
-	if (job_pptr == NULL)
+	if (!id_hash_remove(job_hash, job_ptr->job_id, job_ptr))
 		error("job hash error");
-	else
-		*job_pptr = job_ptr->job_next;
+	_journal_purge_add(job_ptr->job_id);
+	job_queue_remove(job_ptr);
 
 	if (job_ptr->array_recs) {
 		job_array_size = MAX(1, job_ptr->array_recs->task_cnt);
@@ -8252,34 +8636,7 @@ static void _list_delete_job(void *job_entry)
 	}
 
 	/* Remove the record from job array hash tables, if applicable */
-	if (job_ptr->array_task_id != NO_VAL) {
-		job_pptr = &job_array_hash_j[
-			JOB_HASH_INX(job_ptr->array_job_id)];
-		while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-		       ((tmp_ptr = *job_pptr) !=
-			(struct job_record *) job_entry)) {
-			xassert(tmp_ptr->magic == JOB_MAGIC);
-			job_pptr = &tmp_ptr->job_array_next_j;
-		}
-		if (job_pptr == NULL)
-			error("job array hash error");
-		else
-			*job_pptr = job_ptr->job_array_next_j;
-
-		job_pptr = &job_array_hash_t[
-			JOB_ARRAY_HASH_INX(job_ptr->array_job_id,
-					   job_ptr->array_task_id)];
-		while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-		       ((tmp_ptr = *job_pptr) !=
-			(struct job_record *) job_entry)) {
-			xassert(tmp_ptr->magic == JOB_MAGIC);
-			job_pptr = &tmp_ptr->job_array_next_t;
-		}
-		if (job_pptr == NULL)
-			error("job array, task ID hash error");
-		else
-			*job_pptr = job_ptr->job_array_next_t;
-	}
+	_remove_job_array_hash(job_ptr);
 
 	delete_job_details(job_ptr);
 	xfree(job_ptr->account);
@@ -8494,30 +8851,177 @@ static bool _hide_job(struct job_record *job_ptr, uid_t uid,
 	return false;
 }
 
+/* Return true if the first len characters of name match an entry of the
+ * comma separated list */
+static bool _name_in_list(char *name, int len, char *list, bool ignore_case)
+{
+	char *tok = list, *sep;
+	int tok_len;
+
+	while (tok) {
+		sep = strchr(tok, ',');
+		tok_len = sep ? (sep - tok) : strlen(tok);
+		if ((tok_len == len) &&
+		    (ignore_case ? !strncasecmp(tok, name, len) :
+				   !strncmp(tok, name, len)))
+			return true;
+		tok = sep ? (sep + 1) : NULL;
+	}
+	return false;
+}
+
 /*
- * pack_all_jobs - dump all job information for all jobs in
- *	machine independent form (for network transmission)
- * OUT buffer_ptr - the pointer is set to the allocated buffer.
- * OUT buffer_size - set to size of the buffer in bytes
- * IN show_flags - job filtering options
- * IN uid - uid of user making request (for partition filtering)
- * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
- * global: job_list - global list of job records
- * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
- * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
- *	whenever the data format changes
+ * Determine if a job matches every filter of a job information request.
+ * Matching is never narrower than the client side filtering of squeue.
+ * IN node_filter - bitmap of cond->nodes, NULL if no node filter
  */
-extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
-			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
-			  uint16_t protocol_version)
+static bool _match_job_cond(struct job_record *job_ptr, job_info_cond_t *cond,
+			    bitstr_t *node_filter)
+{
+	bitstr_t *node_bitmap;
+	uint32_t i, job_state;
+	char *part, *sep;
+	bool match;
+
+	if (cond->job_id_cnt) {
+		for (i = 0; i < cond->job_id_cnt; i++) {
+			if ((cond->job_ids[i] == job_ptr->job_id) ||
+			    (cond->job_ids[i] == job_ptr->array_job_id))
+				break;
+		}
+		if (i >= cond->job_id_cnt)
+			return false;
+	}
+
+	if (cond->user_cnt) {
+		for (i = 0; i < cond->user_cnt; i++) {
+			if (cond->user_ids[i] == job_ptr->user_id)
+				break;
+		}
+		if (i >= cond->user_cnt)
+			return false;
+	}
+
+	if (cond->state_cnt) {
+		job_state = job_ptr->job_state & (~JOB_UPDATE_DB);
+		for (i = 0; i < cond->state_cnt; i++) {
+			if (cond->states[i] & JOB_STATE_FLAGS) {
+				if (cond->states[i] & job_state)
+					break;
+			} else if (cond->states[i] ==
+				   (job_state & JOB_STATE_BASE))
+				break;
+		}
+		if (i >= cond->state_cnt)
+			return false;
+	}
+
+	if (cond->partitions) {
+		/* Same partition name(s) as reported by pack_job() */
+		if (!IS_JOB_PENDING(job_ptr) && job_ptr->part_ptr)
+			part = job_ptr->part_ptr->name;
+		else
+			part = job_ptr->partition;
+		match = false;
+		while (part && !match) {
+			sep = strchr(part, ',');
+			match = _name_in_list(part,
+					      sep ? (sep - part) : strlen(part),
+					      cond->partitions, false);
+			part = sep ? (sep + 1) : NULL;
+		}
+		if (!match)
+			return false;
+	}
+
+	if (cond->accounts &&
+	    (!job_ptr->account ||
+	     !_name_in_list(job_ptr->account, strlen(job_ptr->account),
+			    cond->accounts, true)))
+		return false;
+
+	if (node_filter) {
+		if (IS_JOB_COMPLETING(job_ptr))
+			node_bitmap = job_ptr->node_bitmap_cg;
+		else
+			node_bitmap = job_ptr->node_bitmap;
+		if (!node_bitmap)	/* Let the client match the names */
+			return (job_ptr->nodes != NULL);
+		if (!bit_overlap(node_bitmap, node_filter))
+			return false;
+	}
+
+	return true;
+}
+
+/* FNV-1a hash of buffer data */
+static uint64_t _hash_data(uint64_t hash, const char *data, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*
+ * Hash a packed job record for snapshot deltas. The expected start and end
+ * times of a pending job are packed as no earlier than the current time, so
+ * they are replaced by the job times they are derived from. Otherwise every
+ * pending job's hash would change each second and every delta would resend
+ * the whole queue. Once the expected start time has passed, the packed
+ * times follow the clock, so such records are resent every SLIPPED_RESEND
+ * seconds rather than left showing a start time in the past.
+ * IN rec_start, rec_end - record location in buffer
+ * IN now_start, now_end - location of the times derived from the current
+ *	time within the record, now_end is 0 if there are none
+ */
+static uint64_t _hash_job_rec(struct job_record *job_ptr, Buf buffer,
+			      uint32_t rec_start, uint32_t rec_end,
+			      uint32_t now_start, uint32_t now_end)
+{
+	char *data = get_buf_data(buffer);
+	uint64_t hash = 14695981039346656037ULL;
+	time_t now, times[3];
+
+	if (!now_end)
+		return _hash_data(hash, data + rec_start, rec_end - rec_start);
+
+	hash = _hash_data(hash, data + rec_start, now_start - rec_start);
+	now = time(NULL);
+	times[0] = job_ptr->start_time;
+	times[1] = job_ptr->end_time;
+	if (job_ptr->start_time < now)
+		times[2] = now / SLIPPED_RESEND;
+	else
+		times[2] = 0;
+	hash = _hash_data(hash, (char *) times, sizeof(times));
+	return _hash_data(hash, data + now_end, rec_end - now_end);
+}
+
+static void _pack_all_jobs(char **buffer_ptr, int *buffer_size,
+			   uint32_t *rec_cnt, uint32_t **rec_id,
+			   uint32_t **rec_offset, uint64_t **rec_hash,
+			   uint16_t show_flags, uid_t uid, uint32_t filter_uid,
+			   job_info_cond_t *cond, uint16_t protocol_version)
 {
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
-	uint32_t jobs_packed = 0, tmp_offset;
+	uint32_t jobs_packed = 0, tmp_offset, now_start, now_end;
+	uint32_t field_mask = JOB_FIELD_ALL;
+	bitstr_t *node_filter = NULL;
 	Buf buffer;
 
 	buffer_ptr[0] = NULL;
 	*buffer_size = 0;
+	if (rec_id) {
+		tmp_offset = list_count(job_list);
+		*rec_id = xmalloc(sizeof(uint32_t) * (tmp_offset + 1));
+		*rec_offset = xmalloc(sizeof(uint32_t) * (tmp_offset + 1));
+		*rec_hash = xmalloc(sizeof(uint64_t) * (tmp_offset + 1));
+	}
 
 	buffer = init_buf(BUF_SIZE);
 
@@ -8526,7 +9030,17 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	pack32(jobs_packed, buffer);
 	pack_time(time(NULL), buffer);
 
-	/* write individual job records */
+	if (cond) {
+		field_mask = cond->field_mask;
+		if (cond->nodes)
+			(void) node_name2bitmap(cond->nodes, true,
+						&node_filter);
+	}
+
+	/* write individual job records, with repeated strings (partition,
+	 * account, paths, etc.) sent once per response if SHOW_COMPACT */
+	if (show_flags & SHOW_COMPACT)
+		compact_buf_start(buffer);
 	part_filter_set(uid);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
@@ -8542,11 +9056,31 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 		if ((filter_uid != NO_VAL) && (filter_uid != job_ptr->user_id))
 			continue;
 
-		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		if (cond && !_match_job_cond(job_ptr, cond, node_filter))
+			continue;
+
+		if (!rec_id) {
+			_pack_job(job_ptr, show_flags, field_mask, buffer,
+				  protocol_version, uid, NULL, NULL);
+			jobs_packed++;
+			continue;
+		}
+		(*rec_id)[jobs_packed] = job_ptr->job_id;
+		(*rec_offset)[jobs_packed] = get_buf_offset(buffer);
+		_pack_job(job_ptr, show_flags, field_mask, buffer,
+			  protocol_version, uid, &now_start, &now_end);
+		(*rec_hash)[jobs_packed] =
+			_hash_job_rec(job_ptr, buffer,
+				      (*rec_offset)[jobs_packed],
+				      get_buf_offset(buffer),
+				      now_start, now_end);
 		jobs_packed++;
 	}
 	list_iterator_destroy(job_iterator);
 	part_filter_clear();
+	FREE_NULL_BITMAP(node_filter);
+	if (show_flags & SHOW_COMPACT)
+		compact_buf_end(buffer);
 
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
@@ -8554,10 +9088,63 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	pack32(jobs_packed, buffer);
 	set_buf_offset(buffer, tmp_offset);
 
+	if (rec_cnt)
+		*rec_cnt = jobs_packed;
 	*buffer_size = get_buf_offset(buffer);
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
 
+/*
+ * pack_all_jobs - dump all job information for all jobs in
+ *	machine independent form (for network transmission)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN show_flags - job filtering options, with SHOW_COMPACT the job records
+ *	are packed in compact form for RESPONSE_JOB_INFO_COMPACT
+ * IN uid - uid of user making request (for partition filtering)
+ * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
+ * IN cond - pack only the jobs matching these filters and the optional
+ *	fields in cond->field_mask, NULL for all jobs and fields
+ * global: job_list - global list of job records
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
+			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
+			  job_info_cond_t *cond, uint16_t protocol_version)
+{
+	_pack_all_jobs(buffer_ptr, buffer_size, NULL, NULL, NULL, NULL,
+		       show_flags, uid, filter_uid, cond, protocol_version);
+}
+
+/*
+ * pack_all_jobs_index - same as pack_all_jobs() for all jobs, also
+ *	identifying where each job's record starts in the buffer
+ * IN field_mask - JOB_FIELD_* of optional fields to pack
+ * OUT rec_cnt - set to the count of job records packed
+ * OUT rec_id - set to an array with the job ID of each record
+ * OUT rec_offset - set to an array with the buffer offset of each record
+ * OUT rec_hash - set to an array with a hash of each record which changes
+ *	only with the job, not with the current time
+ * NOTE: the buffer, rec_id, rec_offset and rec_hash must be xfreed by the
+ *	caller
+ */
+extern void pack_all_jobs_index(char **buffer_ptr, int *buffer_size,
+				uint32_t *rec_cnt, uint32_t **rec_id,
+				uint32_t **rec_offset, uint64_t **rec_hash,
+				uint16_t show_flags, uid_t uid,
+				uint32_t field_mask, uint16_t protocol_version)
+{
+	job_info_cond_t cond;
+
+	memset(&cond, 0, sizeof(job_info_cond_t));
+	cond.field_mask = field_mask;
+	_pack_all_jobs(buffer_ptr, buffer_size, rec_cnt, rec_id, rec_offset,
+		       rec_hash, show_flags, uid, NO_VAL, &cond,
+		       protocol_version);
+}
+
 /*
  * pack_one_job - dump information for one jobs in
  *	machine independent form (for network transmission)
@@ -8575,7 +9162,8 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 			uint16_t protocol_version)
 {
 	struct job_record *job_ptr;
-	uint32_t jobs_packed = 0, tmp_offset;
+	job_array_tasks_t *tasks;
+	uint32_t i, jobs_packed = 0, tmp_offset;
 	Buf buffer;
 
 	buffer_ptr[0] = NULL;
@@ -8609,18 +9197,18 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 			}
 		}
 
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		while (job_ptr) {
+		tasks = _job_array_tasks(job_id);
+		for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+			job_ptr = tasks->task_ptr[i];
 			if ((job_ptr->job_id == job_id) && packed_head) {
 				;	/* Already packed */
-			} else if (job_ptr->array_job_id == job_id) {
+			} else {
 				if (_hide_job(job_ptr, uid, show_flags))
 					break;
 				pack_job(job_ptr, show_flags, buffer,
 					 protocol_version, uid);
 				jobs_packed++;
 			}
-			job_ptr = job_ptr->job_array_next_j;
 		}
 	}
 
@@ -8675,15 +9263,39 @@ static void _pack_job_gres(struct job_record *dump_job_ptr, Buf buffer,
  */
 void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 	      uint16_t protocol_version, uid_t uid)
+{
+	_pack_job(dump_job_ptr, show_flags, JOB_FIELD_ALL, buffer,
+		  protocol_version, uid, NULL, NULL);
+}
+
+/* Pack a string of an optional job information field, NULL if the field
+ * was not requested */
+static void _pack_field_str(char *str, bool send, Buf buffer)
+{
+	if (send)
+		packstr(str, buffer);
+	else
+		packnull(buffer);
+}
+
+/* Same as pack_job(), fields not in field_mask (JOB_FIELD_*) are packed
+ * as NULL */
+static void _pack_job(struct job_record *dump_job_ptr, uint16_t show_flags,
+		      uint32_t field_mask, Buf buffer,
+		      uint16_t protocol_version, uid_t uid,
+		      uint32_t *now_start, uint32_t *now_end)
 {
 	struct job_details *detail_ptr;
 	time_t begin_time = 0, start_time = 0, end_time = 0;
+	bool now_times = false;
 	uint32_t time_limit;
 	uint8_t uint8_tmp = 0;
 	char *nodelist = NULL;
 	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK,
 				   NO_LOCK, NO_LOCK, NO_LOCK };
 
+	if (now_start)
+		*now_start = *now_end = 0;
 	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		detail_ptr = dump_job_ptr->details;
 		pack32(dump_job_ptr->array_job_id, buffer);
@@ -8748,6 +9360,7 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 			/* Report expected start time,
 			 * making sure that time is not in the past */
 			start_time = MAX(dump_job_ptr->start_time, time(NULL));
+			now_times = true;
 			if (time_limit != NO_VAL) {
 				end_time = MAX(dump_job_ptr->end_time,
 					       (start_time + time_limit * 60));
@@ -8760,8 +9373,12 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					       (start_time + time_limit * 60));
 			}
 		}
+		if (now_times && now_start)
+			*now_start = get_buf_offset(buffer);
 		pack_time(start_time, buffer);
 		pack_time(end_time, buffer);
+		if (now_times && now_start)
+			*now_end = get_buf_offset(buffer);
 
 		pack_time(dump_job_ptr->suspend_time, buffer);
 		pack_time(dump_job_ptr->pre_sus_time, buffer);
@@ -8788,9 +9405,11 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 		else
 			packstr(dump_job_ptr->partition, buffer);
 		packstr(dump_job_ptr->account, buffer);
-		packstr(dump_job_ptr->admin_comment, buffer);
+		_pack_field_str(dump_job_ptr->admin_comment,
+				(field_mask & JOB_FIELD_COMMENT), buffer);
 		packstr(dump_job_ptr->network, buffer);
-		packstr(dump_job_ptr->comment, buffer);
+		_pack_field_str(dump_job_ptr->comment,
+				(field_mask & JOB_FIELD_COMMENT), buffer);
 		packstr(dump_job_ptr->gres, buffer);
 		packstr(dump_job_ptr->batch_host, buffer);
 		if (!IS_JOB_COMPLETED(dump_job_ptr) &&
@@ -8846,20 +9465,22 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					     buffer, protocol_version);
 
 		/* A few details are always dumped here */
-		_pack_default_job_details(dump_job_ptr, buffer,
+		_pack_default_job_details(dump_job_ptr, field_mask, buffer,
 					  protocol_version);
 
 		/* other job details are only dumped until the job starts
 		 * running (at which time they become meaningless) */
 		if (detail_ptr)
-			_pack_pending_job_details(detail_ptr, buffer,
-						  protocol_version);
+			_pack_pending_job_details(detail_ptr, field_mask,
+						  buffer, protocol_version);
 		else
-			_pack_pending_job_details(NULL, buffer,
+			_pack_pending_job_details(NULL, field_mask, buffer,
 						  protocol_version);
 		pack32(dump_job_ptr->bit_flags, buffer);
-		packstr(dump_job_ptr->tres_fmt_alloc_str, buffer);
-		packstr(dump_job_ptr->tres_fmt_req_str, buffer);
+		_pack_field_str(dump_job_ptr->tres_fmt_alloc_str,
+				(field_mask & JOB_FIELD_TRES), buffer);
+		_pack_field_str(dump_job_ptr->tres_fmt_req_str,
+				(field_mask & JOB_FIELD_TRES), buffer);
 		pack16(dump_job_ptr->start_protocol_ver, buffer);
 
 		if (dump_job_ptr->fed_details) {
@@ -8932,9 +9553,14 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 			/* Report expected start time,
 			 * making sure that time is not in the past */
 			start_time = MAX(dump_job_ptr->start_time, time(NULL));
+			now_times = true;
 		} else	/* earliest start time in the future */
 			start_time = begin_time;
+		if (now_times && now_start)
+			*now_start = get_buf_offset(buffer);
 		pack_time(start_time, buffer);
+		if (now_times && now_start)
+			*now_end = get_buf_offset(buffer);
 
 		pack_time(dump_job_ptr->end_time, buffer);
 		pack_time(dump_job_ptr->suspend_time, buffer);
@@ -9017,16 +9643,16 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					     buffer, protocol_version);
 
 		/* A few details are always dumped here */
-		_pack_default_job_details(dump_job_ptr, buffer,
+		_pack_default_job_details(dump_job_ptr, field_mask, buffer,
 					  protocol_version);
 
 		/* other job details are only dumped until the job starts
 		 * running (at which time they become meaningless) */
 		if (detail_ptr)
-			_pack_pending_job_details(detail_ptr, buffer,
-						  protocol_version);
+			_pack_pending_job_details(detail_ptr, field_mask,
+						  buffer, protocol_version);
 		else
-			_pack_pending_job_details(NULL, buffer,
+			_pack_pending_job_details(NULL, field_mask, buffer,
 						  protocol_version);
 		pack32(dump_job_ptr->bit_flags, buffer);
 		packstr(dump_job_ptr->tres_fmt_alloc_str, buffer);
@@ -9096,9 +9722,14 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 			/* Report expected start time,
 			 * making sure that time is not in the past */
 			start_time = MAX(dump_job_ptr->start_time, time(NULL));
+			now_times = true;
 		} else	/* earliest start time in the future */
 			start_time = begin_time;
+		if (now_times && now_start)
+			*now_start = get_buf_offset(buffer);
 		pack_time(start_time, buffer);
+		if (now_times && now_start)
+			*now_end = get_buf_offset(buffer);
 
 		pack_time(dump_job_ptr->end_time, buffer);
 		pack_time(dump_job_ptr->suspend_time, buffer);
@@ -9180,16 +9811,16 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					     buffer, protocol_version);
 
 		/* A few details are always dumped here */
-		_pack_default_job_details(dump_job_ptr, buffer,
+		_pack_default_job_details(dump_job_ptr, field_mask, buffer,
 					  protocol_version);
 
 		/* other job details are only dumped until the job starts
 		 * running (at which time they become meaningless) */
 		if (detail_ptr)
-			_pack_pending_job_details(detail_ptr, buffer,
-						  protocol_version);
+			_pack_pending_job_details(detail_ptr, field_mask,
+						  buffer, protocol_version);
 		else
-			_pack_pending_job_details(NULL, buffer,
+			_pack_pending_job_details(NULL, field_mask, buffer,
 						  protocol_version);
 		pack32(dump_job_ptr->bit_flags, buffer);
 		packstr(dump_job_ptr->tres_fmt_alloc_str, buffer);
@@ -9233,7 +9864,8 @@ static void _find_node_config(int *cpu_cnt_ptr, int *core_cnt_ptr)
 
 /* pack default job details for "get_job_info" RPC */
 static void _pack_default_job_details(struct job_record *job_ptr,
-				      Buf buffer, uint16_t protocol_version)
+				      uint32_t field_mask, Buf buffer,
+				      uint16_t protocol_version)
 {
 	int max_cpu_cnt = -1, max_core_cnt = -1;
 	int i;
@@ -9276,11 +9908,18 @@ static void _pack_default_job_details(struct job_record *job_ptr,
 
 	if (protocol_version >= SLURM_16_05_PROTOCOL_VERSION) {
 		if (detail_ptr) {
-			packstr(detail_ptr->features,   buffer);
-			packstr(detail_ptr->work_dir,   buffer);
-			packstr(detail_ptr->dependency, buffer);
-
-			if (detail_ptr->argv) {
+			_pack_field_str(detail_ptr->features,
+					(field_mask & JOB_FIELD_FEATURES),
+					buffer);
+			_pack_field_str(detail_ptr->work_dir,
+					(field_mask & JOB_FIELD_COMMAND),
+					buffer);
+			_pack_field_str(detail_ptr->dependency,
+					(field_mask & JOB_FIELD_FEATURES),
+					buffer);
+
+			if (detail_ptr->argv &&
+			    (field_mask & JOB_FIELD_COMMAND)) {
 				/* Determine size needed for a string
 				 * containing all arguments */
 				for (i =0; detail_ptr->argv[i]; i++) {
@@ -9574,7 +10213,8 @@ static void _pack_default_job_details(struct job_record *job_ptr,
 
 /* pack pending job details for "get_job_info" RPC */
 static void _pack_pending_job_details(struct job_details *detail_ptr,
-				      Buf buffer, uint16_t protocol_version)
+				      uint32_t field_mask, Buf buffer,
+				      uint16_t protocol_version)
 {
 	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		if (detail_ptr) {
@@ -9586,15 +10226,30 @@ static void _pack_pending_job_details(struct job_details *detail_ptr,
 			pack64(detail_ptr->pn_min_memory, buffer);
 			pack32(detail_ptr->pn_min_tmp_disk, buffer);
 
-			packstr(detail_ptr->req_nodes, buffer);
-			pack_bit_fmt(detail_ptr->req_node_bitmap, buffer);
-			/* detail_ptr->req_node_layout is not packed */
-			packstr(detail_ptr->exc_nodes, buffer);
-			pack_bit_fmt(detail_ptr->exc_node_bitmap, buffer);
+			if (field_mask & JOB_FIELD_REQ_NODES) {
+				packstr(detail_ptr->req_nodes, buffer);
+				pack_bit_fmt(detail_ptr->req_node_bitmap,
+					     buffer);
+				/* req_node_layout is not packed */
+				packstr(detail_ptr->exc_nodes, buffer);
+				pack_bit_fmt(detail_ptr->exc_node_bitmap,
+					     buffer);
+			} else {
+				packnull(buffer);
+				packnull(buffer);
+				packnull(buffer);
+				packnull(buffer);
+			}
 
-			packstr(detail_ptr->std_err, buffer);
-			packstr(detail_ptr->std_in, buffer);
-			packstr(detail_ptr->std_out, buffer);
+			_pack_field_str(detail_ptr->std_err,
+					(field_mask & JOB_FIELD_COMMAND),
+					buffer);
+			_pack_field_str(detail_ptr->std_in,
+					(field_mask & JOB_FIELD_COMMAND),
+					buffer);
+			_pack_field_str(detail_ptr->std_out,
+					(field_mask & JOB_FIELD_COMMAND),
+					buffer);
 
 			pack_multi_core_data(detail_ptr->mc_ptr, buffer,
 					     protocol_version);
@@ -10044,6 +10699,7 @@ extern void set_job_prio(struct job_record *job_ptr)
 
 	if (IS_JOB_FINISHED(job_ptr))
 		return;
+	job_state_changed(job_ptr);
 	job_ptr->priority = slurm_sched_g_initial_priority(lowest_prio,
 							   job_ptr);
 	if ((job_ptr->priority == 0) || (job_ptr->direct_set_prio))
@@ -10233,8 +10889,8 @@ static void _merge_job_licenses(struct job_record *shrink_job_ptr,
 	return;
 }
 
-static int _update_job(struct job_record *job_ptr, job_desc_msg_t * job_specs,
-		       uid_t uid)
+static int _update_job_specs(struct job_record *job_ptr,
+			     job_desc_msg_t * job_specs, uid_t uid)
 {
 	int error_code = SLURM_SUCCESS;
 	enum job_state_reason fail_reason;
@@ -12164,6 +12820,7 @@ static int _update_job(struct job_record *job_ptr, job_desc_msg_t * job_specs,
 fini:
 	/* This was a local variable, so set it back to NULL */
 	job_specs->tres_req_cnt = NULL;
+	job_ptr->last_update = now;
 
 	FREE_NULL_LIST(gres_list);
 	FREE_NULL_LIST(license_list);
@@ -12184,6 +12841,18 @@ fini:
 	return error_code;
 }
 
+/* Apply an update request to one job and note the job changed */
+static int _update_job(struct job_record *job_ptr, job_desc_msg_t * job_specs,
+		       uid_t uid)
+{
+	int rc;
+
+	rc = _update_job_specs(job_ptr, job_specs, uid);
+	job_state_changed(job_ptr);
+
+	return rc;
+}
+
 /*
  * update_job - update a job's parameters per the supplied specifications
  * IN msg - RPC to update job, including change specification
@@ -12229,6 +12898,7 @@ extern int update_job_str(slurm_msg_t *msg, uid_t uid)
 	slurm_msg_t resp_msg;
 	job_desc_msg_t *job_specs = (job_desc_msg_t *) msg->data;
 	struct job_record *job_ptr, *new_job_ptr;
+	job_array_tasks_t *tasks;
 	slurm_ctl_conf_t *conf;
 	long int long_id;
 	uint32_t job_id = 0;
@@ -12279,19 +12949,18 @@ extern int update_job_str(slurm_msg_t *msg, uid_t uid)
 		}
 
 		/* Update all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		if (!job_ptr && !job_ptr_done) {
+		tasks = _job_array_tasks(job_id);
+		if (!tasks && !job_ptr_done) {
 			info("update_job_str: invalid job id %u", job_id);
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
 		}
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+		for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+			job_ptr = tasks->task_ptr[i];
+			if (job_ptr != job_ptr_done) {
 				rc2 = _update_job(job_ptr, job_specs, uid);
 				_resp_array_add(&resp_array, job_ptr, rc2);
 			}
-			job_ptr = job_ptr->job_array_next_j;
 		}
 		goto reply;
 	}
@@ -13104,8 +13773,9 @@ static int _test_state_dir_flag(void *x, void *arg)
 static void _validate_job_files(List batch_dirs)
 {
 	struct job_record *job_ptr;
+	job_array_tasks_t *tasks;
 	ListIterator batch_dir_iter;
-	uint32_t *job_id_ptr, array_job_id;
+	uint32_t *job_id_ptr, i;
 
 	list_for_each(job_list, _clear_state_dir_flag, NULL);
 
@@ -13117,13 +13787,9 @@ static void _validate_job_files(List batch_dirs)
 			list_delete_item(batch_dir_iter);
 		}
 		if (job_ptr && job_ptr->array_recs) { /* Update all tasks */
-			array_job_id = job_ptr->array_job_id;
-			job_ptr = job_array_hash_j[JOB_HASH_INX(array_job_id)];
-			while (job_ptr) {
-				if (job_ptr->array_job_id == array_job_id)
-					job_ptr->bit_flags |= HAS_STATE_DIR;
-				job_ptr = job_ptr->job_array_next_j;
-			}
+			tasks = _job_array_tasks(job_ptr->array_job_id);
+			for (i = 0; tasks && (i < tasks->task_cnt); i++)
+				tasks->task_ptr[i]->bit_flags |= HAS_STATE_DIR;
 		}
 	}
 	list_iterator_destroy(batch_dir_iter);
@@ -13245,6 +13911,7 @@ extern bool job_epilog_complete(uint32_t job_id, char *node_name,
 		return true;
 
 	trace_job(job_ptr, __func__, "enter");
+	job_state_changed(job_ptr);
 
 	/* There is a potential race condition this handles.
 	 * If slurmctld cold-starts while slurmd keeps running,
@@ -13368,6 +14035,7 @@ void batch_requeue_fini(struct job_record  *job_ptr)
 		return;
 
 	info("Requeuing %s", jobid2str(job_ptr, jbuf, sizeof(jbuf)));
+	job_state_changed(job_ptr);
 
 	/* Clear everything so this appears to be a new job and then restart
 	 * it in accounting. */
@@ -13431,11 +14099,19 @@ void batch_requeue_fini(struct job_record  *job_ptr)
 void job_fini (void)
 {
 	FREE_NULL_LIST(job_list);
-	xfree(job_hash);
-	xfree(job_array_hash_j);
-	xfree(job_array_hash_t);
+	id_hash_free(job_hash);
+	id_hash_free(job_array_hash_j);
+	id_hash_free(job_array_hash_t);
+	job_hash = NULL;
+	job_array_hash_j = NULL;
+	job_array_hash_t = NULL;
 	FREE_NULL_BITMAP(requeue_exit);
 	FREE_NULL_BITMAP(requeue_exit_hold);
+	_journal_close();
+	xfree(journal_purge);
+	journal_purge_cnt = journal_purge_size = 0;
+	xfree(journal_dirty);
+	journal_dirty_cnt = journal_dirty_size = 0;
 }
 
 /* Record the start of one job array task */
@@ -13517,6 +14193,7 @@ extern void job_completion_logger(struct job_record *job_ptr, bool requeue)
 
 	xassert(job_ptr);
 
+	job_state_changed(job_ptr);
 	acct_policy_remove_job_submit(job_ptr);
 	if (job_ptr->nodes) {
 		(void) bb_g_job_start_stage_out(job_ptr);
@@ -13937,6 +14614,7 @@ static int _suspend_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		}
 	}
 	last_job_update = last_node_update = now;
+	snapshot_node_alloc_changed();
 	return rc;
 }
 
@@ -13985,6 +14663,7 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
 	}
 	last_job_update = last_node_update = time(NULL);
+	snapshot_node_alloc_changed();
 	return rc;
 }
 
@@ -14133,6 +14812,7 @@ static int _job_suspend(struct job_record *job_ptr, uint16_t op, bool indf_susp)
 
 	job_ptr->time_last_active = now;
 	job_ptr->suspend_time = now;
+	job_state_changed(job_ptr);
 	jobacct_storage_g_job_suspend(acct_db_conn, job_ptr);
 
 	return rc;
@@ -14224,6 +14904,7 @@ extern int job_suspend2(suspend_msg_t *sus_ptr, uid_t uid,
 	slurm_ctl_conf_t *conf;
 	int rc = SLURM_SUCCESS, rc2;
 	struct job_record *job_ptr = NULL;
+	job_array_tasks_t *tasks;
 	long int long_id;
 	uint32_t job_id = 0;
 	char *end_ptr = NULL, *tok, *tmp;
@@ -14283,19 +14964,18 @@ extern int job_suspend2(suspend_msg_t *sus_ptr, uid_t uid,
 		}
 
 		/* Suspend all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		if (!job_ptr && !job_ptr_done) {
+		tasks = _job_array_tasks(job_id);
+		if (!tasks && !job_ptr_done) {
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
 		}
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+		for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+			job_ptr = tasks->task_ptr[i];
+			if (job_ptr != job_ptr_done) {
 				rc2 = _job_suspend(job_ptr, sus_ptr->op,
 						   indf_susp);
 				_resp_array_add(&resp_array, job_ptr, rc2);
 			}
-			job_ptr = job_ptr->job_array_next_j;
 		}
 		goto reply;
 	}
@@ -14587,6 +15267,7 @@ extern int job_requeue2(uid_t uid, requeue_msg_t *req_ptr,
 	slurm_ctl_conf_t *conf;
 	int rc = SLURM_SUCCESS, rc2;
 	struct job_record *job_ptr = NULL;
+	job_array_tasks_t *tasks;
 	long int long_id;
 	uint32_t job_id = 0;
 	char *end_ptr = NULL, *tok, *tmp;
@@ -14638,18 +15319,17 @@ extern int job_requeue2(uid_t uid, requeue_msg_t *req_ptr,
 		}
 
 		/* Requeue all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		if (!job_ptr && !job_ptr_done) {
+		tasks = _job_array_tasks(job_id);
+		if (!tasks && !job_ptr_done) {
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
 		}
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+		for (i = 0; tasks && (i < tasks->task_cnt); i++) {
+			job_ptr = tasks->task_ptr[i];
+			if (job_ptr != job_ptr_done) {
 				rc2 = _job_requeue(uid, job_ptr, preempt,state);
 				_resp_array_add(&resp_array, job_ptr, rc2);
 			}
-			job_ptr = job_ptr->job_array_next_j;
 		}
 		goto reply;
 	}
@@ -57,6 +57,7 @@
 #include "src/common/assoc_mgr.h"
 #include "src/common/env.h"
 #include "src/common/gres.h"
+#include "src/common/id_hash.h"
 #include "src/common/layouts_mgr.h"
 #include "src/common/list.h"
 #include "src/common/macros.h"
@@ -98,6 +99,11 @@
 #define BUILD_TIMEOUT 2000000	/* Max build_job_queue() run time in usec */
 #define MAX_FAILED_RESV 10
 #define MAX_RETRIES 10
+#define SCHED_RESCAN_INTERVAL 60 /* Max seconds between tests of all jobs */
+#define SCHED_RESCAN_MIN 5	/* Min seconds between tests of all jobs when
+				 * prompted by job completions */
+#define SCHED_DIRTY_MAX 10000	/* Changed jobs to re-test before testing
+				 * all jobs instead */
 
 typedef struct epilog_arg {
 	char *epilog_slurmctld;
@@ -105,10 +111,38 @@ typedef struct epilog_arg {
 	char **my_env;
 } epilog_arg_t;
 
+/*
+ * Runnable job/partition pairs seen by _schedule() are kept in a binary heap
+ * between passes. Jobs are re-tested and their records moved only when
+ * job_queue_update() reports that they changed; every job is re-tested only
+ * after partition, reservation or configuration changes, after jobs ended
+ * (dependencies), and at least every SCHED_RESCAN_INTERVAL seconds to catch
+ * priority recalculation and begin times. Each pass then pops records in
+ * priority order until the queue depth is reached rather than allocating and
+ * sorting a record for every pending job.
+ */
+typedef struct sched_queue_rec {
+	job_queue_rec_t rec;		/* Job/partition pair, must be first */
+	bool has_resv;			/* Job has a reservation */
+	uint16_t tier;			/* Partition priority_tier */
+	uint32_t sort_id;		/* Job ID or job array ID */
+	uint32_t gen;			/* Pass that last found the pair */
+	int heap_inx;			/* Position in sched_heap, -1 if popped */
+	struct sched_queue_rec *next;	/* Same job, other partition */
+} sched_queue_rec_t;
+
+typedef void (*job_queue_add_f) (void *arg, struct job_record *job_ptr,
+				 struct part_record *part_ptr,
+				 uint32_t priority);
+
 static char **	_build_env(struct job_record *job_ptr, bool is_epilog);
+static int	_build_job_pairs(struct job_record *job_ptr, bool clear_start,
+				 bool backfill, job_queue_add_f add, void *arg);
+static void	_build_job_queue(bool clear_start, bool backfill,
+				 job_queue_add_f add, void *arg);
 static void	_depend_list_del(void *dep_ptr);
 static void	_feature_list_delete(void *x);
-static void	_job_queue_append(List job_queue, struct job_record *job_ptr,
+static void	_job_queue_append(void *arg, struct job_record *job_ptr,
 				  struct part_record *part_ptr, uint32_t priority);
 static void	_job_queue_rec_del(void *x);
 static bool	_job_runnable_test1(struct job_record *job_ptr,
@@ -119,6 +153,13 @@ static void *	_run_epilog(void *arg);
 static void *	_run_prolog(void *arg);
 static bool	_scan_depend(List dependency_list, uint32_t job_id);
 static void *	_sched_agent(void *args);
+static void	_sched_dirty_add(uint32_t job_id);
+static void	_sched_queue_add(void *arg, struct job_record *job_ptr,
+				 struct part_record *part_ptr,
+				 uint32_t priority);
+static sched_queue_rec_t *_sched_queue_pop(void);
+static void	_sched_queue_refresh(void);
+static void	_sched_queue_restore(void);
 static int	_schedule(uint32_t job_limit);
 static int	_valid_feature_list(struct job_record *job_ptr,
 				    List feature_list);
@@ -133,6 +174,21 @@ static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int sched_pend_thread = 0;
 static bool sched_running = false;
 static struct timeval sched_last = {0, 0};
+
+/* Persistent job queue of _schedule(), protected by the job write lock */
+static sched_queue_rec_t **sched_heap = NULL;	/* Binary heap */
+static int sched_heap_cnt = 0, sched_heap_size = 0;
+static sched_queue_rec_t **sched_popped = NULL;	/* Popped in this pass */
+static int sched_popped_cnt = 0, sched_popped_size = 0;
+static id_hash_t *sched_hash = NULL;		/* Records by job ID */
+static uint32_t *sched_dirty = NULL;		/* IDs of changed jobs */
+static int sched_dirty_cnt = 0, sched_dirty_size = 0;
+static bool sched_job_ended = false;
+static time_t sched_rescan_time = 0;		/* Time all jobs were tested */
+static uint32_t sched_gen = 0;
+static int sched_changes = 0;
+static bool sched_heap_valid = false;
+static bool sched_preempt = false;
 static uint32_t max_array_size = NO_VAL;
 #ifdef HAVE_ALPS_CRAY
 static int sched_min_interval = 1000000;
@@ -224,9 +280,10 @@ static List _build_user_job_list(uint32_t user_id, char* job_name)
 	return job_queue;
 }
 
-static void _job_queue_append(List job_queue, struct job_record *job_ptr,
+static void _job_queue_append(void *arg, struct job_record *job_ptr,
 			      struct part_record *part_ptr, uint32_t prio)
 {
+	List job_queue = (List) arg;
 	job_queue_rec_t *job_queue_rec;
 
 	job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
@@ -396,13 +453,94 @@ static int _delta_tv(struct timeval *tv)
  */
 extern List build_job_queue(bool clear_start, bool backfill)
 {
-	static time_t last_log_time = 0;
 	List job_queue;
-	ListIterator depend_iter, job_iterator, part_iterator;
-	struct job_record *job_ptr = NULL, *new_job_ptr;
+
+	job_queue = list_create(_job_queue_rec_del);
+	_build_job_queue(clear_start, backfill, _job_queue_append, job_queue);
+
+	return job_queue;
+}
+
+/*
+ * Test one job for ability to run now and add a record for each partition it
+ * can run in
+ * RET number of job/partition pairs added
+ */
+static int _build_job_pairs(struct job_record *job_ptr, bool clear_start,
+			    bool backfill, job_queue_add_f add, void *arg)
+{
+	ListIterator part_iterator;
 	struct part_record *part_ptr;
+	int reason, job_part_pairs = 0;
+
+	job_ptr->preempt_in_progress = false;	/* initialize */
+	if (job_ptr->state_reason != WAIT_NO_REASON)
+		job_ptr->state_reason_prev = job_ptr->state_reason;
+	if (!_job_runnable_test1(job_ptr, clear_start))
+		return job_part_pairs;
+
+	if (job_ptr->part_ptr_list) {
+		int inx = -1;
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = (struct part_record *)
+			list_next(part_iterator))) {
+			job_ptr->part_ptr = part_ptr;
+			reason = job_limits_check(&job_ptr, backfill);
+			if ((reason != WAIT_NO_REASON) &&
+			    (reason != job_ptr->state_reason)) {
+				job_ptr->state_reason = reason;
+				xfree(job_ptr->state_desc);
+				last_job_update = time(NULL);
+			}
+			/* priority_array index matches part_ptr_list
+			 * position: increment inx */
+			inx++;
+			if (reason != WAIT_NO_REASON)
+				continue;
+			job_part_pairs++;
+			if (job_ptr->priority_array) {
+				add(arg, job_ptr, part_ptr,
+				    job_ptr->priority_array[inx]);
+			} else {
+				add(arg, job_ptr, part_ptr, job_ptr->priority);
+			}
+		}
+		list_iterator_destroy(part_iterator);
+	} else {
+		if (job_ptr->part_ptr == NULL) {
+			part_ptr = find_part_record(job_ptr->partition);
+			if (part_ptr == NULL) {
+				error("Could not find partition %s "
+				      "for job %u", job_ptr->partition,
+				      job_ptr->job_id);
+				return job_part_pairs;
+			}
+			job_ptr->part_ptr = part_ptr;
+			error("partition pointer reset for job %u, "
+			      "part %s", job_ptr->job_id,
+			      job_ptr->partition);
+		}
+		if (!_job_runnable_test2(job_ptr, backfill))
+			return job_part_pairs;
+		job_part_pairs++;
+		add(arg, job_ptr, job_ptr->part_ptr, job_ptr->priority);
+	}
+
+	return job_part_pairs;
+}
+
+/*
+ * Test every pending job and call add() for each runnable job/partition pair
+ * with the job's priority in that partition
+ */
+static void _build_job_queue(bool clear_start, bool backfill,
+			     job_queue_add_f add, void *arg)
+{
+	static time_t last_log_time = 0;
+	ListIterator depend_iter, job_iterator;
+	struct job_record *job_ptr = NULL, *new_job_ptr;
 	struct depend_spec *dep_ptr;
-	int i, pend_cnt, reason, dep_corr;
+	int i, pend_cnt, dep_corr;
 	struct timeval start_tv = {0, 0};
 	int tested_jobs = 0;
 	char jobid_buf[32];
@@ -410,7 +548,6 @@ extern List build_job_queue(bool clear_start, bool backfill)
 	time_t now = time(NULL);
 
 	(void) _delta_tv(&start_tv);
-	job_queue = list_create(_job_queue_rec_del);
 
 	/* Create individual job records for job arrays that need burst buffer
 	 * staging */
@@ -518,68 +655,10 @@ extern List build_job_queue(bool clear_start, bool backfill)
 			break;
 		}
 		tested_jobs++;
-		job_ptr->preempt_in_progress = false;	/* initialize */
-		if (job_ptr->state_reason != WAIT_NO_REASON)
-			job_ptr->state_reason_prev = job_ptr->state_reason;
-		if (!_job_runnable_test1(job_ptr, clear_start))
-			continue;
-
-		if (job_ptr->part_ptr_list) {
-			int inx = -1;
-			part_iterator = list_iterator_create(
-				job_ptr->part_ptr_list);
-			while ((part_ptr = (struct part_record *)
-				list_next(part_iterator))) {
-				job_ptr->part_ptr = part_ptr;
-				reason = job_limits_check(&job_ptr, backfill);
-				if ((reason != WAIT_NO_REASON) &&
-				    (reason != job_ptr->state_reason)) {
-					job_ptr->state_reason = reason;
-					xfree(job_ptr->state_desc);
-					last_job_update = now;
-				}
-				/* priority_array index matches part_ptr_list
-				 * position: increment inx */
-				inx++;
-				if (reason != WAIT_NO_REASON)
-					continue;
-				job_part_pairs++;
-				if (job_ptr->priority_array) {
-					_job_queue_append(job_queue, job_ptr,
-							  part_ptr,
-							  job_ptr->
-							  priority_array[inx]);
-				} else {
-					_job_queue_append(job_queue, job_ptr,
-							  part_ptr,
-							  job_ptr->priority);
-				}
-			}
-			list_iterator_destroy(part_iterator);
-		} else {
-			if (job_ptr->part_ptr == NULL) {
-				part_ptr = find_part_record(job_ptr->partition);
-				if (part_ptr == NULL) {
-					error("Could not find partition %s "
-					      "for job %u", job_ptr->partition,
-					      job_ptr->job_id);
-					continue;
-				}
-				job_ptr->part_ptr = part_ptr;
-				error("partition pointer reset for job %u, "
-				      "part %s", job_ptr->job_id,
-				      job_ptr->partition);
-			}
-			if (!_job_runnable_test2(job_ptr, backfill))
-				continue;
-			job_part_pairs++;
-			_job_queue_append(job_queue, job_ptr,
-					  job_ptr->part_ptr, job_ptr->priority);
-		}
+		job_part_pairs += _build_job_pairs(job_ptr, clear_start,
+						   backfill, add, arg);
 	}
 	list_iterator_destroy(job_iterator);
-
-	return job_queue;
 }
 
 /*
@@ -688,7 +767,7 @@ static bool _failed_partition(struct part_record *part_ptr,
 	return false;
 }
 
-static void _do_diag_stats(long delta_t)
+static void _do_diag_stats(long delta_t, uint64_t lock_usec)
 {
 	if (delta_t > slurmctld_diag_stats.schedule_cycle_max)
 		slurmctld_diag_stats.schedule_cycle_max = delta_t;
@@ -696,6 +775,8 @@ static void _do_diag_stats(long delta_t)
 	slurmctld_diag_stats.schedule_cycle_sum += delta_t;
 	slurmctld_diag_stats.schedule_cycle_last = delta_t;
 	slurmctld_diag_stats.schedule_cycle_counter++;
+	slurmctld_diag_stats.schedule_lock_last = lock_usec;
+	slurmctld_diag_stats.schedule_lock_sum += lock_usec;
 }
 
 
@@ -1172,11 +1253,10 @@ extern bool deadline_ok(struct job_record *job_ptr, char *func)
 static int _schedule(uint32_t job_limit)
 {
 	ListIterator job_iterator = NULL, part_iterator = NULL;
-	List job_queue = NULL;
 	int failed_part_cnt = 0, failed_resv_cnt = 0, job_cnt = 0;
 	int error_code, i, j, part_cnt, time_limit, pend_time;
 	uint32_t job_depth = 0, array_task_id;
-	job_queue_rec_t *job_queue_rec;
+	sched_queue_rec_t *sched_rec;
 	struct job_record *job_ptr = NULL;
 	struct part_record *part_ptr, **failed_parts = NULL;
 	struct part_record *skip_part_ptr = NULL;
@@ -1206,6 +1286,7 @@ static int _schedule(uint32_t job_limit)
 	static int max_jobs_per_part = 0;
 	static int defer_rpc_cnt = 0;
 	time_t now, last_job_sched_start, sched_start;
+	uint64_t lock_usec;
 	uint32_t reject_array_job_id = 0;
 	struct part_record *reject_array_part = NULL;
 	uint16_t reject_state_reason = WAIT_NO_REASON;
@@ -1418,6 +1499,7 @@ static int _schedule(uint32_t job_limit)
 	if (job_limit == 0)
 		job_limit = def_job_limit;
 
+	lock_usec = lock_thread_hold_usec();
 	lock_slurmctld(job_write_lock);
 	now = time(NULL);
 	sched_start = now;
@@ -1496,8 +1578,9 @@ static int _schedule(uint32_t job_limit)
 	 * If we are doing FIFO scheduling, use the job records right off the
 	 * job list.
 	 *
-	 * If a job is submitted to multiple partitions then build_job_queue()
-	 * will return a separate record for each job:partition pair.
+	 * Otherwise pop job:partition pairs in priority order from the
+	 * persistent queue, which holds a separate record for each partition
+	 * a job is submitted to.
 	 *
 	 * In both cases, we test each partition associated with the job.
 	 */
@@ -1505,9 +1588,8 @@ static int _schedule(uint32_t job_limit)
 		slurmctld_diag_stats.schedule_queue_len = list_count(job_list);
 		job_iterator = list_iterator_create(job_list);
 	} else {
-		job_queue = build_job_queue(false, false);
-		slurmctld_diag_stats.schedule_queue_len = list_count(job_queue);
-		sort_job_queue(job_queue);
+		_sched_queue_refresh();
+		slurmctld_diag_stats.schedule_queue_len = sched_heap_cnt;
 	}
 	while (1) {
 		if (fifo_sched) {
@@ -1545,14 +1627,13 @@ next_part:			part_ptr = (struct part_record *)
 					continue;
 			}
 		} else {
-			job_queue_rec = list_pop(job_queue);
-			if (!job_queue_rec)
+			sched_rec = _sched_queue_pop();
+			if (!sched_rec)
 				break;
-			array_task_id = job_queue_rec->array_task_id;
-			job_ptr  = job_queue_rec->job_ptr;
-			part_ptr = job_queue_rec->part_ptr;
-			job_ptr->priority = job_queue_rec->priority;
-			xfree(job_queue_rec);
+			array_task_id = sched_rec->rec.array_task_id;
+			job_ptr  = sched_rec->rec.job_ptr;
+			part_ptr = sched_rec->rec.part_ptr;
+			job_ptr->priority = sched_rec->rec.priority;
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
@@ -1565,9 +1646,23 @@ next_part:			part_ptr = (struct part_record *)
 				 * reset pointer to "master" job array record */
 				job_ptr = find_job_record(job_ptr->array_job_id);
 			}
-			if (!job_ptr || !IS_JOB_PENDING(job_ptr))
-				continue;	/* started in other partition */
+			if (!job_ptr || !IS_JOB_PENDING(job_ptr)) {
+				/* started in other partition or by backfill */
+				_sched_dirty_add(sched_rec->rec.job_id);
+				continue;
+			}
+			/* Changes not reported by job_queue_update() are only
+			 * seen by the next test of all jobs, re-test here */
+			if (!_job_runnable_test1(job_ptr, false)) {
+				_sched_dirty_add(sched_rec->rec.job_id);
+				continue;
+			}
 			job_ptr->part_ptr = part_ptr;
+			if (job_limits_check(&job_ptr, false) !=
+			    WAIT_NO_REASON) {
+				_sched_dirty_add(sched_rec->rec.job_id);
+				continue;
+			}
 		}
 
 		if (job_ptr->preempt_in_progress)
@@ -2022,8 +2117,8 @@ next_task:
 			list_iterator_destroy(job_iterator);
 		if (part_iterator)
 			list_iterator_destroy(part_iterator);
-	} else if (job_queue) {
-		FREE_NULL_LIST(job_queue);
+	} else {
+		_sched_queue_restore();
 	}
 	xfree(sched_part_ptr);
 	xfree(sched_part_jobs);
@@ -2036,7 +2131,7 @@ next_task:
 	unlock_slurmctld(job_write_lock);
 	END_TIMER2("schedule");
 
-	_do_diag_stats(DELTA_TIMER);
+	_do_diag_stats(DELTA_TIMER, lock_thread_hold_usec() - lock_usec);
 
 out:
 #if HAVE_SYS_PRCTL_H
@@ -2048,6 +2143,360 @@ out:
 	return job_cnt;
 }
 
+/* RET true if record a is to be scheduled before record b */
+static bool _sched_queue_before(sched_queue_rec_t *a, sched_queue_rec_t *b)
+{
+	if (sched_preempt) {
+		if (slurm_job_preempt_check(&a->rec, &b->rec))
+			return true;
+		if (slurm_job_preempt_check(&b->rec, &a->rec))
+			return false;
+	}
+	if (a->has_resv != b->has_resv)
+		return a->has_resv;
+	if (a->tier != b->tier)
+		return (a->tier > b->tier);
+	if (a->rec.priority != b->rec.priority)
+		return (a->rec.priority > b->rec.priority);
+	if (a->sort_id != b->sort_id)
+		return (a->sort_id < b->sort_id);
+	return (a->rec.array_task_id < b->rec.array_task_id);
+}
+
+static void _sched_heap_set(int inx, sched_queue_rec_t *rec)
+{
+	sched_heap[inx] = rec;
+	rec->heap_inx = inx;
+}
+
+/* Restore heap order around a record whose key changed */
+static void _sched_heap_fix(int inx)
+{
+	sched_queue_rec_t *rec = sched_heap[inx];
+	int child, parent;
+
+	while (inx > 0) {
+		parent = (inx - 1) / 2;
+		if (!_sched_queue_before(rec, sched_heap[parent]))
+			break;
+		_sched_heap_set(inx, sched_heap[parent]);
+		inx = parent;
+	}
+	while ((child = (2 * inx) + 1) < sched_heap_cnt) {
+		if (((child + 1) < sched_heap_cnt) &&
+		    _sched_queue_before(sched_heap[child + 1],
+					sched_heap[child]))
+			child++;
+		if (!_sched_queue_before(sched_heap[child], rec))
+			break;
+		_sched_heap_set(inx, sched_heap[child]);
+		inx = child;
+	}
+	_sched_heap_set(inx, rec);
+}
+
+static void _sched_heap_push(sched_queue_rec_t *rec)
+{
+	if (sched_heap_cnt >= sched_heap_size) {
+		sched_heap_size = MAX(1024, sched_heap_size * 2);
+		xrealloc(sched_heap,
+			 sizeof(sched_queue_rec_t *) * sched_heap_size);
+	}
+	_sched_heap_set(sched_heap_cnt++, rec);
+	if (sched_heap_valid)
+		_sched_heap_fix(rec->heap_inx);
+}
+
+static void _sched_heap_delete(int inx)
+{
+	sched_heap[inx]->heap_inx = -1;
+	if (--sched_heap_cnt == inx)
+		return;
+	_sched_heap_set(inx, sched_heap[sched_heap_cnt]);
+	if (sched_heap_valid)
+		_sched_heap_fix(inx);
+}
+
+/* Add a record to the job ID table, records of one job are chained */
+static void _sched_hash_add(sched_queue_rec_t *rec)
+{
+	if (!sched_hash)
+		sched_hash = id_hash_init(1024);
+	rec->next = id_hash_remove(sched_hash, rec->rec.job_id, NULL);
+	id_hash_add(sched_hash, rec->rec.job_id, rec);
+}
+
+static void _sched_hash_remove(sched_queue_rec_t *rec)
+{
+	sched_queue_rec_t *head, **prev;
+
+	head = id_hash_find(sched_hash, rec->rec.job_id);
+	if (head == rec) {
+		(void) id_hash_remove(sched_hash, rec->rec.job_id, rec);
+		if (rec->next)
+			id_hash_add(sched_hash, rec->rec.job_id, rec->next);
+		return;
+	}
+	for (prev = &head->next; *prev; prev = &(*prev)->next) {
+		if (*prev == rec) {
+			*prev = rec->next;
+			break;
+		}
+	}
+}
+
+/* Record a runnable job/partition pair found by _build_job_queue() */
+static void _sched_queue_add(void *arg, struct job_record *job_ptr,
+			     struct part_record *part_ptr, uint32_t priority)
+{
+	sched_queue_rec_t *rec = NULL;
+	bool has_resv = (job_ptr->resv_id != 0);
+	uint32_t sort_id;
+
+	if (job_ptr->array_task_id == NO_VAL)
+		sort_id = job_ptr->job_id;
+	else
+		sort_id = job_ptr->array_job_id;
+
+	if (sched_hash)
+		rec = id_hash_find(sched_hash, job_ptr->job_id);
+	while (rec && (rec->rec.part_ptr != part_ptr))
+		rec = rec->next;
+	if (!rec) {
+		rec = xmalloc(sizeof(sched_queue_rec_t));
+		rec->rec.job_id = job_ptr->job_id;
+		rec->rec.part_ptr = part_ptr;
+		_sched_hash_add(rec);
+	} else if ((rec->gen != sched_gen) &&
+		   (rec->has_resv == has_resv) &&
+		   (rec->tier == part_ptr->priority_tier) &&
+		   (rec->rec.priority == priority) &&
+		   (rec->sort_id == sort_id) &&
+		   (rec->rec.array_task_id == job_ptr->array_task_id)) {
+		rec->rec.job_ptr = job_ptr;
+		rec->gen = sched_gen;
+		return;		/* Sort key unchanged */
+	}
+	rec->rec.array_task_id = job_ptr->array_task_id;
+	rec->rec.job_ptr = job_ptr;
+	rec->rec.priority = priority;
+	rec->has_resv = has_resv;
+	rec->tier = part_ptr->priority_tier;
+	rec->sort_id = sort_id;
+
+	/* Re-sort everything at the end of the pass once that is cheaper */
+	if (sched_heap_valid && (++sched_changes > (sched_heap_cnt / 16)))
+		sched_heap_valid = false;
+	if (rec->gen == 0)
+		_sched_heap_push(rec);
+	else if (sched_heap_valid)
+		_sched_heap_fix(rec->heap_inx);
+	rec->gen = sched_gen;
+}
+
+/* Queue a job for re-test by the next _sched_queue_refresh() */
+static void _sched_dirty_add(uint32_t job_id)
+{
+	if (sched_dirty_cnt &&
+	    (sched_dirty[sched_dirty_cnt - 1] == job_id))
+		return;
+	if (sched_dirty_cnt >= SCHED_DIRTY_MAX) {
+		sched_rescan_time = 0;	/* Test all jobs on next pass */
+		return;
+	}
+	if (sched_dirty_cnt >= sched_dirty_size) {
+		sched_dirty_size = MAX(256, sched_dirty_size * 2);
+		xrealloc(sched_dirty, sizeof(uint32_t) * sched_dirty_size);
+	}
+	sched_dirty[sched_dirty_cnt++] = job_id;
+}
+
+/* Remove a record from the queue, wherever it currently is */
+static void _sched_queue_del(sched_queue_rec_t *rec)
+{
+	int i;
+
+	if (rec->heap_inx >= 0) {
+		_sched_heap_delete(rec->heap_inx);
+	} else {
+		for (i = 0; i < sched_popped_cnt; i++) {
+			if (sched_popped[i] != rec)
+				continue;
+			sched_popped[i] = sched_popped[--sched_popped_cnt];
+			break;
+		}
+	}
+	_sched_hash_remove(rec);
+	xfree(rec);
+}
+
+/* Remove records of a job not found runnable in this pass */
+static void _sched_queue_prune(uint32_t job_id)
+{
+	sched_queue_rec_t *rec, *next;
+
+	if (!sched_hash)
+		return;
+	for (rec = id_hash_find(sched_hash, job_id); rec; rec = next) {
+		next = rec->next;
+		if (rec->gen != sched_gen)
+			_sched_queue_del(rec);
+	}
+}
+
+/*
+ * Bring the persistent job queue up to date with the pending jobs: re-test
+ * the jobs changed since the last pass, or every job when a change may affect
+ * any of them, then add or re-sort runnable pairs and remove those no longer
+ * found runnable
+ */
+static void _sched_queue_refresh(void)
+{
+	static time_t config_update = 0, part_update = 0, resv_update = 0;
+	sched_queue_rec_t **stale = NULL;
+	struct job_record *job_ptr;
+	bool rescan = false;
+	int i, stale_cnt = 0;
+	time_t now = time(NULL);
+	double since_rescan = difftime(now, sched_rescan_time);
+
+	if (config_update != slurmctld_conf.last_update) {
+		sched_preempt = slurm_preemption_enabled();
+		config_update = slurmctld_conf.last_update;
+		rescan = true;
+	}
+	if ((part_update != last_part_update) ||
+	    (resv_update != last_resv_update)) {
+		part_update = last_part_update;
+		resv_update = last_resv_update;
+		rescan = true;
+	}
+	if ((since_rescan >= SCHED_RESCAN_INTERVAL) ||
+	    (sched_job_ended && (since_rescan >= SCHED_RESCAN_MIN)))
+		rescan = true;
+
+	if (++sched_gen == 0)
+		sched_gen = 1;
+	sched_changes = 0;
+
+	if (rescan) {
+		/* Preemption order depends upon partitions and QOS, re-sort */
+		if (sched_preempt)
+			sched_heap_valid = false;
+		sched_job_ended = false;
+		sched_rescan_time = now;
+		_build_job_queue(false, false, _sched_queue_add, NULL);
+		for (i = 0; i < sched_heap_cnt; i++) {
+			if (sched_heap[i]->gen == sched_gen)
+				continue;
+			if (!stale)
+				stale = xmalloc(sizeof(sched_queue_rec_t *) *
+						(sched_heap_cnt - i));
+			stale[stale_cnt++] = sched_heap[i];
+		}
+		for (i = 0; i < stale_cnt; i++)
+			_sched_queue_del(stale[i]);
+		xfree(stale);
+	} else {
+		for (i = 0; i < sched_dirty_cnt; i++) {
+			job_ptr = find_job_record(sched_dirty[i]);
+			if (job_ptr) {
+				(void) _build_job_pairs(job_ptr, false, false,
+							_sched_queue_add, NULL);
+			}
+			_sched_queue_prune(sched_dirty[i]);
+		}
+	}
+	sched_dirty_cnt = 0;
+
+	if (!sched_heap_valid) {
+		for (i = (sched_heap_cnt / 2) - 1; i >= 0; i--)
+			_sched_heap_fix(i);
+		sched_heap_valid = true;
+	}
+}
+
+/* RET the next job/partition pair to schedule, kept until restored */
+static sched_queue_rec_t *_sched_queue_pop(void)
+{
+	sched_queue_rec_t *rec;
+
+	if (sched_heap_cnt == 0)
+		return NULL;
+	rec = sched_heap[0];
+	_sched_heap_delete(0);
+	if (sched_popped_cnt >= sched_popped_size) {
+		sched_popped_size = MAX(64, sched_popped_size * 2);
+		xrealloc(sched_popped,
+			 sizeof(sched_queue_rec_t *) * sched_popped_size);
+	}
+	sched_popped[sched_popped_cnt++] = rec;
+	return rec;
+}
+
+/* Return records popped in this pass to the queue, the next refresh drops
+ * those of jobs which started */
+static void _sched_queue_restore(void)
+{
+	int i;
+
+	for (i = 0; i < sched_popped_cnt; i++) {
+		sched_popped[i]->rec.job_ptr->preempt_in_progress = false;
+		_sched_heap_push(sched_popped[i]);
+	}
+	sched_popped_cnt = 0;
+}
+
+/*
+ * Note that a job was created, changed or ended so that the main scheduler
+ * re-tests it on its next pass. Call with the job write lock held.
+ */
+extern void job_queue_update(struct job_record *job_ptr)
+{
+	if (IS_JOB_FINISHED(job_ptr))
+		sched_job_ended = true;	/* Dependent jobs may now run */
+	_sched_dirty_add(job_ptr->job_id);
+}
+
+/*
+ * Remove a job's records from the main scheduler's queue before the job
+ * record is purged. Call with the job write lock held.
+ */
+extern void job_queue_remove(struct job_record *job_ptr)
+{
+	sched_queue_rec_t *rec, *next;
+
+	if (!sched_hash)
+		return;
+	for (rec = id_hash_find(sched_hash, job_ptr->job_id); rec; rec = next) {
+		next = rec->next;
+		_sched_queue_del(rec);
+	}
+}
+
+/* Free the persistent job queue of the main scheduler */
+extern void job_queue_fini(void)
+{
+	int i;
+
+	for (i = 0; i < sched_heap_cnt; i++)
+		xfree(sched_heap[i]);
+	for (i = 0; i < sched_popped_cnt; i++)
+		xfree(sched_popped[i]);
+	xfree(sched_heap);
+	xfree(sched_popped);
+	xfree(sched_dirty);
+	sched_heap_cnt = sched_heap_size = 0;
+	sched_popped_cnt = sched_popped_size = 0;
+	sched_dirty_cnt = sched_dirty_size = 0;
+	sched_rescan_time = 0;
+	if (sched_hash) {
+		id_hash_free(sched_hash);
+		sched_hash = NULL;
+	}
+	sched_heap_valid = false;
+}
+
 /*
  * sort_job_queue - sort job_queue in descending priority order
  * IN/OUT job_queue - sorted job queue
@@ -4237,6 +4686,7 @@ cleanup_completing(struct job_record *job_ptr)
 	time_t delay;
 
 	trace_job(job_ptr, __func__, "");
+	job_state_changed(job_ptr);
 
 	delay = last_job_update - job_ptr->end_time;
 	if (delay > 60) {
@@ -90,6 +90,21 @@ extern bool deadline_ok(struct job_record *job_ptr, char *func);
  */
 extern int epilog_slurmctld(struct job_record *job_ptr);
 
+/* Free the persistent job queue of the main scheduler */
+extern void job_queue_fini(void);
+
+/*
+ * Note that a job was created, changed or ended so that the main scheduler
+ * re-tests it on its next pass. Call with the job write lock held.
+ */
+extern void job_queue_update(struct job_record *job_ptr);
+
+/*
+ * Remove a job's records from the main scheduler's queue before the job
+ * record is purged. Call with the job write lock held.
+ */
+extern void job_queue_remove(struct job_record *job_ptr);
+
 /*
  * job_is_completing - Determine if jobs are in the process of completing.
  * RET - True of any job is in the process of completing AND
@@ -40,18 +40,61 @@
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 
-static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
+/*
+ * Each entity (config, job, node, partition, federation) has its own mutex
+ * and condition variable protecting its lock counters. A thread waiting on
+ * one entity is only woken by state changes of that entity, so heavy job
+ * lock traffic no longer forces every node or partition lock waiter to
+ * wake up, re-acquire a single global mutex and go back to sleep.
+ */
+static pthread_mutex_t locks_mutex[ENTITY_COUNT];
+static pthread_cond_t locks_cond[ENTITY_COUNT];
 static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t locks_once = PTHREAD_ONCE_INIT;
 
 static slurmctld_lock_flags_t slurmctld_locks;
 static int kill_thread = 0;
 
+/*
+ * Wait and hold times of each entity's read and write locks, protected by
+ * the mutex of the entity. Hold times of read locks are summed over all
+ * readers, so they can exceed the elapsed time.
+ */
+typedef struct lock_stat {
+	uint32_t cnt;		/* locks granted */
+	uint64_t wait_usec;	/* time waiting for the lock */
+	uint64_t wait_max;
+	uint64_t hold_usec;	/* time the lock was held */
+	uint64_t hold_max;
+} lock_stat_t;
+
+#define lock_stat_inx(data_type, write)	(data_type * 2 + (write ? 1 : 0))
+static lock_stat_t lock_stats[ENTITY_COUNT * 2];
+
+/* Lock timing of one thread, see _thread_locks() */
+typedef struct thread_locks {
+	uint64_t grant_usec[ENTITY_COUNT]; /* when each lock was granted */
+	int held_cnt;			/* entities currently locked */
+	uint64_t held_start;		/* when held_cnt became non-zero */
+	uint64_t hold_usec;		/* total time any lock was held */
+} thread_locks_t;
+
+static pthread_key_t thread_locks_key;
+
+static void _init_entity_locks(void);
+static void _lock_granted(lock_datatype_t datatype, bool write,
+			  uint64_t wait_start);
+static void _lock_released(lock_datatype_t datatype, bool write);
+static thread_locks_t *_thread_locks(void);
+static uint64_t _usec_now(void);
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock);
 static void _wr_rdunlock(lock_datatype_t datatype);
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock);
@@ -61,8 +104,93 @@ static void _wr_wrunlock(lock_datatype_t datatype);
  *	control */
 void init_locks(void)
 {
+	int i;
+
+	pthread_once(&locks_once, _init_entity_locks);
+
 	/* just clear all semaphores */
+	for (i = 0; i < ENTITY_COUNT; i++)
+		slurm_mutex_lock(&locks_mutex[i]);
 	memset((void *) &slurmctld_locks, 0, sizeof(slurmctld_locks));
+	for (i = ENTITY_COUNT - 1; i >= 0; i--)
+		slurm_mutex_unlock(&locks_mutex[i]);
+}
+
+static void _free_thread_locks(void *arg)
+{
+	xfree(arg);
+}
+
+static void _init_entity_locks(void)
+{
+	int i;
+
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		slurm_mutex_init(&locks_mutex[i]);
+		slurm_cond_init(&locks_cond[i], NULL);
+	}
+	if (pthread_key_create(&thread_locks_key, _free_thread_locks))
+		fatal("%s: pthread_key_create: %m", __func__);
+}
+
+static uint64_t _usec_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((uint64_t) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+/* Return the lock timing record of the calling thread */
+static thread_locks_t *_thread_locks(void)
+{
+	thread_locks_t *thread_locks = pthread_getspecific(thread_locks_key);
+
+	if (!thread_locks) {
+		thread_locks = xmalloc(sizeof(thread_locks_t));
+		if (pthread_setspecific(thread_locks_key, thread_locks))
+			fatal("%s: pthread_setspecific: %m", __func__);
+	}
+	return thread_locks;
+}
+
+/* Record the grant of a lock. Call with the entity's mutex locked.
+ * IN wait_start - when the lock was requested */
+static void _lock_granted(lock_datatype_t datatype, bool write,
+			  uint64_t wait_start)
+{
+	lock_stat_t *stat = &lock_stats[lock_stat_inx(datatype, write)];
+	thread_locks_t *thread_locks = _thread_locks();
+	uint64_t now = _usec_now(), wait_usec;
+
+	wait_usec = (now > wait_start) ? (now - wait_start) : 0;
+	stat->cnt++;
+	stat->wait_usec += wait_usec;
+	if (wait_usec > stat->wait_max)
+		stat->wait_max = wait_usec;
+
+	thread_locks->grant_usec[datatype] = now;
+	if (thread_locks->held_cnt++ == 0)
+		thread_locks->held_start = now;
+}
+
+/* Record the release of a lock. Call with the entity's mutex locked. */
+static void _lock_released(lock_datatype_t datatype, bool write)
+{
+	lock_stat_t *stat = &lock_stats[lock_stat_inx(datatype, write)];
+	thread_locks_t *thread_locks = _thread_locks();
+	uint64_t now = _usec_now(), hold_usec = 0;
+
+	if (now > thread_locks->grant_usec[datatype])
+		hold_usec = now - thread_locks->grant_usec[datatype];
+	stat->hold_usec += hold_usec;
+	if (hold_usec > stat->hold_max)
+		stat->hold_max = hold_usec;
+
+	if ((thread_locks->held_cnt > 0) &&
+	    (--thread_locks->held_cnt == 0) &&
+	    (now > thread_locks->held_start))
+		thread_locks->hold_usec += now - thread_locks->held_start;
 }
 
 /* lock_slurmctld - Issue the required lock requests in a well defined order */
@@ -223,8 +351,10 @@ extern void unlock_slurmctld(slurmctld_lock_t lock_levels)
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 {
 	bool success = true;
+	uint64_t wait_start = _usec_now();
 
-	slurm_mutex_lock(&locks_mutex);
+	pthread_once(&locks_once, _init_entity_locks);
+	slurm_mutex_lock(&locks_mutex[datatype]);
 	while (1) {
 #if 1
 		if ((slurmctld_locks.entity[write_lock(datatype)] == 0) &&
@@ -237,35 +367,44 @@ static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 #endif
 			slurmctld_locks.entity[read_lock(datatype)]++;
 			slurmctld_locks.entity[write_cnt_lock(datatype)] = 0;
+			_lock_granted(datatype, false, wait_start);
 			break;
 		} else if (!wait_lock) {
 			success = false;
 			break;
 		} else {	/* wait for state change and retry */
-			slurm_cond_wait(&locks_cond, &locks_mutex);
-			if (kill_thread)
+			slurm_cond_wait(&locks_cond[datatype],
+					&locks_mutex[datatype]);
+			if (kill_thread) {
+				slurm_mutex_unlock(&locks_mutex[datatype]);
 				pthread_exit(NULL);
+			}
 		}
 	}
-	slurm_mutex_unlock(&locks_mutex);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 	return success;
 }
 
-/* _wr_rdunlock - Issue a read unlock on the specified data type */
+/* _wr_rdunlock - Issue a read unlock on the specified data type
+ *	Other readers can never be blocked by a read lock, so waiters only
+ *	need to be woken once the last reader is gone */
 static void _wr_rdunlock(lock_datatype_t datatype)
 {
-	slurm_mutex_lock(&locks_mutex);
-	slurmctld_locks.entity[read_lock(datatype)]--;
-	slurm_cond_broadcast(&locks_cond);
-	slurm_mutex_unlock(&locks_mutex);
+	slurm_mutex_lock(&locks_mutex[datatype]);
+	_lock_released(datatype, false);
+	if (--slurmctld_locks.entity[read_lock(datatype)] == 0)
+		slurm_cond_broadcast(&locks_cond[datatype]);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 }
 
 /* _wr_wrlock - Issue a write lock on the specified data type */
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 {
 	bool success = true;
+	uint64_t wait_start = _usec_now();
 
-	slurm_mutex_lock(&locks_mutex);
+	pthread_once(&locks_once, _init_entity_locks);
+	slurm_mutex_lock(&locks_mutex[datatype]);
 	slurmctld_locks.entity[write_wait_lock(datatype)]++;
 
 	while (1) {
@@ -274,44 +413,129 @@ static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 			slurmctld_locks.entity[write_lock(datatype)]++;
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
 			slurmctld_locks.entity[write_cnt_lock(datatype)]++;
+			_lock_granted(datatype, true, wait_start);
 			break;
 		} else if (!wait_lock) {
-			slurmctld_locks.entity[write_wait_lock(datatype)]--;
+			/* Readers held off by this pending writer may proceed */
+			if (--slurmctld_locks.entity[write_wait_lock(datatype)]
+			    == 0)
+				slurm_cond_broadcast(&locks_cond[datatype]);
 			success = false;
 			break;
 		} else {	/* wait for state change and retry */
-			slurm_cond_wait(&locks_cond, &locks_mutex);
-			if (kill_thread)
+			slurm_cond_wait(&locks_cond[datatype],
+					&locks_mutex[datatype]);
+			if (kill_thread) {
+				slurm_mutex_unlock(&locks_mutex[datatype]);
 				pthread_exit(NULL);
+			}
 		}
 	}
-	slurm_mutex_unlock(&locks_mutex);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 	return success;
 }
 
 /* _wr_wrunlock - Issue a write unlock on the specified data type */
 static void _wr_wrunlock(lock_datatype_t datatype)
 {
-	slurm_mutex_lock(&locks_mutex);
+	slurm_mutex_lock(&locks_mutex[datatype]);
+	_lock_released(datatype, true);
 	slurmctld_locks.entity[write_lock(datatype)]--;
-	slurm_cond_broadcast(&locks_cond);
-	slurm_mutex_unlock(&locks_mutex);
+	slurm_cond_broadcast(&locks_cond[datatype]);
+	slurm_mutex_unlock(&locks_mutex[datatype]);
 }
 
 /* get_lock_values - Get the current value of all locks
  * OUT lock_flags - a copy of the current lock values */
 void get_lock_values(slurmctld_lock_flags_t * lock_flags)
 {
+	int i;
+
 	xassert(lock_flags);
+	pthread_once(&locks_once, _init_entity_locks);
+	for (i = 0; i < ENTITY_COUNT; i++)
+		slurm_mutex_lock(&locks_mutex[i]);
 	memcpy((void *) lock_flags, (void *) &slurmctld_locks,
 	       sizeof(slurmctld_locks));
+	for (i = ENTITY_COUNT - 1; i >= 0; i--)
+		slurm_mutex_unlock(&locks_mutex[i]);
+}
+
+/* lock_thread_hold_usec - Get the time the calling thread has spent holding
+ *	any slurmctld lock, in microseconds */
+extern uint64_t lock_thread_hold_usec(void)
+{
+	thread_locks_t *thread_locks;
+	uint64_t hold_usec, now;
+
+	pthread_once(&locks_once, _init_entity_locks);
+	thread_locks = _thread_locks();
+	hold_usec = thread_locks->hold_usec;
+	if (thread_locks->held_cnt) {
+		now = _usec_now();
+		if (now > thread_locks->held_start)
+			hold_usec += now - thread_locks->held_start;
+	}
+	return hold_usec;
+}
+
+/* Pack the wait and hold statistics of each entity's read and write locks */
+extern void pack_lock_stats(Buf buffer)
+{
+	lock_stat_t stats[ENTITY_COUNT * 2];
+	uint32_t cnt[ENTITY_COUNT * 2];
+	uint64_t wait_usec[ENTITY_COUNT * 2], wait_max[ENTITY_COUNT * 2];
+	uint64_t hold_usec[ENTITY_COUNT * 2], hold_max[ENTITY_COUNT * 2];
+	int i;
+
+	pthread_once(&locks_once, _init_entity_locks);
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		slurm_mutex_lock(&locks_mutex[i]);
+		stats[lock_stat_inx(i, false)] =
+			lock_stats[lock_stat_inx(i, false)];
+		stats[lock_stat_inx(i, true)] =
+			lock_stats[lock_stat_inx(i, true)];
+		slurm_mutex_unlock(&locks_mutex[i]);
+	}
+	for (i = 0; i < ENTITY_COUNT * 2; i++) {
+		cnt[i]       = stats[i].cnt;
+		wait_usec[i] = stats[i].wait_usec;
+		wait_max[i]  = stats[i].wait_max;
+		hold_usec[i] = stats[i].hold_usec;
+		hold_max[i]  = stats[i].hold_max;
+	}
+
+	pack32(ENTITY_COUNT * 2, buffer);
+	pack32_array(cnt,       ENTITY_COUNT * 2, buffer);
+	pack64_array(wait_usec, ENTITY_COUNT * 2, buffer);
+	pack64_array(wait_max,  ENTITY_COUNT * 2, buffer);
+	pack64_array(hold_usec, ENTITY_COUNT * 2, buffer);
+	pack64_array(hold_max,  ENTITY_COUNT * 2, buffer);
+}
+
+/* Clear the lock wait and hold statistics */
+extern void reset_lock_stats(void)
+{
+	int i;
+
+	pthread_once(&locks_once, _init_entity_locks);
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		slurm_mutex_lock(&locks_mutex[i]);
+		memset(&lock_stats[lock_stat_inx(i, false)], 0,
+		       sizeof(lock_stat_t) * 2);
+		slurm_mutex_unlock(&locks_mutex[i]);
+	}
 }
 
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads(void)
 {
+	int i;
+
 	kill_thread = 1;
-	slurm_cond_broadcast(&locks_cond);
+	pthread_once(&locks_once, _init_entity_locks);
+	for (i = 0; i < ENTITY_COUNT; i++)
+		slurm_cond_broadcast(&locks_cond[i]);
 }
 
 /* un/lock semaphore used for saving state of slurmctld */
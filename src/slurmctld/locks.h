@@ -75,6 +75,13 @@
  * number of writers waiting semaphore to become 0, meaning that there are no
  * writers waiting to lock the resource.
  *
+ * The counters of each entity are protected by a mutex and condition
+ * variable private to that entity, so lock traffic on one data structure
+ * (e.g. jobs) does not wake threads waiting on another (e.g. nodes).
+ * The locks themselves are still one read/write lock per entity: there is
+ * no per-job or per-node record locking, so all job (or node) operations
+ * still serialize on the job (or node) entity lock.
+ *
  * use init_locks() to initialize the locks then
  * lock_slurmctld() and unlock_slurmctld() to get the ordering so as to
  * prevent deadlock. The arguments indicate the lock type required for
@@ -91,6 +98,8 @@
 #ifndef _SLURMCTLD_LOCKS_H
 #define _SLURMCTLD_LOCKS_H
 
+#include <inttypes.h>
+
 /* levels of locking required for each data structure */
 typedef enum {
 	NO_LOCK,
@@ -149,6 +158,11 @@ extern void kill_locked_threads ( void );
 /* lock_slurmctld - Issue the required lock requests in a well defined order */
 extern void lock_slurmctld (slurmctld_lock_t lock_levels);
 
+/* lock_thread_hold_usec - Get the time the calling thread has spent holding
+ *	any slurmctld lock, in microseconds. The difference between two
+ *	calls gives the lock hold time of the work done in between. */
+extern uint64_t lock_thread_hold_usec(void);
+
 /* try_lock_slurmctld - equivalent to lock_slurmctld() except 
  * RET 0 on success or -1 if the locks are currently not available */
 extern int try_lock_slurmctld (slurmctld_lock_t lock_levels);
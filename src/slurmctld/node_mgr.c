@@ -79,6 +79,7 @@
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
+#include "src/slurmctld/snapshot.h"
 #include "src/slurmctld/state_save.h"
 #include "src/common/timers.h"
 #include "src/slurmctld/trigger_mgr.h"
@@ -106,10 +107,13 @@ static front_end_record_t * _front_end_reg(
 static bool	_is_cloud_hidden(struct node_record *node_ptr);
 static void 	_make_node_down(struct node_record *node_ptr,
 				time_t event_time);
+static bitstr_t *_node_cond_bitmap(node_info_cond_t *cond);
 static bool	_node_is_hidden(struct node_record *node_ptr, uid_t uid);
 static int	_open_node_state_file(char **state_file);
 static void 	_pack_node(struct node_record *dump_node_ptr, Buf buffer,
 			   uint16_t protocol_version, uint16_t show_flags);
+static void	_pack_node_placeholder(struct node_record *dump_node_ptr,
+				       Buf buffer, uint16_t protocol_version);
 static void	_sync_bitmaps(struct node_record *node_ptr, int job_count);
 static void	_update_config_ptr(bitstr_t *bitmap,
 				struct config_record *config_ptr);
@@ -770,6 +774,39 @@ static bool _node_is_hidden(struct node_record *node_ptr, uid_t uid)
 	return true;
 }
 
+/* Return a bitmap of the nodes matching the filters of a node information
+ * request, free with bit_free() */
+static bitstr_t *_node_cond_bitmap(node_info_cond_t *cond)
+{
+	bitstr_t *node_bitmap = NULL, *part_bitmap;
+	struct part_record *part_ptr;
+	char *tmp, *tok, *save_ptr = NULL;
+
+	if (cond->nodes) {
+		(void) node_name2bitmap(cond->nodes, true, &node_bitmap);
+	} else {
+		node_bitmap = bit_alloc(node_record_count);
+		bit_nset(node_bitmap, 0, node_record_count - 1);
+	}
+
+	if (cond->partitions) {
+		part_bitmap = bit_alloc(node_record_count);
+		tmp = xstrdup(cond->partitions);
+		tok = strtok_r(tmp, ",", &save_ptr);
+		while (tok) {
+			part_ptr = find_part_record(tok);
+			if (part_ptr && part_ptr->node_bitmap)
+				bit_or(part_bitmap, part_ptr->node_bitmap);
+			tok = strtok_r(NULL, ",", &save_ptr);
+		}
+		xfree(tmp);
+		bit_and(node_bitmap, part_bitmap);
+		bit_free(part_bitmap);
+	}
+
+	return node_bitmap;
+}
+
 /*
  * pack_all_node - dump all configuration and node information for all nodes
  *	in machine independent form (for network transmission)
@@ -777,6 +814,8 @@ static bool _node_is_hidden(struct node_record *node_ptr, uid_t uid)
  * OUT buffer_size - set to size of the buffer in bytes
  * IN show_flags - node filtering options
  * IN uid - uid of user making request (for partition filtering)
+ * IN cond - nodes to report, others are packed as nameless placeholders,
+ *	NULL for all nodes
  * IN protocol_version - slurm protocol version of client
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
@@ -786,13 +825,14 @@ static bool _node_is_hidden(struct node_record *node_ptr, uid_t uid)
  */
 extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid,
-			   uint16_t protocol_version)
+			   node_info_cond_t *cond, uint16_t protocol_version)
 {
 	int inx;
 	uint32_t nodes_packed, tmp_offset, node_scaling;
 	Buf buffer;
 	time_t now = time(NULL);
 	struct node_record *node_ptr = node_record_table_ptr;
+	bitstr_t *cond_bitmap = NULL;
 	bool hidden;
 
 	buffer_ptr[0] = NULL;
@@ -811,12 +851,21 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 		pack_time(now, buffer);
 
 		/* write node records */
+		if (cond)
+			cond_bitmap = _node_cond_bitmap(cond);
 		part_filter_set(uid);
 		for (inx = 0; inx < node_record_count; inx++, node_ptr++) {
 			xassert (node_ptr->magic == NODE_MAGIC);
 			xassert (node_ptr->config_ptr->magic ==
 				 CONFIG_MAGIC);
 
+			if (cond_bitmap && !bit_test(cond_bitmap, inx)) {
+				_pack_node_placeholder(node_ptr, buffer,
+						       protocol_version);
+				nodes_packed++;
+				continue;
+			}
+
 			/* We can't avoid packing node records without breaking
 			 * the node index pointers. So pack a node
 			 * with a name of NULL and let the caller deal
@@ -846,6 +895,7 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			nodes_packed++;
 		}
 		part_filter_clear();
+		FREE_NULL_BITMAP(cond_bitmap);
 	} else {
 		error("select_g_select_jobinfo_pack: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -860,6 +910,40 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 	buffer_ptr[0] = xfer_buf_data (buffer);
 }
 
+/*
+ * node_view_key - Return a key shared by all users who get the same
+ *	response from pack_all_node(): the partitions hidden from them
+ * IN uid - uid of user making request
+ * IN show_flags - node filtering options
+ * RET xmalloc'd key, NULL if the response is specific to uid
+ * NOTE: READ lock_slurmctld config and WRITE lock part before entry
+ */
+extern char *node_view_key(uid_t uid, uint16_t show_flags)
+{
+	ListIterator part_iterator;
+	struct part_record *part_ptr;
+	char *key;
+
+	if ((show_flags & SHOW_ALL) || (uid == 0))
+		return xstrdup("all");
+
+	/* MCS labels hide nodes from each user individually */
+	if ((slurmctld_conf.private_data & PRIVATE_DATA_NODES) &&
+	    (slurm_mcs_get_privatedata() == 1) && !validate_operator(uid))
+		return NULL;
+
+	key = xstrdup("hidden:");
+	part_iterator = list_iterator_create(part_list);
+	while ((part_ptr = list_next(part_iterator))) {
+		if ((part_ptr->flags & PART_FLAG_HIDDEN) ||
+		    (validate_group(part_ptr, uid) == 0))
+			xstrfmtcat(key, "%s,", part_ptr->name);
+	}
+	list_iterator_destroy(part_iterator);
+
+	return key;
+}
+
 /*
  * pack_one_node - dump all configuration and node information for one node
  *	in machine independent form (for network transmission)
@@ -953,6 +1037,70 @@ extern void pack_one_node (char **buffer_ptr, int *buffer_size,
  * 	to _unpack_node_info_members() in common/slurm_protocol_pack.c
  * NOTE: READ lock_slurmctld config before entry
  */
+/*
+ * _pack_node_placeholder - pack a nameless record in place of a node not
+ *	requested by the client, keeping the node indexes of partitions and
+ *	jobs valid. Only the select plugin data (which has no empty form)
+ *	is real, everything else is zero or NULL.
+ */
+static void _pack_node_placeholder(struct node_record *dump_node_ptr,
+				   Buf buffer, uint16_t protocol_version)
+{
+	char *orig_name;
+
+	if (protocol_version < SLURM_17_02_PROTOCOL_VERSION) {
+		orig_name = dump_node_ptr->name;
+		dump_node_ptr->name = NULL;
+		_pack_node(dump_node_ptr, buffer, protocol_version, 0);
+		dump_node_ptr->name = orig_name;
+		return;
+	}
+
+	packnull(buffer);			/* name */
+	packnull(buffer);			/* node_hostname */
+	packnull(buffer);			/* comm_name */
+	pack32((uint32_t) NODE_STATE_UNKNOWN, buffer);
+	packnull(buffer);			/* version */
+	pack16((uint16_t) 0, buffer);		/* cpus */
+	pack16((uint16_t) 0, buffer);		/* boards */
+	pack16((uint16_t) 0, buffer);		/* sockets */
+	pack16((uint16_t) 0, buffer);		/* cores */
+	pack16((uint16_t) 0, buffer);		/* threads */
+	pack64((uint64_t) 0, buffer);		/* real_memory */
+	pack32((uint32_t) 0, buffer);		/* tmp_disk */
+	packnull(buffer);			/* mcs_label */
+	pack32((uint32_t) NO_VAL, buffer);	/* owner */
+	pack16((uint16_t) 0, buffer);		/* core_spec_cnt */
+	pack64((uint64_t) 0, buffer);		/* mem_spec_limit */
+	packnull(buffer);			/* cpu_spec_list */
+
+	pack32((uint32_t) 0, buffer);		/* cpu_load */
+	pack64((uint64_t) 0, buffer);		/* free_mem */
+	pack32((uint32_t) 0, buffer);		/* weight */
+	pack32((uint32_t) 0, buffer);		/* reason_uid */
+
+	pack_time((time_t) 0, buffer);		/* boot_time */
+	pack_time((time_t) 0, buffer);		/* reason_time */
+	pack_time((time_t) 0, buffer);		/* slurmd_start_time */
+
+	select_g_select_nodeinfo_pack(dump_node_ptr->select_nodeinfo,
+				      buffer, protocol_version);
+
+	packnull(buffer);			/* arch */
+	packnull(buffer);			/* features */
+	packnull(buffer);			/* features_act */
+	packnull(buffer);			/* gres */
+	packnull(buffer);			/* gres_drain */
+	packnull(buffer);			/* gres_used */
+	packnull(buffer);			/* os */
+	packnull(buffer);			/* reason */
+	acct_gather_energy_pack(NULL, buffer, protocol_version);
+	ext_sensors_data_pack(NULL, buffer, protocol_version);
+	power_mgmt_data_pack(NULL, buffer, protocol_version);
+
+	packnull(buffer);			/* tres_fmt_str */
+}
+
 static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
 			uint16_t protocol_version, uint16_t show_flags)
 {
@@ -2525,16 +2673,18 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 	node_ptr->os = reg_msg->os;
 	reg_msg->os = NULL;	/* Nothing left to free */
 
+	/* Refresh the sample times even if the values are unchanged so
+	 * ping_nodes() need not ask for them again */
 	if (node_ptr->cpu_load != reg_msg->cpu_load) {
 		node_ptr->cpu_load = reg_msg->cpu_load;
-		node_ptr->cpu_load_time = now;
 		last_node_update = now;
 	}
+	node_ptr->cpu_load_time = now;
 	if (node_ptr->free_mem != reg_msg->free_mem) {
 		node_ptr->free_mem = reg_msg->free_mem;
-		node_ptr->free_mem_time = now;
 		last_node_update = now;
 	}
+	node_ptr->free_mem_time = now;
 
 	if (IS_NODE_NO_RESPOND(node_ptr) || IS_NODE_POWER_UP(node_ptr)) {
 		info("Node %s now responding", node_ptr->name);
@@ -3674,7 +3824,9 @@ void make_node_idle(struct node_record *node_ptr,
 	bitstr_t *node_bitmap = NULL;
 	char jbuf[JBUFSIZ];
 
+	snapshot_node_alloc_changed();
 	if (job_ptr) {
+		job_state_changed(job_ptr);
 		if (job_ptr->node_bitmap_cg)
 			node_bitmap = job_ptr->node_bitmap_cg;
 		else
@@ -3933,3 +4085,23 @@ extern void reset_node_free_mem(char *node_name, uint64_t free_mem)
 #endif
 }
 
+/* Reset a node's energy data from a sample piggybacked on another message */
+extern void reset_node_energy(char *node_name, acct_gather_energy_t *energy)
+{
+#ifdef HAVE_FRONT_END
+	return;
+#else
+	struct node_record *node_ptr;
+
+	if (!energy || !energy->poll_time)
+		return;		/* No energy plugin or no sample yet */
+	node_ptr = find_node_record(node_name);
+	if (node_ptr) {
+		if (node_ptr->energy->poll_time <= energy->poll_time)
+			memcpy(node_ptr->energy, energy,
+			       sizeof(acct_gather_energy_t));
+	} else
+		error("reset_node_energy unable to find node %s", node_name);
+#endif
+}
+
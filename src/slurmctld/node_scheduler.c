@@ -84,6 +84,7 @@
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
+#include "src/slurmctld/snapshot.h"
 
 #define MAX_FEATURES  32	/* max exclusive features "[fs1|fs2]"=2 */
 #define MAX_RETRIES   10
@@ -408,6 +409,7 @@ extern void allocate_nodes(struct job_record *job_ptr)
 	}
 
 	last_node_update = time(NULL);
+	snapshot_node_alloc_changed();
 	license_job_get(job_ptr);
 
 	if (has_cloud) {
@@ -502,6 +504,7 @@ extern void deallocate_nodes(struct job_record *job_ptr, bool timeout,
 	agent_args->hostlist = hostlist_create(NULL);
 	kill_job = xmalloc(sizeof(kill_job_msg_t));
 	last_node_update    = time(NULL);
+	snapshot_node_alloc_changed();
 	kill_job->job_id    = job_ptr->job_id;
 	kill_job->step_id   = NO_VAL;
 	kill_job->job_state = job_ptr->job_state;
@@ -772,22 +775,20 @@ extern void build_active_feature_bitmap(struct job_record *job_ptr,
 		    (node_feat_ptr->node_bitmap == NULL)) {
 			if (!tmp_bitmap)
 				tmp_bitmap = bit_alloc(node_record_count);
-			bit_nset(tmp_bitmap, 0, node_record_count-1);
+			else
+				bit_nclear(tmp_bitmap, 0, node_record_count-1);
 			continue;
 		}
-		if (!tmp_bitmap) {
+		/* Leave the shared feature bitmap untouched, the backfill
+		 * scheduler may call this from several threads at once */
+		if (!tmp_bitmap)
 			tmp_bitmap = bit_copy(node_feat_ptr->node_bitmap);
-			bit_not(tmp_bitmap);
-		} else {
-			bit_not(node_feat_ptr->node_bitmap);
-			bit_or(tmp_bitmap, node_feat_ptr->node_bitmap);
-			bit_not(node_feat_ptr->node_bitmap);
-		}
+		else
+			bit_and(tmp_bitmap, node_feat_ptr->node_bitmap);
 	}
 	list_iterator_destroy(feat_iter);
 
 	if (tmp_bitmap) {
-		bit_not(tmp_bitmap);
 		if (bit_super_set(avail_bitmap, tmp_bitmap)) {
 			FREE_NULL_BITMAP(tmp_bitmap);
 		} else {
@@ -2579,6 +2580,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	configuring = IS_JOB_CONFIGURING(job_ptr);
 
 	job_ptr->job_state = JOB_RUNNING;
+	job_state_changed(job_ptr);
 	if (nonstop_ops.job_begin)
 		(nonstop_ops.job_begin)(job_ptr);
 
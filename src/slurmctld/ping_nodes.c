@@ -536,6 +536,11 @@ extern void update_nodes_acct_gather_data(void)
 	int i;
 	char *host_str = NULL;
 	agent_arg_t *agent_args = NULL;
+#ifndef HAVE_FRONT_END
+	/* Samples piggybacked on pings or epilog completions are as good */
+	time_t old_energy_time = time(NULL) -
+				 slurmctld_conf.acct_gather_node_freq;
+#endif
 
 	agent_args = xmalloc (sizeof (agent_arg_t));
 	agent_args->msg_type = REQUEST_ACCT_GATHER_UPDATE;
@@ -562,6 +567,9 @@ extern void update_nodes_acct_gather_data(void)
 		if (IS_NODE_NO_RESPOND(node_ptr) || IS_NODE_FUTURE(node_ptr) ||
 		    IS_NODE_POWER_SAVE(node_ptr))
 			continue;
+		if (node_ptr->energy &&
+		    (node_ptr->energy->poll_time > old_energy_time))
+			continue;
 		if (agent_args->protocol_version > node_ptr->protocol_version)
 			agent_args->protocol_version =
 				node_ptr->protocol_version;
@@ -92,17 +92,28 @@
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/snapshot.h"
 #include "src/slurmctld/srun_comm.h"
 #include "src/slurmctld/state_save.h"
 #include "src/slurmctld/trigger_mgr.h"
 
 #include "src/plugins/select/bluegene/bg_enums.h"
 
+/* RPC latency histogram: bucket b counts RPCs of 2^(b-1) to 2^b - 1 usec,
+ * the last bucket counts all longer RPCs */
+#define RPC_HIST_SIZE	32
+
+/* Jobs of a REQUEST_SUBMIT_BATCH_JOBS validated or created per job lock
+ * acquisition, so a large batch does not stall other RPCs until it completes */
+#define SUBMIT_BATCH_LOCK_JOBS	256
+
 static pthread_mutex_t rpc_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int rpc_type_size = 0;	/* Size of rpc_type_* arrays */
 static uint16_t *rpc_type_id = NULL;
 static uint32_t *rpc_type_cnt = NULL;
 static uint64_t *rpc_type_time = NULL;
+static uint64_t *rpc_type_max = NULL;	/* longest RPC of each type */
+static uint32_t *rpc_type_hist = NULL;	/* RPC_HIST_SIZE buckets per type */
 static int rpc_user_size = 0;	/* Size of rpc_user_* arrays */
 static uint32_t *rpc_user_id = NULL;
 static uint32_t *rpc_user_cnt = NULL;
@@ -192,6 +203,7 @@ inline static void  _slurm_rpc_step_complete(slurm_msg_t * msg,
 inline static void  _slurm_rpc_step_layout(slurm_msg_t * msg);
 inline static void  _slurm_rpc_step_update(slurm_msg_t * msg);
 inline static void  _slurm_rpc_submit_batch_job(slurm_msg_t * msg);
+inline static void  _slurm_rpc_submit_batch_jobs(slurm_msg_t * msg);
 inline static void  _slurm_rpc_suspend(slurm_msg_t * msg);
 inline static void  _slurm_rpc_top_job(slurm_msg_t * msg);
 inline static void  _slurm_rpc_trigger_clear(slurm_msg_t * msg);
@@ -218,6 +230,18 @@ static void  _slurm_rpc_persist_init(slurm_msg_t *msg, connection_arg_t *arg);
 
 extern diag_stats_t slurmctld_diag_stats;
 
+/* Return the latency histogram bucket of an RPC taking usec microseconds */
+static inline int _rpc_hist_bucket(long usec)
+{
+	int bucket = 0;
+
+	while ((usec > 0) && (bucket < (RPC_HIST_SIZE - 1))) {
+		usec >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
 /*
  * slurmctld_req  - Process an individual RPC request
  * IN/OUT msg - the request message, data associated with the message is freed
@@ -245,6 +269,9 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 		rpc_type_id   = xmalloc(sizeof(uint16_t) * rpc_type_size);
 		rpc_type_cnt  = xmalloc(sizeof(uint32_t) * rpc_type_size);
 		rpc_type_time = xmalloc(sizeof(uint64_t) * rpc_type_size);
+		rpc_type_max  = xmalloc(sizeof(uint64_t) * rpc_type_size);
+		rpc_type_hist = xmalloc(sizeof(uint32_t) * rpc_type_size *
+					RPC_HIST_SIZE);
 	}
 	for (i = 0; i < rpc_type_size; i++) {
 		if (rpc_type_id[i] == 0)
@@ -444,6 +471,9 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	case REQUEST_SUBMIT_BATCH_JOB:
 		_slurm_rpc_submit_batch_job(msg);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		_slurm_rpc_submit_batch_jobs(msg);
+		break;
 	case REQUEST_UPDATE_FRONT_END:
 		_slurm_rpc_update_front_end(msg);
 		break;
@@ -604,6 +634,10 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	if (rpc_type_index >= 0) {
 		rpc_type_cnt[rpc_type_index]++;
 		rpc_type_time[rpc_type_index] += DELTA_TIMER;
+		if (DELTA_TIMER > rpc_type_max[rpc_type_index])
+			rpc_type_max[rpc_type_index] = DELTA_TIMER;
+		rpc_type_hist[(rpc_type_index * RPC_HIST_SIZE) +
+			      _rpc_hist_bucket(DELTA_TIMER)]++;
 	}
 	if (rpc_user_index >= 0) {
 		rpc_user_cnt[rpc_user_index]++;
@@ -716,6 +750,7 @@ static void _fill_ctld_conf(slurm_ctl_conf_t * conf_ptr)
 	conf_ptr->checkpoint_type     = xstrdup(conf->checkpoint_type);
 	conf_ptr->chos_loc            = xstrdup(conf->chos_loc);
 	conf_ptr->cluster_name        = xstrdup(conf->cluster_name);
+	conf_ptr->comm_params         = xstrdup(conf->comm_params);
 	conf_ptr->complete_wait       = conf->complete_wait;
 	conf_ptr->control_addr        = xstrdup(conf->control_addr);
 	conf_ptr->control_machine     = xstrdup(conf->control_machine);
@@ -1331,11 +1366,18 @@ static void _slurm_rpc_dump_conf(slurm_msg_t * msg)
 static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 {
 	DEF_TIMERS;
-	char *dump;
+	char *dump, *delta = NULL, *filtered = NULL;
 	int dump_size;
+	uint16_t show_flags;
+	uint32_t field_mask = JOB_FIELD_ALL;
+	uint32_t rec_cnt, *rec_id, *rec_offset;
+	uint64_t *rec_hash;
 	slurm_msg_t response_msg;
+	snapshot_t *snap = NULL;
 	job_info_request_msg_t *job_info_request_msg =
 		(job_info_request_msg_t *) msg->data;
+	bool filtered_req =
+		slurm_job_info_cond_filtered(job_info_request_msg->cond);
 	/* Locks: Read config job, write partition (for hiding) */
 	slurmctld_lock_t job_read_lock = {
 		READ_LOCK, READ_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK };
@@ -1344,38 +1386,80 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_INFO from uid=%d", uid);
-	lock_slurmctld(job_read_lock);
 
+	/* last_job_update is only advanced, an unlocked read is safe here */
 	if ((job_info_request_msg->last_update - 1) >= last_job_update) {
-		unlock_slurmctld(job_read_lock);
 		debug3("_slurm_rpc_dump_jobs, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
-	} else {
-		pack_all_jobs(&dump, &dump_size,
-			      job_info_request_msg->show_flags,
-			      g_slurm_auth_get_uid(msg->auth_cred,
-						   slurmctld_config.auth_info),
-			      NO_VAL, msg->protocol_version);
+		return;
+	}
+
+	/* Full responses and deltas are built from the plain records of one
+	 * snapshot per field mask, the compact form is only used for
+	 * filtered responses */
+	show_flags = job_info_request_msg->show_flags;
+	if (!filtered_req)
+		show_flags &= (~SHOW_COMPACT);
+	if (job_info_request_msg->cond)
+		field_mask = job_info_request_msg->cond->field_mask;
+
+	if (filtered_req) {
+		/* Filtered responses are specific to the request and cost
+		 * in proportion to the jobs matched, don't cache them */
+		lock_slurmctld(job_read_lock);
+		pack_all_jobs(&filtered, &dump_size, show_flags, uid, NO_VAL,
+			      job_info_request_msg->cond,
+			      msg->protocol_version);
 		unlock_slurmctld(job_read_lock);
-		END_TIMER2("_slurm_rpc_dump_jobs");
+		dump = filtered;
+	} else {
+		snap = snapshot_acquire(REQUEST_JOB_INFO, uid, NULL,
+					show_flags, field_mask,
+					msg->protocol_version);
+		if (!snapshot_data(snap, &dump, &dump_size)) {
+			lock_slurmctld(job_read_lock);
+			pack_all_jobs_index(&dump, &dump_size, &rec_cnt,
+					    &rec_id, &rec_offset, &rec_hash,
+					    show_flags, uid, field_mask,
+					    msg->protocol_version);
+			snapshot_set_index(snap, rec_cnt, rec_id, rec_offset,
+					   rec_hash);
+			snapshot_publish(snap, dump, dump_size);
+			unlock_slurmctld(job_read_lock);
+		}
+	}
+	if (snap && job_info_request_msg->delta_version) {
+		snapshot_pack_job_delta(snap,
+					job_info_request_msg->delta_version,
+					&delta, &dump_size);
+		dump = delta;
+	}
+	END_TIMER2("_slurm_rpc_dump_jobs");
 #if 0
-		info("_slurm_rpc_dump_jobs, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_jobs, size=%d %s", dump_size, TIME_STR);
 #endif
 
-		/* init response_msg structure */
-		slurm_msg_t_init(&response_msg);
-		response_msg.flags = msg->flags;
-		response_msg.protocol_version = msg->protocol_version;
-		response_msg.address = msg->address;
-		response_msg.conn = msg->conn;
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.conn = msg->conn;
+	if (delta)
+		response_msg.msg_type = RESPONSE_JOB_INFO_DELTA;
+	else if (show_flags & SHOW_COMPACT)
+		response_msg.msg_type = RESPONSE_JOB_INFO_COMPACT;
+	else
 		response_msg.msg_type = RESPONSE_JOB_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	if (snap)
+		snapshot_release(snap);
+	xfree(delta);
+	xfree(filtered);
 }
 
 /* _slurm_rpc_dump_jobs - process RPC for job state information */
@@ -1400,7 +1484,8 @@ static void _slurm_rpc_dump_jobs_user(slurm_msg_t * msg)
 		      job_info_request_msg->show_flags,
 		      g_slurm_auth_get_uid(msg->auth_cred,
 					   slurmctld_config.auth_info),
-		      job_info_request_msg->user_id, msg->protocol_version);
+		      job_info_request_msg->user_id, NULL,
+		      msg->protocol_version);
 	unlock_slurmctld(job_read_lock);
 	END_TIMER2("_slurm_rpc_dump_job_user");
 #if 0
@@ -1413,7 +1498,10 @@ static void _slurm_rpc_dump_jobs_user(slurm_msg_t * msg)
 	response_msg.protocol_version = msg->protocol_version;
 	response_msg.address = msg->address;
 	response_msg.conn = msg->conn;
-	response_msg.msg_type = RESPONSE_JOB_INFO;
+	if (job_info_request_msg->show_flags & SHOW_COMPACT)
+		response_msg.msg_type = RESPONSE_JOB_INFO_COMPACT;
+	else
+		response_msg.msg_type = RESPONSE_JOB_INFO;
 	response_msg.data = dump;
 	response_msg.data_size = dump_size;
 
@@ -1645,15 +1733,19 @@ static void _slurm_rpc_dump_front_end(slurm_msg_t * msg)
 static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 {
 	DEF_TIMERS;
-	char *dump;
+	char *dump, *filtered = NULL, *view, *pack_view;
 	int dump_size;
 	slurm_msg_t response_msg;
+	snapshot_t *snap = NULL;
 	node_info_request_msg_t *node_req_msg =
 		(node_info_request_msg_t *) msg->data;
 	/* Locks: Read config, write node (reset allocated CPU count in some
 	 * select plugins), write part (for part_filter_set) */
 	slurmctld_lock_t node_write_lock = {
 		READ_LOCK, NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
+	/* Locks: Read config, write part (for validate_group) */
+	slurmctld_lock_t part_write_lock = {
+		READ_LOCK, NO_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred,
 					 slurmctld_config.auth_info);
 
@@ -1668,37 +1760,72 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 		return;
 	}
 
-	lock_slurmctld(node_write_lock);
-
-	select_g_select_nodeinfo_set_all();
-
+	/* last_node_update is only advanced, an unlocked read is safe here */
 	if ((node_req_msg->last_update - 1) >= last_node_update) {
-		unlock_slurmctld(node_write_lock);
 		debug3("_slurm_rpc_dump_nodes, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
-	} else {
-		pack_all_node(&dump, &dump_size, node_req_msg->show_flags,
-			      uid, msg->protocol_version);
+		return;
+	}
+
+	if (node_req_msg->cond) {
+		/* Filtered responses are specific to the request, don't
+		 * cache them */
+		lock_slurmctld(node_write_lock);
+		select_g_select_nodeinfo_set_all();
+		pack_all_node(&filtered, &dump_size, node_req_msg->show_flags,
+			      uid, node_req_msg->cond, msg->protocol_version);
 		unlock_slurmctld(node_write_lock);
-		END_TIMER2("_slurm_rpc_dump_nodes");
+		dump = filtered;
+	} else {
+		/* Users who see the same partitions share a snapshot */
+		lock_slurmctld(part_write_lock);
+		view = node_view_key(uid, node_req_msg->show_flags);
+		unlock_slurmctld(part_write_lock);
+		snap = snapshot_acquire(REQUEST_NODE_INFO, uid, view,
+					node_req_msg->show_flags,
+					JOB_FIELD_ALL, msg->protocol_version);
+		if (!snapshot_data(snap, &dump, &dump_size)) {
+			lock_slurmctld(node_write_lock);
+			select_g_select_nodeinfo_set_all();
+			pack_all_node(&dump, &dump_size,
+				      node_req_msg->show_flags, uid, NULL,
+				      msg->protocol_version);
+			/* Only share it if the partitions did not change
+			 * since the view was computed */
+			pack_view = node_view_key(uid,
+						  node_req_msg->show_flags);
+			if (!xstrcmp(view, pack_view)) {
+				snapshot_publish(snap, dump, dump_size);
+			} else {
+				snapshot_release(snap);
+				snap = NULL;
+				filtered = dump;
+			}
+			xfree(pack_view);
+			unlock_slurmctld(node_write_lock);
+		}
+		xfree(view);
+	}
+	END_TIMER2("_slurm_rpc_dump_nodes");
 #if 0
-		info("_slurm_rpc_dump_nodes, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_nodes, size=%d %s", dump_size, TIME_STR);
 #endif
 
-		/* init response_msg structure */
-		slurm_msg_t_init(&response_msg);
-		response_msg.flags = msg->flags;
-		response_msg.protocol_version = msg->protocol_version;
-		response_msg.address = msg->address;
-		response_msg.conn = msg->conn;
-		response_msg.msg_type = RESPONSE_NODE_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.conn = msg->conn;
+	response_msg.msg_type = RESPONSE_NODE_INFO;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	if (snap)
+		snapshot_release(snap);
+	xfree(filtered);
 }
 
 /* _slurm_rpc_dump_node_single - done RPC state information for one node */
@@ -1766,6 +1893,7 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	int dump_size;
 	slurm_msg_t response_msg;
 	part_info_request_msg_t  *part_req_msg;
+	snapshot_t *snap;
 
 	/* Locks: Read configuration and partition */
 	slurmctld_lock_t part_read_lock = {
@@ -1776,40 +1904,48 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	START_TIMER;
 	debug2("Processing RPC: REQUEST_PARTITION_INFO uid=%d", uid);
 	part_req_msg = (part_info_request_msg_t  *) msg->data;
-	lock_slurmctld(part_read_lock);
 
 	if ((slurmctld_conf.private_data & PRIVATE_DATA_PARTITIONS) &&
 	    !validate_operator(uid)) {
-		unlock_slurmctld(part_read_lock);
 		debug2("Security violation, PARTITION_INFO RPC from uid=%d",
 		       uid);
 		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
-	} else if ((part_req_msg->last_update - 1) >= last_part_update) {
-		unlock_slurmctld(part_read_lock);
+		return;
+	}
+
+	/* last_part_update is only advanced, an unlocked read is safe here */
+	if ((part_req_msg->last_update - 1) >= last_part_update) {
 		debug2("_slurm_rpc_dump_partitions, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
-	} else {
+		return;
+	}
+
+	snap = snapshot_acquire(REQUEST_PARTITION_INFO, uid, NULL,
+				part_req_msg->show_flags, JOB_FIELD_ALL,
+				msg->protocol_version);
+	if (!snapshot_data(snap, &dump, &dump_size)) {
+		lock_slurmctld(part_read_lock);
 		pack_all_part(&dump, &dump_size, part_req_msg->show_flags,
 			      uid, msg->protocol_version);
+		snapshot_publish(snap, dump, dump_size);
 		unlock_slurmctld(part_read_lock);
-		END_TIMER2("_slurm_rpc_dump_partitions");
-		debug2("_slurm_rpc_dump_partitions, size=%d %s",
-		       dump_size, TIME_STR);
+	}
+	END_TIMER2("_slurm_rpc_dump_partitions");
+	debug2("_slurm_rpc_dump_partitions, size=%d %s", dump_size, TIME_STR);
 
-		/* init response_msg structure */
-		slurm_msg_t_init(&response_msg);
-		response_msg.flags = msg->flags;
-		response_msg.protocol_version = msg->protocol_version;
-		response_msg.address = msg->address;
-		response_msg.conn = msg->conn;
-		response_msg.msg_type = RESPONSE_PARTITION_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	/* init response_msg structure */
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.address = msg->address;
+	response_msg.conn = msg->conn;
+	response_msg.msg_type = RESPONSE_PARTITION_INFO;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	snapshot_release(snap);
 }
 
 /* _slurm_rpc_epilog_complete - process RPC noting the completion of
@@ -1864,6 +2000,16 @@ static void  _slurm_rpc_epilog_complete(slurm_msg_t *msg,
 				epilog_msg->return_code))
 		*run_scheduler = true;
 
+	/* The slurmd sent this itself, so it need not be pinged and the
+	 * health data it carries spares another ping or energy poll */
+	node_did_resp(epilog_msg->node_name);
+	if (epilog_msg->energy) {
+		reset_node_load(epilog_msg->node_name, epilog_msg->cpu_load);
+		reset_node_free_mem(epilog_msg->node_name,
+				    epilog_msg->free_mem);
+		reset_node_energy(epilog_msg->node_name, epilog_msg->energy);
+	}
+
 	job_ptr = find_job_record(epilog_msg->job_id);
 
 	if (epilog_msg->return_code)
@@ -3672,6 +3818,190 @@ send_msg:
 	xfree(err_msg);
 }
 
+/* Move a job's submit message into the response, replacing any message
+ * recorded for that job at an earlier stage */
+static void _submit_jobs_err_msg(submit_jobs_response_msg_t *resp, int inx,
+				 char **err_msg)
+{
+	if (!*err_msg)
+		return;
+	xfree(resp->err_msg[inx]);
+	resp->err_msg[inx] = *err_msg;
+	*err_msg = NULL;
+}
+
+/* _slurm_rpc_submit_batch_jobs - process RPC to submit many batch jobs.
+ * Each job is validated and created as by _slurm_rpc_submit_batch_job(), but
+ * the job_submit plugin runs and the jobs are created under a few read and
+ * write locks, released every SUBMIT_BATCH_LOCK_JOBS jobs, and state save and
+ * scheduling are triggered once for the whole request. Jobs can not be batch
+ * job steps of an existing allocation. */
+static void _slurm_rpc_submit_batch_jobs(slurm_msg_t * msg)
+{
+	static int active_rpc_cnt = 0;
+	int error_code, i, lock_jobs = 0, submit_cnt = 0;
+	DEF_TIMERS;
+	uint32_t job_id;
+	struct job_record *job_ptr;
+	slurm_msg_t response_msg, job_msg;
+	submit_jobs_response_msg_t resp;
+	job_desc_array_msg_t *req = (job_desc_array_msg_t *) msg->data;
+	job_desc_msg_t *job_desc_msg;
+	/* Locks: Read config, read job, read node, read partition */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK };
+	/* Locks: Write job, read node, read partition */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK, READ_LOCK };
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred,
+					 slurmctld_config.auth_info);
+	char *err_msg = NULL;
+
+	START_TIMER;
+	debug2("Processing RPC: REQUEST_SUBMIT_BATCH_JOBS(%u jobs) from uid=%d",
+	       req->job_cnt, uid);
+
+	memset(&resp, 0, sizeof(submit_jobs_response_msg_t));
+	resp.job_cnt = req->job_cnt;
+	resp.job_id = xmalloc(sizeof(uint32_t) * req->job_cnt);
+	resp.error_code = xmalloc(sizeof(uint32_t) * req->job_cnt);
+	resp.err_msg = xmalloc(sizeof(char *) * req->job_cnt);
+
+	/* Locks are for job_submit plugin use */
+	lock_slurmctld(job_read_lock);
+	for (i = 0; i < req->job_cnt; i++) {
+		job_desc_msg = req->job_desc[i];
+		if ((uid != job_desc_msg->user_id) &&
+		    !validate_super_user(uid)) {
+			/* NOTE: Super root can submit a batch job for any
+			 * user */
+			error_code = ESLURM_USER_ID_MISSING;
+			error("Security violation, SUBMIT_JOB from uid=%d",
+			      uid);
+		} else if ((job_desc_msg->alloc_node == NULL) ||
+			   (job_desc_msg->alloc_node[0] == '\0')) {
+			error_code = ESLURM_INVALID_NODE_NAME;
+			error("REQUEST_SUBMIT_BATCH_JOBS lacks alloc_node "
+			      "from uid=%d", uid);
+		} else {
+			dump_job_desc(job_desc_msg);
+			error_code = validate_job_create_req(job_desc_msg, uid,
+							     &err_msg);
+		}
+		if (error_code) {
+			info("_slurm_rpc_submit_batch_jobs: job %d: %s", i,
+			     err_msg ? err_msg : slurm_strerror(error_code));
+		}
+		_submit_jobs_err_msg(&resp, i, &err_msg);
+		resp.error_code[i] = error_code;
+
+		if (++lock_jobs >= SUBMIT_BATCH_LOCK_JOBS) {
+			lock_jobs = 0;
+			unlock_slurmctld(job_read_lock);
+			lock_slurmctld(job_read_lock);
+		}
+	}
+	unlock_slurmctld(job_read_lock);
+	lock_jobs = 0;
+
+	_throttle_start(&active_rpc_cnt);
+	if (fed_mgr_is_active()) {
+		/* Federated jobs are submitted one at a time, the sibling
+		 * clusters being consulted for each */
+		job_msg = *msg;
+		job_msg.msg_type = REQUEST_SUBMIT_BATCH_JOB;
+		for (i = 0; i < req->job_cnt; i++) {
+			job_desc_msg = req->job_desc[i];
+			if (resp.error_code[i] ||
+			    (job_desc_msg->job_id != SLURM_BATCH_SCRIPT))
+				continue;
+			job_msg.data = job_desc_msg;
+			job_id = 0;
+			error_code = SLURM_SUCCESS;
+			if (fed_mgr_job_allocate(&job_msg, job_desc_msg, false,
+						 uid, msg->protocol_version,
+						 &job_id, &error_code,
+						 &err_msg)) {
+				if (!error_code)
+					error_code = SLURM_ERROR;
+			} else {
+				resp.job_id[i] = job_id;
+				submit_cnt++;
+			}
+			resp.error_code[i] = error_code;
+			_submit_jobs_err_msg(&resp, i, &err_msg);
+		}
+	}
+
+	lock_slurmctld(job_write_lock);
+	for (i = 0; i < req->job_cnt; i++) {
+		job_desc_msg = req->job_desc[i];
+		if (resp.error_code[i] || resp.job_id[i])
+			continue;	/* rejected or federated */
+
+		if (job_desc_msg->job_id != SLURM_BATCH_SCRIPT) {
+			job_ptr = find_job_record(job_desc_msg->job_id);
+			if (job_ptr && (!IS_JOB_FINISHED(job_ptr) ||
+					IS_JOB_COMPLETING(job_ptr))) {
+				info("Attempt to re-use active job id %u",
+				     job_ptr->job_id);
+				resp.error_code[i] = ESLURM_DUPLICATE_JOB_ID;
+				continue;
+			}
+		}
+
+		job_ptr = NULL;
+		error_code = job_allocate(job_desc_msg,
+					  job_desc_msg->immediate,
+					  false, NULL, 0, uid, &job_ptr,
+					  &err_msg, msg->protocol_version);
+		_submit_jobs_err_msg(&resp, i, &err_msg);
+		if (job_desc_msg->immediate && (error_code != SLURM_SUCCESS))
+			error_code = ESLURM_CAN_NOT_START_IMMEDIATELY;
+		if (!job_ptr ||
+		    (error_code && (job_ptr->job_state == JOB_FAILED))) {
+			if (!error_code)
+				error_code = SLURM_ERROR;
+		} else {
+			resp.job_id[i] = job_ptr->job_id;
+			submit_cnt++;
+		}
+		resp.error_code[i] = error_code;
+
+		if (++lock_jobs >= SUBMIT_BATCH_LOCK_JOBS) {
+			lock_jobs = 0;
+			unlock_slurmctld(job_write_lock);
+			lock_slurmctld(job_write_lock);
+		}
+	}
+	unlock_slurmctld(job_write_lock);
+	_throttle_fini(&active_rpc_cnt);
+
+	END_TIMER2("_slurm_rpc_submit_batch_jobs");
+	info("_slurm_rpc_submit_batch_jobs: %d of %u jobs submitted %s",
+	     submit_cnt, req->job_cnt, TIME_STR);
+
+	slurm_msg_t_init(&response_msg);
+	response_msg.flags = msg->flags;
+	response_msg.protocol_version = msg->protocol_version;
+	response_msg.conn = msg->conn;
+	response_msg.msg_type = RESPONSE_SUBMIT_BATCH_JOBS;
+	response_msg.data = &resp;
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+
+	if (submit_cnt) {
+		schedule_job_save();	/* Has own locks */
+		schedule_node_save();	/* Has own locks */
+		queue_job_scheduler();
+	}
+
+	xfree(resp.job_id);
+	xfree(resp.error_code);
+	for (i = 0; i < req->job_cnt; i++)
+		xfree(resp.err_msg[i]);
+	xfree(resp.err_msg);
+}
+
 /* _slurm_rpc_update_job - process RPC to update the configuration of a
  * job (e.g. priority)
  */
@@ -5652,6 +5982,11 @@ static void _clear_rpc_stats(void)
 		rpc_type_cnt[i] = 0;
 		rpc_type_id[i] = 0;
 		rpc_type_time[i] = 0;
+		rpc_type_max[i] = 0;
+	}
+	if (rpc_type_hist) {
+		memset(rpc_type_hist, 0,
+		       sizeof(uint32_t) * rpc_type_size * RPC_HIST_SIZE);
 	}
 	for (i = 0; i < rpc_user_size; i++) {
 		rpc_user_cnt[i] = 0;
@@ -5664,20 +5999,22 @@ static void _clear_rpc_stats(void)
 static void _pack_rpc_stats(int resp, char **buffer_ptr, int *buffer_size,
 			    uint16_t protocol_version)
 {
-	uint32_t i;
+	uint32_t i, type_cnt;
+	uint64_t *type_max = NULL;
+	uint32_t *type_hist = NULL;
 	Buf buffer;
 
 	slurm_mutex_lock(&rpc_mutex);
 	buffer = create_buf(*buffer_ptr, *buffer_size);
 	set_buf_offset(buffer, *buffer_size);
-	for (i = 0; i < rpc_type_size; i++) {
-		if (rpc_type_id[i] == 0)
+	for (type_cnt = 0; type_cnt < rpc_type_size; type_cnt++) {
+		if (rpc_type_id[type_cnt] == 0)
 			break;
 	}
-	pack32(i, buffer);
-	pack16_array(rpc_type_id,   i, buffer);
-	pack32_array(rpc_type_cnt,  i, buffer);
-	pack64_array(rpc_type_time, i, buffer);
+	pack32(type_cnt, buffer);
+	pack16_array(rpc_type_id,   type_cnt, buffer);
+	pack32_array(rpc_type_cnt,  type_cnt, buffer);
+	pack64_array(rpc_type_time, type_cnt, buffer);
 
 	for (i = 1; i < rpc_user_size; i++) {
 		if (rpc_user_id[i] == 0)
@@ -5687,8 +6024,30 @@ static void _pack_rpc_stats(int resp, char **buffer_ptr, int *buffer_size,
 	pack32_array(rpc_user_id,   i, buffer);
 	pack32_array(rpc_user_cnt,  i, buffer);
 	pack64_array(rpc_user_time, i, buffer);
+
+	/* Copy the rest of the RPC statistics in the same hold of rpc_mutex
+	 * so all of them describe the same set of RPCs. They are packed
+	 * after the RPC queue statistics. */
+	if ((protocol_version >= SLURM_17_02_PROTOCOL_VERSION) && type_cnt) {
+		type_max = xmalloc(sizeof(uint64_t) * type_cnt);
+		memcpy(type_max, rpc_type_max, sizeof(uint64_t) * type_cnt);
+		type_hist = xmalloc(sizeof(uint32_t) * type_cnt *
+				    RPC_HIST_SIZE);
+		memcpy(type_hist, rpc_type_hist,
+		       sizeof(uint32_t) * type_cnt * RPC_HIST_SIZE);
+	}
 	slurm_mutex_unlock(&rpc_mutex);
 
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		pack_rpc_queue_stats(buffer);
+		pack64_array(type_max, type_cnt, buffer);
+		pack32(RPC_HIST_SIZE, buffer);
+		pack32_array(type_hist, type_cnt * RPC_HIST_SIZE, buffer);
+		pack_lock_stats(buffer);
+	}
+	xfree(type_max);
+	xfree(type_hist);
+
 	*buffer_size = get_buf_offset(buffer);
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
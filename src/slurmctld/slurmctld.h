@@ -149,6 +149,8 @@ typedef struct slurmctld_config {
 	pthread_t thread_id_rpc;
 } slurmctld_config_t;
 
+#define BF_MAX_THREADS	32	/* limit of SchedulerParameters=bf_threads */
+
 /* Job scheduling statistics */
 typedef struct diag_stats {
 	int proc_req_threads;
@@ -160,6 +162,8 @@ typedef struct diag_stats {
 	uint32_t schedule_cycle_counter;
 	uint32_t schedule_cycle_depth;
 	uint32_t schedule_queue_len;
+	uint64_t schedule_lock_last;	/* usec locks held, last cycle */
+	uint64_t schedule_lock_sum;	/* usec locks held, all cycles */
 
 	uint32_t jobs_submitted;
 	uint32_t jobs_started;
@@ -181,6 +185,15 @@ typedef struct diag_stats {
 	uint32_t bf_queue_len_sum;
 	time_t   bf_when_last_cycle;
 	uint32_t bf_active;
+	uint32_t bf_thread_cnt;		/* threads used by last cycle */
+	uint32_t bf_thread_tests[BF_MAX_THREADS]; /* job tests, last cycle */
+	uint64_t bf_thread_usec[BF_MAX_THREADS];  /* time testing, last cycle */
+	uint32_t bf_spec_used;		/* look-ahead tests used, last cycle */
+	uint32_t bf_spec_discard;	/* look-ahead tests discarded */
+	uint32_t bf_plan_used;		/* earlier cycles' tests reused */
+	uint32_t bf_plan_cnt;		/* test results kept for next cycle */
+	uint64_t bf_lock_last;		/* usec locks held, last cycle */
+	uint64_t bf_lock_sum;		/* usec locks held, all cycles */
 } diag_stats_t;
 
 /* This is used to point out constants that exist in the
@@ -584,6 +597,8 @@ struct job_record {
 	uint32_t alloc_sid;		/* local sid making resource alloc */
 	uint32_t array_job_id;		/* job_id of a job array or 0 if N/A */
 	uint32_t array_task_id;		/* task_id of a job array */
+	uint32_t array_task_inx;	/* index in job array's list of task
+					 * records, see _add_job_array_hash */
 	job_array_struct_t *array_recs;	/* job array details,
 					 * only in meta-job record */
 	uint32_t assoc_id;              /* used for accounting plugins */
@@ -651,13 +666,12 @@ struct job_record {
 					 * to be passed to slurmdbd */
 	uint32_t group_id;		/* group submitted under */
 	uint32_t job_id;		/* job ID */
-	struct job_record *job_next;	/* next entry with same hash index */
-	struct job_record *job_array_next_j; /* job array linked list by job_id */
-	struct job_record *job_array_next_t; /* job array linked list by task_id */
 	job_resources_t *job_resrcs;	/* details of allocated cores */
 	uint32_t job_state;		/* state of the job */
 	uint16_t kill_on_node_fail;	/* 1 if job should be killed on
 					 * node failure */
+	time_t last_update;		/* time of last update_job() request,
+					 * not saved in state */
 	char *licenses;			/* licenses required by the job */
 	List license_list;		/* structure with license info */
 	acct_policy_limit_set_t limit_set; /* flags if indicate an
@@ -750,6 +764,8 @@ struct job_record {
 					 * return valid job information during
 					 * scheduling cycle (state_reason is
 					 * cleared at start of cycle) */
+	uint64_t state_hash;		/* hash of state last saved, see
+					 * dump_all_job_state(), not saved */
 	List step_list;			/* list of job's steps */
 	time_t suspend_time;		/* time job last suspended or resumed */
 	time_t time_last_active;	/* time of last job activity */
@@ -1406,6 +1422,13 @@ extern int job_step_checkpoint_task_comp(checkpoint_task_comp_msg_t *ckpt_ptr,
 					 int conn_fd,
 					 uint16_t protocol_version);
 
+/*
+ * job_state_changed - note that a job record changed so that the next
+ *	dump_all_job_state() journals it and the main scheduler re-tests it
+ * IN job_ptr - job which changed, job write lock must be held
+ */
+extern void job_state_changed(struct job_record *job_ptr);
+
 /*
  * job_str_signal - signal the specified job
  * IN job_id_str - id of the job to be signaled, valid formats include "#"
@@ -1753,6 +1776,16 @@ extern void node_not_resp (char *name, time_t msg_time,
  * and log that the node is not responding using a hostlist expression */
 extern void node_no_resp_msg(void);
 
+/*
+ * node_view_key - Return a key shared by all users who get the same
+ *	response from pack_all_node(): the partitions hidden from them
+ * IN uid - uid of user making request
+ * IN show_flags - node filtering options
+ * RET xmalloc'd key, NULL if the response is specific to uid
+ * NOTE: READ lock_slurmctld config and WRITE lock part before entry
+ */
+extern char *node_view_key(uid_t uid, uint16_t show_flags);
+
 /* For a given job ID return the number of PENDING tasks which have their
  * own separate job_record (do not count tasks in pending META job record) */
 extern int num_pending_job_array_tasks(uint32_t array_job_id);
@@ -1765,6 +1798,8 @@ extern int num_pending_job_array_tasks(uint32_t array_job_id);
  * IN show_flags - job filtering options
  * IN uid - uid of user making request (for partition filtering)
  * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
+ * IN cond - pack only the jobs matching these filters and the optional
+ *	fields in cond->field_mask, NULL for all jobs and fields
  * IN protocol_version - slurm protocol version of client
  * global: job_list - global list of job records
  * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
@@ -1773,7 +1808,25 @@ extern int num_pending_job_array_tasks(uint32_t array_job_id);
  */
 extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
-			  uint16_t protocol_version);
+			  job_info_cond_t *cond, uint16_t protocol_version);
+
+/*
+ * pack_all_jobs_index - same as pack_all_jobs() for all jobs, also
+ *	identifying where each job's record starts in the buffer
+ * IN field_mask - JOB_FIELD_* of optional fields to pack
+ * OUT rec_cnt - set to the count of job records packed
+ * OUT rec_id - set to an array with the job ID of each record
+ * OUT rec_offset - set to an array with the buffer offset of each record
+ * OUT rec_hash - set to an array with a hash of each record which changes
+ *	only with the job, not with the current time
+ * NOTE: the buffer, rec_id, rec_offset and rec_hash must be xfreed by the
+ *	caller
+ */
+extern void pack_all_jobs_index(char **buffer_ptr, int *buffer_size,
+				uint32_t *rec_cnt, uint32_t **rec_id,
+				uint32_t **rec_offset, uint64_t **rec_hash,
+				uint16_t show_flags, uid_t uid,
+				uint32_t field_mask, uint16_t protocol_version);
 
 /*
  * pack_all_node - dump all configuration and node information for all nodes
@@ -1782,6 +1835,8 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
  * OUT buffer_size - set to size of the buffer in bytes
  * IN show_flags - node filtering options
  * IN uid - uid of user making request (for partition filtering)
+ * IN cond - nodes to report, others are packed as nameless placeholders,
+ *	NULL for all nodes
  * IN protocol_version - slurm protocol version of client
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
@@ -1790,12 +1845,18 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
  */
 extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid,
-			   uint16_t protocol_version);
+			   node_info_cond_t *cond, uint16_t protocol_version);
 
 /* Pack all scheduling statistics */
 extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			  uint16_t protocol_version);
 
+/* Pack the wait and hold statistics of each entity's read and write locks */
+extern void pack_lock_stats(Buf buffer);
+
+/* Pack the current and peak depth of the RPC queues by message type */
+extern void pack_rpc_queue_stats(Buf buffer);
+
 /*
  * pack_ctld_job_step_info_response_msg - packs job step info
  * IN job_id - specific id or NO_VAL for all
@@ -1997,13 +2058,22 @@ extern void reset_job_bitmaps (void);
 /* Reset a node's CPU load value */
 extern void reset_node_load(char *node_name, uint32_t cpu_load);
 
+/* Clear the lock wait and hold statistics */
+extern void reset_lock_stats(void);
+
 /* Reset a node's free memory value */
 extern void reset_node_free_mem(char *node_name, uint64_t free_mem);
 
+/* Reset a node's energy data, ignored unless the sample is newer */
+extern void reset_node_energy(char *node_name, acct_gather_energy_t *energy);
+
 /* Reset all scheduling statistics
  * level IN - clear backfilled_jobs count if set */
 extern void reset_stats(int level);
 
+/* Reset the peak RPC queue depths to the current depths */
+extern void reset_rpc_queue_stats(void);
+
 /*
  * restore_node_features - Make node and config (from slurm.conf) fields
  *	consistent for Features, Gres and Weight
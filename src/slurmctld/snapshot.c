@@ -0,0 +1,560 @@
+/*****************************************************************************\
+ *  snapshot.c - cache of packed job, node and partition information
+ *	shared by query RPCs
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "src/common/macros.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/snapshot.h"
+
+#define SNAPSHOT_CNT		32	/* maximum cached snapshots */
+#define SNAPSHOT_MAX_BYTES	(64 * 1024 * 1024) /* total size of the
+					 * responses held in snapshot_table */
+#define SNAPSHOT_MAX_AGE	2	/* seconds a snapshot stays current */
+#define DIGEST_CNT		64	/* job record digests kept for deltas */
+#define DIGEST_PER_CLIENT	2	/* digests kept for each uid, show_flags,
+					 * field mask and protocol version */
+
+/* Identity and content hash of one job record in a snapshot */
+typedef struct {
+	uint32_t job_id;
+	uint32_t inx;			/* record index in the snapshot */
+	uint64_t hash;			/* hash of the packed record */
+} digest_rec_t;
+
+/* Job records sent to clients in one delta version, sorted by job ID */
+typedef struct {
+	uint32_t version;
+	uid_t uid;
+	uint16_t show_flags;
+	uint32_t field_mask;
+	uint16_t protocol_version;
+	uint32_t rec_cnt;
+	uint32_t *rec_id;
+	uint64_t *rec_hash;
+	time_t last_used;		/* last delta built against it */
+} job_digest_t;
+
+struct snapshot {
+	uint16_t msg_type;		/* request this is the response to */
+	uid_t uid;
+	char *view;			/* shared view key, NULL if per uid */
+	uint16_t show_flags;
+	uint32_t field_mask;		/* JOB_FIELD_* of job records */
+	uint16_t protocol_version;
+
+	time_t conf_update;		/* table update times when packed */
+	time_t job_update;
+	time_t node_update;
+	time_t part_update;
+	uint32_t node_alloc_gen;	/* node_alloc_gen when packed */
+	time_t pack_time;
+
+	char *dump;			/* packed response, NULL until built */
+	int dump_size;
+
+	uint32_t rec_cnt;		/* job records in dump */
+	uint32_t *rec_id;		/* job ID of each record */
+	uint32_t *rec_offset;		/* offset of each record in dump */
+	uint64_t *rec_hash;		/* hash of each record */
+	digest_rec_t *digest;		/* records sorted by job ID */
+	uint32_t version;		/* delta version of digest */
+
+	bool building;			/* a thread is packing dump */
+	bool linked;			/* still in snapshot_table */
+	int ref_cnt;			/* threads holding this snapshot */
+};
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  snapshot_cond  = PTHREAD_COND_INITIALIZER;
+static snapshot_t *snapshot_table[SNAPSHOT_CNT];
+static job_digest_t *digest_table[DIGEST_CNT];
+static uint64_t snapshot_bytes = 0;	/* size of dumps in snapshot_table */
+static uint32_t node_alloc_gen = 0;	/* node allocation changes */
+static uint32_t digest_version = 0;
+
+static void _snapshot_free(snapshot_t *snap)
+{
+	xfree(snap->view);
+	xfree(snap->dump);
+	xfree(snap->rec_id);
+	xfree(snap->rec_offset);
+	xfree(snap->rec_hash);
+	xfree(snap->digest);
+	xfree(snap);
+}
+
+static void _digest_free(job_digest_t *digest)
+{
+	if (digest) {
+		xfree(digest->rec_id);
+		xfree(digest->rec_hash);
+		xfree(digest);
+	}
+}
+
+/* Remove a snapshot from the table, freeing it once unreferenced.
+ * snapshot_mutex must be locked */
+static void _snapshot_unlink(int inx)
+{
+	snapshot_t *snap = snapshot_table[inx];
+
+	snapshot_table[inx] = NULL;
+	snap->linked = false;
+	if (snap->dump)
+		snapshot_bytes -= snap->dump_size;
+	if (snap->ref_cnt == 0)
+		_snapshot_free(snap);
+}
+
+/*
+ * Test if a snapshot still matches the tables it was packed from.
+ * The update times are read without slurmctld locks. They are only written
+ * by threads holding the relevant write lock, so the worst case is a
+ * snapshot being discarded or reused one update later than strictly needed,
+ * which SNAPSHOT_MAX_AGE bounds.
+ */
+static bool _snapshot_current(snapshot_t *snap, time_t now)
+{
+	if (snap->building)
+		return true;
+	if ((now - snap->pack_time) >= SNAPSHOT_MAX_AGE)
+		return false;
+	if ((snap->conf_update != slurmctld_conf.last_update) ||
+	    (snap->part_update != last_part_update))
+		return false;
+	if (snap->msg_type == REQUEST_JOB_INFO)
+		return (snap->job_update == last_job_update);
+	if ((snap->msg_type == REQUEST_NODE_INFO) &&
+	    (snap->node_alloc_gen != node_alloc_gen))
+		return false;
+	return (snap->node_update == last_node_update);
+}
+
+static bool _snapshot_match(snapshot_t *snap, uint16_t msg_type, uid_t uid,
+			    const char *view, uint16_t show_flags,
+			    uint32_t field_mask, uint16_t protocol_version)
+{
+	if ((snap->msg_type != msg_type) ||
+	    (snap->show_flags != show_flags) ||
+	    (snap->field_mask != field_mask) ||
+	    (snap->protocol_version != protocol_version))
+		return false;
+	if (view || snap->view)
+		return !xstrcmp(snap->view, view);
+	return (snap->uid == uid);
+}
+
+extern snapshot_t *snapshot_acquire(uint16_t msg_type, uid_t uid,
+				    const char *view, uint16_t show_flags,
+				    uint32_t field_mask,
+				    uint16_t protocol_version)
+{
+	snapshot_t *snap;
+	time_t now;
+	int i, free_inx, old_inx;
+
+	slurm_mutex_lock(&snapshot_mutex);
+	while (1) {
+		now = time(NULL);
+		snap = NULL;
+		free_inx = -1;
+		old_inx = -1;
+		for (i = 0; i < SNAPSHOT_CNT; i++) {
+			if (snapshot_table[i] &&
+			    !_snapshot_current(snapshot_table[i], now))
+				_snapshot_unlink(i);
+			if (!snapshot_table[i]) {
+				if (free_inx == -1)
+					free_inx = i;
+				continue;
+			}
+			if (_snapshot_match(snapshot_table[i], msg_type, uid,
+					    view, show_flags, field_mask,
+					    protocol_version)) {
+				snap = snapshot_table[i];
+				break;
+			}
+			if (snapshot_table[i]->building)
+				continue;
+			if ((old_inx == -1) ||
+			    (snapshot_table[i]->pack_time <
+			     snapshot_table[old_inx]->pack_time))
+				old_inx = i;
+		}
+
+		if (!snap)
+			break;
+
+		snap->ref_cnt++;
+		while (snap->building)
+			slurm_cond_wait(&snapshot_cond, &snapshot_mutex);
+		if (snap->dump) {
+			slurm_mutex_unlock(&snapshot_mutex);
+			return snap;
+		}
+
+		/* Builder gave up, try again */
+		snap->ref_cnt--;
+		if (!snap->linked && (snap->ref_cnt == 0))
+			_snapshot_free(snap);
+	}
+
+	if ((free_inx == -1) && (old_inx != -1)) {
+		_snapshot_unlink(old_inx);
+		free_inx = old_inx;
+	}
+
+	snap = xmalloc(sizeof(snapshot_t));
+	snap->msg_type = msg_type;
+	snap->uid = uid;
+	snap->view = xstrdup(view);
+	snap->show_flags = show_flags;
+	snap->field_mask = field_mask;
+	snap->protocol_version = protocol_version;
+	snap->building = true;
+	snap->ref_cnt = 1;
+	if (free_inx != -1) {	/* else every slot is being built, no caching */
+		snap->linked = true;
+		snapshot_table[free_inx] = snap;
+	}
+	slurm_mutex_unlock(&snapshot_mutex);
+
+	return snap;
+}
+
+extern bool snapshot_data(snapshot_t *snap, char **dump, int *dump_size)
+{
+	if (!snap->dump)
+		return false;
+
+	*dump = snap->dump;
+	*dump_size = snap->dump_size;
+	return true;
+}
+
+/* Unlink the oldest published snapshots until those left in snapshot_table
+ * fit in SNAPSHOT_MAX_BYTES. snapshot_mutex must be locked */
+static void _snapshot_trim(void)
+{
+	int i, old_inx;
+
+	while (snapshot_bytes > SNAPSHOT_MAX_BYTES) {
+		old_inx = -1;
+		for (i = 0; i < SNAPSHOT_CNT; i++) {
+			if (!snapshot_table[i] || !snapshot_table[i]->dump)
+				continue;
+			if ((old_inx == -1) ||
+			    (snapshot_table[i]->pack_time <
+			     snapshot_table[old_inx]->pack_time))
+				old_inx = i;
+		}
+		if (old_inx == -1)
+			break;
+		_snapshot_unlink(old_inx);
+	}
+}
+
+extern void snapshot_publish(snapshot_t *snap, char *dump, int dump_size)
+{
+	slurm_mutex_lock(&snapshot_mutex);
+	snap->dump = dump;
+	snap->dump_size = dump_size;
+	snap->conf_update = slurmctld_conf.last_update;
+	snap->job_update = last_job_update;
+	snap->node_update = last_node_update;
+	snap->part_update = last_part_update;
+	snap->node_alloc_gen = node_alloc_gen;
+	snap->pack_time = time(NULL);
+	snap->building = false;
+	if (snap->linked) {
+		snapshot_bytes += dump_size;
+		_snapshot_trim();
+	}
+	slurm_cond_broadcast(&snapshot_cond);
+	slurm_mutex_unlock(&snapshot_mutex);
+}
+
+extern void snapshot_set_index(snapshot_t *snap, uint32_t rec_cnt,
+			       uint32_t *rec_id, uint32_t *rec_offset,
+			       uint64_t *rec_hash)
+{
+	snap->rec_cnt = rec_cnt;
+	snap->rec_id = rec_id;
+	snap->rec_offset = rec_offset;
+	snap->rec_hash = rec_hash;
+}
+
+static uint32_t _rec_size(snapshot_t *snap, uint32_t inx)
+{
+	if ((inx + 1) < snap->rec_cnt)
+		return snap->rec_offset[inx + 1] - snap->rec_offset[inx];
+	return snap->dump_size - snap->rec_offset[inx];
+}
+
+static int _sort_digest_rec(const void *x, const void *y)
+{
+	const digest_rec_t *rec1 = x, *rec2 = y;
+
+	if (rec1->job_id < rec2->job_id)
+		return -1;
+	if (rec1->job_id > rec2->job_id)
+		return 1;
+	return 0;
+}
+
+static digest_rec_t *_build_digest(snapshot_t *snap)
+{
+	digest_rec_t *digest;
+	uint32_t i;
+
+	digest = xmalloc(sizeof(digest_rec_t) * (snap->rec_cnt + 1));
+	for (i = 0; i < snap->rec_cnt; i++) {
+		digest[i].job_id = snap->rec_id[i];
+		digest[i].inx = i;
+		digest[i].hash = snap->rec_hash[i];
+	}
+	qsort(digest, snap->rec_cnt, sizeof(digest_rec_t), _sort_digest_rec);
+
+	return digest;
+}
+
+/* Save a snapshot's digest for later deltas and assign its version.
+ * snapshot_mutex must be locked */
+static void _digest_add(snapshot_t *snap)
+{
+	job_digest_t *digest;
+	uint32_t i;
+	int client_cnt = 0, client_inx = -1, free_inx = -1, lru_inx = -1, inx;
+
+	if (++digest_version >= NO_VAL)
+		digest_version = 1;
+
+	digest = xmalloc(sizeof(job_digest_t));
+	digest->version = digest_version;
+	digest->uid = snap->uid;
+	digest->show_flags = snap->show_flags;
+	digest->field_mask = snap->field_mask;
+	digest->protocol_version = snap->protocol_version;
+	digest->rec_cnt = snap->rec_cnt;
+	digest->rec_id = xmalloc(sizeof(uint32_t) * (snap->rec_cnt + 1));
+	digest->rec_hash = xmalloc(sizeof(uint64_t) * (snap->rec_cnt + 1));
+	for (i = 0; i < snap->rec_cnt; i++) {
+		digest->rec_id[i] = snap->digest[i].job_id;
+		digest->rec_hash[i] = snap->digest[i].hash;
+	}
+
+	digest->last_used = time(NULL);
+
+	/* Replace the client's oldest digest once it has DIGEST_PER_CLIENT,
+	 * else a free slot or the one least recently used by any client */
+	for (i = 0; i < DIGEST_CNT; i++) {
+		if (!digest_table[i]) {
+			if (free_inx == -1)
+				free_inx = i;
+			continue;
+		}
+		if ((lru_inx == -1) || (digest_table[i]->last_used <
+					digest_table[lru_inx]->last_used))
+			lru_inx = i;
+		if ((digest_table[i]->uid != snap->uid) ||
+		    (digest_table[i]->show_flags != snap->show_flags) ||
+		    (digest_table[i]->field_mask != snap->field_mask) ||
+		    (digest_table[i]->protocol_version !=
+		     snap->protocol_version))
+			continue;
+		client_cnt++;
+		if ((client_inx == -1) || (digest_table[i]->last_used <
+					   digest_table[client_inx]->last_used))
+			client_inx = i;
+	}
+	if (client_cnt >= DIGEST_PER_CLIENT)
+		inx = client_inx;
+	else if (free_inx != -1)
+		inx = free_inx;
+	else
+		inx = lru_inx;
+
+	_digest_free(digest_table[inx]);
+	digest_table[inx] = digest;
+	snap->version = digest_version;
+}
+
+/* Find the digest a client's cached records were sent from.
+ * snapshot_mutex must be locked */
+static job_digest_t *_digest_find(snapshot_t *snap, uint32_t version)
+{
+	job_digest_t *digest;
+	int i;
+
+	for (i = 0; i < DIGEST_CNT; i++) {
+		digest = digest_table[i];
+		if (digest && (digest->version == version) &&
+		    (digest->uid == snap->uid) &&
+		    (digest->show_flags == snap->show_flags) &&
+		    (digest->field_mask == snap->field_mask) &&
+		    (digest->protocol_version == snap->protocol_version)) {
+			digest->last_used = time(NULL);
+			return digest;
+		}
+	}
+	return NULL;
+}
+
+extern void snapshot_pack_job_delta(snapshot_t *snap, uint32_t base_version,
+				    char **buffer_ptr, int *buffer_size)
+{
+	digest_rec_t *digest, *rec;
+	job_digest_t *base;
+	uint32_t *update_inx, *purge_id = NULL;
+	uint32_t update_cnt = 0, purge_cnt = 0, i = 0, j = 0;
+	Buf buffer;
+
+	xassert(snap->rec_id || !snap->rec_cnt);
+
+	slurm_mutex_lock(&snapshot_mutex);
+	digest = snap->digest;
+	slurm_mutex_unlock(&snapshot_mutex);
+	if (!digest) {
+		/* Hash outside of the mutex, first thread to finish wins */
+		digest = _build_digest(snap);
+		slurm_mutex_lock(&snapshot_mutex);
+		if (snap->digest) {
+			xfree(digest);
+			digest = snap->digest;
+		} else {
+			snap->digest = digest;
+			_digest_add(snap);
+		}
+		slurm_mutex_unlock(&snapshot_mutex);
+	}
+
+	update_inx = xmalloc(sizeof(uint32_t) * (snap->rec_cnt + 1));
+	slurm_mutex_lock(&snapshot_mutex);
+	if (!(base = _digest_find(snap, base_version))) {
+		base_version = 0;
+		for (i = 0; i < snap->rec_cnt; i++)
+			update_inx[update_cnt++] = i;
+	} else {
+		purge_id = xmalloc(sizeof(uint32_t) * (base->rec_cnt + 1));
+		while ((i < snap->rec_cnt) || (j < base->rec_cnt)) {
+			if ((j >= base->rec_cnt) ||
+			    ((i < snap->rec_cnt) &&
+			     (digest[i].job_id < base->rec_id[j]))) {
+				update_inx[update_cnt++] = i++;
+			} else if ((i >= snap->rec_cnt) ||
+				   (base->rec_id[j] < digest[i].job_id)) {
+				purge_id[purge_cnt++] = base->rec_id[j++];
+			} else {
+				if (digest[i].hash != base->rec_hash[j])
+					update_inx[update_cnt++] = i;
+				i++;
+				j++;
+			}
+		}
+	}
+	slurm_mutex_unlock(&snapshot_mutex);
+
+	buffer = init_buf(BUF_SIZE);
+	pack32(snap->version, buffer);
+	pack32(base_version, buffer);
+	pack_time(snap->pack_time, buffer);
+	pack32(snap->rec_cnt, buffer);
+	pack32(update_cnt, buffer);
+	for (i = 0; i < update_cnt; i++) {
+		rec = &digest[update_inx[i]];
+		pack32(rec->job_id, buffer);
+		packmem(snap->dump + snap->rec_offset[rec->inx],
+			_rec_size(snap, rec->inx), buffer);
+	}
+	pack32_array(purge_id, purge_cnt, buffer);
+	xfree(update_inx);
+	xfree(purge_id);
+
+	debug3("%s: version %u base %u records %u updates %u purges %u",
+	       __func__, snap->version, base_version, snap->rec_cnt,
+	       update_cnt, purge_cnt);
+
+	*buffer_size = get_buf_offset(buffer);
+	*buffer_ptr = xfer_buf_data(buffer);
+}
+
+extern void snapshot_node_alloc_changed(void)
+{
+	slurm_mutex_lock(&snapshot_mutex);
+	node_alloc_gen++;
+	slurm_mutex_unlock(&snapshot_mutex);
+}
+
+extern void snapshot_release(snapshot_t *snap)
+{
+	int i;
+
+	slurm_mutex_lock(&snapshot_mutex);
+	snap->ref_cnt--;
+	if (snap->building) {
+		/* Never published, let a waiting thread build it */
+		snap->building = false;
+		for (i = 0; snap->linked && (i < SNAPSHOT_CNT); i++) {
+			if (snapshot_table[i] == snap)
+				snapshot_table[i] = NULL;
+		}
+		snap->linked = false;
+		slurm_cond_broadcast(&snapshot_cond);
+	}
+	if (!snap->linked && (snap->ref_cnt == 0))
+		_snapshot_free(snap);
+	slurm_mutex_unlock(&snapshot_mutex);
+}
+
+extern void snapshot_fini(void)
+{
+	int i;
+
+	slurm_mutex_lock(&snapshot_mutex);
+	for (i = 0; i < SNAPSHOT_CNT; i++) {
+		if (snapshot_table[i])
+			_snapshot_unlink(i);
+	}
+	for (i = 0; i < DIGEST_CNT; i++) {
+		_digest_free(digest_table[i]);
+		digest_table[i] = NULL;
+	}
+	slurm_mutex_unlock(&snapshot_mutex);
+}
@@ -0,0 +1,122 @@
+/*****************************************************************************\
+ *  snapshot.h - cache of packed job, node and partition information
+ *	shared by query RPCs
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_SNAPSHOT_H
+#define _HAVE_SNAPSHOT_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * A snapshot is the packed response to REQUEST_JOB_INFO, REQUEST_NODE_INFO
+ * or REQUEST_PARTITION_INFO for one user (or one view shared by many users),
+ * show_flags, job field mask and protocol version.
+ * Once published it is never modified, so any number of RPC threads may send
+ * it without holding slurmctld locks. A snapshot is current until one of the
+ * tables it was packed from changes (see last_job_update, last_node_update,
+ * last_part_update and slurmctld_conf.last_update), node allocations change
+ * (see snapshot_node_alloc_changed()) or it reaches SNAPSHOT_MAX_AGE seconds
+ * of age. A snapshot is rebuilt whole rather than
+ * updated in place, and the oldest ones are dropped once the cached
+ * responses exceed SNAPSHOT_MAX_BYTES in total.
+ */
+typedef struct snapshot snapshot_t;
+
+/*
+ * Find a current snapshot for the given request, blocking while another
+ * thread is packing the same one. The caller must release the snapshot
+ * with snapshot_release() once the response has been sent.
+ * IN view - if not NULL, a key shared by all users getting the same response
+ *	(e.g. from node_view_key()), the snapshot is then shared by them
+ *	rather than kept for uid alone
+ * IN field_mask - JOB_FIELD_* of the job records packed, JOB_FIELD_ALL for
+ *	requests other than REQUEST_JOB_INFO
+ * RET snapshot. If snapshot_data() reports no data, the caller was chosen
+ *     to build it: pack the response under the usual locks and call
+ *     snapshot_publish() before releasing those locks.
+ */
+extern snapshot_t *snapshot_acquire(uint16_t msg_type, uid_t uid,
+				    const char *view, uint16_t show_flags,
+				    uint32_t field_mask,
+				    uint16_t protocol_version);
+
+/*
+ * Get the packed response of a snapshot.
+ * RET true if the snapshot holds data, false if the caller must build it
+ */
+extern bool snapshot_data(snapshot_t *snap, char **dump, int *dump_size);
+
+/*
+ * Store a freshly packed response in a snapshot and wake any threads waiting
+ * for it. Must be called with the locks used to pack the data still held.
+ * The snapshot takes ownership of dump.
+ */
+extern void snapshot_publish(snapshot_t *snap, char *dump, int dump_size);
+
+/*
+ * Record the job ID, buffer offset and hash of each record of a
+ * REQUEST_JOB_INFO snapshot so that snapshot_pack_job_delta() can be used on
+ * it. A record is resent in a delta when its hash changes. Call before
+ * snapshot_publish(). The snapshot takes ownership of rec_id, rec_offset and
+ * rec_hash.
+ */
+extern void snapshot_set_index(snapshot_t *snap, uint32_t rec_cnt,
+			       uint32_t *rec_id, uint32_t *rec_offset,
+			       uint64_t *rec_hash);
+
+/*
+ * Pack the body of a RESPONSE_JOB_INFO_DELTA message holding the job records
+ * of a snapshot which differ from those the client received in delta version
+ * base_version. If that version is no longer known, all records are packed.
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ */
+extern void snapshot_pack_job_delta(snapshot_t *snap, uint32_t base_version,
+				    char **buffer_ptr, int *buffer_size);
+
+/*
+ * Note that node allocations changed (a job was allocated or deallocated
+ * nodes). Node snapshots packed before are no longer current, even if
+ * last_node_update still holds the same second.
+ */
+extern void snapshot_node_alloc_changed(void);
+
+/* Drop a reference to a snapshot from snapshot_acquire() */
+extern void snapshot_release(snapshot_t *snap);
+
+/* Free all cached snapshots */
+extern void snapshot_fini(void);
+
+#endif	/* !_HAVE_SNAPSHOT_H */
@@ -111,6 +111,31 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			pack32(slurmctld_diag_stats.bf_depth_try_sum, buffer);
 			pack32(slurmctld_diag_stats.bf_queue_len_sum, buffer);
 			pack32(slurmctld_diag_stats.bf_active,	 buffer);
+			if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+				uint32_t cnt =
+					slurmctld_diag_stats.bf_thread_cnt;
+				pack32(cnt, buffer);
+				pack32_array(slurmctld_diag_stats.
+					     bf_thread_tests, cnt, buffer);
+				pack64_array(slurmctld_diag_stats.
+					     bf_thread_usec, cnt, buffer);
+				pack32(slurmctld_diag_stats.bf_spec_used,
+				       buffer);
+				pack32(slurmctld_diag_stats.bf_spec_discard,
+				       buffer);
+				pack32(slurmctld_diag_stats.bf_plan_used,
+				       buffer);
+				pack32(slurmctld_diag_stats.bf_plan_cnt,
+				       buffer);
+				pack64(slurmctld_diag_stats.schedule_lock_last,
+				       buffer);
+				pack64(slurmctld_diag_stats.schedule_lock_sum,
+				       buffer);
+				pack64(slurmctld_diag_stats.bf_lock_last,
+				       buffer);
+				pack64(slurmctld_diag_stats.bf_lock_sum,
+				       buffer);
+			}
 		}
 	}
 
@@ -128,6 +153,7 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.schedule_cycle_sum = 0;
 	slurmctld_diag_stats.schedule_cycle_counter = 0;
 	slurmctld_diag_stats.schedule_cycle_depth = 0;
+	slurmctld_diag_stats.schedule_lock_sum = 0;
 	slurmctld_diag_stats.jobs_submitted = 0;
 	slurmctld_diag_stats.jobs_started = 0;
 	slurmctld_diag_stats.jobs_completed = 0;
@@ -150,6 +176,15 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.bf_last_depth = 0;
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_active = 0;
+	slurmctld_diag_stats.bf_thread_cnt = 0;
+	slurmctld_diag_stats.bf_spec_used = 0;
+	slurmctld_diag_stats.bf_spec_discard = 0;
+	slurmctld_diag_stats.bf_plan_used = 0;
+	slurmctld_diag_stats.bf_lock_last = 0;
+	slurmctld_diag_stats.bf_lock_sum = 0;
+
+	reset_rpc_queue_stats();
+	reset_lock_stats();
 
 	last_proc_req_start = time(NULL);
 }
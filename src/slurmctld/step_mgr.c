@@ -191,6 +191,7 @@ static struct step_record * _create_step_record(struct job_record *job_ptr,
 		step_ptr->start_protocol_ver = job_ptr->start_protocol_ver;
 
 	(void) list_append (job_ptr->step_list, step_ptr);
+	job_state_changed(job_ptr);
 
 	return step_ptr;
 }
@@ -248,6 +249,7 @@ static void _internal_step_complete(struct job_record *job_ptr,
 				    struct step_record *step_ptr)
 {
 	jobacct_storage_g_step_complete(acct_db_conn, step_ptr);
+	job_state_changed(job_ptr);
 
 	if (step_ptr->step_id == SLURM_PENDING_STEP)
 		return;
@@ -397,6 +399,7 @@ delete_step_record (struct job_record *job_ptr, uint32_t step_id)
 			break;
 		list_remove(step_iterator);
 		_free_step_rec(step_ptr);
+		job_state_changed(job_ptr);
 		break;
 	}
 	list_iterator_destroy(step_iterator);
@@ -0,0 +1,214 @@
+/*****************************************************************************\
+ *  proc_events.c - wait for process exits using the Linux proc connector
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#endif
+
+#include "src/common/fd.h"
+#include "src/common/log.h"
+#include "src/slurmd/common/proc_events.h"
+
+#ifdef __linux__
+
+/* Ask the kernel to start or stop multicasting process events to fd */
+static int _set_listen(int fd, enum proc_cn_mcast_op op)
+{
+	char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))]
+		__attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *hdr = (struct nlmsghdr *) buf;
+	struct cn_msg *msg = NLMSG_DATA(hdr);
+
+	memset(buf, 0, sizeof(buf));
+	hdr->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+	hdr->nlmsg_type = NLMSG_DONE;
+	hdr->nlmsg_pid = getpid();
+	msg->id.idx = CN_IDX_PROC;
+	msg->id.val = CN_VAL_PROC;
+	msg->len = sizeof(op);
+	memcpy(msg->data, &op, sizeof(op));
+
+	if (send(fd, hdr, hdr->nlmsg_len, 0) != (ssize_t) hdr->nlmsg_len)
+		return -1;
+	return 0;
+}
+
+extern int proc_events_open(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_CONNECTOR);
+	if (fd < 0) {
+		debug2("%s: socket: %m", __func__);
+		return -1;
+	}
+	fd_set_close_on_exec(fd);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		debug2("%s: bind: %m", __func__);
+		close(fd);
+		return -1;
+	}
+
+	if (_set_listen(fd, PROC_CN_MCAST_LISTEN) < 0) {
+		debug2("%s: unable to subscribe to process events: %m",
+		       __func__);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Return true if the message holds the exit of one of the pids */
+static bool _exit_matches(struct proc_event *ev, pid_t *pids, int npids)
+{
+	int i;
+
+	if (ev->what != PROC_EVENT_EXIT)
+		return false;
+	if (!pids)
+		return true;
+	for (i = 0; i < npids; i++) {
+		if ((pids[i] == ev->event_data.exit.process_pid) ||
+		    (pids[i] == ev->event_data.exit.process_tgid))
+			return true;
+	}
+	return false;
+}
+
+extern bool proc_events_wait_exit(int fd, pid_t *pids, int npids,
+				  int timeout)
+{
+	char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *hdr;
+	struct cn_msg *msg;
+	struct pollfd pfd;
+	struct timeval now, end;
+	ssize_t len;
+	int rc, msec;
+
+	if (fd < 0) {
+		sleep(timeout);
+		return false;
+	}
+
+	gettimeofday(&end, NULL);
+	end.tv_sec += timeout;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	while (1) {
+		gettimeofday(&now, NULL);
+		msec = (end.tv_sec - now.tv_sec) * 1000 +
+		       (end.tv_usec - now.tv_usec) / 1000;
+		if (msec <= 0)
+			return false;
+
+		rc = poll(&pfd, 1, msec);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			error("%s: poll: %m", __func__);
+			sleep(timeout);
+			return false;
+		} else if (rc == 0)
+			return false;
+
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			/* ENOBUFS: events were dropped, the caller must
+			 * look for itself */
+			debug2("%s: recv: %m", __func__);
+			return true;
+		}
+
+		for (hdr = (struct nlmsghdr *) buf; NLMSG_OK(hdr, len);
+		     hdr = NLMSG_NEXT(hdr, len)) {
+			if ((hdr->nlmsg_type == NLMSG_ERROR) ||
+			    (hdr->nlmsg_type == NLMSG_NOOP))
+				continue;
+			msg = NLMSG_DATA(hdr);
+			if ((msg->id.idx != CN_IDX_PROC) ||
+			    (msg->id.val != CN_VAL_PROC))
+				continue;
+			if (_exit_matches((struct proc_event *) msg->data,
+					  pids, npids))
+				return true;
+		}
+	}
+}
+
+extern void proc_events_close(int fd)
+{
+	if (fd < 0)
+		return;
+	(void) _set_listen(fd, PROC_CN_MCAST_IGNORE);
+	close(fd);
+}
+
+#else
+
+extern int proc_events_open(void)
+{
+	return -1;
+}
+
+extern bool proc_events_wait_exit(int fd, pid_t *pids, int npids,
+				  int timeout)
+{
+	sleep(timeout);
+	return false;
+}
+
+extern void proc_events_close(int fd)
+{
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*****************************************************************************\
+ *  proc_events.h - wait for process exits using the Linux proc connector
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _PROC_EVENTS_H
+#define _PROC_EVENTS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * Subscribe to process exit notifications from the kernel.
+ * RET a file descriptor to pass to proc_events_wait_exit() or -1 if the
+ *	proc connector is not available (non-Linux, no CAP_NET_ADMIN, ...)
+ */
+extern int proc_events_open(void);
+
+/*
+ * Wait up to "timeout" seconds for one of the given processes to exit.
+ * IN fd - from proc_events_open(), if -1 just sleep for "timeout" seconds
+ * IN pids - processes or threads of interest, NULL for any process
+ * IN npids - count of pids
+ * RET true if one of the processes exited (or exits may have been lost),
+ *	false if the timeout expired
+ */
+extern bool proc_events_wait_exit(int fd, pid_t *pids, int npids,
+				  int timeout);
+
+/* Stop receiving process exit notifications */
+extern void proc_events_close(int fd);
+
+#endif /* _PROC_EVENTS_H */
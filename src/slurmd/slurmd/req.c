@@ -205,6 +205,8 @@ static int  _rpc_acct_gather_update(slurm_msg_t *);
 static int  _rpc_acct_gather_energy(slurm_msg_t *);
 static int  _rpc_step_complete(slurm_msg_t *msg);
 static int  _rpc_step_complete_aggr(slurm_msg_t *msg);
+static void _rpc_composite(slurm_msg_t *msg);
+static bool _can_reply(slurm_msg_t *msg);
 static int  _rpc_stat_jobacct(slurm_msg_t *msg);
 static int  _rpc_list_pids(slurm_msg_t *msg);
 static int  _rpc_daemon_status(slurm_msg_t *msg);
@@ -283,6 +285,20 @@ static pthread_cond_t  file_bcast_cond  = PTHREAD_COND_INITIALIZER;
 static int fb_read_lock = 0, fb_write_wait_lock = 0, fb_write_lock = 0;
 static List file_bcast_list = NULL;
 
+/* slurmstepds started ahead of launch requests, see
+ * LaunchParameters=slurmstepd_pool */
+typedef struct {
+	int to_stepd;		/* write end of the slurmstepd's stdin */
+	int to_slurmd;		/* read end of the slurmstepd's stdout */
+} pooled_stepd_t;
+
+static pthread_mutex_t stepd_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  stepd_pool_cond  = PTHREAD_COND_INITIALIZER;
+static List stepd_pool = NULL;
+static int stepd_pool_size = 0;
+static uint32_t stepd_pool_gen = 0;
+static bool stepd_pool_filling = false;
+
 void
 slurmd_req(slurm_msg_t *msg)
 {
@@ -393,6 +409,7 @@ slurmd_req(slurm_msg_t *msg)
 		/* Treat as ping (for slurmctld agent, just return SUCCESS) */
 		rc = _rpc_ping(msg);
 		last_slurmctld_msg = time(NULL);
+		slurmd_release_conn(msg);
 		/* Then initiate a separate node registration */
 		if (rc == SLURM_SUCCESS)
 			send_registration_msg(SLURM_SUCCESS, true);
@@ -456,6 +473,10 @@ slurmd_req(slurm_msg_t *msg)
 		debug2("Processing RPC: RESPONSE_MESSAGE_COMPOSITE");
 		msg_aggr_resp(msg);
 		break;
+	case REQUEST_MESSAGE_COMPOSITE:
+		debug2("Processing RPC: REQUEST_MESSAGE_COMPOSITE");
+		_rpc_composite(msg);
+		break;
 	default:
 		error("slurmd_req: invalid request msg type %d",
 		      msg->msg_type);
@@ -485,7 +506,8 @@ static int _send_slurmd_conf_lite (int fd, slurmd_conf_t *cf)
 static int
 _send_slurmstepd_init(int fd, int type, void *req,
 		      slurm_addr_t *cli, slurm_addr_t *self,
-		      hostset_t step_hset, uint16_t protocol_version)
+		      hostset_t step_hset, uint16_t protocol_version,
+		      bool pooled)
 {
 	int len = 0;
 	Buf buffer = NULL;
@@ -587,8 +609,8 @@ _send_slurmstepd_init(int fd, int type, void *req,
 	safe_write(fd, &max_depth, sizeof(int));
 	safe_write(fd, &parent_addr, sizeof(slurm_addr_t));
 
-	/* send conf over to slurmstepd */
-	if (_send_slurmd_conf_lite(fd, conf) < 0)
+	/* send conf over to slurmstepd, a pooled one already has it */
+	if (!pooled && (_send_slurmd_conf_lite(fd, conf) < 0))
 		goto rwfail;
 
 	/* send cli address over to slurmstepd */
@@ -725,16 +747,437 @@ rwfail:
 
 
 /*
- * Fork and exec the slurmstepd, then send the slurmstepd its
- * initialization data.  Then wait for slurmstepd to send an "ok"
- * message before returning.  When the "ok" message is received,
- * the slurmstepd has created and begun listening on its unix
- * domain socket.
+ * Exec the slurmstepd in a child of slurmd, with to_stepd and to_slurmd
+ * on its stdin and stdout. A pooled slurmstepd waits for the launch
+ * request after receiving slurmd's configuration.
  *
- * Note that this code forks twice and it is the grandchild that
+ * Note that this code forks again and it is the grandchild that
  * becomes the slurmstepd process, so the slurmstepd's parent process
  * will be init, not slurmd.
  */
+static void
+_exec_slurmstepd(int *to_stepd, int *to_slurmd, uint16_t type, void *req,
+		 bool pooled)
+{
+#if (SLURMSTEPD_MEMCHECK == 1)
+	/* memcheck test of slurmstepd, option #1 */
+	char *const argv[3] = {"memcheck",
+			       (char *)conf->stepd_loc, NULL};
+#elif (SLURMSTEPD_MEMCHECK == 2)
+	/* valgrind test of slurmstepd, option #2 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[13] = {"valgrind", "--tool=memcheck",
+				"--error-limit=no",
+				"--leak-check=summary",
+				"--show-reachable=yes",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				"--track-origins=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
+#elif (SLURMSTEPD_MEMCHECK == 3)
+	/* valgrind/drd test of slurmstepd, option #3 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[10] = {"valgrind", "--tool=drd",
+				"--error-limit=no",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
+#elif (SLURMSTEPD_MEMCHECK == 4)
+	/* valgrind/helgrind test of slurmstepd, option #4 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[10] = {"valgrind", "--tool=helgrind",
+				"--error-limit=no",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
+#else
+	/* no memory checking, default */
+	char *const argv[3] = { (char *)conf->stepd_loc,
+				pooled ? "pool" : NULL, NULL };
+#endif
+	pid_t pid;
+	int i;
+	int failed = 0;
+	/* inform slurmstepd about our config */
+	setenv("SLURM_CONF", conf->conffile, 1);
+
+	/*
+	 * Child forks and exits
+	 */
+	if (setsid() < 0) {
+		error("_forkexec_slurmstepd: setsid: %m");
+		failed = 1;
+	}
+	if ((pid = fork()) < 0) {
+		error("_forkexec_slurmstepd: "
+		      "Unable to fork grandchild: %m");
+		failed = 2;
+	} else if (pid > 0) { /* child */
+		exit(0);
+	}
+
+	/*
+	 * Just incase we (or someone we are linking to)
+	 * opened a file and didn't do a close on exec.  This
+	 * is needed mostly to protect us against libs we link
+	 * to that don't set the flag as we should already be
+	 * setting it for those that we open.  The number 256
+	 * is an arbitrary number based off test7.9.
+	 */
+	for (i=3; i<256; i++) {
+		(void) fcntl(i, F_SETFD, FD_CLOEXEC);
+	}
+
+	/*
+	 * Grandchild exec's the slurmstepd
+	 *
+	 * If the slurmd is being shutdown/restarted before
+	 * the pipe happens the old conf->lfd could be reused
+	 * and if we close it the dup2 below will fail.
+	 */
+	if ((to_stepd[0] != conf->lfd)
+	    && (to_slurmd[1] != conf->lfd))
+		slurm_shutdown_msg_engine(conf->lfd);
+
+	if (close(to_stepd[1]) < 0)
+		error("close write to_stepd in grandchild: %m");
+	if (close(to_slurmd[0]) < 0)
+		error("close read to_slurmd in parent: %m");
+
+	(void) close(STDIN_FILENO); /* ignore return */
+	if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
+		error("dup2 over STDIN_FILENO: %m");
+		exit(1);
+	}
+	fd_set_close_on_exec(to_stepd[0]);
+	(void) close(STDOUT_FILENO); /* ignore return */
+	if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
+		error("dup2 over STDOUT_FILENO: %m");
+		exit(1);
+	}
+	fd_set_close_on_exec(to_slurmd[1]);
+	(void) close(STDERR_FILENO); /* ignore return */
+	if (dup2(devnull, STDERR_FILENO) == -1) {
+		error("dup2 /dev/null to STDERR_FILENO: %m");
+		exit(1);
+	}
+	fd_set_noclose_on_exec(STDERR_FILENO);
+	log_fini();
+	if (!failed) {
+		if (conf->chos_loc && !access(conf->chos_loc, X_OK))
+			execvp(conf->chos_loc, argv);
+		else
+			execvp(argv[0], argv);
+		error("exec of slurmstepd failed: %m");
+	}
+	exit(2);
+}
+
+/*
+ * Send the slurmstepd its initialization data, then wait for slurmstepd
+ * to send an "ok" message before returning.  When the "ok" message is
+ * received, the slurmstepd has created and begun listening on its unix
+ * domain socket.
+ */
+static int
+_init_slurmstepd(int to_stepd, int to_slurmd, uint16_t type, void *req,
+		 slurm_addr_t *cli, slurm_addr_t *self,
+		 const hostset_t step_hset, uint16_t protocol_version,
+		 bool pooled)
+{
+	int rc = SLURM_SUCCESS;
+#if (SLURMSTEPD_MEMCHECK == 0)
+	int i;
+	time_t start_time = time(NULL);
+#endif
+
+	if ((rc = _send_slurmstepd_init(to_stepd, type, req, cli, self,
+					step_hset, protocol_version,
+					pooled)) != 0) {
+		error("Unable to init slurmstepd");
+		return rc;
+	}
+
+	/* If running under valgrind/memcheck, this pipe doesn't work
+	 * correctly so just skip it. */
+#if (SLURMSTEPD_MEMCHECK == 0)
+	i = read(to_slurmd, &rc, sizeof(int));
+	if (i < 0) {
+		error("%s: Can not read return code from slurmstepd "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_FAILURE;
+	} else if (i != sizeof(int)) {
+		error("%s: slurmstepd failed to send return code "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_FAILURE;
+	} else {
+		int delta_time = time(NULL) - start_time;
+		int cc;
+		if (delta_time > 5) {
+			info("Warning: slurmstepd startup took %d sec, "
+			     "possible file system problem or full "
+			     "memory", delta_time);
+		}
+		if (rc != SLURM_SUCCESS)
+			error("slurmstepd return code %d", rc);
+
+		cc = SLURM_SUCCESS;
+		cc = write(to_stepd, &cc, sizeof(int));
+		if (cc != sizeof(int)) {
+			error("%s: failed to send ack to stepd %d: %m",
+			      __func__, cc);
+		}
+	}
+#endif
+	return rc;
+}
+
+static void _pooled_stepd_destroy(void *x)
+{
+	pooled_stepd_t *stepd = (pooled_stepd_t *) x;
+
+	/* The slurmstepd exits when it reads EOF */
+	if (close(stepd->to_stepd) < 0)
+		error("close write to pooled stepd: %m");
+	if (close(stepd->to_slurmd) < 0)
+		error("close read from pooled stepd: %m");
+	xfree(stepd);
+}
+
+/*
+ * Start a slurmstepd for the pool, send it slurmd's configuration and
+ * wait until it has loaded its plugins.
+ * RET the pooled slurmstepd or NULL on failure
+ */
+static pooled_stepd_t *_stepd_pool_spawn(void)
+{
+	pooled_stepd_t *stepd;
+	pid_t pid;
+	int to_stepd[2] = {-1, -1};
+	int to_slurmd[2] = {-1, -1};
+	int rc = SLURM_FAILURE;
+
+	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
+		error("%s: pipe failed: %m", __func__);
+		return NULL;
+	}
+
+	if ((pid = fork()) < 0) {
+		error("%s: fork: %m", __func__);
+		close(to_stepd[0]);
+		close(to_stepd[1]);
+		close(to_slurmd[0]);
+		close(to_slurmd[1]);
+		return NULL;
+	} else if (pid == 0) {
+		_exec_slurmstepd(to_stepd, to_slurmd, 0, NULL, true);
+	}
+
+	if (close(to_stepd[0]) < 0)
+		error("Unable to close read to_stepd in parent: %m");
+	if (close(to_slurmd[1]) < 0)
+		error("Unable to close write to_slurmd in parent: %m");
+	/* Do not leak the pipes into other slurmstepds, they would keep
+	 * a dropped pooled slurmstepd from ever reading EOF */
+	fd_set_close_on_exec(to_stepd[1]);
+	fd_set_close_on_exec(to_slurmd[0]);
+
+	/* Reap child */
+	if (waitpid(pid, NULL, 0) < 0)
+		error("Unable to reap slurmd child process");
+
+	stepd = xmalloc(sizeof(pooled_stepd_t));
+	stepd->to_stepd = to_stepd[1];
+	stepd->to_slurmd = to_slurmd[0];
+	if ((_send_slurmd_conf_lite(stepd->to_stepd, conf) < 0) ||
+	    (read(stepd->to_slurmd, &rc, sizeof(int)) != sizeof(int)) ||
+	    (rc != SLURM_SUCCESS)) {
+		error("%s: pooled slurmstepd failed to start: %d",
+		      __func__, rc);
+		_pooled_stepd_destroy(stepd);
+		return NULL;
+	}
+
+	return stepd;
+}
+
+static void *_stepd_pool_fill(void *arg)
+{
+	pooled_stepd_t *stepd;
+	uint32_t gen;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	while (stepd_pool && (list_count(stepd_pool) < stepd_pool_size)) {
+		gen = stepd_pool_gen;
+		slurm_mutex_unlock(&stepd_pool_mutex);
+
+		stepd = _stepd_pool_spawn();
+
+		slurm_mutex_lock(&stepd_pool_mutex);
+		if (!stepd)
+			break;
+		/* Drop it if the pool was flushed meanwhile */
+		if (stepd_pool && (gen == stepd_pool_gen))
+			list_append(stepd_pool, stepd);
+		else
+			_pooled_stepd_destroy(stepd);
+	}
+	stepd_pool_filling = false;
+	slurm_cond_broadcast(&stepd_pool_cond);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	return NULL;
+}
+
+/* Start refilling the pool in the background. Call with stepd_pool_mutex
+ * locked. */
+static void _stepd_pool_refill(void)
+{
+	pthread_attr_t attr;
+	pthread_t id;
+
+	if (stepd_pool_filling || !stepd_pool ||
+	    (list_count(stepd_pool) >= stepd_pool_size))
+		return;
+
+	slurm_attr_init(&attr);
+	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+		error("%s: pthread_attr_setdetachstate: %m", __func__);
+	if (pthread_create(&id, &attr, _stepd_pool_fill, NULL))
+		error("%s: pthread_create: %m", __func__);
+	else
+		stepd_pool_filling = true;
+	slurm_attr_destroy(&attr);
+}
+
+/* Return true if a pooled slurmstepd is still waiting for a request */
+static bool _pooled_stepd_alive(pooled_stepd_t *stepd)
+{
+	struct pollfd pfd;
+
+	/* A slurmstepd that exited has closed its end of the pipe */
+	pfd.fd = stepd->to_slurmd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return (poll(&pfd, 1, 0) == 0);
+}
+
+/* Take a slurmstepd from the pool, RET NULL if none is available */
+static pooled_stepd_t *_stepd_pool_get(void)
+{
+	pooled_stepd_t *stepd = NULL;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	while (stepd_pool && (stepd = list_pop(stepd_pool))) {
+		if (_pooled_stepd_alive(stepd))
+			break;
+		debug("%s: dropping dead pooled slurmstepd", __func__);
+		_pooled_stepd_destroy(stepd);
+	}
+	if (stepd_pool)
+		_stepd_pool_refill();
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	return stepd;
+}
+
+extern void stepd_pool_init(void)
+{
+	char *launch_params, *tmp_ptr;
+	int size = 0;
+
+#if (SLURMSTEPD_MEMCHECK == 0)
+	launch_params = slurm_get_launch_params();
+	if (launch_params &&
+	    (tmp_ptr = strstr(launch_params, "slurmstepd_pool=")))
+		size = atoi(tmp_ptr + 16);
+	xfree(launch_params);
+#endif
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	/* Pooled slurmstepds hold the configuration they were started
+	 * with, replace them all */
+	FREE_NULL_LIST(stepd_pool);
+	stepd_pool_gen++;
+	stepd_pool_size = MAX(size, 0);
+	if (stepd_pool_size) {
+		stepd_pool = list_create(_pooled_stepd_destroy);
+		_stepd_pool_refill();
+	}
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+extern void stepd_pool_fini(void)
+{
+	slurm_mutex_lock(&stepd_pool_mutex);
+	FREE_NULL_LIST(stepd_pool);
+	stepd_pool_gen++;
+	stepd_pool_size = 0;
+	/* The fill thread is detached and uses conf, let it finish first */
+	while (stepd_pool_filling)
+		slurm_cond_wait(&stepd_pool_cond, &stepd_pool_mutex);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+/* Record a slurmstepd which is now running in the stepd registry */
+static void _stepd_registry_add(uint16_t type, void *req)
+{
+	switch (type) {
+	case LAUNCH_BATCH_JOB:
+		stepd_registry_add(((batch_job_launch_msg_t *)req)->job_id,
+				   SLURM_BATCH_SCRIPT);
+		break;
+	case LAUNCH_TASKS:
+		stepd_registry_add(((launch_tasks_request_msg_t *)req)->job_id,
+			((launch_tasks_request_msg_t *)req)->job_step_id);
+		break;
+	}
+}
+
+/*
+ * Fork and exec the slurmstepd, or take one from the pool of those
+ * started ahead of time, then send the slurmstepd its initialization
+ * data and wait for it to be ready.
+ */
 static int
 _forkexec_slurmstepd(uint16_t type, void *req,
 		     slurm_addr_t *cli, slurm_addr_t *self,
@@ -743,6 +1186,33 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 	pid_t pid;
 	int to_stepd[2] = {-1, -1};
 	int to_slurmd[2] = {-1, -1};
+	pooled_stepd_t *stepd;
+	int rc;
+	DEF_TIMERS;
+
+	START_TIMER;
+	if ((stepd = _stepd_pool_get())) {
+		if (_add_starting_step(type, req)) {
+			error("_forkexec_slurmstepd failed in "
+			      "_add_starting_step: %m");
+			_pooled_stepd_destroy(stepd);
+			return SLURM_FAILURE;
+		}
+		rc = _init_slurmstepd(stepd->to_stepd, stepd->to_slurmd,
+				      type, req, cli, self, step_hset,
+				      protocol_version, true);
+		/* Register the step before it leaves the starting list, or
+		 * a kill arriving in between would not find it */
+		if (rc == SLURM_SUCCESS)
+			_stepd_registry_add(type, req);
+		if (_remove_starting_step(type, req))
+			error("Error cleaning up starting_step list");
+		_pooled_stepd_destroy(stepd);
+		END_TIMER;
+		debug("%s: pooled slurmstepd ready in %s", __func__,
+		      TIME_STR);
+		return rc;
+	}
 
 	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
 		error("_forkexec_slurmstepd pipe failed: %m");
@@ -762,224 +1232,38 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		close(to_slurmd[1]);
 		_remove_starting_step(type, req);
 		return SLURM_FAILURE;
-	} else if (pid > 0) {
-		int rc = SLURM_SUCCESS;
-#if (SLURMSTEPD_MEMCHECK == 0)
-		int i;
-		time_t start_time = time(NULL);
-#endif
-		/*
-		 * Parent sends initialization data to the slurmstepd
-		 * over the to_stepd pipe, and waits for the return code
-		 * reply on the to_slurmd pipe.
-		 */
-		if (close(to_stepd[0]) < 0)
-			error("Unable to close read to_stepd in parent: %m");
-		if (close(to_slurmd[1]) < 0)
-			error("Unable to close write to_slurmd in parent: %m");
-
-		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
-						req, cli, self,
-						step_hset,
-						protocol_version)) != 0) {
-			error("Unable to init slurmstepd");
-			goto done;
-		}
-
-		/* If running under valgrind/memcheck, this pipe doesn't work
-		 * correctly so just skip it. */
-#if (SLURMSTEPD_MEMCHECK == 0)
-		i = read(to_slurmd[0], &rc, sizeof(int));
-		if (i < 0) {
-			error("%s: Can not read return code from slurmstepd "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_FAILURE;
-		} else if (i != sizeof(int)) {
-			error("%s: slurmstepd failed to send return code "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_FAILURE;
-		} else {
-			int delta_time = time(NULL) - start_time;
-			int cc;
-			if (delta_time > 5) {
-				info("Warning: slurmstepd startup took %d sec, "
-				     "possible file system problem or full "
-				     "memory", delta_time);
-			}
-			if (rc != SLURM_SUCCESS)
-				error("slurmstepd return code %d", rc);
-
-			cc = SLURM_SUCCESS;
-			cc = write(to_stepd[1], &cc, sizeof(int));
-			if (cc != sizeof(int)) {
-				error("%s: failed to send ack to stepd %d: %m",
-				      __func__, cc);
-			}
-		}
-#endif
-	done:
-		if (_remove_starting_step(type, req))
-			error("Error cleaning up starting_step list");
-
-		/* Reap child */
-		if (waitpid(pid, NULL, 0) < 0)
-			error("Unable to reap slurmd child process");
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in parent: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-		return rc;
-	} else {
-#if (SLURMSTEPD_MEMCHECK == 1)
-		/* memcheck test of slurmstepd, option #1 */
-		char *const argv[3] = {"memcheck",
-				       (char *)conf->stepd_loc, NULL};
-#elif (SLURMSTEPD_MEMCHECK == 2)
-		/* valgrind test of slurmstepd, option #2 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[13] = {"valgrind", "--tool=memcheck",
-					"--error-limit=no",
-					"--leak-check=summary",
-					"--show-reachable=yes",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					"--track-origins=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
-#elif (SLURMSTEPD_MEMCHECK == 3)
-		/* valgrind/drd test of slurmstepd, option #3 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[10] = {"valgrind", "--tool=drd",
-					"--error-limit=no",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
-#elif (SLURMSTEPD_MEMCHECK == 4)
-		/* valgrind/helgrind test of slurmstepd, option #4 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[10] = {"valgrind", "--tool=helgrind",
-					"--error-limit=no",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
-#else
-		/* no memory checking, default */
-		char *const argv[2] = { (char *)conf->stepd_loc, NULL};
-#endif
-		int i;
-		int failed = 0;
-		/* inform slurmstepd about our config */
-		setenv("SLURM_CONF", conf->conffile, 1);
+	} else if (pid == 0) {
+		_exec_slurmstepd(to_stepd, to_slurmd, type, req, false);
+	}
 
-		/*
-		 * Child forks and exits
-		 */
-		if (setsid() < 0) {
-			error("_forkexec_slurmstepd: setsid: %m");
-			failed = 1;
-		}
-		if ((pid = fork()) < 0) {
-			error("_forkexec_slurmstepd: "
-			      "Unable to fork grandchild: %m");
-			failed = 2;
-		} else if (pid > 0) { /* child */
-			exit(0);
-		}
+	/*
+	 * Parent sends initialization data to the slurmstepd
+	 * over the to_stepd pipe, and waits for the return code
+	 * reply on the to_slurmd pipe.
+	 */
+	if (close(to_stepd[0]) < 0)
+		error("Unable to close read to_stepd in parent: %m");
+	if (close(to_slurmd[1]) < 0)
+		error("Unable to close write to_slurmd in parent: %m");
 
-		/*
-		 * Just incase we (or someone we are linking to)
-		 * opened a file and didn't do a close on exec.  This
-		 * is needed mostly to protect us against libs we link
-		 * to that don't set the flag as we should already be
-		 * setting it for those that we open.  The number 256
-		 * is an arbitrary number based off test7.9.
-		 */
-		for (i=3; i<256; i++) {
-			(void) fcntl(i, F_SETFD, FD_CLOEXEC);
-		}
+	rc = _init_slurmstepd(to_stepd[1], to_slurmd[0], type, req, cli, self,
+			      step_hset, protocol_version, false);
 
-		/*
-		 * Grandchild exec's the slurmstepd
-		 *
-		 * If the slurmd is being shutdown/restarted before
-		 * the pipe happens the old conf->lfd could be reused
-		 * and if we close it the dup2 below will fail.
-		 */
-		if ((to_stepd[0] != conf->lfd)
-		    && (to_slurmd[1] != conf->lfd))
-			slurm_shutdown_msg_engine(conf->lfd);
-
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in grandchild: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-
-		(void) close(STDIN_FILENO); /* ignore return */
-		if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
-			error("dup2 over STDIN_FILENO: %m");
-			exit(1);
-		}
-		fd_set_close_on_exec(to_stepd[0]);
-		(void) close(STDOUT_FILENO); /* ignore return */
-		if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
-			error("dup2 over STDOUT_FILENO: %m");
-			exit(1);
-		}
-		fd_set_close_on_exec(to_slurmd[1]);
-		(void) close(STDERR_FILENO); /* ignore return */
-		if (dup2(devnull, STDERR_FILENO) == -1) {
-			error("dup2 /dev/null to STDERR_FILENO: %m");
-			exit(1);
-		}
-		fd_set_noclose_on_exec(STDERR_FILENO);
-		log_fini();
-		if (!failed) {
-			if (conf->chos_loc && !access(conf->chos_loc, X_OK))
-				execvp(conf->chos_loc, argv);
-			else
-				execvp(argv[0], argv);
-			error("exec of slurmstepd failed: %m");
-		}
-		exit(2);
-	}
+	if (rc == SLURM_SUCCESS)
+		_stepd_registry_add(type, req);
+	if (_remove_starting_step(type, req))
+		error("Error cleaning up starting_step list");
+
+	/* Reap child */
+	if (waitpid(pid, NULL, 0) < 0)
+		error("Unable to reap slurmd child process");
+	if (close(to_stepd[1]) < 0)
+		error("close write to_stepd in parent: %m");
+	if (close(to_slurmd[0]) < 0)
+		error("close read to_slurmd in parent: %m");
+	END_TIMER;
+	debug("%s: slurmstepd ready in %s", __func__, TIME_STR);
+	return rc;
 }
 
 
@@ -2783,6 +3067,19 @@ _enforce_job_mem_limit(void)
 	xfree(job_mem_info_ptr);
 }
 
+/* This node's energy use as last sampled by the energy plugin, piggybacked
+ * on a message to slurmctld to spare it a separate
+ * REQUEST_ACCT_GATHER_UPDATE. The sensors are not read here, pings and epilog
+ * completions must not wait on them. */
+static acct_gather_energy_t *_node_energy(void)
+{
+	acct_gather_energy_t *energy = acct_gather_energy_alloc(1);
+
+	acct_gather_energy_g_get_data(ENERGY_DATA_NODE_ENERGY, energy);
+
+	return energy;
+}
+
 static int
 _rpc_ping(slurm_msg_t *msg)
 {
@@ -2820,11 +3117,13 @@ _rpc_ping(slurm_msg_t *msg)
 		ping_slurmd_resp_msg_t ping_resp;
 		get_cpu_load(&ping_resp.cpu_load);
 		get_free_mem(&ping_resp.free_mem);
+		ping_resp.energy = _node_energy();
 		slurm_msg_t_copy(&resp_msg, msg);
 		resp_msg.msg_type = RESPONSE_PING_SLURMD;
 		resp_msg.data     = &ping_resp;
 
 		slurm_send_node_msg(msg->conn_fd, &resp_msg);
+		acct_gather_energy_destroy(ping_resp.energy);
 	}
 
 	/* Take this opportunity to enforce any job memory limits */
@@ -2858,6 +3157,7 @@ _rpc_health_check(slurm_msg_t *msg)
 		error("Error responding to health check: %m");
 		send_registration_msg(SLURM_SUCCESS, false);
 	}
+	slurmd_release_conn(msg);
 
 	if (rc == SLURM_SUCCESS)
 		rc = run_script_health_check();
@@ -3246,6 +3546,72 @@ _rpc_step_complete_aggr(slurm_msg_t *msg)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * RET true if a reply to msg can still be sent, on its connection or, for a
+ * request of a composite message, with the reply to the composite message
+ */
+static bool
+_can_reply(slurm_msg_t *msg)
+{
+	return ((msg->conn_fd >= 0) || (msg->msg_index && msg->ret_list));
+}
+
+/* Requests from slurmctld bundled into a REQUEST_MESSAGE_COMPOSITE by its
+ * agent. Each request is processed in its own thread as if it had arrived
+ * on a connection of its own, their return codes are sent back together in
+ * a RESPONSE_MESSAGE_COMPOSITE. */
+static void
+_rpc_composite(slurm_msg_t *msg)
+{
+	composite_msg_t *comp_msg = (composite_msg_t *) msg->data;
+	composite_msg_t comp_resp;
+	slurm_msg_t *next_msg, resp_msg;
+	List req_list;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, conf->auth_info);
+
+	if (!_slurm_authorized_user(uid)) {
+		error("Security violation: composite msg from uid %d", uid);
+		slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
+		return;
+	}
+
+	memset(&comp_resp, 0, sizeof(composite_msg_t));
+	comp_resp.msg_list = list_create(slurm_free_comp_msg_list);
+	req_list = list_create(NULL);
+	while (comp_msg->msg_list &&
+	       (next_msg = list_dequeue(comp_msg->msg_list))) {
+		switch (next_msg->msg_type) {
+		case REQUEST_ABORT_JOB:
+		case REQUEST_KILL_PREEMPTED:
+		case REQUEST_KILL_TIMELIMIT:
+		case REQUEST_SIGNAL_JOB:
+		case REQUEST_SIGNAL_TASKS:
+		case REQUEST_TERMINATE_JOB:
+		case REQUEST_TERMINATE_TASKS:
+			memcpy(&next_msg->address, &msg->address,
+			       sizeof(slurm_addr_t));
+			memcpy(&next_msg->orig_addr, &msg->orig_addr,
+			       sizeof(slurm_addr_t));
+			list_append(req_list, next_msg);
+			break;
+		default:
+			error("%s: invalid msg type %s in composite msg",
+			      __func__, rpc_num2string(next_msg->msg_type));
+			slurm_free_comp_msg_list(next_msg);
+			break;
+		}
+	}
+	slurmd_spawn_reqs(req_list, comp_resp.msg_list);
+	FREE_NULL_LIST(req_list);
+
+	slurm_msg_t_copy(&resp_msg, msg);
+	resp_msg.msg_type = RESPONSE_MESSAGE_COMPOSITE;
+	resp_msg.data     = &comp_resp;
+	slurm_send_node_msg(msg->conn_fd, &resp_msg);
+	slurmd_release_conn(msg);
+	FREE_NULL_LIST(comp_resp.msg_list);
+}
+
 /* Get list of active jobs and steps, xfree returned value */
 static char *
 _get_step_list(void)
@@ -3594,8 +3960,7 @@ _rpc_timelimit(slurm_msg_t *msg)
 	 *  Indicate to slurmctld that we've received the message
 	 */
 	slurm_send_rc_msg(msg, SLURM_SUCCESS);
-	slurm_close(msg->conn_fd);
-	msg->conn_fd = -1;
+	slurmd_release_conn(msg);
 
 	if (req->step_id != NO_VAL) {
 		slurm_ctl_conf_t *cf;
@@ -4497,6 +4862,9 @@ static void _epilog_complete_msg_setup(
 	req->job_id      = jobid;
 	req->return_code = rc;
 	req->node_name   = conf->node_name;
+	get_cpu_load(&req->cpu_load);
+	get_free_mem(&req->free_mem);
+	req->energy      = _node_energy();
 
 	msg->msg_type    = MESSAGE_EPILOG_COMPLETE;
 	msg->data        = req;
@@ -4540,6 +4908,7 @@ _epilog_complete(uint32_t jobid, int rc)
 			debug("Job %u: sent epilog complete msg: rc = %d",
 			      jobid, rc);
 		}
+		acct_gather_energy_destroy(req.energy);
 	}
 	return ret;
 }
@@ -4573,12 +4942,9 @@ _rpc_signal_job(slurm_msg_t *msg)
 	if ((req_uid != job_uid) && (!_slurm_authorized_user(req_uid))) {
 		error("Security violation: kill_job(%u) from uid %d",
 		      req->job_id, req_uid);
-		if (msg->conn_fd >= 0) {
+		if (_can_reply(msg)) {
 			slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
-			if (slurm_close(msg->conn_fd) < 0)
-				error ("_rpc_signal_job: close(%d): %m",
-				       msg->conn_fd);
-			msg->conn_fd = -1;
+			slurmd_release_conn(msg);
 		}
 		return;
 	}
@@ -4633,11 +4999,9 @@ no_job:
 	 *  At this point, if connection still open, we send controller
 	 *   a "success" reply to indicate that we've recvd the msg.
 	 */
-	if (msg->conn_fd >= 0) {
+	if (_can_reply(msg)) {
 		slurm_send_rc_msg(msg, SLURM_SUCCESS);
-		if (slurm_close(msg->conn_fd) < 0)
-			error ("_rpc_signal_job: close(%d): %m", msg->conn_fd);
-		msg->conn_fd = -1;
+		slurmd_release_conn(msg);
 	}
 }
 
@@ -4746,10 +5110,7 @@ _rpc_suspend_job(slurm_msg_t *msg)
 	 * detected with the request */
 	if (msg->conn_fd >= 0) {
 		slurm_send_rc_msg(msg, rc);
-		if (slurm_close(msg->conn_fd) < 0)
-			error("_rpc_suspend_job: close(%d): %m",
-			      msg->conn_fd);
-		msg->conn_fd = -1;
+		slurmd_release_conn(msg);
 	}
 	if (rc != SLURM_SUCCESS)
 		return;
@@ -4929,7 +5290,7 @@ _rpc_abort_job(slurm_msg_t *msg)
 	if (!_slurm_authorized_user(uid)) {
 		error("Security violation: abort_job(%u) from uid %d",
 		      req->job_id, uid);
-		if (msg->conn_fd >= 0)
+		if (_can_reply(msg))
 			slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
 		return;
 	}
@@ -4951,11 +5312,9 @@ _rpc_abort_job(slurm_msg_t *msg)
 	 *  At this point, if connection still open, we send controller
 	 *   a "success" reply to indicate that we've recvd the msg.
 	 */
-	if (msg->conn_fd >= 0) {
+	if (_can_reply(msg)) {
 		slurm_send_rc_msg(msg, SLURM_SUCCESS);
-		if (slurm_close(msg->conn_fd) < 0)
-			error ("rpc_abort_job: close(%d): %m", msg->conn_fd);
-		msg->conn_fd = -1;
+		slurmd_release_conn(msg);
 	}
 
 	if (_kill_all_active_steps(req->job_id, SIG_ABORT, true)) {
@@ -4964,6 +5323,7 @@ _rpc_abort_job(slurm_msg_t *msg)
 		 */
 		_pause_for_job_completion (req->job_id, req->nodes, 0);
 	}
+	stepd_registry_remove_job(req->job_id);
 
 	/*
 	 *  Begin expiration period for cached information about job.
@@ -5236,7 +5596,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 	if (!_slurm_authorized_user(uid)) {
 		error("Security violation: kill_job(%u) from uid %d",
 		      req->job_id, uid);
-		if (msg->conn_fd >= 0)
+		if (_can_reply(msg))
 			slurm_send_rc_msg(msg, ESLURM_USER_ID_MISSING);
 		return;
 	}
@@ -5251,7 +5611,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 	 *   then exit this thread.
 	 */
 	if (_waiter_init(req->job_id) == SLURM_ERROR) {
-		if (msg->conn_fd >= 0) {
+		if (_can_reply(msg)) {
 			/* No matter if the step hasn't started yet or
 			 * not just send a success to let the
 			 * controller know we got this request.
@@ -5279,17 +5639,14 @@ _rpc_terminate_job(slurm_msg_t *msg)
 	 * job termination message and run indefinitely.
 	 */
 	if (_step_is_starting(req->job_id, NO_VAL)) {
-		if (msg->conn_fd >= 0) {
+		if (_can_reply(msg)) {
 			/* If the step hasn't started yet just send a
 			 * success to let the controller know we got
 			 * this request.
 			 */
 			debug("sent SUCCESS, waiting for step to start");
 			slurm_send_rc_msg (msg, SLURM_SUCCESS);
-			if (slurm_close(msg->conn_fd) < 0)
-				error ( "rpc_kill_job: close(%d): %m",
-					msg->conn_fd);
-			msg->conn_fd = -1;
+			slurmd_release_conn(msg);
 		}
 		if (_wait_for_starting_step(req->job_id, NO_VAL)) {
 			/*
@@ -5337,7 +5694,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 	 */
 	if ((nsteps == 0) && !conf->epilog && !have_spank) {
 		debug4("sent ALREADY_COMPLETE");
-		if (msg->conn_fd >= 0) {
+		if (_can_reply(msg)) {
 			slurm_send_rc_msg(msg,
 					  ESLURMD_KILL_JOB_ALREADY_COMPLETE);
 		}
@@ -5352,7 +5709,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 		 * to terminate is resent.
 		 */
 		_sync_messages_kill(req);
-		if (msg->conn_fd < 0) {
+		if (!_can_reply(msg)) {
 			/* The epilog complete message processing on
 			 * slurmctld is equivalent to that of a
 			 * ESLURMD_KILL_JOB_ALREADY_COMPLETE reply above */
@@ -5368,12 +5725,10 @@ _rpc_terminate_job(slurm_msg_t *msg)
 	 *  At this point, if connection still open, we send controller
 	 *   a "success" reply to indicate that we've recvd the msg.
 	 */
-	if (msg->conn_fd >= 0) {
+	if (_can_reply(msg)) {
 		debug4("sent SUCCESS");
 		slurm_send_rc_msg(msg, SLURM_SUCCESS);
-		if (slurm_close(msg->conn_fd) < 0)
-			error ("rpc_kill_job: close(%d): %m", msg->conn_fd);
-		msg->conn_fd = -1;
+		slurmd_release_conn(msg);
 	}
 
 	/*
@@ -5387,6 +5742,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 		 */
 		_pause_for_job_completion (req->job_id, req->nodes, 0);
 	}
+	stepd_registry_remove_job(req->job_id);
 
 	/*
 	 *  Begin expiration period for cached information about job.
@@ -54,6 +54,12 @@ void gids_cache_purge(void);
 /* Add record for every launched job so we know they are ready for suspend */
 extern void record_launched_jobs(void);
 
+/* (Re)start the pool of slurmstepds waiting for launch requests, sized by
+ * LaunchParameters=slurmstepd_pool=<count> */
+extern void stepd_pool_init(void);
+/* Terminate all pooled slurmstepds */
+extern void stepd_pool_fini(void);
+
 void file_bcast_init(void);
 void file_bcast_purge(void);
 
@@ -50,12 +50,14 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <grp.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -127,7 +129,7 @@ int devnull = -1;
 slurmd_conf_t * conf = NULL;
 
 /*
- * count of active threads
+ * count of active threads, including requests queued for a worker
  */
 static int             active_threads = 0;
 static pthread_mutex_t active_mutex   = PTHREAD_MUTEX_INITIALIZER;
@@ -135,11 +137,67 @@ static pthread_cond_t  active_cond    = PTHREAD_COND_INITIALIZER;
 
 static pthread_mutex_t fork_mutex     = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Replies of the requests of one composite message, see slurmd_spawn_reqs().
+ * Protected by comp_mutex.
+ */
+typedef struct comp_reply {
+	List resp_list;		/* replies, see slurm_send_rc_msg() */
+	int pending;		/* requests still being processed */
+	int refcnt;
+} comp_reply_t;
+
+static pthread_mutex_t comp_mutex     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  comp_cond      = PTHREAD_COND_INITIALIZER;
+
+/* msec between checks for the replies of a composite message's requests,
+ * which are added to its resp_list without notice */
+#define COMP_REPLY_POLL		10
+
 typedef struct connection {
 	int fd;
 	slurm_addr_t *cli_addr;
+	slurm_msg_t *msg;	/* request already read, if any */
+	time_t idle_end;	/* close a parked connection still idle then */
+	comp_reply_t *comp;	/* composite message msg came in, if any */
 } conn_t;
 
+/*
+ * Pools of worker threads processing the requests accepted by the message
+ * engine, each with at most MAX_THREADS workers. Workers are started as
+ * requests are queued and exit after sitting idle for WORKER_IDLE seconds.
+ * Requests which may block for a long time get their own pool, so pings
+ * and other short requests are still answered while hundreds of steps are
+ * launched or killed. Protected by active_mutex.
+ */
+#define WORKER_IDLE		60
+
+typedef struct worker_pool {
+	char *name;
+	List queue;		/* conn_t records waiting for a worker */
+	int threads;		/* workers running */
+	int idle;		/* workers waiting on cond */
+	bool logged;		/* logged that all workers are busy */
+	pthread_cond_t cond;
+} worker_pool_t;
+
+static worker_pool_t   req_pool  = { "request", NULL, 0, 0, false,
+				     PTHREAD_COND_INITIALIZER };
+static worker_pool_t   long_pool = { "long request", NULL, 0, 0, false,
+				     PTHREAD_COND_INITIALIZER };
+
+/*
+ * Connections kept open by their sender, parked by the workers for the
+ * message engine to poll for the next request. parked_cnt counts those
+ * queued here and those polled by the engine, at most MAX_PARKED_CONNS.
+ */
+#define MAX_PARKED_CONNS	128
+
+static List            parked_conns  = NULL;
+static int             parked_cnt    = 0;
+static pthread_mutex_t parked_mutex  = PTHREAD_MUTEX_INITIALIZER;
+static int             engine_wake_fd[2] = { -1, -1 };
+
 /*
  * Global data for resource specialization
  */
@@ -162,6 +220,8 @@ static time_t sent_reg_time = (time_t) 0;
 
 static void      _atfork_final(void);
 static void      _atfork_prepare(void);
+static void      _close_conn(conn_t *con);
+static void      _comp_part_done(comp_reply_t *comp, slurm_msg_t *msg);
 static int       _convert_spec_cores(void);
 static int       _core_spec_init(void);
 static void      _create_msg_socket(void);
@@ -177,12 +237,17 @@ static void      _init_conf(void);
 static void      _install_fork_handlers(void);
 static bool      _is_core_spec_cray(void);
 static void      _kill_old_slurmd(void);
+static bool      _long_running_req(uint16_t msg_type);
 static int       _memory_spec_init(void);
 static void      _msg_engine(void);
+static bool      _keep_open(slurm_msg_t *msg);
+static bool      _park_conn(int fd, slurm_addr_t *cli);
 static uint64_t  _parse_msg_aggr_params(int type, char *params);
 static void      _print_conf(void);
 static void      _print_config(void);
 static void      _process_cmdline(int ac, char **av);
+static void      _queue_conn(worker_pool_t *pool, conn_t *con,
+			     bool new_req);
 static void      _read_config(void);
 static void      _reconfigure(void);
 static void     *_registration_engine(void *arg);
@@ -190,7 +255,7 @@ static void      _resource_spec_fini(void);
 static int       _resource_spec_init(void);
 static int       _restore_cred_state(slurm_cred_ctx_t ctx);
 static void      _select_spec_cores(void);
-static void     *_service_connection(void *);
+static void      _service_connection(conn_t *con, worker_pool_t *pool);
 static void      _set_msg_aggr_params(void);
 static int       _set_slurmd_spooldir(void);
 static int       _set_topo_info(void);
@@ -204,6 +269,7 @@ static void      _usage(void);
 static int       _validate_and_convert_cpu_list(void);
 static void      _wait_for_all_threads(int secs);
 static void      _wait_health_check(void);
+static void     *_worker(void *arg);
 
 int
 main (int argc, char *argv[])
@@ -369,6 +435,7 @@ main (int argc, char *argv[])
 	/* Wait for a successfull health check if HealthCheckInterval != 0 */
 	_wait_health_check();
 
+	stepd_pool_init();
 	_spawn_registration_engine();
 	msg_aggr_sender_init(conf->hostname, conf->port,
 			     conf->msg_aggr_window_time,
@@ -384,6 +451,7 @@ main (int argc, char *argv[])
 	if (unlink(conf->pidfile) < 0)
 		error("Unable to remove pidfile `%s': %m", conf->pidfile);
 
+	stepd_pool_fini();
 	_wait_for_all_threads(120);
 	_slurmd_fini();
 	_destroy_conf();
@@ -450,11 +518,25 @@ _registration_engine(void *arg)
 static void
 _msg_engine(void)
 {
+	struct pollfd *pfds = NULL;
+	conn_t **idle = NULL, *con;
+	int idle_cnt = 0, idle_size = 0;
 	slurm_addr_t *cli;
-	int sock;
+	time_t now;
+	char buf[64];
+	int i, j, sock;
 
 	msg_pthread = pthread_self();
 	slurmd_req(NULL);	/* initialize timer */
+	if (pipe(engine_wake_fd) < 0)
+		fatal("%s: pipe: %m", __func__);
+	fd_set_nonblocking(engine_wake_fd[0]);
+	fd_set_nonblocking(engine_wake_fd[1]);
+	fd_set_close_on_exec(engine_wake_fd[0]);
+	fd_set_close_on_exec(engine_wake_fd[1]);
+	req_pool.queue  = list_create(NULL);
+	long_pool.queue = list_create(NULL);
+
 	while (!_shutdown) {
 		if (_reconfig) {
 			verbose("got reconfigure request");
@@ -462,6 +544,60 @@ _msg_engine(void)
 			_reconfigure();
 		}
 
+		/* Pick up connections parked by the request workers */
+		slurm_mutex_lock(&parked_mutex);
+		while (parked_conns && (con = list_dequeue(parked_conns))) {
+			if (idle_cnt >= idle_size) {
+				idle_size += 64;
+				xrealloc(idle, sizeof(conn_t *) * idle_size);
+			}
+			idle[idle_cnt++] = con;
+		}
+		slurm_mutex_unlock(&parked_mutex);
+
+		xrealloc(pfds, sizeof(struct pollfd) * (idle_cnt + 2));
+		pfds[0].fd = engine_wake_fd[0];
+		pfds[0].events = POLLIN;
+		pfds[1].fd = conf->lfd;
+		pfds[1].events = POLLIN;
+		for (i = 0; i < idle_cnt; i++) {
+			pfds[i + 2].fd = idle[i]->fd;
+			pfds[i + 2].events = POLLIN;
+		}
+		if (poll(pfds, idle_cnt + 2, 1000) < 0) {
+			if (errno != EINTR)
+				error("%s: poll: %m", __func__);
+			continue;
+		}
+
+		if (pfds[0].revents) {
+			while (read(engine_wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		/* Hand connections with a new request to the workers and close
+		 * those the sender closed or left idle for too long */
+		now = time(NULL);
+		for (i = 0, j = 0; i < idle_cnt; i++) {
+			con = idle[i];
+			if (!pfds[i + 2].revents && (now < con->idle_end)) {
+				idle[j++] = con;
+				continue;
+			}
+			slurm_mutex_lock(&parked_mutex);
+			parked_cnt--;
+			slurm_mutex_unlock(&parked_mutex);
+			/* A zero length read means the sender closed its end */
+			if (pfds[i + 2].revents &&
+			    (recv(con->fd, buf, 1, MSG_PEEK) > 0))
+				_queue_conn(&req_pool, con, true);
+			else
+				_close_conn(con);
+		}
+		idle_cnt = j;
+
+		if (!(pfds[1].revents & POLLIN))
+			continue;
 		cli = xmalloc (sizeof (slurm_addr_t));
 		if ((sock = slurm_accept_msg_conn(conf->lfd, cli)) >= 0) {
 			_handle_connection(sock, cli);
@@ -477,6 +613,22 @@ _msg_engine(void)
 	}
 	verbose("got shutdown request");
 	slurm_shutdown_msg_engine(conf->lfd);
+
+	for (i = 0; i < idle_cnt; i++)
+		_close_conn(idle[i]);
+	xfree(idle);
+	xfree(pfds);
+	slurm_mutex_lock(&parked_mutex);
+	while (parked_conns && (con = list_dequeue(parked_conns)))
+		_close_conn(con);
+	parked_cnt = 0;
+	slurm_mutex_unlock(&parked_mutex);
+
+	/* Idle workers exit, busy ones once the queues are empty */
+	slurm_mutex_lock(&active_mutex);
+	slurm_cond_broadcast(&req_pool.cond);
+	slurm_cond_broadcast(&long_pool.cond);
+	slurm_mutex_unlock(&active_mutex);
 	return;
 }
 
@@ -536,79 +688,317 @@ _wait_for_all_threads(int secs)
 	verbose("all threads complete");
 }
 
-static void _handle_connection(int fd, slurm_addr_t *cli)
+/*
+ * Requests which may hold their worker for a long time: running the prolog,
+ * starting slurmstepd or waiting for a job's steps to end
+ */
+static bool _long_running_req(uint16_t msg_type)
 {
-	int            rc;
-	pthread_attr_t attr;
-	pthread_t      id;
-	conn_t         *arg = xmalloc(sizeof(conn_t));
-	int            retries = 0;
+	switch (msg_type) {
+	case REQUEST_LAUNCH_PROLOG:
+	case REQUEST_BATCH_JOB_LAUNCH:
+	case REQUEST_LAUNCH_TASKS:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_SUSPEND_INT:
+	case REQUEST_ABORT_JOB:
+	case REQUEST_TERMINATE_JOB:
+	case REQUEST_MESSAGE_COMPOSITE:
+		return true;
+	default:
+		return false;
+	}
+}
 
-	arg->fd       = fd;
-	arg->cli_addr = cli;
+/*
+ * Queue a connection or request on a worker pool, starting a new worker if
+ * none is idle and the pool is not at MAX_THREADS.
+ * new_req IN - true if this is a new request rather than one moved between
+ *		pools, so it counts towards active_threads
+ */
+static void _queue_conn(worker_pool_t *pool, conn_t *con, bool new_req)
+{
+	pthread_attr_t attr;
+	pthread_t id;
 
-	slurm_attr_init(&attr);
-	rc = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-	if (rc != 0) {
-		errno = rc;
-		xfree(arg);
-		error("Unable to set detachstate on attr: %m");
+	slurm_mutex_lock(&active_mutex);
+	if (new_req)
+		active_threads++;
+	list_enqueue(pool->queue, con);
+	if ((list_count(pool->queue) > pool->idle) &&
+	    (pool->threads < MAX_THREADS)) {
+		slurm_attr_init(&attr);
+		if (pthread_attr_setdetachstate(&attr,
+						PTHREAD_CREATE_DETACHED))
+			error("Unable to set detachstate on attr: %m");
+		if (pthread_create(&id, &attr, _worker, pool))
+			error("%s: pthread_create: %m", __func__);
+		else
+			pool->threads++;
 		slurm_attr_destroy(&attr);
-		return;
+	} else if (!pool->idle && !pool->logged) {
+		info("all %d %s workers busy, queueing requests",
+		     pool->threads, pool->name);
+		pool->logged = true;
 	}
+	if (pool->idle)
+		slurm_cond_signal(&pool->cond);
+	slurm_mutex_unlock(&active_mutex);
+}
 
-	fd_set_close_on_exec(fd);
-
-	_increment_thd_count();
-	while (pthread_create(&id, &attr, &_service_connection, (void *)arg)) {
-		error("msg_engine: pthread_create: %m");
-		if (++retries > 3) {
-			error("running service_connection without starting "
-			      "a new thread slurmd will be "
-			      "unresponsive until done");
+static void *
+_worker(void *arg)
+{
+	worker_pool_t *pool = (worker_pool_t *) arg;
+	struct timespec ts;
+	conn_t *con;
+	int rc;
 
-			_service_connection((void *) arg);
-			info("slurmd should be responsive now");
-			break;
+	slurm_mutex_lock(&active_mutex);
+	while (1) {
+		if ((con = list_dequeue(pool->queue))) {
+			slurm_mutex_unlock(&active_mutex);
+			_service_connection(con, pool);
+			slurm_mutex_lock(&active_mutex);
+			continue;
 		}
-		usleep(10);	/* sleep and again */
+		pool->logged = false;
+		if (_shutdown)
+			break;
+		ts.tv_sec  = time(NULL) + WORKER_IDLE;
+		ts.tv_nsec = 0;
+		pool->idle++;
+		rc = pthread_cond_timedwait(&pool->cond, &active_mutex, &ts);
+		pool->idle--;
+		if ((rc == ETIMEDOUT) && list_is_empty(pool->queue))
+			break;
 	}
+	pool->threads--;
+	slurm_mutex_unlock(&active_mutex);
+	return NULL;
+}
 
-	return;
+static void _handle_connection(int fd, slurm_addr_t *cli)
+{
+	conn_t *con = xmalloc(sizeof(conn_t));
+
+	con->fd       = fd;
+	con->cli_addr = cli;
+	fd_set_close_on_exec(fd);
+	_queue_conn(&req_pool, con, true);
 }
 
-static void *
-_service_connection(void *arg)
+static void _close_conn(conn_t *con)
+{
+	if (slurm_close(con->fd) < 0)
+		error ("close(%d): %m", con->fd);
+	xfree(con->cli_addr);
+	xfree(con);
+}
+
+/*
+ * RET true if the connection of a request is to be kept open for the
+ * sender's next request. Only SlurmUser and root may ask for that.
+ */
+static bool _keep_open(slurm_msg_t *msg)
+{
+	uid_t uid;
+
+	if (!(msg->flags & SLURM_MSG_KEEP_OPEN) || (msg->conn_fd < 0))
+		return false;
+	uid = g_slurm_auth_get_uid(msg->auth_cred, conf->auth_info);
+	return ((uid == (uid_t) 0) || (uid == conf->slurm_user_id));
+}
+
+/*
+ * Give a connection kept open by its sender to the message engine, which
+ * queues it again once the next request arrives
+ * RET false if MAX_PARKED_CONNS are already parked, the caller then closes
+ *	the connection and keeps ownership of cli
+ */
+static bool _park_conn(int fd, slurm_addr_t *cli)
 {
-	conn_t *con = (conn_t *) arg;
-	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
+	conn_t *con;
+
+	slurm_mutex_lock(&parked_mutex);
+	if (parked_cnt >= MAX_PARKED_CONNS) {
+		slurm_mutex_unlock(&parked_mutex);
+		debug("%s: %d connections parked, closing", __func__,
+		      MAX_PARKED_CONNS);
+		return false;
+	}
+	con = xmalloc(sizeof(conn_t));
+	con->fd       = fd;
+	con->cli_addr = cli;
+	con->idle_end = time(NULL) + SLURM_KEEP_OPEN_IDLE;
+	if (!parked_conns)
+		parked_conns = list_create(NULL);
+	list_enqueue(parked_conns, con);
+	parked_cnt++;
+	slurm_mutex_unlock(&parked_mutex);
+	if (write(engine_wake_fd[1], "", 1) < 0 && (errno != EAGAIN))
+		error("%s: write: %m", __func__);
+	return true;
+}
+
+/*
+ * Read and process one request. Long running requests are moved to the
+ * long_pool so they do not hold up workers needed for short ones.
+ */
+static void
+_service_connection(conn_t *con, worker_pool_t *pool)
+{
+	slurm_msg_t *msg = con->msg;
+	bool keep_open = false;
 	int rc = SLURM_SUCCESS;
 
 	debug3("in the service_connection");
-	slurm_msg_t_init(msg);
-	if ((rc = slurm_receive_msg_and_forward(con->fd, con->cli_addr, msg, 0))
-	   != SLURM_SUCCESS) {
-		error("service_connection: slurm_receive_msg: %m");
-		/* if this fails we need to make sure the nodes we forward
-		   to are taken care of and sent back. This way the control
-		   also has a better idea what happened to us */
-		slurm_send_rc_msg(msg, rc);
-		goto cleanup;
+	if (!msg) {
+		msg = xmalloc(sizeof(slurm_msg_t));
+		slurm_msg_t_init(msg);
+		if ((rc = slurm_receive_msg_and_forward(con->fd, con->cli_addr,
+							msg, 0))
+		    != SLURM_SUCCESS) {
+			error("service_connection: slurm_receive_msg: %m");
+			/* if this fails we need to make sure the nodes we
+			   forward to are taken care of and sent back. This
+			   way the control also has a better idea what
+			   happened to us */
+			slurm_send_rc_msg(msg, rc);
+			goto fini;
+		}
+		debug2("got this type of message %d", msg->msg_type);
+	}
+
+	if ((pool != &long_pool) && _long_running_req(msg->msg_type)) {
+		con->msg = msg;
+		_queue_conn(&long_pool, con, false);
+		return;
 	}
-	debug2("got this type of message %d", msg->msg_type);
 
 	if (msg->msg_type != MESSAGE_COMPOSITE)
 		slurmd_req(msg);
+	/* The sender may reuse the connection for its next request, unless
+	 * the RPC already released it */
+	if (_keep_open(msg) && _park_conn(msg->conn_fd, con->cli_addr)) {
+		con->cli_addr = NULL;
+		keep_open = true;
+	}
 
-cleanup:
-	if ((msg->conn_fd >= 0) && slurm_close(msg->conn_fd) < 0)
+fini:
+	if (!keep_open && (msg->conn_fd >= 0) &&
+	    (slurm_close(msg->conn_fd) < 0))
 		error ("close(%d): %m", con->fd);
-
+	if (con->comp)
+		_comp_part_done(con->comp, msg);
+	slurm_free_msg(msg);
 	xfree(con->cli_addr);
 	xfree(con);
-	slurm_free_msg(msg);
 	_decrement_thd_count();
-	return NULL;
+}
+
+/*
+ * Release the connection of a request whose reply has already been sent,
+ * for RPCs which continue working after replying. If the sender intends to
+ * reuse the connection, it is handed back to the message engine to wait for
+ * the next request, otherwise it is closed.
+ */
+extern void slurmd_release_conn(slurm_msg_t *msg)
+{
+	slurm_addr_t *cli;
+
+	if (msg->conn_fd < 0) {
+		/* A request of a composite message has replied through the
+		 * composite's reply list, see slurmd_spawn_reqs() */
+		if (msg->msg_index)
+			msg->ret_list = NULL;
+		return;
+	}
+
+	if (_keep_open(msg)) {
+		cli = xmalloc(sizeof(slurm_addr_t));
+		memcpy(cli, &msg->address, sizeof(slurm_addr_t));
+		if (_park_conn(msg->conn_fd, cli)) {
+			msg->conn_fd = -1;
+			return;
+		}
+		xfree(cli);
+	}
+	if (slurm_close(msg->conn_fd) < 0)
+		error("close(%d): %m", msg->conn_fd);
+	msg->conn_fd = -1;
+}
+
+static void _comp_unref(comp_reply_t *comp)
+{
+	bool last;
+
+	slurm_mutex_lock(&comp_mutex);
+	last = (--comp->refcnt == 0);
+	slurm_mutex_unlock(&comp_mutex);
+	if (last) {
+		FREE_NULL_LIST(comp->resp_list);
+		xfree(comp);
+	}
+}
+
+/* A request of a composite message has been processed, msg no longer
+ * shares its reply list */
+static void _comp_part_done(comp_reply_t *comp, slurm_msg_t *msg)
+{
+	msg->ret_list = NULL;
+	slurm_mutex_lock(&comp_mutex);
+	comp->pending--;
+	slurm_cond_broadcast(&comp_cond);
+	slurm_mutex_unlock(&comp_mutex);
+	_comp_unref(comp);
+}
+
+extern void slurmd_spawn_reqs(List req_list, List resp_list)
+{
+	comp_reply_t *comp;
+	slurm_msg_t *msg;
+	conn_t *con;
+	struct timespec ts;
+	struct timeval now;
+	time_t deadline;
+	int cnt = list_count(req_list);
+
+	if (!cnt)
+		return;
+
+	comp = xmalloc(sizeof(comp_reply_t));
+	comp->resp_list = list_create(slurm_free_comp_msg_list);
+	comp->pending = cnt;
+	comp->refcnt = cnt + 1;
+	while ((msg = list_dequeue(req_list))) {
+		/* slurm_send_rc_msg() adds replies to ret_list */
+		msg->conn_fd = -1;
+		msg->ret_list = comp->resp_list;
+		con = xmalloc(sizeof(conn_t));
+		con->fd   = -1;
+		con->msg  = msg;
+		con->comp = comp;
+		_queue_conn(&req_pool, con, true);
+	}
+
+	deadline = time(NULL) + MAX(slurm_get_msg_timeout() / 2, 1);
+	slurm_mutex_lock(&comp_mutex);
+	while (comp->pending && (list_count(comp->resp_list) < cnt)) {
+		gettimeofday(&now, NULL);
+		if (now.tv_sec >= deadline) {
+			debug("%s: %d of %d requests did not reply", __func__,
+			      cnt - list_count(comp->resp_list), cnt);
+			break;
+		}
+		now.tv_usec += COMP_REPLY_POLL * 1000;
+		ts.tv_sec  = now.tv_sec + (now.tv_usec / 1000000);
+		ts.tv_nsec = (now.tv_usec % 1000000) * 1000;
+		pthread_cond_timedwait(&comp_cond, &comp_mutex, &ts);
+	}
+	list_transfer(resp_list, comp->resp_list);
+	slurm_mutex_unlock(&comp_mutex);
+	_comp_unref(comp);
 }
 
 extern int
@@ -1090,6 +1480,11 @@ _reconfigure(void)
 	 */
 	gids_cache_purge();
 
+	/*
+	 * Restart pooled slurmstepds with the new configuration.
+	 */
+	stepd_pool_init();
+
 	/* send reconfig to each stepd so they can refresh their log
 	 * file handle
 	 */
@@ -1595,6 +1990,12 @@ _slurmd_init(void)
 		_stepd_cleanup_batch_dirs(conf->spooldir, conf->node_name);
 	}
 
+	/*
+	 * Find the steps left running by an earlier slurmd, those started
+	 * from now on are added to the registry as they are launched.
+	 */
+	stepd_registry_init(conf->spooldir, conf->node_name);
+
 	if (conf->daemonize) {
 		bool success = false;
 
@@ -1720,6 +2121,7 @@ _slurmd_fini(void)
 	gres_plugin_fini();
 	slurm_topo_fini();
 	slurmd_req(NULL);	/* purge memory allocated by slurmd_req() */
+	stepd_registry_fini();
 	fini_setproctitle();
 	slurm_select_fini();
 	spank_slurmd_exit();
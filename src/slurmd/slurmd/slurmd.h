@@ -187,4 +187,21 @@ int save_cred_state(slurm_cred_ctx_t vctx);
 /* Run the health check program if configured */
 int run_script_health_check(void);
 
+/*
+ * Release the connection of a request after its reply has been sent,
+ * keeping it open for the next request if the sender asked for that.
+ * Sets msg->conn_fd to -1.
+ */
+extern void slurmd_release_conn(slurm_msg_t *msg);
+
+/*
+ * Process each request of a composite message in one of the request workers,
+ * as if it had arrived on a connection of its own, and gather the replies
+ * they send with slurm_send_rc_msg(). Waits for the replies up to half of
+ * MessageTimeout, later ones are discarded.
+ * req_list IN - slurm_msg_t of the requests, emptied and freed once processed
+ * resp_list IN/OUT - the replies, indexed as their requests, are moved to it
+ */
+extern void slurmd_spawn_reqs(List req_list, List resp_list);
+
 #endif /* !_SLURMD_H */
@@ -836,13 +836,19 @@ _one_step_complete_msg(stepd_step_rec_t *job, int first, int last)
 		/* on error AGAIN, send to the slurmctld instead */
 		debug3("Rank %d sending complete to slurmctld instead, range "
 		       "%d to %d", step_complete.rank, first, last);
-	} else if (conf->msg_aggr_window_msgs > 1) {
+	} else {
 		/* this is the base of the tree, its parent is slurmctld */
+		debug3("Rank %d sending complete to slurmctld, range %d to %d",
+		       step_complete.rank, first, last);
+	}
+
+	if (conf->msg_aggr_window_msgs > 1) {
+		/* we are doing message aggr so send it to the slurmd to
+		 * handle, this also bundles the completions of ranks which
+		 * could not reach their parent */
 		debug3("Rank %d sending complete to slurmd for message aggr, "
 		       "range %d to %d",
 		       step_complete.rank, first, last);
-		/* this is the base of the tree, but we are doing
-		 * message aggr so send it to the slurmd to handle */
 		req.msg_type = REQUEST_STEP_COMPLETE_AGGR;
 		slurm_set_addr_char(&req.address, conf->port, conf->hostname);
 		for (i = 0; i <= REVERSE_TREE_PARENT_RETRY; i++) {
@@ -853,13 +859,8 @@ _one_step_complete_msg(stepd_step_rec_t *job, int first, int last)
 				goto finished;
 		}
 		req.msg_type = REQUEST_STEP_COMPLETE;
-		/* this is the base of the tree, its parent is slurmctld */
 		debug3("Rank %d sending complete to slurmctld instead, range "
 		       "%d to %d", step_complete.rank, first, last);
-	}  else {
-		/* this is the base of the tree, its parent is slurmctld */
-		debug3("Rank %d sending complete to slurmctld, range %d to %d",
-		       step_complete.rank, first, last);
 	}
 
 	/* Retry step complete RPC send to slurmctld indefinitely.
@@ -1095,6 +1096,37 @@ fail1:
 	return rc;
 }
 
+/*
+ * Load all plugins used by the step manager. Safe to call more than once.
+ */
+extern int mgr_plugins_init(void)
+{
+	char *ckpt_type = slurm_get_checkpoint_type();
+	int rc = SLURM_SUCCESS;
+
+	/* run now so we don't drop permissions on any of the gather plugins */
+	acct_gather_conf_init();
+
+	/*
+	 * Preload all plugins at start time to avoid plugin changes
+	 * (i.e. due to a Slurm upgrade) after the process starts.
+	 */
+	if ((core_spec_g_init() != SLURM_SUCCESS)		||
+	    (switch_init() != SLURM_SUCCESS)			||
+	    (slurmd_task_init() != SLURM_SUCCESS)		||
+	    (slurm_proctrack_init() != SLURM_SUCCESS)		||
+	    (checkpoint_init(ckpt_type) != SLURM_SUCCESS)	||
+	    (jobacct_gather_init() != SLURM_SUCCESS)		||
+	    (acct_gather_profile_init() != SLURM_SUCCESS)	||
+	    (slurm_crypto_init() != SLURM_SUCCESS)		||
+	    (job_container_init() != SLURM_SUCCESS)		||
+	    (gres_plugin_init() != SLURM_SUCCESS))
+		rc = SLURM_PLUGIN_NAME_INVALID;
+
+	xfree(ckpt_type);
+	return rc;
+}
+
 /*
  * Executes the functions of the slurmd job manager process,
  * which runs as root and performs shared memory and interconnect
@@ -1108,7 +1140,6 @@ job_manager(stepd_step_rec_t *job)
 {
 	int  rc = SLURM_SUCCESS;
 	bool io_initialized = false;
-	char *ckpt_type = slurm_get_checkpoint_type();
 	char *err_msg = NULL;
 
 	debug3("Entered job_manager for %u.%u pid=%d",
@@ -1119,26 +1150,8 @@ job_manager(stepd_step_rec_t *job)
 		debug ("Unable to set dumpable to 1");
 #endif /* PR_SET_DUMPABLE */
 
-	/* run now so we don't drop permissions on any of the gather plugins */
-	acct_gather_conf_init();
-
-	/*
-	 * Preload all plugins at start time to avoid plugin changes
-	 * (i.e. due to a Slurm upgrade) after the process starts.
-	 */
-	if ((core_spec_g_init() != SLURM_SUCCESS)		||
-	    (switch_init() != SLURM_SUCCESS)			||
-	    (slurmd_task_init() != SLURM_SUCCESS)		||
-	    (slurm_proctrack_init() != SLURM_SUCCESS)		||
-	    (checkpoint_init(ckpt_type) != SLURM_SUCCESS)	||
-	    (jobacct_gather_init() != SLURM_SUCCESS)		||
-	    (acct_gather_profile_init() != SLURM_SUCCESS)	||
-	    (slurm_crypto_init() != SLURM_SUCCESS)		||
-	    (job_container_init() != SLURM_SUCCESS)		||
-	    (gres_plugin_init() != SLURM_SUCCESS)) {
-		rc = SLURM_PLUGIN_NAME_INVALID;
+	if ((rc = mgr_plugins_init()) != SLURM_SUCCESS)
 		goto fail1;
-	}
 	if (mpi_hook_slurmstepd_init(&job->env) != SLURM_SUCCESS) {
 		rc = SLURM_MPI_PLUGIN_NAME_INVALID;
 		goto fail1;
@@ -1393,7 +1406,6 @@ fail1:
 	if (!job->batch && core_spec_g_clear(job->cont_id))
 		error("core_spec_g_clear: %m");
 
-	xfree(ckpt_type);
 	return(rc);
 }
 
@@ -75,6 +75,7 @@ static int _init_from_slurmd(int sock, char **argv, slurm_addr_t **_cli,
 			     slurm_addr_t **_self, slurm_msg_t **_msg,
 			     int *_ngids, gid_t **_gids);
 
+static void _init_pool_from_slurmd(int sock, char **argv);
 static void _dump_user_env(void);
 static void _send_ok_to_slurmd(int sock);
 static void _send_fail_to_slurmd(int sock);
@@ -94,6 +95,9 @@ int slurmstepd_blocked_signals[] = {
 slurmd_conf_t * conf;
 extern char  ** environ;
 
+/* Started ahead of any launch request to wait in slurmd's pool */
+static bool pooled = false;
+
 int
 main (int argc, char *argv[])
 {
@@ -119,6 +123,10 @@ main (int argc, char *argv[])
 	if (slurm_auth_init(NULL) != SLURM_SUCCESS)
 		fatal( "failed to initialize authentication plugin" );
 
+	/* Receive slurmd's configuration and load plugins while pooled */
+	if (pooled)
+		_init_pool_from_slurmd(STDIN_FILENO, argv);
+
 	/* Receive job parameters from the slurmd */
 	_init_from_slurmd(STDIN_FILENO, argv, &cli, &self, &msg,
 			  &ngids, &gids);
@@ -366,6 +374,8 @@ static int _process_cmdline (int argc, char *argv[])
 			exit (1);
 		exit (0);
 	}
+	if ((argc == 2) && (xstrcmp(argv[1], "pool") == 0))
+		pooled = true;
 	return (0);
 }
 
@@ -416,6 +426,33 @@ rwfail:
 #endif
 }
 
+/*
+ *  A pooled slurmstepd is started by slurmd before any launch request.
+ *  It receives slurmd's configuration, sent by _stepd_pool_spawn() in
+ *  src/slurmd/slurmd/req.c, and loads its plugins, then waits for the
+ *  rest of its initialization in _init_from_slurmd().
+ */
+static void
+_init_pool_from_slurmd(int sock, char **argv)
+{
+	log_options_t lopts = LOG_OPTS_INITIALIZER;
+
+	log_init(argv[0], lopts, LOG_DAEMON, NULL);
+
+	/* receive conf from slurmd, which may have dropped us already */
+	if ((conf = read_slurmd_conf_lite (sock)) == NULL)
+		exit(0);
+
+	log_alter(conf->log_opts, 0, conf->logfile);
+	log_set_timefmt(conf->log_fmt);
+
+	if (mgr_plugins_init() != SLURM_SUCCESS) {
+		_send_fail_to_slurmd(STDOUT_FILENO);
+		exit(1);
+	}
+	_send_ok_to_slurmd(STDOUT_FILENO);
+}
+
 /*
  *  This function handles the initialization information from slurmd
  *  sent by _send_slurmstepd_init() in src/slurmd/slurmd/req.c.
@@ -438,10 +475,16 @@ _init_from_slurmd(int sock, char **argv,
 	char buf[16];
 	log_options_t lopts = LOG_OPTS_INITIALIZER;
 
-	log_init(argv[0], lopts, LOG_DAEMON, NULL);
+	if (pooled) {
+		/* slurmd closes the pipe to drop a pooled slurmstepd */
+		if (read(sock, &step_type, sizeof(int)) != sizeof(int))
+			exit(0);
+	} else {
+		log_init(argv[0], lopts, LOG_DAEMON, NULL);
 
-	/* receive job type from slurmd */
-	safe_read(sock, &step_type, sizeof(int));
+		/* receive job type from slurmd */
+		safe_read(sock, &step_type, sizeof(int));
+	}
 	debug3("step_type = %d", step_type);
 
 	/* receive reverse-tree info from slurmd */
@@ -456,12 +499,14 @@ _init_from_slurmd(int sock, char **argv,
 	step_complete.jobacct = jobacctinfo_create(NULL);
 	slurm_mutex_unlock(&step_complete.lock);
 
-	/* receive conf from slurmd */
-	if ((conf = read_slurmd_conf_lite (sock)) == NULL)
-		fatal("Failed to read conf from slurmd");
+	/* receive conf from slurmd, a pooled slurmstepd already has it */
+	if (!pooled) {
+		if ((conf = read_slurmd_conf_lite (sock)) == NULL)
+			fatal("Failed to read conf from slurmd");
 
-	log_alter(conf->log_opts, 0, conf->logfile);
-	log_set_timefmt(conf->log_fmt);
+		log_alter(conf->log_opts, 0, conf->logfile);
+		log_set_timefmt(conf->log_fmt);
+	}
 
 	debug2("debug level is %d.", conf->debug_level);
 
@@ -484,6 +484,41 @@ job_format_add_function(List list, int width, bool right, char *suffix,
 	return SLURM_SUCCESS;
 }
 
+/* Return the JOB_FIELD_* flags of the optional job fields used by the
+ * print functions of a job format list */
+uint32_t job_format_fields(List list)
+{
+	ListIterator iterator;
+	job_format_t *current;
+	uint32_t field_mask = 0;
+
+	iterator = list_iterator_create(list);
+	while ((current = list_next(iterator))) {
+		if ((current->function == _print_job_command)	||
+		    (current->function == _print_job_work_dir)	||
+		    (current->function == _print_job_std_err)	||
+		    (current->function == _print_job_std_in)	||
+		    (current->function == _print_job_std_out))
+			field_mask |= JOB_FIELD_COMMAND;
+		else if ((current->function == _print_job_comment) ||
+			 (current->function == _print_job_admin_comment))
+			field_mask |= JOB_FIELD_COMMENT;
+		else if ((current->function == _print_job_features) ||
+			 (current->function == _print_job_dependency))
+			field_mask |= JOB_FIELD_FEATURES;
+		else if ((current->function == _print_job_req_nodes)	 ||
+			 (current->function == _print_job_req_node_inx) ||
+			 (current->function == _print_job_exc_nodes)	 ||
+			 (current->function == _print_job_exc_node_inx))
+			field_mask |= JOB_FIELD_REQ_NODES;
+		else if (current->function == _print_job_tres)
+			field_mask |= JOB_FIELD_TRES;
+	}
+	list_iterator_destroy(iterator);
+
+	return field_mask;
+}
+
 int _print_job_array_job_id(job_info_t * job, int width, bool right,
 			    char* suffix)
 {
@@ -86,6 +86,7 @@ int print_step_from_format(job_step_info_t * job_step, List list);
 int job_format_add_function(List list, int width, bool right_justify,
 			    char *suffix,
 			    int (*function) (job_info_t *, int, bool, char*));
+uint32_t job_format_fields(List list);
 #define job_format_add_array_job_id(list,wid,right,suffix) \
 	job_format_add_function(list,wid,right,suffix,_print_job_array_job_id)
 #define job_format_add_array_task_id(list,wid,right,suffix) \
@@ -61,6 +61,7 @@ int max_line_size;
 /*************
  * Functions *
  *************/
+static job_info_cond_t *_build_job_cond(void);
 static int  _get_info(bool clear_old);
 static int  _get_window_width( void );
 static void _print_date( void );
@@ -163,6 +164,88 @@ _get_window_width( void )
 }
 
 
+/*
+ * _build_job_cond - build the filters and fields of the job information
+ *	request from the squeue options, so slurmctld only sends what we
+ *	might print. The jobs received still go through _filter_job(), which
+ *	also drops the inactive jobs unless states were given with --states.
+ *	Without filters only the fields are set, that response is shared
+ *	with other clients and polled with deltas.
+ */
+static job_info_cond_t *_build_job_cond(void)
+{
+	static job_info_cond_t cond;
+	static bool built = false;
+	ListIterator iterator;
+	squeue_job_step_t *job_step_id;
+	uint32_t *id;
+	char *name;
+	int len;
+
+	if (built)
+		return &cond;
+	built = true;
+
+	cond.field_mask = job_format_fields(params.format_list);
+
+	if (params.account_list) {
+		iterator = list_iterator_create(params.account_list);
+		while ((name = list_next(iterator))) {
+			xstrfmtcat(cond.accounts, "%s%s",
+				   cond.accounts ? "," : "", name);
+		}
+		list_iterator_destroy(iterator);
+	}
+
+	if (params.job_list) {
+		cond.job_ids = xmalloc(sizeof(uint32_t) *
+				       list_count(params.job_list));
+		iterator = list_iterator_create(params.job_list);
+		while ((job_step_id = list_next(iterator)))
+			cond.job_ids[cond.job_id_cnt++] = job_step_id->job_id;
+		list_iterator_destroy(iterator);
+	}
+
+	if (params.nodes) {
+		len = 1024;
+		cond.nodes = xmalloc(len);
+		while (hostset_ranged_string(params.nodes, len,
+					     cond.nodes) < 0) {
+			len *= 2;
+			xrealloc(cond.nodes, len);
+		}
+	}
+
+	if (params.part_list) {
+		iterator = list_iterator_create(params.part_list);
+		while ((name = list_next(iterator))) {
+			xstrfmtcat(cond.partitions, "%s%s",
+				   cond.partitions ? "," : "", name);
+		}
+		list_iterator_destroy(iterator);
+	}
+
+	if (params.state_list) {
+		cond.states = xmalloc(sizeof(uint32_t) *
+				      list_count(params.state_list));
+		iterator = list_iterator_create(params.state_list);
+		while ((id = list_next(iterator)))
+			cond.states[cond.state_cnt++] = *id;
+		list_iterator_destroy(iterator);
+	}
+
+	if (params.user_list) {
+		cond.user_ids = xmalloc(sizeof(uint32_t) *
+					list_count(params.user_list));
+		iterator = list_iterator_create(params.user_list);
+		while ((id = list_next(iterator)))
+			cond.user_ids[cond.user_cnt++] = *id;
+		list_iterator_destroy(iterator);
+	}
+
+	return &cond;
+}
+
 /* _print_job - print the specified job's information */
 static int
 _print_job ( bool clear_old )
@@ -172,6 +255,23 @@ _print_job ( bool clear_old )
 	int error_code;
 	uint16_t show_flags = 0;
 
+	if (!params.format && !params.format_long) {
+		if (params.long_list) {
+			xstrcat(params.format,
+				"%.18i %.9P %.8j %.8u %.8T %.10M %.9l %.6D %R");
+		} else {
+			xstrcat(params.format,
+				"%.18i %.9P %.8j %.8u %.2t %.10M %.6D %R");
+		}
+	}
+
+	if (!params.format_list) {
+		if (params.format)
+			parse_format(params.format);
+		else if (params.format_long)
+			parse_long_format(params.format_long);
+	}
+
 	if (params.all_flag || (params.job_list && list_count(params.job_list)))
 		show_flags |= SHOW_ALL;
 
@@ -189,14 +289,11 @@ _print_job ( bool clear_old )
 			error_code = slurm_load_job(
 				&new_job_ptr, params.job_id,
 				show_flags);
-		} else if (params.user_id) {
-			error_code = slurm_load_job_user(&new_job_ptr,
-							 params.user_id,
-							 show_flags);
 		} else {
-			error_code = slurm_load_jobs(
+			error_code = slurm_load_jobs_cond(
 				old_job_ptr->last_update,
-				&new_job_ptr, show_flags);
+				&new_job_ptr, show_flags,
+				_build_job_cond());
 		}
 		if (error_code ==  SLURM_SUCCESS)
 			slurm_free_job_info_msg( old_job_ptr );
@@ -207,12 +304,10 @@ _print_job ( bool clear_old )
 	} else if (params.job_id) {
 		error_code = slurm_load_job(&new_job_ptr, params.job_id,
 					    show_flags);
-	} else if (params.user_id) {
-		error_code = slurm_load_job_user(&new_job_ptr, params.user_id,
-						 show_flags);
 	} else {
-		error_code = slurm_load_jobs((time_t) NULL, &new_job_ptr,
-					     show_flags);
+		error_code = slurm_load_jobs_cond((time_t) NULL, &new_job_ptr,
+						  show_flags,
+						  _build_job_cond());
 	}
 
 	if (error_code) {
@@ -229,23 +324,6 @@ _print_job ( bool clear_old )
 			new_job_ptr->record_count);
 	}
 
-	if (!params.format && !params.format_long) {
-		if (params.long_list) {
-			xstrcat(params.format,
-				"%.18i %.9P %.8j %.8u %.8T %.10M %.9l %.6D %R");
-		} else {
-			xstrcat(params.format,
-				"%.18i %.9P %.8j %.8u %.2t %.10M %.6D %R");
-		}
-	}
-
-	if (!params.format_list) {
-		if (params.format)
-			parse_format(params.format);
-		else if (params.format_long)
-			parse_long_format(params.format_long);
-	}
-
 	print_jobs_array(new_job_ptr->job_array, new_job_ptr->record_count,
 			 params.format_list) ;
 	return SLURM_SUCCESS;
@@ -0,0 +1,204 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <src/common/id_hash.h>
+#include <src/common/xmalloc.h>
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+/* Number of records used for timing, override with argv[1] */
+#define BENCH_RECORDS	1000000
+
+typedef struct rec {
+	uint32_t id;
+	struct rec *next;		/* used by the chained baseline only */
+} rec_t;
+
+static long _usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+	       (now.tv_usec - start->tv_usec);
+}
+
+static void _report(const char *name, long usec, int cnt)
+{
+	printf("%-28s %8ld usec %7.1f nsec/op\n", name, usec,
+	       (usec * 1000.0) / cnt);
+}
+
+/*
+ * The job table slurmctld used before id_hash: an array of MaxJobCount
+ * chains indexed by job ID modulo the table size, linked through the records.
+ */
+static void _bench_chained(rec_t *recs, rec_t **order, int cnt, int size)
+{
+	rec_t **table, *rec;
+	struct timeval start;
+	char name[64];
+	int i, found = 0, lookups = cnt;
+
+	/* Long chains are slow to walk, time a sample of the lookups */
+	if ((cnt / size) > 10)
+		lookups = cnt / (cnt / size);
+
+	table = xmalloc(sizeof(rec_t *) * size);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++) {
+		recs[i].next = table[recs[i].id % size];
+		table[recs[i].id % size] = &recs[i];
+	}
+	snprintf(name, sizeof(name), "chained/%d insert", size);
+	_report(name, _usec_since(&start), cnt);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < lookups; i++) {
+		rec = table[order[i]->id % size];
+		while (rec && (rec->id != order[i]->id))
+			rec = rec->next;
+		if (rec)
+			found++;
+	}
+	snprintf(name, sizeof(name), "chained/%d lookup", size);
+	_report(name, _usec_since(&start), lookups);
+	TEST(found != lookups, "chained baseline lookup");
+	xfree(table);
+}
+
+static void _bench_id_hash(rec_t *recs, rec_t **order, int cnt)
+{
+	id_hash_t *table;
+	struct timeval start;
+	int i, found = 0, missed = 0, removed = 0;
+
+	table = id_hash_init(0);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++)
+		id_hash_add(table, recs[i].id, &recs[i]);
+	_report("id_hash insert (growing)", _usec_since(&start), cnt);
+	id_hash_free(table);
+
+	table = id_hash_init(cnt);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++)
+		id_hash_add(table, recs[i].id, &recs[i]);
+	_report("id_hash insert (presized)", _usec_since(&start), cnt);
+	TEST(id_hash_count(table) != cnt, "id_hash bench count");
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++) {
+		if (id_hash_find(table, order[i]->id) == order[i])
+			found++;
+	}
+	_report("id_hash lookup", _usec_since(&start), cnt);
+	TEST(found != cnt, "id_hash bench lookup");
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++) {
+		if (!id_hash_find(table, (uint64_t) order[i]->id + cnt * 4))
+			missed++;
+	}
+	_report("id_hash miss", _usec_since(&start), cnt);
+	TEST(missed != cnt, "id_hash bench miss");
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++) {
+		if (id_hash_remove(table, order[i]->id, NULL))
+			removed++;
+	}
+	_report("id_hash remove", _usec_since(&start), cnt);
+	TEST((removed != cnt) || id_hash_count(table),
+	     "id_hash bench remove");
+	id_hash_free(table);
+}
+
+int main(int argc, char *argv[])
+{
+	id_hash_t *table;
+	rec_t *recs, **order, *tmp;
+	int a = 1, b = 2, c = 3;
+	int i, j, cnt = BENCH_RECORDS, bad;
+
+	if (argc > 1)
+		cnt = atoi(argv[1]);
+
+	/* Basic operations */
+	table = id_hash_init(4);
+	TEST(id_hash_find(table, 1) != NULL, "find in empty table");
+	id_hash_add(table, 1, &a);
+	id_hash_add(table, 2, &b);
+	TEST(id_hash_find(table, 1) != &a, "find first item");
+	TEST(id_hash_find(table, 2) != &b, "find second item");
+	TEST(id_hash_find(table, 3) != NULL, "find missing item");
+
+	/* Duplicate IDs are removed by item */
+	id_hash_add(table, 1, &c);
+	TEST(id_hash_count(table) != 3, "count with duplicate ID");
+	TEST(id_hash_remove(table, 1, &a) != &a, "remove duplicate by item");
+	TEST(id_hash_find(table, 1) != &c, "find remaining duplicate");
+	TEST(id_hash_remove(table, 1, &a) != NULL, "remove item twice");
+	TEST(id_hash_remove(table, 1, NULL) != &c, "remove by ID");
+	TEST(id_hash_count(table) != 1, "count after remove");
+	id_hash_free(table);
+
+	/*
+	 * Multiples of 1024 share their home slot in tables of up to 1024
+	 * slots and fall in two slots after that; removing from the middle of
+	 * a probe sequence must keep the rest reachable
+	 */
+	table = id_hash_init(0);
+	for (i = 0; i < 1000; i++)
+		id_hash_add(table, (uint64_t) i * 1024,
+			    (void *) (intptr_t) (i + 1));
+	for (i = 0; i < 1000; i += 2)
+		id_hash_remove(table, (uint64_t) i * 1024, NULL);
+	bad = 0;
+	for (i = 0; i < 1000; i++) {
+		void *item = id_hash_find(table, (uint64_t) i * 1024);
+		if ((i % 2) ? (item != (void *) (intptr_t) (i + 1)) : !!item)
+			bad++;
+	}
+	TEST(bad, "find after removal from probe sequences");
+	TEST(id_hash_count(table) != 500, "count after growth and removal");
+	id_hash_free(table);
+
+	/*
+	 * Timing at the scale of a large job table, with IDs assigned mostly
+	 * in sequence and looked up in random order
+	 */
+	recs = xmalloc(sizeof(rec_t) * cnt);
+	order = xmalloc(sizeof(rec_t *) * cnt);
+	srandom(1);
+	for (i = 0; i < cnt; i++) {
+		recs[i].id = i + 1 + (random() % 4) * cnt;
+		order[i] = &recs[i];
+	}
+	for (i = cnt - 1; i > 0; i--) {
+		j = random() % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	_bench_chained(recs, order, cnt, 10000);	/* default MaxJobCount */
+	_bench_chained(recs, order, cnt, cnt);
+	_bench_id_hash(recs, order, cnt);
+	xfree(order);
+	xfree(recs);
+
+	totals();
+	return failed;
+}
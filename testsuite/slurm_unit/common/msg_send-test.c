@@ -0,0 +1,300 @@
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <src/common/pack.h>
+#include <src/common/slurm_protocol_interface.h>
+#include <src/common/xmalloc.h>
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+#define MSG_TIMEOUT	10000		/* msec */
+#define BENCH_BODY	(1024 * 1024)	/* forwarded body, e.g. a bcast block */
+#define BENCH_RELAYS	8		/* relays each forwarding node sends to */
+#define BENCH_ITER	50
+#define BENCH_RPCS	50		/* small round trips over TCP */
+#define BENCH_RPC_SIZE	200
+
+typedef struct {
+	int fd;
+	int cnt;		/* messages to receive */
+	int echo;		/* reply with each message */
+	char *expect;		/* content every message should match */
+	size_t expect_len;
+	int bad;		/* messages received with wrong content */
+} reader_t;
+
+static void *_reader(void *arg)
+{
+	reader_t *r = (reader_t *) arg;
+	char *buf;
+	size_t len;
+	int i;
+
+	for (i = 0; i < r->cnt; i++) {
+		if (slurm_msg_recvfrom_timeout(r->fd, &buf, &len, 0,
+					       MSG_TIMEOUT) < 0) {
+			r->bad++;
+			break;
+		}
+		if (r->expect &&
+		    ((len != r->expect_len) || memcmp(buf, r->expect, len)))
+			r->bad++;
+		if (r->echo)
+			slurm_msg_sendto_timeout(r->fd, buf, len, 0,
+						 MSG_TIMEOUT);
+		xfree(buf);
+	}
+	return NULL;
+}
+
+static long _usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+	       (now.tv_usec - start->tv_usec);
+}
+
+static void _report(const char *name, long usec, int cnt)
+{
+	printf("%-34s %8ld usec %9.1f usec/op\n", name, usec,
+	       (double) usec / cnt);
+}
+
+/* Stand-in for a forwarded message header */
+static Buf _pack_hdr(int relay)
+{
+	Buf buffer = init_buf(BUF_SIZE);
+
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack16(0, buffer);
+	pack16(5001, buffer);
+	pack32(BENCH_BODY, buffer);
+	pack16(BENCH_RELAYS - relay, buffer);
+	packstr("n[2-9]", buffer);
+	return buffer;
+}
+
+/* How forward threads sent before: copy the body behind the header, then
+ * write the length and the message separately */
+static int _send_copy(int fd, char *body, size_t body_len, int relay)
+{
+	Buf buffer = _pack_hdr(relay);
+	uint32_t usize;
+	int rc;
+
+	if (remaining_buf(buffer) < body_len) {
+		int new_size = buffer->processed + body_len + 1024;
+		xrealloc_nz(buffer->head, new_size);
+		buffer->size = new_size;
+	}
+	memcpy(&buffer->head[buffer->processed], body, body_len);
+	buffer->processed += body_len;
+
+	usize = htonl(get_buf_offset(buffer));
+	rc = slurm_send_timeout(fd, (char *) &usize, sizeof(usize), 0,
+				MSG_TIMEOUT);
+	if (rc >= 0)
+		rc = slurm_send_timeout(fd, get_buf_data(buffer),
+					get_buf_offset(buffer), 0,
+					MSG_TIMEOUT);
+	free_buf(buffer);
+	return rc;
+}
+
+static int _send_iov(int fd, char *body, size_t body_len, int relay)
+{
+	Buf buffer = _pack_hdr(relay);
+	struct iovec iov[2];
+	int rc;
+
+	iov[0].iov_base = get_buf_data(buffer);
+	iov[0].iov_len  = get_buf_offset(buffer);
+	iov[1].iov_base = body;
+	iov[1].iov_len  = body_len;
+	rc = slurm_msg_sendv_timeout(fd, iov, 2, MSG_TIMEOUT);
+	free_buf(buffer);
+	return rc;
+}
+
+static void _bench_forward(const char *name, char *body,
+			   int (*send_func)(int, char *, size_t, int))
+{
+	reader_t r;
+	pthread_t tid;
+	struct timeval start;
+	int fd[2], i, j, errs = 0;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) < 0) {
+		fail("socketpair");
+		return;
+	}
+	memset(&r, 0, sizeof(r));
+	r.fd = fd[1];
+	r.cnt = BENCH_ITER * BENCH_RELAYS;
+	pthread_create(&tid, NULL, _reader, &r);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_ITER; i++) {
+		for (j = 0; j < BENCH_RELAYS; j++) {
+			if ((*send_func)(fd[0], body, BENCH_BODY, j) < 0)
+				errs++;
+		}
+	}
+	pthread_join(tid, NULL);
+	_report(name, _usec_since(&start), BENCH_ITER * BENCH_RELAYS);
+	TEST(errs || r.bad, name);
+
+	close(fd[0]);
+	close(fd[1]);
+}
+
+/* Request/response over TCP loopback. Writing the length prefix on its
+ * own leaves the body to Nagle, which waits for the peer's delayed ACK. */
+static void _bench_rpc(const char *name, bool split)
+{
+	struct sockaddr_in sin;
+	socklen_t sin_len = sizeof(sin);
+	reader_t r;
+	pthread_t tid;
+	struct timeval start;
+	struct iovec iov;
+	char msg[BENCH_RPC_SIZE], *buf;
+	size_t len;
+	uint32_t usize;
+	int lfd, cfd, sfd, i, errs = 0;
+
+	memset(msg, 'r', sizeof(msg));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if ((lfd < 0) || bind(lfd, (struct sockaddr *) &sin, sizeof(sin)) ||
+	    listen(lfd, 1) ||
+	    getsockname(lfd, (struct sockaddr *) &sin, &sin_len)) {
+		fail("tcp listen");
+		return;
+	}
+	cfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (connect(cfd, (struct sockaddr *) &sin, sizeof(sin)) ||
+	    ((sfd = accept(lfd, NULL, NULL)) < 0)) {
+		fail("tcp connect");
+		return;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.fd = sfd;
+	r.cnt = BENCH_RPCS;
+	r.echo = 1;
+	pthread_create(&tid, NULL, _reader, &r);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_RPCS; i++) {
+		if (split) {
+			usize = htonl(sizeof(msg));
+			if ((slurm_send_timeout(cfd, (char *) &usize,
+						sizeof(usize), 0,
+						MSG_TIMEOUT) < 0) ||
+			    (slurm_send_timeout(cfd, msg, sizeof(msg), 0,
+						MSG_TIMEOUT) < 0))
+				errs++;
+		} else {
+			iov.iov_base = msg;
+			iov.iov_len  = sizeof(msg);
+			if (slurm_msg_sendv_timeout(cfd, &iov, 1,
+						    MSG_TIMEOUT) < 0)
+				errs++;
+		}
+		if (slurm_msg_recvfrom_timeout(cfd, &buf, &len, 0,
+					       MSG_TIMEOUT) < 0) {
+			errs++;
+			break;
+		}
+		xfree(buf);
+	}
+	pthread_join(tid, NULL);
+	_report(name, _usec_since(&start), BENCH_RPCS);
+	TEST(errs || r.bad, name);
+
+	close(cfd);
+	close(sfd);
+	close(lfd);
+}
+
+int main(int argc, char *argv[])
+{
+	reader_t r;
+	pthread_t tid;
+	struct iovec iov[MSG_IOV_MAX + 1];
+	char *body, *whole;
+	size_t big = 4 * 1024 * 1024;
+	int fd[2], i;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) < 0) {
+		fail("socketpair");
+		totals();
+		return failed;
+	}
+
+	/* Pieces must arrive as one message, in order, even when sendmsg()
+	 * stops part way through a piece */
+	whole = xmalloc(big);
+	for (i = 0; i < big; i++)
+		whole[i] = (char) (i * 7);
+	memset(&r, 0, sizeof(r));
+	r.fd = fd[1];
+	r.cnt = 2;
+	r.expect = whole;
+	r.expect_len = big;
+	pthread_create(&tid, NULL, _reader, &r);
+	iov[0].iov_base = whole;
+	iov[0].iov_len  = 100;
+	iov[1].iov_base = whole + 100;
+	iov[1].iov_len  = 0;
+	iov[2].iov_base = whole + 100;
+	iov[2].iov_len  = big - 100;
+	TEST(slurm_msg_sendv_timeout(fd[0], iov, 3, MSG_TIMEOUT) != big,
+	     "sendv returns message size");
+	TEST(slurm_msg_sendto_timeout(fd[0], whole, big, 0, MSG_TIMEOUT)
+	     != big, "sendto returns message size");
+	pthread_join(tid, NULL);
+	TEST(r.bad, "sendv and sendto messages received intact");
+
+	TEST(slurm_msg_sendv_timeout(fd[0], iov, MSG_IOV_MAX + 1,
+				     MSG_TIMEOUT) >= 0,
+	     "sendv rejects too many pieces");
+	close(fd[0]);
+	close(fd[1]);
+	xfree(whole);
+
+	body = xmalloc(BENCH_BODY);
+	memset(body, 'b', BENCH_BODY);
+	_bench_forward("forward 1MB, copy + 2 sends", body, _send_copy);
+	_bench_forward("forward 1MB, sendv", body, _send_iov);
+	xfree(body);
+
+	_bench_rpc("tcp rpc, length sent apart", true);
+	_bench_rpc("tcp rpc, sendv", false);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,319 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <src/common/bitstring.h>
+#include <src/common/node_space.h>
+#include <src/common/xmalloc.h>
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+/* Number of reservations used for timing, override with argv[1] */
+#define BENCH_RESV	2000
+#define BENCH_NODES	16384
+#define BENCH_WINDOW	(7 * 24 * 60 * 60)
+#define BENCH_RES	60
+
+typedef struct {
+	time_t start;
+	time_t end;
+	int first;
+	int len;
+} resv_t;
+
+/*
+ * The table the backfill scheduler used before node_space: an array of
+ * records linked by time and walked from the start for every operation.
+ */
+typedef struct {
+	time_t begin_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;
+	int next;
+} array_rec_t;
+
+static void _array_reserve(array_rec_t *node_space, int *node_space_recs,
+			   uint32_t start_time, uint32_t end_reserve,
+			   bitstr_t *res_bitmap)
+{
+	bool placed = false;
+	int i, j;
+
+	start_time = MAX(start_time, node_space[0].begin_time);
+	for (j = 0; ; ) {
+		if (node_space[j].end_time > start_time) {
+			i = *node_space_recs;
+			node_space[i].begin_time = start_time;
+			node_space[i].end_time = node_space[j].end_time;
+			node_space[j].end_time = start_time;
+			node_space[i].avail_bitmap =
+				bit_copy(node_space[j].avail_bitmap);
+			node_space[i].next = node_space[j].next;
+			node_space[j].next = i;
+			(*node_space_recs)++;
+			placed = true;
+		}
+		if (node_space[j].end_time == start_time)
+			placed = true;
+		if (placed == true) {
+			while ((j = node_space[j].next)) {
+				if (end_reserve < node_space[j].end_time) {
+					i = *node_space_recs;
+					node_space[i].begin_time = end_reserve;
+					node_space[i].end_time =
+						node_space[j].end_time;
+					node_space[j].end_time = end_reserve;
+					node_space[i].avail_bitmap =
+						bit_copy(node_space[j].
+							 avail_bitmap);
+					node_space[i].next = node_space[j].next;
+					node_space[j].next = i;
+					(*node_space_recs)++;
+					break;
+				}
+				if (end_reserve == node_space[j].end_time)
+					break;
+			}
+			break;
+		}
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+
+	for (j = 0; ; ) {
+		if ((node_space[j].begin_time >= start_time) &&
+		    (node_space[j].end_time <= end_reserve))
+			bit_and(node_space[j].avail_bitmap, res_bitmap);
+		if ((node_space[j].begin_time >= end_reserve) ||
+		    ((j = node_space[j].next) == 0))
+			break;
+	}
+
+	for (i = 0; ; ) {
+		if ((j = node_space[i].next) == 0)
+			break;
+		if (!bit_equal(node_space[i].avail_bitmap,
+			       node_space[j].avail_bitmap)) {
+			i = j;
+			continue;
+		}
+		node_space[i].end_time = node_space[j].end_time;
+		node_space[i].next = node_space[j].next;
+		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
+		break;
+	}
+}
+
+static void _array_filter(array_rec_t *node_space, time_t start_res,
+			  time_t end_time, bitstr_t *avail_bitmap)
+{
+	int j;
+
+	for (j = 0; ; ) {
+		if (node_space[j].end_time <= start_res)
+			;
+		else if (node_space[j].begin_time <= end_time)
+			bit_and(avail_bitmap, node_space[j].avail_bitmap);
+		else
+			break;
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+}
+
+static void _node_space_filter(node_space_t *space, time_t start_res,
+			       time_t end_time, bitstr_t *avail_bitmap)
+{
+	node_space_rec_t *rec;
+
+	for (rec = node_space_find(space, start_res); rec; rec = rec->next) {
+		if (rec->end_time <= start_res)
+			;
+		else if (rec->begin_time <= end_time)
+			bit_and(avail_bitmap, rec->avail_bitmap);
+		else
+			break;
+	}
+}
+
+static long _usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+	       (now.tv_usec - start->tv_usec);
+}
+
+static void _report(const char *name, long usec, int cnt)
+{
+	printf("%-28s %8ld usec %7.1f usec/op\n", name, usec,
+	       (double) usec / cnt);
+}
+
+/* Jobs of up to 64 nodes and a day placed at random times in the window,
+ * rounded to the backfill resolution */
+static resv_t *_make_resv(int cnt)
+{
+	resv_t *resv = xmalloc(sizeof(resv_t) * cnt);
+	int i;
+
+	srandom(1);
+	for (i = 0; i < cnt; i++) {
+		resv[i].start = (random() % BENCH_WINDOW) / BENCH_RES *
+				BENCH_RES;
+		resv[i].end = resv[i].start + BENCH_RES +
+			      (random() % (24 * 60 * 60)) / BENCH_RES *
+			      BENCH_RES;
+		resv[i].len = 1 + random() % 64;
+		resv[i].first = random() % BENCH_NODES;
+	}
+	return resv;
+}
+
+/*
+ * Pick nodes for a job from those found available, as the backfill
+ * scheduler does, and build the bitmap of nodes left available.
+ * RET false if too few nodes are available
+ */
+static bool _pick_nodes(resv_t *resv, bitstr_t *avail, bitstr_t *left)
+{
+	int i, cnt = 0;
+
+	if (bit_set_count(avail) < resv->len)
+		return false;
+	bit_nset(left, 0, BENCH_NODES - 1);
+	for (i = resv->first; cnt < resv->len; i = (i + 1) % BENCH_NODES) {
+		if (bit_test(avail, i)) {
+			bit_clear(left, i);
+			cnt++;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	node_space_t *space;
+	node_space_rec_t *rec;
+	array_rec_t *array;
+	resv_t *resv;
+	bitstr_t *all, *a1, *a2, *left;
+	struct timeval start;
+	int i, recs, cnt = BENCH_RESV, bad;
+
+	if (argc > 1)
+		cnt = atoi(argv[1]);
+
+	all = bit_alloc(BENCH_NODES);
+	bit_nset(all, 0, BENCH_NODES - 1);
+	a1 = bit_alloc(BENCH_NODES);
+	a2 = bit_alloc(BENCH_NODES);
+	left = bit_alloc(BENCH_NODES);
+
+	/* Splitting and merging */
+	space = node_space_init(0, 1000, all);
+	bit_copybits(a1, all);
+	bit_clear(a1, 5);
+	node_space_reserve(space, 100, 200, a1);
+	TEST(node_space_count(space) != 3, "reserve splits record");
+	rec = node_space_find(space, 150);
+	TEST(!rec || (rec->begin_time != 100) || (rec->end_time != 200) ||
+	     bit_test(rec->avail_bitmap, 5), "find reserved record");
+	node_space_reserve(space, 200, 1500, a1);
+	TEST(node_space_count(space) != 2, "reserve merges identical records");
+	rec = node_space_find(space, 999);
+	TEST(!rec || (rec->begin_time != 100) || (rec->end_time != 1000),
+	     "merged record covers end of window");
+	TEST(node_space_find(space, 50) != node_space_first(space),
+	     "find before reservation");
+	node_space_reserve(space, 2000, 3000, a1);
+	TEST(node_space_count(space) != 2, "reserve beyond window");
+	node_space_free(space);
+
+	/*
+	 * Compare with the array table on random reservations: both must
+	 * report the same nodes available for every job
+	 */
+	resv = _make_resv(cnt);
+	array = xmalloc(sizeof(array_rec_t) * (cnt * 2 + 1));
+	array[0].end_time = BENCH_WINDOW;
+	array[0].avail_bitmap = bit_copy(all);
+	recs = 1;
+	space = node_space_init(0, BENCH_WINDOW, all);
+	bad = 0;
+	for (i = 0; i < cnt; i++) {
+		bit_copybits(a1, all);
+		bit_copybits(a2, all);
+		_array_filter(array, resv[i].start, resv[i].end, a1);
+		_node_space_filter(space, resv[i].start, resv[i].end, a2);
+		if (!bit_equal(a1, a2))
+			bad++;
+		if (!_pick_nodes(&resv[i], a1, left))
+			continue;
+		_array_reserve(array, &recs, resv[i].start, resv[i].end, left);
+		node_space_reserve(space, resv[i].start, resv[i].end, left);
+	}
+	TEST(bad, "node_space matches array table");
+	for (i = 0; ; ) {
+		FREE_NULL_BITMAP(array[i].avail_bitmap);
+		if ((i = array[i].next) == 0)
+			break;
+	}
+	node_space_free(space);
+
+	/* Timing of the reservations and job tests of a backfill cycle */
+	memset(array, 0, sizeof(array_rec_t) * (cnt * 2 + 1));
+	array[0].end_time = BENCH_WINDOW;
+	array[0].avail_bitmap = bit_copy(all);
+	recs = 1;
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++) {
+		bit_copybits(a1, all);
+		_array_filter(array, resv[i].start, resv[i].end, a1);
+		if (_pick_nodes(&resv[i], a1, left))
+			_array_reserve(array, &recs, resv[i].start,
+				       resv[i].end, left);
+	}
+	_report("array table", _usec_since(&start), cnt);
+	printf("array table records: %d\n", recs);
+	for (i = 0; ; ) {
+		FREE_NULL_BITMAP(array[i].avail_bitmap);
+		if ((i = array[i].next) == 0)
+			break;
+	}
+
+	space = node_space_init(0, BENCH_WINDOW, all);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < cnt; i++) {
+		bit_copybits(a1, all);
+		_node_space_filter(space, resv[i].start, resv[i].end, a1);
+		if (_pick_nodes(&resv[i], a1, left))
+			node_space_reserve(space, resv[i].start, resv[i].end,
+					   left);
+	}
+	_report("node_space", _usec_since(&start), cnt);
+	printf("node_space records: %u\n", node_space_count(space));
+	node_space_free(space);
+
+	xfree(resv);
+	xfree(array);
+	FREE_NULL_BITMAP(all);
+	FREE_NULL_BITMAP(a1);
+	FREE_NULL_BITMAP(a2);
+	FREE_NULL_BITMAP(left);
+
+	totals();
+	return failed;
+}
@@ -2,6 +2,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <src/common/pack.h>
 #include <src/common/xmalloc.h>
@@ -17,6 +18,106 @@
 		pass( _msg );       \
 } while (0)
 
+#define REC_CNT 20000
+
+static char *parts[] = { "debug", "batch", "gpu", "long" };
+static char *accts[] = { "physics", "chem", "bio", "astro", "climate" };
+
+/* Pack something resembling a job record: a few unique values, many
+ * repeated strings and small or NO_VAL integers */
+static void _pack_rec(int i, Buf buffer)
+{
+	char name[32], dir[64];
+
+	snprintf(name, sizeof(name), "job_%d", i);
+	snprintf(dir, sizeof(dir), "/home/user%d/run", i % 50);
+	pack32(1000 + i, buffer);
+	pack32(i % 50, buffer);
+	pack32(0xfffffffe, buffer);
+	pack16(i % 3, buffer);
+	pack16(0xfffe, buffer);
+	pack64(0xfffffffffffffffe, buffer);
+	pack_time(1480000000 + i, buffer);
+	pack_time(0, buffer);
+	packstr(parts[i % 4], buffer);
+	packstr(accts[i % 5], buffer);
+	packstr(name, buffer);
+	packstr(dir, buffer);
+	packstr(dir, buffer);
+	packnull(buffer);
+}
+
+static int _unpack_rec(int i, Buf buffer)
+{
+	char name[32], dir[64], *str = NULL, *ptr;
+	uint16_t u16;
+	uint32_t u32, len;
+	uint64_t u64;
+	time_t t;
+	int bad = 0;
+
+	snprintf(name, sizeof(name), "job_%d", i);
+	snprintf(dir, sizeof(dir), "/home/user%d/run", i % 50);
+	bad |= unpack32(&u32, buffer) || (u32 != 1000 + i);
+	bad |= unpack32(&u32, buffer) || (u32 != i % 50);
+	bad |= unpack32(&u32, buffer) || (u32 != 0xfffffffe);
+	bad |= unpack16(&u16, buffer) || (u16 != i % 3);
+	bad |= unpack16(&u16, buffer) || (u16 != 0xfffe);
+	bad |= unpack64(&u64, buffer) || (u64 != 0xfffffffffffffffe);
+	bad |= unpack_time(&t, buffer) || (t != 1480000000 + i);
+	bad |= unpack_time(&t, buffer) || (t != 0);
+	bad |= unpackstr_ptr(&ptr, &len, buffer) || strcmp(ptr, parts[i % 4]);
+	bad |= unpackstr_ptr(&ptr, &len, buffer) || strcmp(ptr, accts[i % 5]);
+	bad |= unpackstr_xmalloc(&str, &len, buffer) || strcmp(str, name);
+	xfree(str);
+	bad |= unpackstr_xmalloc(&str, &len, buffer) || strcmp(str, dir);
+	xfree(str);
+	bad |= unpackstr_ptr(&ptr, &len, buffer) || strcmp(ptr, dir);
+	bad |= unpackstr_xmalloc(&str, &len, buffer) || (str != NULL);
+	return bad;
+}
+
+/* Pack REC_CNT records, plain or in compact form, then unpack them */
+static void _test_records(int compact, uint32_t *size)
+{
+	Buf buffer = init_buf(0);
+	struct timeval start, end;
+	char *data;
+	uint32_t cnt;
+	int i, bad = 0;
+
+	gettimeofday(&start, NULL);
+	pack32(REC_CNT, buffer);
+	if (compact)
+		compact_buf_start(buffer);
+	for (i = 0; i < REC_CNT; i++)
+		_pack_rec(i, buffer);
+	if (compact)
+		compact_buf_end(buffer);
+	packstr("end", buffer);
+	gettimeofday(&end, NULL);
+	*size = get_buf_offset(buffer);
+	printf("%s records: %u bytes, packed in %ld usec\n",
+	       compact ? "compact" : "plain", *size,
+	       (long) ((end.tv_sec - start.tv_sec) * 1000000 +
+		       (end.tv_usec - start.tv_usec)));
+
+	data = xfer_buf_data(buffer);
+	buffer = create_buf(data, *size);
+	bad |= unpack32(&cnt, buffer) || (cnt != REC_CNT);
+	if (compact)
+		compact_buf_start(buffer);
+	for (i = 0; i < REC_CNT; i++)
+		bad |= _unpack_rec(i, buffer);
+	if (compact)
+		compact_buf_end(buffer);
+	bad |= unpackstr_ptr(&data, &cnt, buffer) || strcmp(data, "end") ||
+	       remaining_buf(buffer);
+	free_buf(buffer);
+	TEST(bad, compact ? "un/pack records in compact form" :
+	     "un/pack records");
+}
+
 int main (int argc, char *argv[])
 {
 	Buf buffer;
@@ -83,6 +184,31 @@ int main (int argc, char *argv[])
 	xfree(outstring);
 
 	free_buf(buffer);
+
+	/* A repeated string in compact form refers back to the first copy,
+	 * which must have been unpacked in the same compact section */
+	buffer = init_buf(0);
+	compact_buf_start(buffer);
+	packstr(teststring, buffer);
+	packstr(teststring, buffer);
+	compact_buf_end(buffer);
+	data_size = get_buf_offset(buffer);
+	data = xfer_buf_data(buffer);
+	buffer = create_buf(data, data_size);
+	compact_buf_start(buffer);
+	TEST((unpackstr_ptr(&outbytes, &byte_cnt, buffer) != 0) ||
+	     (unpackstr_ptr(&outbytes, &byte_cnt, buffer) != 0) ||
+	     strcmp(outbytes, teststring), "unpackstr of compact reference");
+	set_buf_offset(buffer, data_size - 1);
+	compact_buf_start(buffer);
+	TEST(unpackstr_ptr(&outbytes, &byte_cnt, buffer) == 0,
+	     "unpackstr of unknown compact reference");
+	free_buf(buffer);
+
+	_test_records(false, &out32);
+	_test_records(true, &byte_cnt);
+	TEST((byte_cnt * 2) > out32, "compact records at most half the size");
+
 	totals();
 	return failed;
 